@@ -0,0 +1,54 @@
+include(setup_paths.cmake)
+# object names from instances traced in child processes (rtrace -n)
+set(ENV{RAYPATH} ".${sep}${rlibpath}")
+file(WRITE ${test_output_dir}/ball.rad
+"void plastic redmat 0 0 5 .8 .1 .1 0 0
+redmat sphere ball 0 0 4 0 0 0 1
+")
+file(WRITE ${test_output_dir}/inst.rad
+"void instance i1 1 ball.oct 0 0
+void instance i2 5 ball.oct -t 3 0 0 0 0
+")
+file(WRITE ${test_output_dir}/rtrace_inst.in
+"0 0 5 0 0 -1
+3 0 5 0 0 -1
+")
+execute_process(
+  WORKING_DIRECTORY ${test_output_dir}
+  COMMAND oconv${CMAKE_EXECUTABLE_SUFFIX} ball.rad
+  OUTPUT_FILE ${test_output_dir}/ball.oct
+  RESULT_VARIABLE res
+)
+if(NOT ${res} EQUAL 0)
+  message(FATAL_ERROR "Bad return value from oconv, res = ${res}")
+endif()
+execute_process(
+  WORKING_DIRECTORY ${test_output_dir}
+  COMMAND oconv${CMAKE_EXECUTABLE_SUFFIX} inst.rad
+  OUTPUT_FILE ${test_output_dir}/inst.oct
+  RESULT_VARIABLE res
+)
+if(NOT ${res} EQUAL 0)
+  message(FATAL_ERROR "Bad return value from oconv, res = ${res}")
+endif()
+foreach(n 1 2)
+  execute_process(
+    WORKING_DIRECTORY ${test_output_dir}
+    COMMAND rtrace${CMAKE_EXECUTABLE_SUFFIX} -w -n ${n} -h -osmMv inst.oct
+    INPUT_FILE ${test_output_dir}/rtrace_inst.in
+    OUTPUT_FILE ${test_output_dir}/rtrace_inst${n}.out
+    RESULT_VARIABLE res
+  )
+  if(NOT ${res} EQUAL 0)
+    message(FATAL_ERROR "Bad return value from rtrace -n ${n}, res = ${res}")
+  endif()
+endforeach()
+
+file(READ ${test_output_dir}/rtrace_inst1.out test_output1)
+file(READ ${test_output_dir}/rtrace_inst2.out test_output2)
+if(test_output1 MATCHES "ball\tredmat\tredmat" AND
+    test_output1 STREQUAL test_output2)
+  message(STATUS "passed")
+else()
+  message(STATUS "failed")
+endif()
@@ -15,7 +15,11 @@ static const char RCSid[] = "$Id: rcalc.c,v 1.27 2016/08/18 00:52:47 greg Exp $"
 #include  "rterror.h"
 #include  "rtmisc.h"
 #include  "rtio.h"
+#include  "rtprocess.h"
 #include  "calcomp.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include  <sys/wait.h>
+#endif
 
 #define  isnum(c)       (isdigit(c) || (c)=='-' || (c)=='.' \
 				|| (c)=='+' || (c)=='e' || (c)=='E')
@@ -24,6 +28,7 @@ static const char RCSid[] = "$Id: rcalc.c,v 1.27 2016/08/18 00:52:47 greg Exp $"
 
 #define  INBSIZ         16384	/* longest record */
 #define  MAXCOL         32      /* number of columns recorded */
+#define  PCHUNKSIZ      (1L<<18)        /* input bytes per parallel chunk */
 
 				/* field type specifications */
 #define  F_NUL          0               /* empty */
@@ -51,6 +56,12 @@ struct field {                  /* record format structure */
 	struct field  *next;            /* next field in record */
 };
 
+struct chunk {                  /* parallel input chunk */
+	long  recno;                    /* number of first record */
+	int  nrec;                      /* records in chunk */
+	int  nbytes;                    /* bytes of record data */
+};
+
 #define  savqstr(s)     strcpy(emalloc(strlen(s)+1),s)
 #define  freqstr(s)     efree(s)
 
@@ -59,6 +70,7 @@ static void scaninp(void), advinp(void), resetinp(void);
 static void putrec(void), putout(void), nbsynch(void);
 static int getrec(void);
 static void execute(char *file);
+static void pexecute(FILE *fp, int conditional, long maxrec);
 static void initinp(FILE *fp);
 static void svpreset(char *eqn);
 static void readfmt(char *spec, int output);
@@ -91,6 +103,8 @@ int  colpos;                    /* output column position */
 
 int  nowarn = 0;                /* non-fatal diagnostic output */
 int  unbuff = 0;		/* unbuffered output (flush each record) */
+int  nproc = 1;			/* number of evaluation processes */
+int  outnoref = 0;		/* is output record number referenced? */
 
 struct {
 	FILE  *fin;                     /* input file */
@@ -153,6 +167,9 @@ char  *argv[]
 		case 'n':
 			noinput = 1;
 			break;
+		case 'N':
+			nproc = atoi(argv[++i]);
+			break;
 		case 'i':
 			switch (argv[i][2]) {
 			case '\0':
@@ -229,11 +246,14 @@ char  *argv[]
 		userr:
 			eputs("Usage: ");
 			eputs(argv[0]);
-eputs(" [-b][-l][-n][-p][-w][-u][-tS][-s svar=sval][-e expr][-f source][-i infmt][-o outfmt] [file]\n");
+eputs(" [-b][-l][-n][-p][-w][-u][-N nproc][-tS][-s svar=sval][-e expr][-f source][-i infmt][-o outfmt] [file]\n");
 			quit(1);
 		}
 	if (otype != 'a')
 		SET_FILE_BINARY(stdout);
+#if defined(_WIN32) || defined(_WIN64)
+	nproc = 1;		/* no fork() */
+#endif
 #ifdef getc_unlocked		/* avoid lock/unlock overhead */
 	flockfile(stdout);
 #endif
@@ -249,6 +269,8 @@ eputs(" [-b][-l][-n][-p][-w][-u][-tS][-s svar=sval][-e expr][-f source][-i infmt
 	}
 	if (blnkeq)             /* for efficiency */
 		nbsynch();
+				/* records independent of output count? */
+	outnoref = (varlookup("outno") != NULL);
 
 	if (i == argc)          /* from stdin */
 		execute(NULL);
@@ -322,6 +344,15 @@ char  *file
 #endif
 	if (inpfmt != NULL)
 		initinp(fp);
+	else if ((nproc > 1) & !outnoref & !unbuff &&
+			!(conditional && outcnt)) {
+		pexecute(fp, conditional,
+			!incnt ? (conditional ? 0 : outcnt) :
+			(!outcnt || conditional) ? incnt :
+			outcnt < incnt ? outcnt : incnt);
+		fclose(fp);
+		return;
+	}
 	
 	while (getinputrec(fp)) {
 		varset("recno", '=', (double)++nrecs);
@@ -341,6 +372,182 @@ char  *file
 }
 
 
+#if !defined(_WIN32) && !defined(_WIN64)
+static int
+getchunk(		/* read next chunk of input records */
+FILE  *fp,
+struct chunk  *ch,
+char  *cbuf,
+long  *nrp,
+long  maxrec
+)
+{
+	int  rsiz = 0;
+	
+	if (nbicols)
+		rsiz = nbicols*(tolower(itype)=='d' ? sizeof(double) :
+						sizeof(float));
+	ch->recno = *nrp + 1;
+	ch->nrec = ch->nbytes = 0;
+	while (ch->nbytes <= PCHUNKSIZ - INBSIZ &&
+			(!maxrec || *nrp < maxrec) && getinputrec(fp)) {
+		if (!rsiz)			/* keep terminating nul */
+			rsiz = strlen(inpbuf) + 1;
+		memcpy(cbuf + ch->nbytes, inpbuf, rsiz);
+		ch->nbytes += rsiz;
+		if (!nbicols)
+			rsiz = 0;
+		ch->nrec++;
+		++*nrp;
+	}
+	return(ch->nrec);
+}
+
+
+static void
+pchild(			/* evaluate chunks of records, send output back */
+int  ifd,
+int  ofd,
+int  conditional
+)
+{
+	char  *cbuf = emalloc(PCHUNKSIZ);
+	struct chunk  ch;
+	FILE  *tfp;
+	char  *cp;
+	long  olen, n;
+	int  i;
+				/* our output goes to temporary file */
+	if ((tfp = tmpfile()) == NULL || dup2(fileno(tfp), fileno(stdout)) < 0) {
+		eputs("cannot create temporary output file\n");
+		quit(1);
+	}
+	while (readbuf(ifd, (char *)&ch, sizeof(ch)) == sizeof(ch)) {
+		if (readbuf(ifd, cbuf, ch.nbytes) != ch.nbytes)
+			break;
+		rewind(stdout);
+		cp = cbuf;
+		for (i = 0; i < ch.nrec; i++) {
+			if (nbicols) {
+				n = (cbuf + ch.nbytes - cp)/(ch.nrec - i);
+				memcpy(inpbuf, cp, n);
+			} else {
+				n = strlen(cp) + 1;
+				strcpy(inpbuf, cp);
+			}
+			cp += n;
+			varset("recno", '=', (double)(ch.recno + i));
+			colflg = 0;
+			eclock++;
+			if (!conditional || varvalue("cond") > 0.0)
+				putout();
+		}
+		if (fflush(stdout) == EOF || (olen = ftell(stdout)) < 0)
+			break;
+		if (writebuf(ofd, (char *)&olen, sizeof(olen)) != sizeof(olen))
+			break;
+		lseek(fileno(tfp), 0L, SEEK_SET);
+		for ( ; olen > 0; olen -= n) {
+			n = olen < PCHUNKSIZ ? olen : PCHUNKSIZ;
+			if (readbuf(fileno(tfp), cbuf, n) != n ||
+					writebuf(ofd, cbuf, n) != n)
+				_exit(1);
+		}
+	}
+	_exit(0);
+}
+
+
+static void
+pexecute(		/* process records in parallel */
+FILE  *fp,
+int  conditional,
+long  maxrec
+)
+{
+	char  *cbuf = emalloc(PCHUNKSIZ);
+	int  *ifd = (int *)emalloc(nproc*sizeof(int));
+	int  *ofd = (int *)emalloc(nproc*sizeof(int));
+	struct chunk  ch;
+	long  nrecs = 0;
+	long  olen, n;
+	int  kend, eof;
+	int  k, i;
+	int  p1[2], p2[2];
+
+	fflush(stdout);
+	for (i = 0; i < nproc; i++) {	/* start evaluation processes */
+		if (pipe(p1) < 0 || pipe(p2) < 0) {
+			eputs("cannot create pipe\n");
+			quit(1);
+		}
+		if ((n = fork()) == 0) {
+			close(p1[1]); close(p2[0]);
+			for (k = 0; k < i; k++) {
+				close(ifd[k]); close(ofd[k]);
+			}
+			pchild(p1[0], p2[1], conditional);
+		}
+		if (n < 0) {
+			eputs("cannot fork\n");
+			quit(1);
+		}
+		close(p1[0]); close(p2[1]);
+		ifd[i] = p1[1]; ofd[i] = p2[0];
+	}
+	kend = eof = 0;			/* chunk k goes to process k%nproc */
+	for (k = 0; k <= kend; k++) {
+		i = k % nproc;
+		if (k >= nproc) {	/* copy out results in order */
+			if (readbuf(ofd[i], (char *)&olen, sizeof(olen)) !=
+					sizeof(olen))
+				goto childerr;
+			for ( ; olen > 0; olen -= n) {
+				n = olen < PCHUNKSIZ ? olen : PCHUNKSIZ;
+				if (readbuf(ofd[i], cbuf, n) != n)
+					goto childerr;
+				if (fwrite(cbuf, 1, n, stdout) != n)
+					goto writerr;
+			}
+		}
+		if (eof || !getchunk(fp, &ch, cbuf, &nrecs, maxrec)) {
+			eof = 1;
+			continue;
+		}
+		if (writebuf(ifd[i], (char *)&ch, sizeof(ch)) != sizeof(ch) ||
+				writebuf(ifd[i], cbuf, ch.nbytes) != ch.nbytes)
+			goto childerr;
+		kend = k + nproc;	/* collect it at step kend */
+	}
+	for (i = 0; i < nproc; i++) {	/* done */
+		close(ifd[i]); close(ofd[i]);
+	}
+	while (wait(&i) >= 0)
+		if (i)
+			goto childerr;
+	if (fflush(stdout) == EOF)
+		goto writerr;
+	efree(cbuf);
+	efree((char *)ifd);
+	efree((char *)ofd);
+	return;
+childerr:
+	eputs("evaluation process failed\n");
+	quit(1);
+writerr:
+	eputs("write error on standard output\n");
+	quit(1);
+}
+#else
+static void
+pexecute(FILE *fp, int conditional, long maxrec)
+{
+	eputs("parallel evaluation not supported\n");
+	quit(1);
+}
+#endif
+
+
 static void
 putout(void)                /* produce an output record */
 {
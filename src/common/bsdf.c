@@ -50,6 +50,20 @@ struct SDCache_s	*SDcacheList = NULL;
 /* Retain BSDFs in cache list */
 int			SDretainSet = SDretainNone;
 
+/* Memory budget for cumulative distribution cache */
+size_t			SDmaxCDcache = 64L<<20;
+
+#define SD_CDMINKEEP	32		/* never evict most recent entries */
+#define SD_CDHINIT	256		/* initial hash table size */
+
+/* Shared cumulative distribution cache (hashed, LRU ordered) */
+static struct {
+	SDCDst		*head, *tail;	/* most & least recently used */
+	SDCDst		**htab;		/* hash table */
+	unsigned	hsiz;		/* hash table size (power of 2) */
+	SDCDstats	st;		/* statistics */
+} cdCache;
+
 /* Report any error to the indicated stream */
 SDError
 SDreportError(SDError ec, FILE *fp)
@@ -287,20 +301,177 @@ SDaddComponent(SDSpectralDF *odf, int nadd)
 	return df;
 }
 
+/* Compute hash table index for cumulative distribution key */
+static unsigned
+cd_hash(const SDCDkey *key)
+{
+	unsigned long	h = (unsigned long)key->comp >> 3;
+	int		i;
+
+	for (i = 0; i < SD_CDKEYLEN; i++)
+		h = h*1000003UL ^ (unsigned)key->k[i];
+	h ^= h >> 15;
+	return (unsigned)h & (cdCache.hsiz-1);
+}
+
+/* Check if two cumulative distribution keys are equal */
+static int
+cd_keyeq(const SDCDkey *k1, const SDCDkey *k2)
+{
+	int	i;
+
+	if (k1->comp != k2->comp)
+		return 0;
+	for (i = SD_CDKEYLEN; i--; )
+		if (k1->k[i] != k2->k[i])
+			return 0;
+	return 1;
+}
+
+/* Remove entry from LRU list */
+static void
+cd_unlink(SDCDst *cd)
+{
+	if (cd->prev != NULL)
+		cd->prev->next = cd->next;
+	else
+		cdCache.head = cd->next;
+	if (cd->next != NULL)
+		cd->next->prev = cd->prev;
+	else
+		cdCache.tail = cd->prev;
+}
+
+/* Remove entry from cache and free it */
+static void
+cd_free(SDCDst *cd)
+{
+	SDCDst	**hp = &cdCache.htab[cd_hash(&cd->ckey)];
+
+	while (*hp != cd)
+		hp = &(*hp)->hnext;
+	*hp = cd->hnext;
+	cd_unlink(cd);
+	cdCache.st.nent--;
+	cdCache.st.nbytes -= cd->csiz;
+	free(cd);
+}
+
+/* Double hash table size, returning 0 on allocation failure */
+static int
+cd_rehash(void)
+{
+	SDCDst		**otab = cdCache.htab;
+	unsigned	osiz = cdCache.hsiz;
+	SDCDst		*cd;
+	unsigned	i, h;
+
+	cdCache.hsiz = osiz ? 2*osiz : SD_CDHINIT;
+	cdCache.htab = (SDCDst **)calloc(cdCache.hsiz, sizeof(SDCDst *));
+	if (cdCache.htab == NULL) {
+		cdCache.htab = otab;
+		cdCache.hsiz = osiz;
+		return 0;
+	}
+	for (i = 0; i < osiz; i++)
+		while ((cd = otab[i]) != NULL) {
+			otab[i] = cd->hnext;
+			h = cd_hash(&cd->ckey);
+			cd->hnext = cdCache.htab[h];
+			cdCache.htab[h] = cd;
+		}
+	free(otab);
+	return 1;
+}
+
+/* Find cached cumulative distribution, moving it to front (NULL if none) */
+SDCDst *
+SDfindCDist(const SDCDkey *key)
+{
+	SDCDst	*cd = NULL;
+
+	if (cdCache.hsiz)
+		for (cd = cdCache.htab[cd_hash(key)]; cd != NULL; cd = cd->hnext)
+			if (cd_keyeq(&cd->ckey, key))
+				break;
+	if (cd == NULL)
+		return NULL;
+	cdCache.st.nhits++;
+	if (cd != cdCache.head) {	/* move to front of LRU list */
+		cd_unlink(cd);
+		cd->prev = NULL;
+		cd->next = cdCache.head;
+		cdCache.head->prev = cd;
+		cdCache.head = cd;
+	}
+	return cd;
+}
+
+/* Add new cumulative distribution of the given size to shared cache */
+int
+SDaddCDist(SDCDst *cd, const SDCDkey *key, size_t siz)
+{
+	unsigned	h;
+
+	if ((cd == NULL) | (key == NULL))
+		return 0;
+	cdCache.st.nmiss++;
+	if (cdCache.st.nent >= cdCache.hsiz && !cd_rehash() &&
+			!cdCache.hsiz)
+		return 0;		/* no table -- caller frees */
+	cd->ckey = *key;
+	cd->csiz = siz;
+	h = cd_hash(key);
+	cd->hnext = cdCache.htab[h];
+	cdCache.htab[h] = cd;
+	cd->prev = NULL;
+	if ((cd->next = cdCache.head) != NULL)
+		cdCache.head->prev = cd;
+	else
+		cdCache.tail = cd;
+	cdCache.head = cd;
+	cdCache.st.nent++;
+	cdCache.st.nbytes += siz;
+					/* evict least recently used */
+	while ((cdCache.st.nbytes > SDmaxCDcache) &
+			(cdCache.st.nent > SD_CDMINKEEP)) {
+		cd_free(cdCache.tail);
+		cdCache.st.nevict++;
+	}
+	return 1;
+}
+
+/* Free cached cumulative distributions for component (all if NULL) */
+void
+SDfreeCDists(const void *comp)
+{
+	SDCDst	*cd, *cdnext;
+
+	for (cd = cdCache.head; cd != NULL; cd = cdnext) {
+		cdnext = cd->next;
+		if ((comp == NULL) | (cd->ckey.comp == comp))
+			cd_free(cd);
+	}
+}
+
+/* Get statistics for shared cumulative distribution cache */
+void
+SDgetCDstats(SDCDstats *cs)
+{
+	if (cs != NULL)
+		*cs = cdCache.st;
+}
+
 /* Free cached cumulative distributions for BSDF component */
 void
 SDfreeCumulativeCache(SDSpectralDF *df)
 {
 	int	n;
-	SDCDst	*cdp;
 
 	if (df == NULL)
 		return;
 	for (n = df->ncomp; n-- > 0; )
-		while ((cdp = df->comp[n].cdList) != NULL) {
-			df->comp[n].cdList = cdp->next;
-			free(cdp);
-		}
+		SDfreeCDists(&df->comp[n]);
 }
 
 /* Free a spectral distribution function */
@@ -427,7 +598,8 @@ SDcacheFile(const char *fname)
 		SDreportError(SDEmemory, stderr);
 		return NULL;
 	}
-	if (!SDisLoaded(sd) && (ec = SDloadFile(sd, fname))) {
+	if (!SDisLoaded(sd) && SDloadCompiled(sd, fname) != SDEnone &&
+			(ec = SDloadFile(sd, fname))) {
 		SDreportError(ec, stderr);
 		SDfreeCache(sd);
 		sd = NULL;
@@ -624,21 +796,12 @@ SDsizeBSDF(double *projSA, const FVECT v1, const RREAL *v2,
 	return SDEnone;
 }
 
-/* Return BSDF for the given incident and scattered ray vectors */
-SDError
-SDevalBSDF(SDValue *sv, const FVECT outVec, const FVECT inVec, const SDData *sd)
+/* Assign diffuse portion and return non-diffuse DF for the given sides */
+static SDSpectralDF *
+SDpickDF(SDValue *sv, int inFront, int outFront, const SDData *sd)
 {
-	int		inFront, outFront;
 	SDSpectralDF	*sdf;
-	float		coef[SDmaxCh];
-	int		nch, i;
-					/* check arguments */
-	if ((sv == NULL) | (outVec == NULL) | (inVec == NULL) | (sd == NULL))
-		return SDEargument;
-					/* whose side are we on? */
-	inFront = (inVec[2] > 0);
-	outFront = (outVec[2] > 0);
-					/* start with diffuse portion */
+
 	if (inFront & outFront) {
 		*sv = sd->rLambFront;
 		sdf = sd->rf;
@@ -653,6 +816,21 @@ SDevalBSDF(SDValue *sv, const FVECT outVec, const FVECT inVec, const SDData *sd)
 		sdf = (sd->tb != NULL) ? sd->tb : sd->tf;
 	}
 	sv->cieY *= 1./M_PI;
+	return sdf;
+}
+
+/* Return BSDF for the given incident and scattered ray vectors */
+SDError
+SDevalBSDF(SDValue *sv, const FVECT outVec, const FVECT inVec, const SDData *sd)
+{
+	SDSpectralDF	*sdf;
+	float		coef[SDmaxCh];
+	int		nch, i;
+					/* check arguments */
+	if ((sv == NULL) | (outVec == NULL) | (inVec == NULL) | (sd == NULL))
+		return SDEargument;
+					/* start with diffuse portion */
+	sdf = SDpickDF(sv, inVec[2] > 0, outVec[2] > 0, sd);
 					/* add non-diffuse components */
 	i = (sdf != NULL) ? sdf->ncomp : 0;
 	while (i-- > 0) {
@@ -668,6 +846,52 @@ SDevalBSDF(SDValue *sv, const FVECT outVec, const FVECT inVec, const SDData *sd)
 	return SDEnone;
 }
 
+#define	SD_EVBATCH	64		/* vector pairs per component call */
+
+/* Return BSDFs for n incident and scattered ray vector pairs */
+SDError
+SDevalBSDFs(SDValue sv[], int n, const FVECT outVec[], const FVECT inVec[],
+				const SDData *sd)
+{
+	float		coef[SD_EVBATCH][SDmaxCh];
+	int		nch[SD_EVBATCH];
+	SDSpectralDF	*sdf;
+	int		inFront, outFront;
+	int		i, j, m, c, k;
+					/* check arguments */
+	if ((sv == NULL) | (outVec == NULL) | (inVec == NULL) | (sd == NULL) |
+			(n < 0))
+		return SDEargument;
+	for (i = 0; i < n; i += m) {	/* batch pairs on the same sides */
+		inFront = (inVec[i][2] > 0);
+		outFront = (outVec[i][2] > 0);
+		for (m = 1; (i+m < n) & (m < SD_EVBATCH); m++)
+			if (((inVec[i+m][2] > 0) != inFront) |
+					((outVec[i+m][2] > 0) != outFront))
+				break;
+		sdf = SDpickDF(sv+i, inFront, outFront, sd);
+		for (j = 1; j < m; j++)
+			sv[i+j] = sv[i];
+		c = (sdf != NULL) ? sdf->ncomp : 0;
+		while (c-- > 0) {	/* add non-diffuse components */
+			(*sdf->comp[c].func->getBSDFsN)(coef, nch, m,
+					outVec+i, inVec+i, &sdf->comp[c]);
+			for (j = 0; j < m; j++)
+				for (k = nch[j]; k-- > 0; ) {
+					c_cmix(&sv[i+j].spec, sv[i+j].cieY,
+						&sv[i+j].spec, coef[j][k],
+						&sdf->comp[c].cspec[k]);
+					sv[i+j].cieY += coef[j][k];
+				}
+		}
+		for (j = 0; j < m; j++)
+			c_ccvt(&sv[i+j].spec, C_CSXY);
+	}
+	return SDEnone;
+}
+
+#undef SD_EVBATCH
+
 /* Compute directional hemispherical scattering at this incident angle */
 double
 SDdirectHemi(const FVECT inVec, int sflags, const SDData *sd)
@@ -70,9 +70,20 @@ typedef struct {
 	C_COLOR		spec;		/* spectral and (x,y) color */
 } SDValue;
 
+/* Key for cumulative distribution cache (quantized incident direction) */
+#define SD_CDKEYLEN	3
+typedef struct {
+	const void	*comp;		/* owning component */
+	int		k[SD_CDKEYLEN];	/* component-specific key values */
+} SDCDkey;
+
 /* Cached, encoded, cumulative distribution for one incident (solid) angle */
 #define SD_CDIST_BASE(styp)	double		cTotal;	\
-				struct styp	*next
+				struct styp	*next;	\
+				struct styp	*prev;	\
+				struct styp	*hnext;	\
+				SDCDkey		ckey;	\
+				size_t		csiz
 typedef struct SDCDst_s {
 	SD_CDIST_BASE(SDCDst_s);	/* base fields first */
 	/* ...encoded distribution extends struct */
@@ -88,6 +99,10 @@ typedef struct {
 					/* return non-diffuse BSDF */
 	int		(*getBSDFs)(float coef[SDmaxCh], const FVECT outVec,
 				    const FVECT inVec, SDComponent *sdc);
+					/* same for n vector pairs */
+	void		(*getBSDFsN)(float coef[][SDmaxCh], int nch[], int n,
+				    const FVECT outVec[], const FVECT inVec[],
+				    SDComponent *sdc);
 					/* query non-diffuse PSA for vector */
 	SDError		(*queryProjSA)(double *psa, const FVECT v1,
 						const RREAL *v2, int qflags,
@@ -106,7 +121,6 @@ struct SDComp_s {
 	C_COLOR		cspec[SDmaxCh];	/* component spectral bases */
 	const SDFunc	*func;		/* methods for this component */
 	void		*dist;		/* loaded distribution data */
-	SDCDst		*cdList;	/* cumulative distribution cache */
 };
 
 /* Container for non-diffuse BSDF components */
@@ -146,6 +160,17 @@ extern struct SDCache_s {
 
 extern int		SDretainSet;	/* =SDretainNone by default */
 
+/* Shared cumulative distribution cache statistics */
+typedef struct {
+	unsigned long	nhits;		/* lookups found in cache */
+	unsigned long	nmiss;		/* lookups needing new distribution */
+	unsigned long	nevict;		/* entries freed to stay in budget */
+	unsigned	nent;		/* entries currently cached */
+	size_t		nbytes;		/* memory currently cached */
+} SDCDstats;
+
+extern size_t		SDmaxCDcache;	/* cache budget in bytes */
+
 /*****************************************************************
  * The following routines are less commonly used by applications.
  */
@@ -173,6 +198,12 @@ extern void		SDclearBSDF(SDData *sd, const char *fname);
 /* Load a BSDF struct from the given file (keeps name unchanged) */
 extern SDError		SDloadFile(SDData *sd, const char *fname);
 
+/* Load BSDF from compiled file beside XML source if it is up to date */
+extern SDError		SDloadCompiled(SDData *sd, const char *fname);
+
+/* Write compiled file beside XML source for loaded BSDF (see bsdf_c.c) */
+extern SDError		SDsaveCompiled(const SDData *sd, const char *fname);
+
 /* Free data associated with BSDF struct */
 extern void		SDfreeBSDF(SDData *sd);
 
@@ -182,6 +213,18 @@ extern SDData		*SDgetCache(const char *bname);
 /* Free cached cumulative distributions for BSDF component */
 extern void		SDfreeCumulativeCache(SDSpectralDF *df);
 
+/* Find cached cumulative distribution, moving it to front (NULL if none) */
+extern SDCDst		*SDfindCDist(const SDCDkey *key);
+
+/* Add new cumulative distribution to shared cache (caller frees if 0) */
+extern int		SDaddCDist(SDCDst *cd, const SDCDkey *key, size_t siz);
+
+/* Free cached cumulative distributions for component (all if NULL) */
+extern void		SDfreeCDists(const void *comp);
+
+/* Get statistics for shared cumulative distribution cache */
+extern void		SDgetCDstats(SDCDstats *cs);
+
 /* Sample an individual BSDF component */
 extern SDError		SDsampComponent(SDValue *sv, FVECT ioVec,
 					double randX, SDComponent *sdc);
@@ -216,6 +259,11 @@ extern SDError		SDsizeBSDF(double *projSA, const FVECT v1,
 extern SDError		SDevalBSDF(SDValue *sv, const FVECT outVec,
 					const FVECT inVec, const SDData *sd);
 
+/* Return BSDFs for n incident and scattered ray vector pairs */
+extern SDError		SDevalBSDFs(SDValue sv[], int n,
+					const FVECT outVec[], const FVECT inVec[],
+					const SDData *sd);
+
 /* Compute directional hemispherical scattering at given incident angle */
 extern double		SDdirectHemi(const FVECT inVec,
 					int sflags, const SDData *sd);
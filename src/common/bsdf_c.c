@@ -0,0 +1,275 @@
+#ifndef lint
+static const char RCSid[] = "$Id$";
+#endif
+/*
+ *  bsdf_c.c
+ *
+ *  Compiled BSDF files for fast loading of tensor tree data.
+ *
+ *  A compiled BSDF sits beside its XML source with an added ".sdc"
+ *  suffix.  It holds the trees and their flattened lookup arrays with
+ *  chroma and extrema already computed, and is memory-mapped read-only
+ *  so that grid and lookup values are shared between processes on the
+ *  same machine.
+ *  The file is only valid on the machine architecture that wrote it,
+ *  and only while the XML source keeps the same length and date.
+ */
+
+#define	_USE_MATH_DEFINES
+#include "rtio.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/stat.h>
+#include "platform.h"
+#include "bsdf.h"
+#include "bsdf_t.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define SDcompSuffix	".sdc"		/* compiled BSDF file suffix */
+#define SDtempSuffix	".sdc_tmp"	/* suffix while being written */
+
+static const char	SDcompMagic[16] = "#?SDcompiled 2\n";
+
+/* Compiled BSDF file header (component records & trees follow) */
+typedef struct {
+	char		magic[16];	/* identifier and version */
+	int32_t		horder;		/* byte order check (1) */
+	int16_t		nodeHdr;	/* tree node header size */
+	int16_t		hdrSiz;		/* size of this struct */
+	int64_t		flen;		/* length of compiled file */
+	int64_t		srcLen;		/* length of XML source */
+	int64_t		srcTime;	/* XML source modification time */
+	char		matn[SDnameLn];	/* material name */
+	char		makr[SDnameLn];	/* manufacturer */
+	double		dim[3];		/* width, height, thickness */
+	SDValue		rLambFront;	/* diffuse front reflectance */
+	SDValue		rLambBack;	/* diffuse rear reflectance */
+	SDValue		tLamb;		/* diffuse transmission */
+	int64_t		mgf;		/* geometry string offset (0 if none) */
+	int64_t		df[4];		/* rf, rb, tf, tb offsets (0 if none) */
+} SDCompHdr;
+
+/* Get compiled file name for the given XML source (caller frees) */
+static char *
+comp_name(const char *fname, const char *sfx)
+{
+	char	*cname = (char *)malloc(strlen(fname)+strlen(sfx)+1);
+
+	if (cname == NULL)
+		return NULL;
+	strcpy(cname, fname);
+	strcat(cname, sfx);
+	return cname;
+}
+
+/* Release a reference to compiled memory, freeing it after the last */
+void
+SDreleaseCmpMem(SDCmpMem *cm)
+{
+	if (cm == NULL || --cm->nref > 0)
+		return;
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (cm->mapped)
+		munmap(cm->base, cm->len);
+	else
+#endif
+		free(cm->base);
+	free(cm);
+}
+
+/* Map (or read) a compiled file into memory */
+static SDCmpMem *
+load_comp_mem(const char *cname)
+{
+	SDCmpMem	*cm;
+	struct stat	sbuf;
+	int		fd;
+	size_t		nr;
+
+	if ((fd = open(cname, O_RDONLY)) < 0)
+		return NULL;
+	SET_FD_BINARY(fd);
+	if (fstat(fd, &sbuf) < 0 || sbuf.st_size < (off_t)sizeof(SDCompHdr) ||
+			(cm = (SDCmpMem *)calloc(1, sizeof(SDCmpMem))) == NULL) {
+		close(fd);
+		return NULL;
+	}
+	cm->len = sbuf.st_size;
+	cm->nref = 1;
+#if !defined(_WIN32) && !defined(_WIN64)
+	cm->base = (char *)mmap(NULL, cm->len, PROT_READ, MAP_SHARED, fd, 0);
+	if ((void *)cm->base != MAP_FAILED) {
+		cm->mapped = 1;
+		close(fd);
+		return cm;
+	}
+#endif
+	if ((cm->base = (char *)malloc(cm->len)) == NULL) {
+		close(fd);
+		free(cm);
+		return NULL;
+	}
+	for (nr = 0; nr < cm->len; ) {	/* fall back to reading it in */
+		int	n = read(fd, cm->base+nr, cm->len-nr);
+		if (n <= 0) {
+			close(fd);
+			SDreleaseCmpMem(cm);
+			return NULL;
+		}
+		nr += n;
+	}
+	close(fd);
+	return cm;
+}
+
+/* Load BSDF from compiled file beside the given XML source, if current */
+SDError
+SDloadCompiled(SDData *sd, const char *fname)
+{
+	SDSpectralDF	**dfl[4];
+	struct stat	sbuf;
+	SDCompHdr	hdr;
+	SDCmpMem	*cm;
+	SDError		ec = SDEnone;
+	char		*cname;
+	int		i;
+
+	if ((sd == NULL) | (fname == NULL || !*fname))
+		return SDEargument;
+	if (stat(fname, &sbuf) < 0) {
+		sprintf(SDerrorDetail, "Cannot find BSDF \"%s\"", fname);
+		return SDEfile;
+	}
+	if ((cname = comp_name(fname, SDcompSuffix)) == NULL)
+		return SDEmemory;
+	cm = load_comp_mem(cname);
+	free(cname);
+	if (cm == NULL) {
+		sprintf(SDerrorDetail, "No compiled BSDF for \"%s\"", fname);
+		return SDEfile;
+	}
+	memcpy(&hdr, cm->base, sizeof(hdr));
+	if (memcmp(hdr.magic, SDcompMagic, sizeof(hdr.magic)) ||
+			(hdr.horder != 1) | (hdr.nodeHdr != offsetof(SDNode, u)) |
+			(hdr.hdrSiz != sizeof(SDCompHdr)) ||
+			hdr.flen != (int64_t)cm->len) {
+		sprintf(SDerrorDetail, "Incompatible compiled BSDF for \"%s\"",
+				fname);
+		ec = SDEformat;
+	} else if ((hdr.srcLen != (int64_t)sbuf.st_size) |
+			(hdr.srcTime != (int64_t)sbuf.st_mtime)) {
+		sprintf(SDerrorDetail, "Out-of-date compiled BSDF for \"%s\"",
+				fname);
+		ec = SDEfile;
+	}
+	if (ec) {
+		SDreleaseCmpMem(cm);
+		return ec;
+	}
+	SDfreeBSDF(sd);			/* assign header data */
+	strcpy(sd->matn, hdr.matn);
+	strcpy(sd->makr, hdr.makr);
+	memcpy(sd->dim, hdr.dim, sizeof(sd->dim));
+	if (hdr.mgf > 0 && hdr.mgf < hdr.flen) {
+		const char	*mgf = cm->base + hdr.mgf;
+		if (memchr(mgf, '\0', hdr.flen - hdr.mgf) == NULL) {
+			strcpy(SDerrorDetail, "Unterminated geometry in compiled BSDF");
+			ec = SDEformat;
+		} else if ((sd->mgf = (char *)malloc(strlen(mgf)+1)) == NULL)
+			ec = SDEmemory;
+		else
+			strcpy(sd->mgf, mgf);
+	}
+	dfl[0] = &sd->rf; dfl[1] = &sd->rb;
+	dfl[2] = &sd->tf; dfl[3] = &sd->tb;
+	for (i = 0; !ec & (i < 4); i++)	/* rebuild components */
+		if (hdr.df[i])
+			ec = SDmapTreComp(dfl[i], cm, (long)hdr.df[i]);
+	SDreleaseCmpMem(cm);		/* components hold their own refs */
+	if (ec) {
+		SDfreeBSDF(sd);
+		return ec;
+	}
+	sd->rLambFront = hdr.rLambFront;	/* marks BSDF as loaded */
+	sd->rLambBack = hdr.rLambBack;
+	sd->tLamb = hdr.tLamb;
+	return SDEnone;
+}
+
+/* Write compiled file beside the given XML source for the loaded BSDF */
+SDError
+SDsaveCompiled(const SDData *sd, const char *fname)
+{
+	const SDSpectralDF	*dfl[4];
+	struct stat	sbuf;
+	SDCompHdr	hdr;
+	SDError		ec = SDEnone;
+	char		*cname, *tname;
+	long		off;
+	FILE		*fp;
+	int		i;
+
+	if ((sd == NULL) | (fname == NULL || !*fname) || !SDisLoaded(sd))
+		return SDEargument;
+	if (stat(fname, &sbuf) < 0) {
+		sprintf(SDerrorDetail, "Cannot find BSDF \"%s\"", fname);
+		return SDEfile;
+	}
+	if ((cname = comp_name(fname, SDcompSuffix)) == NULL ||
+			(tname = comp_name(fname, SDtempSuffix)) == NULL) {
+		free(cname);
+		return SDEmemory;
+	}
+	if ((fp = fopen(tname, "wb")) == NULL) {
+		sprintf(SDerrorDetail, "Cannot create \"%s\"", tname);
+		free(tname); free(cname);
+		return SDEfile;
+	}
+	memset(&hdr, 0, sizeof(hdr));	/* header is written last */
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	memcpy(hdr.magic, SDcompMagic, sizeof(hdr.magic));
+	hdr.horder = 1;
+	hdr.nodeHdr = offsetof(SDNode, u);
+	hdr.hdrSiz = sizeof(SDCompHdr);
+	hdr.srcLen = sbuf.st_size;
+	hdr.srcTime = sbuf.st_mtime;
+	strcpy(hdr.matn, sd->matn);
+	strcpy(hdr.makr, sd->makr);
+	memcpy(hdr.dim, sd->dim, sizeof(hdr.dim));
+	hdr.rLambFront = sd->rLambFront;
+	hdr.rLambBack = sd->rLambBack;
+	hdr.tLamb = sd->tLamb;
+	if (sd->mgf != NULL) {
+		hdr.mgf = ftell(fp);
+		fwrite(sd->mgf, 1, strlen(sd->mgf)+1, fp);
+	}
+	dfl[0] = sd->rf; dfl[1] = sd->rb;
+	dfl[2] = sd->tf; dfl[3] = sd->tb;
+	for (i = 0; !ec & (i < 4); i++)
+		if (dfl[i] != NULL && !(ec = SDwriteTreComp(&off, fp, dfl[i])))
+			hdr.df[i] = off;
+	if (!ec) {
+		hdr.flen = ftell(fp);
+		if (fseek(fp, 0L, SEEK_SET) < 0 ||
+				fwrite(&hdr, sizeof(hdr), 1, fp) != 1) {
+			sprintf(SDerrorDetail, "Error writing \"%s\"", tname);
+			ec = SDEfile;
+		}
+	}
+	if (fclose(fp) == EOF && !ec) {
+		sprintf(SDerrorDetail, "Error writing \"%s\"", tname);
+		ec = SDEfile;
+	}
+	if (!ec && rename(tname, cname) < 0) {
+		sprintf(SDerrorDetail, "Cannot rename \"%s\"", tname);
+		ec = SDEfile;
+	}
+	if (ec)
+		unlink(tname);
+	free(tname); free(cname);
+	return ec;
+}
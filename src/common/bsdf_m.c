@@ -742,6 +742,15 @@ SDgetMtxBSDF(float coef[SDmaxCh], const FVECT outVec,
 	return mBSDF_color(coef, dp, i_ndx, o_ndx);
 }
 
+/* Get Matrix BSDF values for multiple vector pairs */
+static void
+SDgetMtxBSDFs(float coef[][SDmaxCh], int nch[], int n,
+		const FVECT outVec[], const FVECT inVec[], SDComponent *sdc)
+{
+	while (n-- > 0)
+		nch[n] = SDgetMtxBSDF(coef[n], outVec[n], inVec[n], sdc);
+}
+
 /* Query solid angle for vector(s) */
 static SDError
 SDqueryMtxProjSA(double *psa, const FVECT v1, const RREAL *v2,
@@ -829,7 +838,8 @@ SDgetMtxCDist(const FVECT inVec, SDComponent *sdc)
 	SDMat		*dp;
 	int		reverse;
 	SDMatCDst	myCD;
-	SDMatCDst	*cd, *cdlast;
+	SDMatCDst	*cd;
+	SDCDkey		key;
 					/* check arguments */
 	if ((inVec == NULL) | (sdc == NULL) ||
 			(dp = (SDMat *)sdc->dist) == NULL)
@@ -850,30 +860,24 @@ SDgetMtxCDist(const FVECT inVec, SDComponent *sdc)
 		myCD.calen = dp->ninc;
 		reverse = 1;
 	}
-	cdlast = NULL;			/* check for it in cache list */
+	memset(&key, 0, sizeof(key));	/* check for it in shared cache */
+	key.comp = sdc;
+	key.k[0] = myCD.indx;
+	key.k[1] = reverse;
 	/* PLACE MUTEX LOCK HERE FOR THREAD-SAFE */
-	for (cd = (SDMatCDst *)sdc->cdList; cd != NULL;
-					cdlast = cd, cd = cd->next)
-		if (cd->indx == myCD.indx && (cd->calen == myCD.calen) &
-					(cd->ob_priv == myCD.ob_priv) &
-					(cd->ob_vec == myCD.ob_vec))
-			break;
+	cd = (SDMatCDst *)SDfindCDist(&key);
 	if (cd == NULL) {		/* need to allocate new entry */
-		cd = (SDMatCDst *)malloc(sizeof(SDMatCDst) +
-					sizeof(myCD.carr[0])*myCD.calen);
+		size_t	siz = sizeof(SDMatCDst) +
+					sizeof(myCD.carr[0])*myCD.calen;
+		cd = (SDMatCDst *)malloc(siz);
 		if (cd == NULL)
 			return NULL;
 		*cd = myCD;		/* compute cumulative distribution */
-		if (!make_cdist(cd, inVec, dp, reverse)) {
+		if (!make_cdist(cd, inVec, dp, reverse) ||
+				!SDaddCDist((SDCDst *)cd, &key, siz)) {
 			free(cd);
 			return NULL;
 		}
-		cdlast = cd;
-	}
-	if (cdlast != NULL) {		/* move entry to head of cache list */
-		cdlast->next = cd->next;
-		cd->next = (SDMatCDst *)sdc->cdList;
-		sdc->cdList = (SDCDst *)cd;
 	}
 	/* END MUTEX LOCK */
 	return (SDCDst *)cd;		/* ready to go */
@@ -910,6 +914,7 @@ SDsampMtxCDist(FVECT ioVec, double randX, const SDCDst *cdp)
 /* Fixed resolution BSDF methods */
 const SDFunc		SDhandleMtx = {
 				&SDgetMtxBSDF,
+				&SDgetMtxBSDFs,
 				&SDqueryMtxProjSA,
 				&SDgetMtxCDist,
 				&SDsampMtxCDist,
@@ -13,6 +13,8 @@ static const char RCSid[] = "$Id: bsdf_t.c,v 3.47 2018/05/10 22:55:35 greg Exp $
 #define	_USE_MATH_DEFINES
 #include "rtio.h"
 #include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
 #include <math.h>
 #include <ctype.h>
 #include "ezxml.h"
@@ -106,6 +108,29 @@ SDfreeTre(SDNode *st)
 	free(st);
 }
 
+/* Free branches of a compiled tree (grids belong to compiled memory) */
+static void
+SDfreeCmpTre(SDNode *st)
+{
+	int	n;
+
+	if (st == NULL || st->log2GR >= 0)
+		return;
+	for (n = 1 << st->ndim; n--; )
+		SDfreeCmpTre(st->u.t[n]);
+	free(st);
+}
+
+/* Free flattened trees */
+static void
+SDfreeFlat(SDFlatTre *ft)
+{
+	if (ft == NULL)
+		return;
+	free(ft->mem);
+	free(ft);
+}
+
 /* Free a variable-resolution BSDF */
 static void
 SDFreeBTre(void *p)
@@ -114,9 +139,17 @@ SDFreeBTre(void *p)
 
 	if (sdt == NULL)
 		return;
-	SDfreeTre(sdt->stc[tt_Y]);
-	SDfreeTre(sdt->stc[tt_u]);
-	SDfreeTre(sdt->stc[tt_v]);
+	SDfreeFlat(sdt->flat);
+	if (sdt->cmem != NULL) {	/* compiled trees? */
+		SDfreeCmpTre(sdt->stc[tt_Y]);
+		SDfreeCmpTre(sdt->stc[tt_u]);
+		SDfreeCmpTre(sdt->stc[tt_v]);
+		SDreleaseCmpMem(sdt->cmem);
+	} else {
+		SDfreeTre(sdt->stc[tt_Y]);
+		SDfreeTre(sdt->stc[tt_u]);
+		SDfreeTre(sdt->stc[tt_v]);
+	}
 	free(sdt);
 }
 
@@ -504,6 +537,188 @@ SDlookupTre(const SDNode *st, const double *pos, double *hcube)
 	return st->u.v[n];		/* no interpolation */
 }
 
+/* Flattened node group alignment (cache line) */
+#define SD_FLATALIGN	64
+#define SD_FLATGROUP	(SD_FLATALIGN/sizeof(SDFlatNode))
+#define SD_FLATMAXV	(1<<24)		/* maximum flattened leaf values */
+
+/* Builder for flattened trees */
+typedef struct {
+	const SDNode	*root[3];	/* original (Y,u,v) trees */
+	int		ndim;		/* number of dimensions */
+	int		nch;		/* number of trees */
+	SDFlatNode	*node;		/* node array */
+	unsigned	nnodes, nalloc;	/* nodes used and allocated */
+	float		*val;		/* leaf value array */
+	unsigned	nvals, valloc;	/* values used and allocated */
+} SDflatBuild;
+
+/* Allocate a group of nodes starting on a cache line */
+static int
+flat_nodes(SDflatBuild *fb, int n)
+{
+	unsigned	ni = fb->nnodes;
+
+	ni += (SD_FLATGROUP - ni%SD_FLATGROUP) % SD_FLATGROUP;
+	if (ni + n > fb->nalloc) {
+		SDFlatNode	*nnode;
+		fb->nalloc = 2*fb->nalloc + n + SD_FLATGROUP;
+		nnode = (SDFlatNode *)realloc(fb->node,
+					sizeof(SDFlatNode)*fb->nalloc);
+		if (nnode == NULL)
+			return -1;
+		fb->node = nnode;
+	}
+	memset(fb->node + fb->nnodes, 0, sizeof(SDFlatNode)*(ni+n-fb->nnodes));
+	fb->nnodes = ni + n;
+	return ni;
+}
+
+/* Fill in flattened node for the given cube, recursing on branches */
+static int
+flat_fill(SDflatBuild *fb, unsigned ni, const SDNode *cur[3],
+			const int *depth, int d, const unsigned *cpos)
+{
+	const SDNode	*ccur[3];
+	int		cdepth[3];
+	unsigned	ccpos[SD_MAXDIM];
+	double		pos[SD_MAXDIM];
+	int		split = 0, g = 0;
+	unsigned	nleaf, j;
+	int		i, t, n;
+					/* need to branch or how fine a grid? */
+	for (t = fb->nch; t--; )
+		if (cur[t]->log2GR < 0)
+			split = 1;
+		else if (depth[t] + cur[t]->log2GR - d > g)
+			g = depth[t] + cur[t]->log2GR - d;
+	if (split) {			/* subdivide all trees together */
+		if ((n = flat_nodes(fb, 1 << fb->ndim)) < 0)
+			return -1;
+		fb->node[ni].log2GR = -1;
+		fb->node[ni].ndx = n;
+		for (j = 0; j < 1<<fb->ndim; j++) {
+			for (t = fb->nch; t--; )
+				if (cur[t]->log2GR < 0) {
+					ccur[t] = cur[t]->u.t[j];
+					cdepth[t] = d + 1;
+				} else {
+					ccur[t] = cur[t];
+					cdepth[t] = depth[t];
+				}
+			for (i = fb->ndim; i--; )
+				ccpos[i] = cpos[i]<<1 | (j>>i & 1);
+			if (flat_fill(fb, n + j, ccur, cdepth, d+1, ccpos) < 0)
+				return -1;
+		}
+		return 0;
+	}
+	if (fb->ndim*g > 24 || d + g > 30)
+		return -1;		/* unreasonable resolution */
+	nleaf = 1 << fb->ndim*g;
+	if (fb->nvals + nleaf*fb->nch > SD_FLATMAXV)
+		return -1;		/* too big -- use pointer trees */
+	if (fb->nvals + nleaf*fb->nch > fb->valloc) {
+		float	*nval;
+		fb->valloc = 2*fb->valloc + nleaf*fb->nch;
+		nval = (float *)realloc(fb->val, sizeof(float)*fb->valloc);
+		if (nval == NULL)
+			return -1;
+		fb->val = nval;
+	}
+	fb->node[ni].log2GR = g;
+	fb->node[ni].ndx = fb->nvals / fb->nch;
+	for (j = 0; j < nleaf; j++) {	/* sample trees at cell centers */
+		for (i = fb->ndim; i--; )
+			pos[i] = ((double)(cpos[i]<<g |
+					(j>>((fb->ndim-1-i)*g) & ((1<<g)-1))) + .5) /
+				(double)(1U << (d+g));
+		for (t = 0; t < fb->nch; t++)
+			fb->val[fb->nvals++] = SDlookupTre(fb->root[t], pos, NULL);
+	}
+	return 0;
+}
+
+/* Flatten (Y,u,v) trees into a single aligned array for lookups */
+static SDFlatTre *
+SDflattenTre(const SDTre *sdt)
+{
+	SDflatBuild	fb;
+	SDFlatTre	*ft;
+	int		depth[3];
+	unsigned	cpos[SD_MAXDIM];
+	int		ok;
+
+	if (sdt == NULL || sdt->stc[tt_Y] == NULL)
+		return NULL;
+	memset(&fb, 0, sizeof(fb));
+	fb.ndim = sdt->stc[tt_Y]->ndim;
+	fb.root[tt_Y] = sdt->stc[tt_Y];
+	if (sdt->stc[tt_u] != NULL && sdt->stc[tt_v] != NULL) {
+		fb.root[tt_u] = sdt->stc[tt_u];
+		fb.root[tt_v] = sdt->stc[tt_v];
+		fb.nch = 3;
+	} else
+		fb.nch = 1;
+	depth[0] = depth[1] = depth[2] = 0;
+	memset(cpos, 0, sizeof(cpos));
+	ok = (flat_nodes(&fb, 1) == 0 &&
+			flat_fill(&fb, 0, fb.root, depth, 0, cpos) == 0);
+	ft = NULL;
+	if (ok && (ft = (SDFlatTre *)malloc(sizeof(SDFlatTre))) != NULL) {
+		fb.nnodes += (SD_FLATGROUP - fb.nnodes%SD_FLATGROUP) % SD_FLATGROUP;
+		ft->mem = malloc(SD_FLATALIGN + sizeof(SDFlatNode)*fb.nnodes +
+					sizeof(float)*fb.nvals);
+		if (ft->mem == NULL) {
+			free(ft);
+			ft = NULL;
+		}
+	}
+	if (ft != NULL) {		/* copy to aligned memory */
+		ft->ndim = fb.ndim;
+		ft->nch = fb.nch;
+		ft->node = (SDFlatNode *)((char *)ft->mem + SD_FLATALIGN -
+				(size_t)ft->mem % SD_FLATALIGN);
+		memcpy(ft->node, fb.node, sizeof(SDFlatNode)*fb.nnodes);
+		ft->val = (float *)(ft->node + fb.nnodes);
+		memcpy(ft->val, fb.val, sizeof(float)*fb.nvals);
+		ft->nnodes = fb.nnodes;
+		ft->nvals = fb.nvals;
+	}
+	free(fb.node);
+	free(fb.val);
+	return ft;
+}
+
+/* Look up leaf values in flattened tree at the given grid position */
+static const float *
+SDlookupFlat(const SDFlatTre *ft, const double *pos)
+{
+	const SDFlatNode	*fn = ft->node;
+	double			spos[SD_MAXDIM];
+	int			i, n, t;
+
+	while (fn->log2GR < 0) {	/* descend branches */
+		n = 0;
+		for (i = ft->ndim; i--; ) {
+			spos[i] = 2.*pos[i];
+			t = (spos[i] >= 1.);
+			n |= t<<i;
+			spos[i] -= (double)t;
+		}
+		fn = ft->node + fn->ndx + n;
+		pos = spos;
+	}
+	if (fn->log2GR == 0)		/* short cut */
+		return ft->val + fn->ndx*ft->nch;
+	n = t = 0;			/* find grid array index */
+	for (i = ft->ndim; i--; ) {
+		n += (int)((1<<fn->log2GR)*pos[i]) << t;
+		t += fn->log2GR;
+	}
+	return ft->val + (fn->ndx + n)*ft->nch;
+}
+
 /* Convert CIE (Y,u',v') color to our RGB */
 static void
 SDyuv2rgb(double yval, double uprime, double vprime, float rgb[3])
@@ -515,18 +730,14 @@ SDyuv2rgb(double yval, double uprime, double vprime, float rgb[3])
 	c_toSharpRGB(&cxy, yval, rgb);
 }
 
-/* Query BSDF value and sample hypercube for the given vectors */
+/* Compute tree grid position for the given vectors, or 0 if wrong side */
 static int
-SDqueryTre(const SDTre *sdt, float *coef,
-		const FVECT outVec, const FVECT inVec, double *hc)
+SDtreGridPos(const SDTre *sdt, double gridPos[4],
+		const FVECT outVec, const FVECT inVec)
 {
 	const RREAL	*vtmp;
-	float		yval;
 	FVECT		rOutVec;
-	double		gridPos[4];
-
-	if (sdt->stc[tt_Y] == NULL)	/* paranoia, I hope */
-		return 0;
+	int		i;
 
 	switch (sdt->sidef) {		/* whose side are you on? */
 	case SD_FREFL:
@@ -567,6 +778,46 @@ SDqueryTre(const SDTre *sdt, float *coef,
 		SDdisk2square(gridPos+2, outVec[0], outVec[1]);
 	} else
 		return 0;		/* should be internal error */
+	for (i = sdt->stc[tt_Y]->ndim; i--; )
+		if (gridPos[i] < 0)	/* keep round-off inside grid */
+			gridPos[i] = 0;
+		else if (gridPos[i] >= 1.)
+			gridPos[i] = 1. - 1./(double)(1L<<31);
+	return sdt->stc[tt_Y]->ndim;
+}
+
+/* Get flattened tree color or grayscale value at grid position */
+static int
+SDflatValue(const SDFlatTre *ft, float *coef, const double *gridPos)
+{
+	const float	*vp = SDlookupFlat(ft, gridPos);
+
+	if (ft->nch == 1) {
+		*coef = vp[tt_Y];
+		return 1;
+	}
+	SDyuv2rgb(vp[tt_Y], vp[tt_u], vp[tt_v], coef);
+	coef[0] *= tt_RGB_coef[0];
+	coef[1] *= tt_RGB_coef[1];
+	coef[2] *= tt_RGB_coef[2];
+	return 3;
+}
+
+/* Query BSDF value and sample hypercube for the given vectors */
+static int
+SDqueryTre(const SDTre *sdt, float *coef,
+		const FVECT outVec, const FVECT inVec, double *hc)
+{
+	float		yval;
+	double		gridPos[4];
+
+	if (sdt->stc[tt_Y] == NULL)	/* paranoia, I hope */
+		return 0;
+	if (!SDtreGridPos(sdt, gridPos, outVec, inVec))
+		return 0;
+					/* flattened lookup if just value */
+	if ((coef != NULL) & (hc == NULL) && sdt->flat != NULL)
+		return SDflatValue(sdt->flat, coef, gridPos);
 					/* get BSDF value */
 	yval = SDlookupTre(sdt->stc[tt_Y], gridPos, hc);
 	if (coef == NULL)		/* just getting hypercube? */
@@ -597,6 +848,63 @@ SDgetTreBSDF(float coef[SDmaxCh], const FVECT outVec,
 	return SDqueryTre((SDTre *)sdc->dist, coef, outVec, inVec, NULL);
 }
 
+#define SD_QBATCH	64		/* grid positions per pass */
+
+/* Compute non-diffuse component for multiple vector pairs */
+static void
+SDgetTreBSDFs(float coef[][SDmaxCh], int nch[], int n,
+		const FVECT outVec[], const FVECT inVec[], SDComponent *sdc)
+{
+	const SDTre	*sdt;
+	double		gridPos[SD_QBATCH][4];
+	const float	*vp[SD_QBATCH];
+	int		i, j, m;
+					/* check arguments */
+	if ((coef == NULL) | (nch == NULL) | (outVec == NULL) |
+			(inVec == NULL) | (sdc == NULL) ||
+			(sdt = (SDTre *)sdc->dist) == NULL) {
+		while (n-- > 0)
+			nch[n] = 0;
+		return;
+	}
+	if (sdt->flat == NULL) {	/* no flattened trees? */
+		while (n-- > 0)
+			nch[n] = SDqueryTre(sdt, coef[n], outVec[n], inVec[n], NULL);
+		return;
+	}
+	for (i = 0; i < n; i += m) {	/* else separate passes per batch */
+		m = (n-i < SD_QBATCH) ? n-i : SD_QBATCH;
+		for (j = 0; j < m; j++)
+			nch[i+j] = SDtreGridPos(sdt, gridPos[j],
+						outVec[i+j], inVec[i+j]);
+		for (j = 0; j < m; j++)
+			vp[j] = nch[i+j] ? SDlookupFlat(sdt->flat, gridPos[j])
+					: NULL;
+		if (sdt->flat->nch == 1) {
+			for (j = 0; j < m; j++)
+				if (vp[j] != NULL) {
+					coef[i+j][0] = vp[j][tt_Y];
+					nch[i+j] = 1;
+				}
+			continue;
+		}
+		for (j = 0; j < m; j++)
+			if (vp[j] != NULL) {
+				SDyuv2rgb(vp[j][tt_Y], vp[j][tt_u], vp[j][tt_v],
+						coef[i+j]);
+				nch[i+j] = 3;
+			}
+		for (j = 0; j < m; j++)
+			if (vp[j] != NULL) {
+				coef[i+j][0] *= tt_RGB_coef[0];
+				coef[i+j][1] *= tt_RGB_coef[1];
+				coef[i+j][2] *= tt_RGB_coef[2];
+			}
+	}
+}
+
+#undef SD_QBATCH
+
 /* Callback to build cumulative distribution using SDtraverseTre() */
 static int
 build_scaffold(float val, const double *cmin, double csiz, void *cptr)
@@ -747,8 +1055,9 @@ SDgetTreCDist(const FVECT inVec, SDComponent *sdc)
 	const SDTre	*sdt;
 	double		inCoord[2];
 	int		i;
-	int		mode;
-	SDTreCDst	*cd, *cdlast;
+	int		mode, lvl;
+	SDCDkey		key;
+	SDTreCDst	*cd;
 					/* check arguments */
 	if ((inVec == NULL) | (sdc == NULL) ||
 			(sdt = (SDTre *)sdc->dist) == NULL)
@@ -788,25 +1097,42 @@ SDgetTreCDist(const FVECT inVec, SDComponent *sdc)
 					/* quantize to avoid f.p. errors */
 	for (i = sdt->stc[tt_Y]->ndim - 2; i--; )
 		inCoord[i] = floor(inCoord[i]/quantum)*quantum + .5*quantum;
-	cdlast = NULL;			/* check for direction in cache list */
+	memset(&key, 0, sizeof(key));	/* check levels in shared cache */
+	key.comp = sdc;
 	/* PLACE MUTEX LOCK HERE FOR THREAD-SAFE */
-	for (cd = (SDTreCDst *)sdc->cdList; cd != NULL;
-					cdlast = cd, cd = cd->next) {
-		if (cd->sidef != mode)
+	for (lvl = 0, cd = NULL; (cd == NULL) & (lvl < SD_CDLEVELS); lvl++) {
+		if (!(sdt->cdLevels & 1<<lvl))
+			continue;
+		key.k[0] = mode | lvl<<4;
+		for (i = sdt->stc[tt_Y]->ndim - 2; i--; )
+			key.k[i+1] = (int)(inCoord[i]*(double)(1<<lvl));
+		cd = (SDTreCDst *)SDfindCDist(&key);
+		if (cd == NULL)
 			continue;
 		for (i = sdt->stc[tt_Y]->ndim - 2; i--; )
 			if ((cd->clim[i][0] > inCoord[i]) |
 					(inCoord[i] >= cd->clim[i][1]))
 				break;
-		if (i < 0)
-			break;		/* means we have a match */
+		if (i >= 0)
+			cd = NULL;	/* should not happen */
 	}
-	if (cd == NULL)			/* need to create new entry? */
-		cdlast = cd = make_cdist(sdt, inCoord, mode != sdt->sidef);
-	if (cdlast != NULL) {		/* move entry to head of cache list */
-		cdlast->next = cd->next;
-		cd->next = (SDTreCDst *)sdc->cdList;
-		sdc->cdList = (SDCDst *)cd;
+	if (cd == NULL) {		/* need to create new entry? */
+		cd = make_cdist(sdt, inCoord, mode != sdt->sidef);
+		if (cd == NULL)
+			return NULL;
+		frexp(cd->clim[0][1] - cd->clim[0][0], &lvl);
+		lvl = 1 - lvl;		/* cell width is 2^-lvl */
+		if ((lvl < 0) | (lvl >= SD_CDLEVELS))
+			lvl = SD_CDLEVELS-1;
+		key.k[0] = mode | lvl<<4;
+		for (i = sdt->stc[tt_Y]->ndim - 2; i--; )
+			key.k[i+1] = (int)(inCoord[i]*(double)(1<<lvl));
+		if (!SDaddCDist((SDCDst *)cd, &key, sizeof(SDTreCDst) +
+					sizeof(cd->carr[0])*cd->calen)) {
+			free(cd);
+			return NULL;
+		}
+		((SDTre *)sdt)->cdLevels |= 1<<lvl;
 	}
 	/* END MUTEX LOCK */
 	return (SDCDst *)cd;		/* ready to go */
@@ -1102,6 +1428,9 @@ load_bsdf_data(SDData *sd, ezxml_t wdb, int ct, int ndim)
 		else /* df == sd->tb */
 			sdt->sidef = SD_BXMIT;
 		sdt->stc[tt_Y] = sdt->stc[tt_u] = sdt->stc[tt_v] = NULL;
+		sdt->cmem = NULL;
+		sdt->flat = NULL;
+		sdt->cdLevels = 0;
 		df->comp[0].dist = sdt;
 		df->comp[0].func = &SDhandleTre;
 	} else {
@@ -1333,11 +1662,23 @@ subtract_min_RGB(C_COLOR *cs, SDNode *stc[])
 	return M_PI * ymin;
 }
 
+/* Initialize our RGB primaries and their Y coefficients on first call */
+static void
+init_RGB_prim(void)
+{
+	int	i = 3*(tt_RGB_coef[1] < .001);
+
+	while (i--) {
+		float	rgb[3];
+		rgb[0] = rgb[1] = rgb[2] = .0f; rgb[i] = 1.f;
+		tt_RGB_coef[i] = c_fromSharpRGB(rgb, &tt_RGB_prim[i]);
+	}
+}
+
 /* Extract and separate diffuse portion of BSDF */
 static void
 extract_diffuse(SDValue *dv, SDSpectralDF *df)
 {
-	int	n;
 	SDTre	*sdt;
 
 	if (df == NULL || df->ncomp <= 0) {
@@ -1348,12 +1689,7 @@ extract_diffuse(SDValue *dv, SDSpectralDF *df)
 	sdt = (SDTre *)df->comp[0].dist;
 					/* subtract minimum color/grayscale */
 	if (sdt->stc[tt_u] != NULL && sdt->stc[tt_v] != NULL) {
-		int	i = 3*(tt_RGB_coef[1] < .001);
-		while (i--) {		/* initialize on first call */
-			float	rgb[3];
-			rgb[0] = rgb[1] = rgb[2] = .0f; rgb[i] = 1.f;
-			tt_RGB_coef[i] = c_fromSharpRGB(rgb, &tt_RGB_prim[i]);
-		}
+		init_RGB_prim();
 		memcpy(df->comp[0].cspec, tt_RGB_prim, sizeof(tt_RGB_prim));
 		dv->cieY = subtract_min_RGB(&dv->spec, sdt->stc);
 	} else {
@@ -1365,6 +1701,19 @@ extract_diffuse(SDValue *dv, SDSpectralDF *df)
 	c_ccvt(&dv->spec, C_CSXY);	/* make sure (x,y) is set */
 }
 
+/* Build flattened lookup trees for component if we can */
+static void
+flatten_comp(SDSpectralDF *df)
+{
+	SDTre	*sdt;
+
+	if (df == NULL || df->ncomp <= 0)
+		return;
+	sdt = (SDTre *)df->comp[0].dist;
+	if (sdt != NULL && sdt->flat == NULL)
+		sdt->flat = SDflattenTre(sdt);	/* else pointer trees */
+}
+
 /* Load a variable-resolution BSDF tree from an open XML file */
 SDError
 SDloadTre(SDData *sd, ezxml_t wtl)
@@ -1417,13 +1766,266 @@ SDloadTre(SDData *sd, ezxml_t wtl)
 		extract_diffuse(&sd->tLamb, sd->tf);
 	if (sd->tb != NULL)
 		extract_diffuse(&sd->tLamb, sd->tb);
+					/* flatten trees for fast lookups */
+	flatten_comp(sd->rf);
+	flatten_comp(sd->rb);
+	flatten_comp(sd->tf);
+	flatten_comp(sd->tb);
 					/* return success */
 	return SDEnone;
 }
 
+/* Size of node header preceding subtrees or values */
+#define SDnodeHdr	offsetof(SDNode, u)
+
+/* Compiled component record (trees precede it in file) */
+typedef struct {
+	int32_t		sidef;		/* which component */
+	int32_t		ndim;		/* tree dimensions */
+	double		minProjSA;	/* minimum projected solid angle */
+	double		maxHemi;	/* maximum directional hemispherical */
+	double		leafMin;	/* smallest leaf width */
+	C_COLOR		cspec[SDmaxCh];	/* component spectral bases */
+	int64_t		stc[3];		/* (Y,u,v) tree offsets (0 if none) */
+	int64_t		flat;		/* flattened tree offset (0 if none) */
+	uint32_t	nfnodes;	/* flattened node count */
+	uint32_t	nfvals;		/* flattened value count */
+	int32_t		fnch;		/* flattened values per leaf */
+	int32_t		fpad;		/* unused */
+} SDTreComp;
+
+/* Pad compiled output to the given power-of-2 boundary and return position */
+static long
+pad_comp(FILE *fp, int align)
+{
+	long	pos = ftell(fp);
+
+	while (pos & (align-1)) {
+		putc(0, fp);
+		++pos;
+	}
+	return pos;
+}
+
+/* Write tree depth-first, returning its offset (or 0 on error) */
+static int64_t
+write_comp_tree(FILE *fp, const SDNode *st)
+{
+	int64_t		coff[1<<SD_MAXDIM];
+	SDNode		nhdr;
+	long		pos;
+	int		n;
+
+	if (st->log2GR < 0)		/* write subtrees first */
+		for (n = 1 << st->ndim; n--; )
+			if (!(coff[n] = write_comp_tree(fp, st->u.t[n])))
+				return 0;
+	pos = pad_comp(fp, 8);
+	memset(&nhdr, 0, sizeof(nhdr));
+	nhdr.ndim = st->ndim;
+	nhdr.log2GR = st->log2GR;
+	fwrite(&nhdr, SDnodeHdr, 1, fp);
+	if (st->log2GR < 0)
+		fwrite(coff, sizeof(int64_t), 1 << st->ndim, fp);
+	else
+		fwrite(st->u.v, sizeof(float), 1 << st->ndim*st->log2GR, fp);
+	return ferror(fp) ? 0 : (int64_t)pos;
+}
+
+/* Write flattened tree nodes and values, returning offset (or 0 on error) */
+static int64_t
+write_comp_flat(FILE *fp, const SDFlatTre *ft)
+{
+	long	pos = pad_comp(fp, SD_FLATALIGN);
+
+	fwrite(ft->node, sizeof(SDFlatNode), ft->nnodes, fp);
+	fwrite(ft->val, sizeof(float), ft->nvals, fp);
+	return ferror(fp) ? 0 : (int64_t)pos;
+}
+
+/* Write variable-resolution BSDF component to compiled file */
+SDError
+SDwriteTreComp(long *offp, FILE *fp, const SDSpectralDF *df)
+{
+	const SDTre	*sdt;
+	SDTreComp	rec;
+	int		i;
+
+	if ((offp == NULL) | (fp == NULL) | (df == NULL))
+		return SDEargument;
+	if (df->ncomp != 1 || df->comp[0].func != &SDhandleTre ||
+			(sdt = (const SDTre *)df->comp[0].dist) == NULL ||
+			sdt->stc[tt_Y] == NULL) {
+		strcpy(SDerrorDetail, "Only tensor tree BSDFs may be compiled");
+		return SDEsupport;
+	}
+	memset(&rec, 0, sizeof(rec));
+	for (i = 3; i--; )
+		if (sdt->stc[i] != NULL &&
+				!(rec.stc[i] = write_comp_tree(fp, sdt->stc[i]))) {
+			strcpy(SDerrorDetail, "Error writing compiled BSDF tree");
+			return SDEfile;
+		}
+	if (sdt->flat != NULL) {	/* lookup arrays go in the file, too */
+		if (!(rec.flat = write_comp_flat(fp, sdt->flat))) {
+			strcpy(SDerrorDetail, "Error writing compiled BSDF tree");
+			return SDEfile;
+		}
+		rec.nfnodes = sdt->flat->nnodes;
+		rec.nfvals = sdt->flat->nvals;
+		rec.fnch = sdt->flat->nch;
+	}
+	rec.sidef = sdt->sidef;
+	rec.ndim = sdt->stc[tt_Y]->ndim;
+	rec.minProjSA = df->minProjSA;
+	rec.maxHemi = df->maxHemi;
+	rec.leafMin = SDsmallestLeaf(sdt->stc[tt_Y]);
+	memcpy(rec.cspec, df->comp[0].cspec, sizeof(rec.cspec));
+	*offp = pad_comp(fp, 8);
+	if (fwrite(&rec, sizeof(rec), 1, fp) != 1) {
+		strcpy(SDerrorDetail, "Error writing compiled BSDF component");
+		return SDEfile;
+	}
+	return SDEnone;
+}
+
+/* Rebuild tree branches, pointing grids into compiled memory */
+static SDNode *
+map_comp_tree(const SDCmpMem *cm, int64_t off, int nd)
+{
+	const SDNode	*sp;
+	SDNode		*st;
+	int64_t		coff;
+	int		n;
+
+	if ((off <= 0) | (off & 7) || off + SDnodeHdr > cm->len)
+		goto badnode;
+	sp = (const SDNode *)(cm->base + off);
+	if (sp->ndim != nd || sp->log2GR*nd > 30)
+		goto badnode;
+	if (sp->log2GR >= 0) {		/* grids stay where they are */
+		if (off + SDnodeHdr + sizeof(float)*(1 << nd*sp->log2GR) >
+				cm->len)
+			goto badnode;
+		return (SDNode *)sp;
+	}
+	if (off + SDnodeHdr + sizeof(int64_t)*(1 << nd) > cm->len)
+		goto badnode;
+	if ((st = SDnewNode(nd, -1)) == NULL)
+		return NULL;
+	for (n = 0; n < 1<<nd; n++) {
+		memcpy(&coff, cm->base + off + SDnodeHdr + sizeof(int64_t)*n,
+				sizeof(coff));
+		if ((st->u.t[n] = map_comp_tree(cm, coff, nd)) == NULL) {
+			SDfreeCmpTre(st);
+			return NULL;
+		}
+	}
+	return st;
+badnode:
+	strcpy(SDerrorDetail, "Corrupted tree in compiled BSDF");
+	return NULL;
+}
+
+/* Point flattened tree into compiled memory after checking its nodes */
+static SDFlatTre *
+map_comp_flat(const SDCmpMem *cm, const SDTreComp *rp)
+{
+	const SDFlatNode	*fn;
+	SDFlatTre		*ft;
+	unsigned		i;
+
+	if ((rp->flat <= 0) | (rp->flat & 7) | !rp->nfnodes ||
+			rp->fnch != (rp->stc[tt_u] && rp->stc[tt_v] ? 3 : 1) ||
+			rp->nfvals % rp->fnch ||
+			rp->flat + sizeof(SDFlatNode)*rp->nfnodes +
+				sizeof(float)*rp->nfvals > cm->len)
+		goto badflat;
+	fn = (const SDFlatNode *)(cm->base + rp->flat);
+	for (i = 0; i < rp->nfnodes; i++)
+		if (fn[i].log2GR < 0) {	/* children follow their parent */
+			if ((fn[i].ndx <= i) | (fn[i].ndx > rp->nfnodes) ||
+					rp->nfnodes - fn[i].ndx < 1U<<rp->ndim)
+				goto badflat;
+		} else if (fn[i].log2GR > 24 || fn[i].log2GR*rp->ndim > 24 ||
+				fn[i].ndx > rp->nfvals/rp->fnch ||
+				rp->nfvals/rp->fnch - fn[i].ndx <
+					1U<<rp->ndim*fn[i].log2GR)
+			goto badflat;
+	if ((ft = (SDFlatTre *)malloc(sizeof(SDFlatTre))) == NULL) {
+		strcpy(SDerrorDetail, "Out of memory for compiled BSDF");
+		return NULL;
+	}
+	ft->ndim = rp->ndim;
+	ft->nch = rp->fnch;
+	ft->node = (SDFlatNode *)fn;
+	ft->val = (float *)(fn + rp->nfnodes);
+	ft->nnodes = rp->nfnodes;
+	ft->nvals = rp->nfvals;
+	ft->mem = NULL;			/* shared with other processes */
+	return ft;
+badflat:
+	strcpy(SDerrorDetail, "Corrupted lookup tree in compiled BSDF");
+	return NULL;
+}
+
+/* Rebuild variable-resolution BSDF component from compiled memory */
+SDError
+SDmapTreComp(SDSpectralDF **dfp, SDCmpMem *cm, long off)
+{
+	SDTreComp	rec;
+	SDSpectralDF	*df;
+	SDTre		*sdt;
+	int		i;
+
+	if ((dfp == NULL) | (cm == NULL))
+		return SDEargument;
+	if ((off <= 0) | (off & 7) || off + sizeof(rec) > cm->len) {
+		strcpy(SDerrorDetail, "Bad component offset in compiled BSDF");
+		return SDEformat;
+	}
+	memcpy(&rec, cm->base + off, sizeof(rec));
+	if ((rec.sidef < SD_FREFL) | (rec.sidef > SD_BXMIT) |
+			(rec.ndim < 3) | (rec.ndim > 4) | !rec.stc[tt_Y]) {
+		strcpy(SDerrorDetail, "Bad component in compiled BSDF");
+		return SDEformat;
+	}
+	if ((df = SDnewSpectralDF(1)) == NULL)
+		return SDEmemory;
+	if ((sdt = (SDTre *)calloc(1, sizeof(SDTre))) == NULL) {
+		SDfreeSpectralDF(df);
+		return SDEmemory;
+	}
+	sdt->sidef = rec.sidef;
+	sdt->cmem = cm;
+	cm->nref++;
+	df->comp[0].dist = sdt;
+	df->comp[0].func = &SDhandleTre;
+	memcpy(df->comp[0].cspec, rec.cspec, sizeof(rec.cspec));
+	df->minProjSA = rec.minProjSA;
+	df->maxHemi = rec.maxHemi;
+	for (i = 3; i--; )
+		if (rec.stc[i] && (sdt->stc[i] =
+				map_comp_tree(cm, rec.stc[i], rec.ndim)) == NULL) {
+			SDfreeSpectralDF(df);
+			return SDEformat;
+		}
+	if (quantum > rec.leafMin)	/* as done in get_extrema() */
+		quantum = rec.leafMin;
+	if (sdt->stc[tt_u] != NULL && sdt->stc[tt_v] != NULL)
+		init_RGB_prim();
+	if (rec.flat && (sdt->flat = map_comp_flat(cm, &rec)) == NULL) {
+		SDfreeSpectralDF(df);	/* else too big to flatten */
+		return SDEformat;
+	}
+	*dfp = df;
+	return SDEnone;
+}
+
 /* Variable resolution BSDF methods */
 const SDFunc SDhandleTre = {
 	&SDgetTreBSDF,
+	&SDgetTreBSDFs,
 	&SDqueryTreProjSA,
 	&SDgetTreCDist,
 	&SDsampTreCDist,
@@ -34,12 +34,42 @@ typedef struct SDNode_s {
 #define SD_FXMIT	3	/* component transmits through front side */
 #define SD_BXMIT	4	/* component transmits through back side */
 
+/* Memory holding a compiled BSDF file (see bsdf_c.c) */
+typedef struct {
+	char	*base;		/* start of mapped or loaded file */
+	size_t	len;		/* file length in bytes */
+	int	mapped;		/* memory-mapped (vs. malloc'ed)? */
+	int	nref;		/* number of references to this memory */
+} SDCmpMem;
+
+/* Flattened tree node (children of a branch are contiguous) */
+typedef struct {
+	int		log2GR;		/* log(2) of grid resolution (< 0 for tree) */
+	unsigned	ndx;		/* first child node or first leaf value */
+} SDFlatNode;
+
+/* Flattened (Y,u,v) tree for value lookups, merged to a common subdivision */
+typedef struct {
+	int		ndim;		/* number of dimensions */
+	int		nch;		/* values per leaf (1 for Y, 3 for Y,u,v) */
+	SDFlatNode	*node;		/* cache-line aligned node array */
+	float		*val;		/* interleaved leaf values */
+	unsigned	nnodes;		/* number of nodes */
+	unsigned	nvals;		/* number of values */
+	void		*mem;		/* allocated memory (NULL if compiled) */
+} SDFlatTre;
+
 /* Variable-resolution BSDF holder */
 typedef struct {
 	int	sidef;		/* which component */
 	SDNode	*stc[3];	/* BSDF (Y,u,v) trees */
+	SDCmpMem *cmem;		/* compiled grid memory (NULL if malloc'ed) */
+	SDFlatTre *flat;	/* flattened trees for lookups (or NULL) */
+	unsigned cdLevels;	/* cell size levels in distribution cache */
 } SDTre;
 
+#define SD_CDLEVELS	24	/* maximum distribution cell levels */
+
 /* Holder for cumulative distribution (sum of BSDF * projSA) */
 typedef struct SDTreCDst_s {
 				/* base fields; must come first */
@@ -63,6 +93,17 @@ extern SDError		SDloadTre(SDData *sd, ezxml_t wtl);
 /* Our matrix handling routines */
 extern const SDFunc	SDhandleTre;
 
+/* Write variable-resolution BSDF component to compiled file */
+extern SDError		SDwriteTreComp(long *offp, FILE *fp,
+					const SDSpectralDF *df);
+
+/* Rebuild variable-resolution BSDF component from compiled memory */
+extern SDError		SDmapTreComp(SDSpectralDF **dfp, SDCmpMem *cm,
+					long off);
+
+/* Release a reference to compiled memory, freeing it after the last */
+extern void		SDreleaseCmpMem(SDCmpMem *cm);
+
 #ifdef __cplusplus
 }
 #endif
@@ -11,6 +11,7 @@ static const char	RCSid[] = "$Id: color.c,v 2.19 2018/04/10 23:42:52 greg Exp $"
 
 #include  <stdio.h>
 #include  <stdlib.h>
+#include  <string.h>
 #include  <math.h>
 #include  "color.h"
 
@@ -193,6 +194,155 @@ freadcolrs(			/* read in an encoded colr scanline */
 }
 
 
+static long
+olddecodecolrs(			/* decode old-style colr scanline from buffer */
+	COLR  *scanline,
+	int  len,
+	const uby8  *bp,
+	long  blen
+)
+{
+	long  n = 0;
+	int  rshift = 0;
+	int  j = 0;
+	int  i;
+
+	while (j < len) {
+		if (n + 4 > blen)
+			return(-1);
+		if ((bp[n] == 1) & (bp[n+1] == 1) & (bp[n+2] == 1)) {
+			i = bp[n+3] << rshift;
+			if ((j == 0) | (j + i > len))
+				return(-1);	/* no previous or overrun */
+			if (scanline != NULL)
+				while (i--) {
+					copycolr(scanline[j], scanline[j-1]);
+					j++;
+				}
+			else
+				j += i;
+			rshift += 8;
+		} else {
+			if (scanline != NULL) {
+				scanline[j][RED] = bp[n];
+				scanline[j][GRN] = bp[n+1];
+				scanline[j][BLU] = bp[n+2];
+				scanline[j][EXP] = bp[n+3];
+			}
+			j++;
+			rshift = 0;
+		}
+		n += 4;
+	}
+	return(n);
+}
+
+
+long
+decodecolrs(			/* decode colr scanline from buffer */
+	COLR  *scanline,	/* NULL to just measure */
+	int  len,
+	const uby8  *bp,
+	long  blen
+)
+{
+	long  n;
+	int  i, j;
+	int  code;
+					/* determine scanline type */
+	if ((len < MINELEN) | (len > MAXELEN) || blen < 4 ||
+			(bp[0] != 2) | (bp[1] != 2) | ((bp[2] & 128) != 0))
+		return(olddecodecolrs(scanline, len, bp, blen));
+	if ((bp[2]<<8 | bp[3]) != len)
+		return(-1);		/* length mismatch! */
+	n = 4;				/* decode each component */
+	for (i = 0; i < 4; i++)
+	    for (j = 0; j < len; ) {
+		if (n >= blen)
+		    return(-1);
+		code = bp[n++];
+		if (code > 128) {	/* run */
+		    code &= 127;
+		    if ((n >= blen) | (j + code > len))
+			return(-1);	/* overrun */
+		    if (scanline != NULL)
+			while (code--)
+			    scanline[j++][i] = bp[n];
+		    else
+			j += code;
+		    n++;
+		} else {		/* non-run */
+		    if ((n + code > blen) | (j + code > len))
+			return(-1);	/* overrun */
+		    if (scanline != NULL)
+			while (code--)
+			    scanline[j++][i] = bp[n++];
+		    else {
+			j += code;
+			n += code;
+		    }
+		}
+	    }
+	return(n);
+}
+
+
+long
+encodecolrs(			/* encode colr scanline into buffer */
+	uby8  *bp,		/* allocated to COLRBUFSIZ(len) */
+	COLR  *scanline,
+	int  len
+)
+{
+	long  n = 0;
+	int  i, j, beg, cnt = 1;
+	int  c2;
+					/* same encoding as fwritecolrs() */
+	if ((len < MINELEN) | (len > MAXELEN)) {
+		memcpy(bp, scanline, sizeof(COLR)*len);
+		return(sizeof(COLR)*len);
+	}
+	bp[n++] = 2;			/* put magic header */
+	bp[n++] = 2;
+	bp[n++] = len>>8;
+	bp[n++] = len&255;
+					/* put components seperately */
+	for (i = 0; i < 4; i++) {
+	    for (j = 0; j < len; j += cnt) {	/* find next run */
+		for (beg = j; beg < len; beg += cnt) {
+		    for (cnt = 1; cnt < 127 && beg+cnt < len &&
+			    scanline[beg+cnt][i] == scanline[beg][i]; cnt++)
+			;
+		    if (cnt >= MINRUN)
+			break;			/* long enough */
+		}
+		if (beg-j > 1 && beg-j < MINRUN) {
+		    c2 = j+1;
+		    while (scanline[c2++][i] == scanline[j][i])
+			if (c2 == beg) {	/* short run */
+			    bp[n++] = 128+beg-j;
+			    bp[n++] = scanline[j][i];
+			    j = beg;
+			    break;
+			}
+		}
+		while (j < beg) {		/* write out non-run */
+		    if ((c2 = beg-j) > 128) c2 = 128;
+		    bp[n++] = c2;
+		    while (c2--)
+			bp[n++] = scanline[j++][i];
+		}
+		if (cnt >= MINRUN) {		/* write out run */
+		    bp[n++] = 128+cnt;
+		    bp[n++] = scanline[beg][i];
+		} else
+		    cnt = 0;
+	    }
+	}
+	return(n);
+}
+
+
 int
 fwritescan(			/* write out a scanline */
 	COLOR  *scanline,
@@ -201,21 +351,10 @@ fwritescan(			/* write out a scanline */
 )
 {
 	COLR  *clrscan;
-	int  n;
-	COLR  *sp;
 					/* get scanline buffer */
-	if ((sp = (COLR *)tempbuffer(len*sizeof(COLR))) == NULL)
+	if ((clrscan = (COLR *)tempbuffer(len*sizeof(COLR))) == NULL)
 		return(-1);
-	clrscan = sp;
-					/* convert scanline */
-	n = len;
-	while (n-- > 0) {
-		setcolr(sp[0], scanline[0][RED],
-				  scanline[0][GRN],
-				  scanline[0][BLU]);
-		scanline++;
-		sp++;
-	}
+	setcolrs(clrscan, scanline, len);	/* convert scanline */
 	return(fwritecolrs(clrscan, len, fp));
 }
 
@@ -233,18 +372,7 @@ freadscan(			/* read in a scanline */
 		return(-1);
 	if (freadcolrs(clrscan, len, fp) < 0)
 		return(-1);
-					/* convert scanline */
-	colr_color(scanline[0], clrscan[0]);
-	while (--len > 0) {
-		scanline++; clrscan++;
-		if (clrscan[0][RED] == clrscan[-1][RED] &&
-			    clrscan[0][GRN] == clrscan[-1][GRN] &&
-			    clrscan[0][BLU] == clrscan[-1][BLU] &&
-			    clrscan[0][EXP] == clrscan[-1][EXP])
-			copycolor(scanline[0], scanline[-1]);
-		else
-			colr_color(scanline[0], clrscan[0]);
-	}
+	colrs_color(scanline, clrscan, len);	/* convert scanline */
 	return(0);
 }
 
@@ -307,6 +435,72 @@ colr_color(			/* convert short to float color */
 }
 
 
+void
+setcolrs(			/* convert float colors to short */
+	COLR  *clrs,
+	COLOR  *cols,
+	int  len
+)
+{
+	double  d, r, g, b;
+	int  e;
+
+	for ( ; len-- > 0; clrs++, cols++) {
+		r = cols[0][RED]; g = cols[0][GRN]; b = cols[0][BLU];
+		d = r > g ? r : g;
+		if (b > d) d = b;
+		if (d <= 1e-32) {
+			clrs[0][RED] = clrs[0][GRN] = clrs[0][BLU] = 0;
+			clrs[0][EXP] = 0;
+			continue;
+		}
+		d = frexp(d, &e) * 255.9999 / d;
+		clrs[0][RED] = (r > 0.0) ? (int)(r * d) : 0;
+		clrs[0][GRN] = (g > 0.0) ? (int)(g * d) : 0;
+		clrs[0][BLU] = (b > 0.0) ? (int)(b * d) : 0;
+		clrs[0][EXP] = e + COLXS;
+	}
+}
+
+
+				/* 2^(i-(COLXS+8)), doubling along the table */
+#define XM1(x)		(float)(x)
+#define XM2(x)		XM1(x), XM1((x)*2.)
+#define XM4(x)		XM2(x), XM2((x)*4.)
+#define XM8(x)		XM4(x), XM4((x)*16.)
+#define XM16(x)		XM8(x), XM8((x)*256.)
+#define XM32(x)		XM16(x), XM16((x)*65536.)
+#define XM64(x)		XM32(x), XM32((x)*4294967296.)
+#define XM128(x)	XM64(x), XM64((x)*18446744073709551616.)
+#define XM0		(1./18446744073709551616./18446744073709551616./256.)
+
+static const float  colr_expmult[256] = {	/* exact powers of 2 */
+	0, XM1(XM0*2.), XM2(XM0*4.), XM4(XM0*16.), XM8(XM0*256.),
+	XM16(XM0*65536.), XM32(XM0*4294967296.),
+	XM64(XM0*18446744073709551616.),
+	XM128(XM0*18446744073709551616.*18446744073709551616.)
+};
+
+
+void
+colrs_color(			/* convert short colors to float */
+	COLOR  *cols,
+	COLR  *clrs,
+	int  len
+)
+{
+	float  f;
+	int  i;
+
+	for (i = 0; i < len; i++) {	/* same result as colr_color() */
+		f = colr_expmult[clrs[i][EXP]];
+		cols[i][RED] = ((float)clrs[i][RED] + 0.5f)*f;
+		cols[i][GRN] = ((float)clrs[i][GRN] + 0.5f)*f;
+		cols[i][BLU] = ((float)clrs[i][BLU] + 0.5f)*f;
+	}
+}
+
+
 int
 bigdiff(				/* c1 delta c2 > md? */
 	COLOR  c1,
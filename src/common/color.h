@@ -32,6 +32,9 @@ extern "C" {
 
 typedef uby8  COLR[4];		/* red, green, blue (or X,Y,Z), exponent */
 
+				/* maximum encoded size of COLR scanline */
+#define  COLRBUFSIZ(len)	(4*((len) + (len)/128 + 2) + 4)
+
 typedef float COLORV;
 typedef COLORV  COLOR[3];	/* red, green, blue (or X,Y,Z) */
 
@@ -207,6 +210,10 @@ extern int	fwritescan(COLOR *scanline, int len, FILE *fp);
 extern int	freadscan(COLOR *scanline, int len, FILE *fp);
 extern void	setcolr(COLR clr, double r, double g, double b);
 extern void	colr_color(COLOR col, COLR clr);
+extern long	decodecolrs(COLR *scanline, int len, const uby8 *bp, long blen);
+extern long	encodecolrs(uby8 *bp, COLR *scanline, int len);
+extern void	setcolrs(COLR *clrs, COLOR *cols, int len);
+extern void	colrs_color(COLOR *cols, COLR *clrs, int len);
 extern int	bigdiff(COLOR c1, COLOR c2, double md);
 					/* defined in spec_rgb.c */
 extern void	spec_rgb(COLOR col, int s, int e);
@@ -3,6 +3,12 @@ static const char RCSid[] = "$Id: instance.c,v 2.12 2016/03/22 03:56:17 greg Exp
 #endif
 /*
  *  instance.c - routines for octree objects.
+ *
+ *  Renderers load only the bounds of an instance octree until a ray
+ *  reaches its cube.  If instmemlim is set, trimscenes() unloads the
+ *  least recently used scenes between primary rays to stay within it.
+ *  An unloaded scene keeps its object numbers, and is reloaded into
+ *  the same slots unless they have been taken in the meantime.
  */
 
 #include "copyright.h"
@@ -20,6 +26,97 @@ static const char RCSid[] = "$Id: instance.c,v 2.12 2016/03/22 03:56:17 greg Exp
 
 static SCENE  *slist = NULL;		/* list of loaded octrees */
 
+long  instmemlim = 0;			/* instance memory limit (0 = none) */
+long  instmem = 0;			/* memory held by loaded scenes */
+unsigned long  instloads = 0;		/* number of scene loads */
+unsigned long  instunloads = 0;		/* number of scene unloads */
+
+static unsigned long  instclock = 0;	/* primary ray counter */
+
+
+static long
+treemem(ot)			/* memory used by octree */
+OCTREE  ot;
+{
+	long  n;
+	int  i;
+
+	if (!istree(ot))
+		return(0);
+	n = 8*sizeof(OCTREE);
+	for (i = 0; i < 8; i++)
+		n += treemem(octkid(ot, i));
+	return(n);
+}
+
+
+static long
+objmem(obj, nobjs)		/* memory freed with objects */
+OBJECT  obj, nobjs;
+{
+	long  n = 0;
+	OBJREC  *o;
+	int  i;
+					/* OBJREC slots are kept */
+	for ( ; nobjs-- > 0; obj++) {
+		o = objptr(obj);
+		n += strlen(o->oname)+1 +
+				sizeof(RREAL)*o->oargs.nfargs;
+		for (i = o->oargs.nsargs; i--; )
+			n += sizeof(char *) + strlen(o->oargs.sarg[i])+1;
+	}
+	return(n);
+}
+
+
+static void
+loadscene(sc, pathname, flags)		/* load what's missing of a scene */
+SCENE  *sc;
+char  *pathname;
+int  flags;
+{
+	flags &= ~sc->ldflags;		/* skip what's already loaded */
+	if (!flags)
+		return;
+					/* refill old slots if we can */
+	if (flags & IO_SCENE && !fillobjects(sc->firstobj, sc->nobjs)) {
+		sc->firstobj = nobjects;
+		sc->nobjs = 0;
+	}
+	readoct(pathname, flags, &sc->scube, NULL);
+	if (flags & IO_SCENE) {
+		if (!sc->nobjs)
+			sc->nobjs = nobjects - sc->firstobj;
+		else if (nextobject() != sc->firstobj + sc->nobjs) {
+			sprintf(errmsg, "octree \"%s\" changed since loaded",
+					pathname);
+			error(USER, errmsg);
+		}
+		fillobjects(OVOID, 0);
+	}
+	sc->ldflags |= flags;
+	if (flags & (IO_TREE|IO_SCENE)) {
+		instmem -= sc->memuse;
+		sc->memuse = treemem(sc->scube.cutree) +
+				objmem(sc->firstobj, sc->nobjs);
+		instmem += sc->memuse;
+		instloads++;
+	}
+}
+
+
+static void
+unloadscene(sc)			/* free scene objects and tree */
+SCENE  *sc;
+{
+	octfree(sc->scube.cutree);
+	sc->scube.cutree = EMPTY;
+	sc->ldflags &= ~(IO_TREE|IO_SCENE);
+	instmem -= sc->memuse;
+	sc->memuse = 0;
+	instunloads++;			/* keep firstobj & nobjs for reload */
+	freeobjects(sc->firstobj, sc->nobjs);	/* may free nested scenes */
+}
 
 SCENE *
 getscene(sname, flags)			/* get new octree reference */
@@ -45,6 +142,8 @@ int  flags;
 				sc->scube.cuorg[2] = 0.;
 		sc->scube.cusize = 0.;
 		sc->firstobj = sc->nobjs = 0;
+		sc->memuse = 0;
+		sc->lastuse = instclock;
 		sc->next = slist;
 		slist = sc;
 	}
@@ -52,14 +151,7 @@ int  flags;
 		sprintf(errmsg, "cannot find octree file \"%s\"", sname);
 		error(SYSTEM, errmsg);
 	}
-	flags &= ~sc->ldflags;		/* skip what's already loaded */
-	if (flags & IO_SCENE)
-		sc->firstobj = nobjects;
-	if (flags)
-		readoct(pathname, flags, &sc->scube, NULL);
-	if (flags & IO_SCENE)
-		sc->nobjs = nobjects - sc->firstobj;
-	sc->ldflags |= flags;
+	loadscene(sc, pathname, flags);
 	sc->nref++;			/* increase reference count */
 	return(sc);
 }
@@ -90,27 +182,38 @@ int  flags;
 	}
 	if (ins->obj == NULL)
 		ins->obj = getscene(o->oargs.sarg[0], flags);
-	else if ((flags &= ~ins->obj->ldflags)) {
-		if (flags & IO_SCENE)
-			ins->obj->firstobj = nobjects;
-		if (flags)
-			readoct(getpath(o->oargs.sarg[0], getrlibpath(), R_OK),
-					flags, &ins->obj->scube, NULL);
-		if (flags & IO_SCENE)
-			ins->obj->nobjs = nobjects - ins->obj->firstobj;
-		ins->obj->ldflags |= flags;
-	}
+	else if (flags & ~ins->obj->ldflags)
+		loadscene(ins->obj, getpath(o->oargs.sarg[0], getrlibpath(),
+				R_OK), flags);
+	ins->obj->lastuse = instclock;
 	return(ins);
 }
 
 
+void
+trimscenes()			/* unload old scenes over memory limit */
+{
+	SCENE  *sc, *lru;
+					/* call between primary rays */
+	instclock++;
+	while ((instmemlim > 0) & (instmem > instmemlim)) {
+		lru = NULL;
+		for (sc = slist; sc != NULL; sc = sc->next)
+			if (sc->ldflags & (IO_TREE|IO_SCENE) &&
+					sc->lastuse < instclock-1 &&
+					(lru == NULL || sc->lastuse < lru->lastuse))
+				lru = sc;
+		if (lru == NULL)	/* keep what last ray used */
+			break;
+		unloadscene(lru);	/* list may change, so start over */
+	}
+}
+
+
 void
 freescene(sc)		/* release a scene reference */
 SCENE *sc;
 {
-	SCENE  shead;
-	register SCENE  *scp;
-
 	if (sc == NULL)
 		return;
 	if (sc->nref <= 0)
@@ -118,20 +221,10 @@ SCENE *sc;
 	sc->nref--;
 	if (sc->nref)			/* still in use? */
 		return;
-	shead.next = slist;		/* else remove from our list */
-	for (scp = &shead; scp->next != NULL; scp = scp->next)
-		if (scp->next == sc) {
-			scp->next = sc->next;
-			sc->next = NULL;
-			break;
-		}
-	if (sc->next != NULL)		/* can't be in list anymore */
-		error(CONSISTENCY, "unlisted scene in freescene");
-	slist = shead.next;
-	freestr(sc->name);		/* free memory */
-	octfree(sc->scube.cutree);
-	freeobjects(sc->firstobj, sc->nobjs);
-	free((void *)sc);
+					/* else unload, but keep slots */
+	if (sc->ldflags & (IO_TREE|IO_SCENE))
+		unloadscene(sc);
+	sc->ldflags = 0;		/* reread bounds if used again */
 }
 
 
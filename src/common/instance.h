@@ -16,6 +16,8 @@ typedef struct scene {
 	int  ldflags;			/* what was loaded */
 	CUBE  scube;			/* scene cube */
 	OBJECT  firstobj, nobjs;	/* first object and count */
+	long  memuse;			/* memory for tree and objects */
+	unsigned long  lastuse;		/* when last used */
 	struct scene  *next;		/* next in list */
 }  SCENE;			/* loaded octree */
 
@@ -25,10 +27,16 @@ typedef struct {
 }  INSTANCE;			/* instance of octree */
 
 
+extern long  instmemlim;		/* instance memory limit (0 = none) */
+extern long  instmem;			/* memory held by loaded scenes */
+extern unsigned long  instloads;	/* number of scene loads */
+extern unsigned long  instunloads;	/* number of scene unloads */
+
 extern SCENE  *getscene(char *sname, int flags);
 extern INSTANCE  *getinstance(OBJREC *o, int flags);
 extern void  freescene(SCENE *sc);
 extern void  freeinstance(OBJREC *o);
+extern void  trimscenes(void);
 
 
 #ifdef __cplusplus
@@ -52,7 +52,9 @@ loadBSDF(char *fname)
 		sprintf(errmsg, "cannot find BSDF file \"%s\"", fname);
 		error(SYSTEM, errmsg);
 	}
-	ec = SDloadFile(sd, pname);
+	ec = SDloadCompiled(sd, pname);		/* compiled sidecar first */
+	if (ec)
+		ec = SDloadFile(sd, pname);
 	if (ec)
 		error(USER, transSDError(ec));
 						/* simple checks */
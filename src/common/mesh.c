@@ -554,7 +554,7 @@ checkmesh(MESH *mp)			/* validate mesh data */
 	}
 					/* check octree */
 	if (mp->ldflags & IO_TREE) {
-		if (isempty(mp->mcube.cutree))
+		if (isempty(mp->mcube.cutree) && mp->bvh == NULL)
 			error(WARNING, "empty mesh octree");
 	}
 					/* check scene data */
@@ -670,10 +670,23 @@ printmeshstats(			/* print out mesh statistics */
 			tcnt+t1cnt+t2cnt,
 			100.*tcnt/(tcnt+t1cnt+t2cnt),
 			100.*t1cnt/(tcnt+t1cnt+t2cnt));
-	fprintf(fp,
-	"\t%d leaves in octree (%.1f%% empty, %.2f avg. set size)\n",
-			lfcnt+lecnt, 100.*lecnt/(lfcnt+lecnt),
-			(double)locnt/lfcnt);
+	if (!isempty(ms->mcube.cutree) || ms->bvh == NULL)
+		fprintf(fp,
+	"\t%d leaves in octree (%.2f MBytes, %.1f%% empty, %.2f avg. set size)\n",
+			lfcnt+lecnt, ((lfcnt+lecnt-1)/7*8*sizeof(OCTREE) +
+				(locnt+lfcnt)*sizeof(OBJECT))/(1024.*1024.),
+			100.*lecnt/(lfcnt+lecnt), (double)locnt/lfcnt);
+	if (ms->bvh != NULL) {
+		int	blcnt = 0;
+		for (i = ms->nbvh; i--; )
+			for (j = ms->bvh[i].nkids; j--; )
+				blcnt += (ms->bvh[i].ntri[j] > 0);
+		fprintf(fp,
+	"\t%d nodes in BVH (%.2f MBytes, %.2f avg. leaf size)\n",
+			ms->nbvh, (ms->nbvh*sizeof(MBVHNODE) +
+				ms->nbvtri*sizeof(OBJECT))/(1024.*1024.),
+			(double)ms->nbvtri/(blcnt + !blcnt));
+	}
 }
 
 
@@ -704,6 +717,10 @@ freemesh(MESH *ms)		/* free mesh data */
 				/* free mesh data */
 	freestr(ms->name);
 	octfree(ms->mcube.cutree);
+	if (ms->bvh != NULL)
+		free((void *)ms->bvh);
+	if (ms->bvtri != NULL)
+		free((void *)ms->bvtri);
 	lu_done(&ms->lut);
 	if (ms->npatches > 0) {
 		MESHPATCH	*pp = ms->patch + ms->npatches;
@@ -73,6 +73,31 @@ typedef struct {
 	short		nj2tris;	/* double joiner triangle count */
 } MESHPATCH;
 
+/*
+ * A mesh may also carry a compressed 4-wide bounding volume hierarchy,
+ * which replaces its octree for ray traversal.  Each node stores its
+ * own origin in cube coordinates and a power-of-two step per axis, so
+ * that the bounds of its children fit in a byte apiece (rounded outward).
+ * A child is either another node or a short run of triangle ID's
+ * in the mesh's leaf list.  Nodes take 60 bytes for up to four
+ * children, and a triangle is listed exactly once, so this is usually
+ * smaller than the octree it replaces, and faster to traverse.
+ */
+
+#define MBVHWIDTH	4		/* children per BVH node */
+#define MBVHLEAF	4		/* maximum triangles per BVH leaf */
+
+/* A compressed BVH node */
+typedef struct {
+	uint32		org[3];		/* node origin in cube coordinates */
+	uby8		qsh[3];		/* quantization step (log2) per axis */
+	uby8		nkids;		/* number of children */
+	uby8		qlo[MBVHWIDTH][3];	/* quantized child minima */
+	uby8		qhi[MBVHWIDTH][3];	/* quantized child maxima */
+	int32		kid[MBVHWIDTH];	/* child node or first leaf triangle */
+	uby8		ntri[MBVHWIDTH];	/* leaf triangles (0 for node) */
+} MBVHNODE;
+
 /* A loaded mesh */
 typedef struct mesh {
 	char		*name;		/* mesh file name */
@@ -85,6 +110,10 @@ typedef struct mesh {
 	MESHPATCH	*patch;		/* allocated mesh patch array */
 	int		npatches;	/* number of mesh patches */
 	OBJREC		*pseudo;	/* mesh pseudo objects */
+	MBVHNODE	*bvh;		/* compressed BVH (root first) */
+	int		nbvh;		/* number of BVH nodes */
+	OBJECT		*bvtri;		/* BVH leaf triangle ID's */
+	int		nbvtri;		/* number of leaf triangles */
 	LUTAB		lut;		/* vertex lookup table */
 	struct mesh	*next;		/* next mesh in list */
 } MESH;
@@ -111,6 +140,10 @@ typedef struct {
 
 				/* mesh format identifier */
 #define MESHFMT		"Radiance_tmesh"
+				/* header line for meshes with BVH */
+#define MBVHSTR		"MESHBVH="
+#define LMBVHSTR	8
+#define isbvhline(s)	(!strncmp(s, MBVHSTR, LMBVHSTR))
 				/* magic number for mesh files */
 #define MESHMAGIC	( 1 *MAXOBJSIZ+311)	/* increment first value */
 
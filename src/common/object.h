@@ -113,14 +113,24 @@ extern int	otype(char *ofname);
 extern void	objerror(OBJREC *o, int etyp, char *msg);
 					/* defined in readfargs.c */
 extern int	readfargs(FUNARGS *fa, FILE *fp);
+extern int	readfalloc(FUNARGS *fa, FILE *fp,
+				void *(*af)(OBJECT, size_t), OBJECT obj);
 extern void	freefargs(FUNARGS *fa);
 					/* defined in readobj.c */
 extern void	readobj(char *inpspec);
 extern void	getobject(char *name, FILE *fp);
 extern OBJECT	newobject(void);
+extern OBJECT	nextobject(void);
+extern int	fillobjects(OBJECT firstobj, OBJECT nobjs);
 extern void	freeobjects(int firstobj, int nobjs);
+extern void	*oballoc(OBJECT obj, size_t n);
+extern char	*obsavstr(OBJECT obj, const char *s);
+extern void	printobjstats(FILE *fp);
 					/* defined in free_os.c */
 extern int	free_os(OBJREC *op);
+					/* defined in sceneio.c */
+extern int	incscene(const void *p);
+extern void	unmapcscene(void);
 
 
 #ifdef __cplusplus
@@ -94,6 +94,8 @@ extern int	readoct(char *fname, int load, CUBE *scene, char *ofn[]);
 
 extern void	readscene(FILE *fp, int objsiz);
 extern void	writescene(int firstobj, int nobjs, FILE *fp);
+extern void	writecscene(int nobjs, FILE *fp);
+extern int	mapcscene(FILE *fp, long nobjs);
 
 
 #ifdef __cplusplus
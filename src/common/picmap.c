@@ -0,0 +1,377 @@
+#ifndef lint
+static const char	RCSid[] = "$Id$";
+#endif
+/*
+ *  picmap.c - random access to Radiance pictures in memory.
+ *
+ *  The pixel data is memory-mapped when possible (or read in),
+ *  and an index of scanline offsets is built when it is loaded.
+ *  Any scanline may then be decoded independently, so several
+ *  processes sharing the map can each work on their own part
+ *  of the picture.  Only pm_readscan() uses the shared buffer.
+ *
+ *  If the picture carries a pyramid of reduced levels (see picmap.h),
+ *  the stored scanline index is used instead of measuring, and the
+ *  levels may be read by tile or by scanline.  Only pm_readlevel()
+ *  uses the cached tile row.
+ *
+ *  Externals declared in picmap.h
+ */
+
+#include "copyright.h"
+
+#include  <stdlib.h>
+#include  <string.h>
+#include  "platform.h"
+#include  "rtio.h"
+#include  "color.h"
+#include  "resolu.h"
+#include  "picmap.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include  <sys/mman.h>
+#endif
+
+
+static int
+pm_loadstream(			/* read rest of stream into memory */
+	PICMAP  *pm,
+	FILE  *fp
+)
+{
+	size_t  alloced = 0;
+	char  buf[8192];
+	size_t  nr;
+
+	while ((nr = fread(buf, 1, sizeof(buf), fp)) > 0) {
+		if (pm->len+nr > alloced) {
+			char	*nb = (char *)realloc(pm->base,
+					alloced = alloced*2 + nr);
+			if (nb == NULL)
+				return(-1);
+			pm->base = nb;
+		}
+		memcpy(pm->base + pm->len, buf, nr);
+		pm->len += nr;
+	}
+	return(ferror(fp) ? -1 : 0);
+}
+
+
+static int
+pm_loadfile(			/* map or read file from current position */
+	PICMAP  *pm,
+	FILE  *fp
+)
+{
+	int	fd = fileno(fp);
+	off_t	skip, flen;
+
+	skip = ftell(fp);
+	flen = lseek(fd, 0, SEEK_END);
+	if ((skip < 0) | (flen < skip)) {	/* not a regular file? */
+		if (skip >= 0)
+			lseek(fd, skip, SEEK_SET);
+		return(pm_loadstream(pm, fp));
+	}
+#if !defined(_WIN32) && !defined(_WIN64)
+	pm->base = (char *)mmap(NULL, flen, PROT_READ, MAP_SHARED, fd, 0);
+	if ((void *)pm->base != MAP_FAILED) {
+		pm->len = flen;
+		pm->mapped = 1;
+		pm->data = (const uby8 *)pm->base + skip;
+		return(0);
+	}
+#endif
+	pm->base = NULL;		/* else read it in */
+	if (fseek(fp, skip, SEEK_SET) < 0)
+		return(-1);
+	return(pm_loadstream(pm, fp));
+}
+
+
+typedef struct {
+	gethfunc	*hf;		/* caller's header function */
+	void		*p;		/* caller's data pointer */
+	int		nl, ts;		/* from PYRAMID= line */
+} PMHEAD;
+
+
+static int
+pm_headline(			/* check for pyramid, pass header line on */
+	char  *s,
+	void  *p
+)
+{
+	PMHEAD	*ph = (PMHEAD *)p;
+
+	if (isPYR(s) && sscanf(s+LPYRSTR, "%d %d", &ph->nl, &ph->ts) != 2)
+		ph->nl = 0;
+	if (ph->hf == NULL)
+		return(0);
+	return((*ph->hf)(s, ph->p));
+}
+
+
+static long
+pm_getoff(			/* get 8-byte offset from index */
+	const uby8  *bp
+)
+{
+	long	r = 0;
+	int	i;
+
+	for (i = 0; i < 8; i++)
+		r = r<<8 | bp[i];
+	return(r);
+}
+
+
+static int
+pm_loadpyr(			/* set up levels from pyramid index */
+	PICMAP  *pm,
+	int  nl,
+	int  ts,
+	long  blen
+)
+{
+	const uby8	*ip;
+	long	io, n;
+	int	l, y;
+
+	if ((nl < 2) | (ts < 1) | (blen < 3*8))
+		return(-1);
+	io = pm_getoff(pm->data + blen - 8);
+	if ((io < 0) | (io > blen - 2*8) ||
+			memcmp(pm->data + io, PYRMAGIC, 8))
+		return(-1);
+	ip = pm->data + io + 8;
+	pm->lev = (PMLEVEL *)calloc(nl, sizeof(PMLEVEL));
+	if (pm->lev == NULL)
+		return(-1);
+	pm->lev[0].sl = pm->sl;
+	pm->lev[0].ns = pm->ns;
+	n = pm->ns + 1;
+	for (l = 1; l < nl; l++) {	/* reduced levels */
+		PMLEVEL	*lp = pm->lev + l;
+		lp->sl = (lp[-1].sl + 1) >> 1;
+		lp->ns = (lp[-1].ns + 1) >> 1;
+		lp->ntx = (lp->sl + ts-1)/ts;
+		lp->nty = (lp->ns + ts-1)/ts;
+		lp->tndx = ip + 8*n;
+		n += (long)lp->ntx*lp->nty + 1;
+	}
+	if (io + 8 + 8*n != blen - 8)
+		goto fail;		/* index size mismatch */
+	pm->sndx = (long *)malloc(sizeof(long)*(pm->ns+1));
+	if (pm->sndx == NULL)
+		goto fail;
+	for (y = 0; y <= pm->ns; y++) {
+		pm->sndx[y] = pm_getoff(ip + 8*y);
+		if ((pm->sndx[y] < (y ? pm->sndx[y-1] : 0)) |
+				(pm->sndx[y] > io))
+			goto fail;
+	}
+	pm->nvalid = pm->ns;
+	pm->nlevels = nl;
+	pm->tsize = ts;
+	return(0);
+fail:
+	free(pm->sndx);
+	pm->sndx = NULL;
+	free(pm->lev);
+	pm->lev = NULL;
+	return(-1);
+}
+
+
+PICMAP *
+pm_load(			/* load binary stream and index scanlines */
+	FILE  *fp,
+	gethfunc  *hf,
+	void  *p
+)
+{
+	PICMAP  *pm;
+	PMHEAD  ph;
+	long  n, blen;
+	int  y;
+
+	if ((pm = (PICMAP *)calloc(1, sizeof(PICMAP))) == NULL)
+		return(NULL);
+	ph.hf = hf; ph.p = p;
+	ph.nl = ph.ts = 0;
+	if (getheader(fp, pm_headline, &ph) < 0 || !fgetsresolu(&pm->rs, fp))
+		goto fail;
+	pm->sl = scanlen(&pm->rs);
+	pm->ns = numscans(&pm->rs);
+	if ((pm->sl <= 0) | (pm->ns <= 0))
+		goto fail;
+	if (pm_loadfile(pm, fp) < 0)
+		goto fail;
+	if (pm->data == NULL)
+		pm->data = (const uby8 *)pm->base;
+	blen = pm->len - (pm->data - (const uby8 *)pm->base);
+	pm->nlevels = 1;
+	if (ph.nl > 1 && pm_loadpyr(pm, ph.nl, ph.ts, blen) == 0)
+		return(pm);		/* use stored index */
+	pm->sndx = (long *)malloc(sizeof(long)*(pm->ns+1));
+	if (pm->sndx == NULL)
+		goto fail;
+	pm->sndx[0] = 0;		/* measure each scanline */
+	for (y = 0; y < pm->ns; y++) {
+		n = decodecolrs(NULL, pm->sl, pm->data + pm->sndx[y],
+				blen - pm->sndx[y]);
+		if (n < 0)
+			break;		/* truncated file */
+		pm->sndx[y+1] = pm->sndx[y] + n;
+	}
+	pm->nvalid = y;
+	return(pm);
+fail:
+	pm_free(pm);
+	return(NULL);
+}
+
+
+int
+pm_readcolrs(			/* decode indexed scanline */
+	PICMAP  *pm,
+	COLR  *scan,
+	int  y
+)
+{
+	if ((y < 0) | (y >= pm->nvalid))
+		return(-1);
+	if (decodecolrs(scan, pm->sl, pm->data + pm->sndx[y],
+			pm->sndx[y+1] - pm->sndx[y]) < 0)
+		return(-1);
+	return(0);
+}
+
+
+int
+pm_readscan(			/* decode indexed scanline to float */
+	PICMAP  *pm,
+	COLOR  *scan,
+	int  y
+)
+{
+	if (pm->cbuf == NULL &&
+			(pm->cbuf = (COLR *)malloc(sizeof(COLR)*pm->sl)) == NULL)
+		return(-1);
+	if (pm_readcolrs(pm, pm->cbuf, y) < 0)
+		return(-1);
+	colrs_color(scan, pm->cbuf, pm->sl);
+	return(0);
+}
+
+
+static int
+pm_dectile(			/* decode tile into strided buffer */
+	PICMAP  *pm,
+	PMLEVEL  *lp,
+	int  tx,
+	int  ty,
+	COLR  *dst,
+	int  stride
+)
+{
+	const int	tw = (tx+1)*pm->tsize > lp->sl ?
+				lp->sl - tx*pm->tsize : pm->tsize;
+	const int	th = (ty+1)*pm->tsize > lp->ns ?
+				lp->ns - ty*pm->tsize : pm->tsize;
+	const long	ti = (long)ty*lp->ntx + tx;
+	long	t0, t1, n;
+	int	y;
+
+	t0 = pm_getoff(lp->tndx + 8*ti);
+	t1 = pm_getoff(lp->tndx + 8*(ti+1));
+	for (y = 0; y < th; y++) {
+		n = decodecolrs(dst, tw, pm->data + t0, t1 - t0);
+		if (n < 0)
+			return(-1);
+		t0 += n;
+		dst += stride;
+	}
+	return(0);
+}
+
+
+int
+pm_readtile(			/* decode tile from reduced level */
+	PICMAP  *pm,
+	int  lvl,
+	int  tx,
+	int  ty,
+	COLR  *tile
+)
+{
+	PMLEVEL	*lp;
+
+	if ((lvl < 1) | (lvl >= pm->nlevels))
+		return(-1);
+	lp = pm->lev + lvl;
+	if ((tx < 0) | (tx >= lp->ntx) | (ty < 0) | (ty >= lp->nty))
+		return(-1);
+	return(pm_dectile(pm, lp, tx, ty, tile,
+			(tx+1)*pm->tsize > lp->sl ?
+				lp->sl - tx*pm->tsize : pm->tsize));
+}
+
+
+int
+pm_readlevel(			/* decode scanline from any level */
+	PICMAP  *pm,
+	int  lvl,
+	COLR  *scan,
+	int  y
+)
+{
+	PMLEVEL	*lp;
+	int	tx, ty;
+
+	if (lvl == 0)
+		return(pm_readcolrs(pm, scan, y));
+	if ((lvl < 1) | (lvl >= pm->nlevels))
+		return(-1);
+	lp = pm->lev + lvl;
+	if ((y < 0) | (y >= lp->ns))
+		return(-1);
+	ty = y / pm->tsize;
+	if ((pm->tbl != lvl) | (pm->tby != ty)) {
+		if (pm->tbuf == NULL && (pm->tbuf = (COLR *)malloc(
+				sizeof(COLR)*pm->tsize*pm->lev[1].sl)) == NULL)
+			return(-1);
+		pm->tbl = 0;		/* decode row of tiles */
+		for (tx = 0; tx < lp->ntx; tx++)
+			if (pm_dectile(pm, lp, tx, ty,
+					pm->tbuf + tx*pm->tsize, lp->sl) < 0)
+				return(-1);
+		pm->tbl = lvl;
+		pm->tby = ty;
+	}
+	memcpy(scan, pm->tbuf + (long)(y - ty*pm->tsize)*lp->sl,
+			sizeof(COLR)*lp->sl);
+	return(0);
+}
+
+
+void
+pm_free(			/* free loaded picture */
+	PICMAP  *pm
+)
+{
+	if (pm == NULL)
+		return;
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (pm->mapped)
+		munmap(pm->base, pm->len);
+	else
+#endif
+		free(pm->base);
+	free(pm->sndx);
+	free(pm->cbuf);
+	free(pm->lev);
+	free(pm->tbuf);
+	free(pm);
+}
@@ -0,0 +1,67 @@
+/* RCSid $Id$ */
+/*
+ * Header for memory-mapped Radiance pictures with scanline index
+ *
+ * Include after "color.h" and "resolu.h"
+ *
+ * A picture may carry a pyramid of reduced-resolution levels after
+ * its scanlines, announced by a "PYRAMID= nlevels tsize" header line.
+ * Each level halves the one before, rounding up, and is stored as
+ * tsize x tsize tiles, each tile an RLE scanline sequence of its
+ * own width.  Readers that ignore this see an ordinary picture.
+ * The section after the last scanline is laid out as:
+ *	level 1 tiles, level 2 tiles, ... (row-major in each level)
+ *	PYRMAGIC
+ *	ns+1 scanline offsets for the full picture
+ *	ntx*nty+1 tile offsets for each reduced level
+ *	offset of PYRMAGIC
+ * All offsets are 8-byte big-endian integers (as putint()) counted
+ * from the first scanline.
+ */
+#ifndef _RAD_PICMAP_H_
+#define _RAD_PICMAP_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PYRSTR		"PYRAMID="	/* header line for reduced levels */
+#define LPYRSTR		8
+#define PYRMAGIC	"#?PYRIDX"	/* start of level index section */
+#define	isPYR(hl)	(!strncmp(hl,PYRSTR,LPYRSTR))
+
+typedef struct {
+	int		sl, ns;		/* scanline length & number */
+	int		ntx, nty;	/* tiles across & down */
+	const uby8	*tndx;		/* tile offset table (ntx*nty+1) */
+} PMLEVEL;		/* reduced-resolution level of picture */
+
+typedef struct {
+	RESOLU		rs;		/* picture resolution */
+	int		sl, ns;		/* scanline length & number */
+	int		nvalid;		/* scanlines present in file */
+	char		*base;		/* loaded or mapped file */
+	size_t		len;		/* length of loaded memory */
+	int		mapped;		/* memory-mapped file? */
+	const uby8	*data;		/* start of encoded scanlines */
+	long		*sndx;		/* scanline offsets (nvalid+1) */
+	COLR		*cbuf;		/* scanline buffer for pm_readscan() */
+	int		nlevels;	/* resolution levels (1 if no pyramid) */
+	int		tsize;		/* tile size in reduced levels */
+	PMLEVEL		*lev;		/* levels (lev[0] is full picture) */
+	COLR		*tbuf;		/* cached row of tiles */
+	int		tbl, tby;	/* level and tile row in tbuf */
+} PICMAP;		/* picture loaded/mapped into memory */
+
+					/* defined in picmap.c */
+extern PICMAP	*pm_load(FILE *fp, gethfunc *hf, void *p);
+extern int	pm_readcolrs(PICMAP *pm, COLR *scan, int y);
+extern int	pm_readscan(PICMAP *pm, COLOR *scan, int y);
+extern int	pm_readtile(PICMAP *pm, int lvl, int tx, int ty, COLR *tile);
+extern int	pm_readlevel(PICMAP *pm, int lvl, COLR *scan, int y);
+extern void	pm_free(PICMAP *pm);
+
+#ifdef __cplusplus
+}
+#endif
+#endif	/* _RAD_PICMAP_H_ */
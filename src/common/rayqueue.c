@@ -0,0 +1,285 @@
+#ifndef lint
+static const char	RCSid[] = "$Id$";
+#endif
+/*
+ *  rayqueue.c - shared-memory ray queue for rtrace and rcontrib.
+ *
+ *  Each side waits for the other's counter by yielding, then sleeping
+ *  briefly, so an idle queue costs little and a busy one has no
+ *  system calls in the way.  (Not yet available on Windows.)
+ *
+ *  Externals declared in rayqueue.h
+ */
+
+#include "copyright.h"
+
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+
+#include  "platform.h"
+#include  "paths.h"
+#include  "rayqueue.h"
+
+#if defined(_WIN32) || defined(_WIN64)
+
+RAYQ *rq_open(char *fname, long nrecs, char *av[]) { return(NULL); }
+RQREC *rq_next(RAYQ *rq) { return(NULL); }
+void rq_submit(RAYQ *rq) { }
+RQREC *rq_result(RAYQ *rq) { return(NULL); }
+int rq_close(RAYQ *rq) { return(-1); }
+RAYQ *rq_attach(char *fname) { return(NULL); }
+RQREC *rq_request(RAYQ *rq, int block) { return(NULL); }
+void rq_putres(RAYQ *rq, const float val[3], double dist) { }
+
+#else	/* ! _WIN32 */
+
+#include  <sched.h>
+#include  <sys/mman.h>
+#include  <sys/stat.h>
+#include  <sys/wait.h>
+
+#if defined(__GNUC__)
+#define rq_sync()	__sync_synchronize()	/* memory barrier */
+#else
+#define rq_sync()
+#endif
+
+
+static void
+rq_pause(			/* wait a little longer each time */
+	int  *np
+)
+{
+	if (++*np < 64)
+		sched_yield();
+	else
+		usleep(*np < 256 ? 20 : 200);
+}
+
+
+static RAYQ *
+rq_map(				/* map queue file */
+	char  *fname,
+	int  fd,
+	size_t  mlen
+)
+{
+	RAYQ  *rq = (RAYQ *)calloc(1, sizeof(RAYQ));
+	void  *mp;
+
+	if (rq == NULL)
+		return(NULL);
+	mp = mmap(NULL, mlen, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+	if (mp == MAP_FAILED) {
+		free(rq);
+		return(NULL);
+	}
+	rq->hp = (RQHEAD *)mp;
+	rq->rec = (RQREC *)(rq->hp + 1);
+	rq->mlen = mlen;
+	rq->fname = fname;
+	return(rq);
+}
+
+
+static void
+rq_unmap(			/* unmap queue and free struct */
+	RAYQ  *rq
+)
+{
+	munmap((void *)rq->hp, rq->mlen);
+	free(rq);
+}
+
+
+RAYQ *
+rq_open(			/* create queue and start renderer */
+	char  *fname,
+	long  nrecs,
+	char  *av[]
+)
+{
+	size_t  mlen = sizeof(RQHEAD) + nrecs*sizeof(RQREC);
+	RAYQ  *rq;
+	char  **nav;
+	int  fd, n;
+
+	if ((nrecs < 1) | (av == NULL) || av[0] == NULL)
+		return(NULL);
+	if ((fd = open(fname, O_RDWR|O_CREAT|O_TRUNC, 0600)) < 0)
+		return(NULL);
+	if (ftruncate(fd, mlen) < 0 || (rq = rq_map(fname, fd, mlen)) == NULL) {
+		close(fd);
+		unlink(fname);
+		return(NULL);
+	}
+	close(fd);
+	memcpy(rq->hp->magic, RQMAGIC, 8);
+	rq->hp->hsiz = sizeof(RQHEAD);
+	rq->hp->rsiz = sizeof(RQREC);
+	rq->hp->nrecs = nrecs;
+	for (n = 0; av[n] != NULL; n++)
+		;
+	if ((nav = (char **)malloc((n+3)*sizeof(char *))) == NULL)
+		goto fail;
+	nav[0] = av[0];			/* insert "-q fname" */
+	nav[1] = "-q";
+	nav[2] = fname;
+	memcpy(nav+3, av+1, n*sizeof(char *));
+	fflush(NULL);
+	if ((rq->pid = fork()) == 0) {
+		execvp(nav[0], nav);
+		perror(nav[0]);
+		_exit(127);
+	}
+	free(nav);
+	if (rq->pid < 0)
+		goto fail;
+	return(rq);
+fail:
+	unlink(fname);
+	rq_unmap(rq);
+	return(NULL);
+}
+
+
+RQREC *
+rq_next(			/* get record for next request */
+	RAYQ  *rq
+)
+{
+	if (rq->nnext - rq->nread >= rq->hp->nrecs)
+		return(NULL);		/* full of unread results */
+	return(rq_slot(rq, rq->nnext++));
+}
+
+
+void
+rq_submit(			/* submit filled requests */
+	RAYQ  *rq
+)
+{
+	rq_sync();
+	rq->hp->nreq = rq->nnext;
+}
+
+
+RQREC *
+rq_result(			/* wait for next result */
+	RAYQ  *rq
+)
+{
+	int  n = 0;
+
+	if (rq->nread >= rq->nnext)
+		return(NULL);		/* nothing outstanding */
+	if (rq->hp->nreq < rq->nnext)
+		rq_submit(rq);
+	while (rq->hp->nres <= rq->nread) {
+		if (rq->pid <= 0 ||
+				waitpid(rq->pid, NULL, WNOHANG) == rq->pid) {
+			rq->pid = -1;	/* renderer died */
+			return(NULL);
+		}
+		rq_pause(&n);
+	}
+	rq_sync();
+	return(rq_slot(rq, rq->nread++));
+}
+
+
+int
+rq_close(			/* finish with queue, return exit status */
+	RAYQ  *rq
+)
+{
+	int  status = -1;
+
+	rq_submit(rq);
+	rq_sync();
+	rq->hp->closed = 1;
+	if (rq->pid > 0 && waitpid(rq->pid, &status, 0) == rq->pid)
+		status = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+	unlink(rq->fname);
+	rq_unmap(rq);
+	return(status);
+}
+
+
+RAYQ *
+rq_attach(			/* map queue created by our parent */
+	char  *fname
+)
+{
+	struct stat  st;
+	RQHEAD  *hp;
+	RAYQ  *rq;
+	int  fd;
+
+	if ((fd = open(fname, O_RDWR)) < 0)
+		return(NULL);
+	if (fstat(fd, &st) < 0 || st.st_size < sizeof(RQHEAD) ||
+			(rq = rq_map(fname, fd, st.st_size)) == NULL) {
+		close(fd);
+		return(NULL);
+	}
+	close(fd);
+	hp = rq->hp;
+	if (memcmp(hp->magic, RQMAGIC, 8) || hp->hsiz != sizeof(RQHEAD) ||
+			hp->rsiz != sizeof(RQREC) || hp->nrecs < 1 ||
+			sizeof(RQHEAD) + hp->nrecs*sizeof(RQREC) != rq->mlen) {
+		rq_unmap(rq);
+		return(NULL);
+	}
+	rq->nnext = hp->nres;
+	rq->pid = getppid();
+	return(rq);
+}
+
+
+RQREC *
+rq_request(			/* get next request, waiting if block */
+	RAYQ  *rq,
+	int  block
+)
+{
+	int  n = 0;
+
+	while (rq->hp->nreq <= rq->nnext) {
+		if (!block)
+			return(NULL);
+		if (rq->hp->closed || getppid() != rq->pid) {
+			rq_sync();	/* last submission? */
+			if (rq->hp->nreq <= rq->nnext)
+				return(NULL);
+			break;
+		}
+		rq_pause(&n);
+	}
+	rq_sync();
+	return(rq_slot(rq, rq->nnext++));
+}
+
+
+void
+rq_putres(			/* put next result (NULL val for zero) */
+	RAYQ  *rq,
+	const float  val[3],
+	double  dist
+)
+{
+	RQREC  *rr = rq_slot(rq, rq->hp->nres);
+
+	if (val != NULL) {
+		rr->val[0] = val[0];
+		rr->val[1] = val[1];
+		rr->val[2] = val[2];
+	} else
+		rr->val[0] = rr->val[1] = rr->val[2] = 0;
+	rr->dist = dist;
+	rq_sync();
+	rq->hp->nres++;
+}
+
+#endif	/* ! _WIN32 */
@@ -0,0 +1,68 @@
+/* RCSid $Id$ */
+/*
+ * Header for shared-memory ray queues between a client and rtrace or rcontrib
+ *
+ * The queue is a file mapped by both processes, holding an RQHEAD
+ * followed by a ring of nrecs RQREC records.  The client fills in the
+ * origin and direction of each ray and advances nreq; the renderer,
+ * started with "-q file", traces the requests in order, writes each
+ * result into the same record and advances nres.  Neither side copies
+ * or parses ray data, and only the owner of a counter writes it.
+ * A zero direction requests a flush, and gets a zero result.
+ *
+ * rcontrib takes rays from the queue but writes its contributions to
+ * its usual outputs, marking each request done once it is read.
+ */
+#ifndef _RAD_RAYQUEUE_H_
+#define _RAD_RAYQUEUE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define RQMAGIC		"#?RAYQ01"	/* queue file magic number */
+
+typedef struct {
+	double		org[3];		/* ray origin (request) */
+	double		dir[3];		/* ray direction (request) */
+	float		val[3];		/* radiance or irradiance (result) */
+	float		dist;		/* distance to first hit (result) */
+} RQREC;		/* one ray in queue */
+
+typedef struct {
+	char		magic[8];	/* RQMAGIC */
+	int		hsiz, rsiz;	/* header & record sizes */
+	long		nrecs;		/* records in ring */
+	volatile long	nreq;		/* requests submitted (client) */
+	volatile long	nres;		/* results completed (renderer) */
+	volatile int	closed;		/* client is done with queue */
+	int		pad[5];		/* (reserved) */
+} RQHEAD;		/* queue file header */
+
+typedef struct {
+	RQHEAD		*hp;		/* mapped header */
+	RQREC		*rec;		/* ring of records */
+	size_t		mlen;		/* length of mapping */
+	long		nnext;		/* next request/result (local) */
+	long		nread;		/* results read (client) */
+	int		pid;		/* renderer (client) or parent */
+	char		*fname;		/* queue file name */
+} RAYQ;			/* an open ray queue */
+
+#define rq_slot(rq,n)	((rq)->rec + (n)%(rq)->hp->nrecs)
+
+					/* client calls */
+extern RAYQ	*rq_open(char *fname, long nrecs, char *av[]);
+extern RQREC	*rq_next(RAYQ *rq);
+extern void	rq_submit(RAYQ *rq);
+extern RQREC	*rq_result(RAYQ *rq);
+extern int	rq_close(RAYQ *rq);
+					/* renderer calls */
+extern RAYQ	*rq_attach(char *fname);
+extern RQREC	*rq_request(RAYQ *rq, int block);
+extern void	rq_putres(RAYQ *rq, const float val[3], double dist);
+
+#ifdef __cplusplus
+}
+#endif
+#endif	/* _RAD_RAYQUEUE_H_ */
@@ -13,10 +13,15 @@ static const char	RCSid[] = "$Id: readfargs.c,v 2.11 2014/06/12 22:12:20 greg Ex
 
 
 
+#define faalloc(n)	(af == NULL ? malloc(n) : (*af)(obj, n))
+
+
 int
-readfargs(			/* read function arguments from stream */
+readfalloc(			/* read arguments with given allocator */
 	FUNARGS  *fa,
-	FILE  *fp
+	FILE  *fp,
+	void  *(*af)(OBJECT, size_t),
+	OBJECT  obj
 )
 {
 #define getstr(s)	(fgetword(s,sizeof(s),fp)!=NULL)
@@ -28,7 +33,7 @@ readfargs(			/* read function arguments from stream */
 	if (!getint(sbuf) || (n = atoi(sbuf)) < 0)
 		return(0);
 	if ( (fa->nsargs = n) ) {
-		fa->sarg = (char **)malloc(n*sizeof(char *));
+		fa->sarg = (char **)faalloc(n*sizeof(char *));
 		if (fa->sarg == NULL)
 			return(-1);
 		for (i = 0; i < fa->nsargs; i++) {
@@ -42,7 +47,7 @@ readfargs(			/* read function arguments from stream */
 		return(0);
 #ifdef  IARGS
 	if (fa->niargs = n) {
-		fa->iarg = (long *)malloc(n*sizeof(long));
+		fa->iarg = (long *)faalloc(n*sizeof(long));
 		if (fa->iarg == NULL)
 			return(-1);
 		for (i = 0; i < n; i++) {
@@ -59,7 +64,7 @@ readfargs(			/* read function arguments from stream */
 	if (!getint(sbuf) || (n = atoi(sbuf)) < 0)
 		return(0);
 	if ( (fa->nfargs = n) ) {
-		fa->farg = (RREAL *)malloc(n*sizeof(RREAL));
+		fa->farg = (RREAL *)faalloc(n*sizeof(RREAL));
 		if (fa->farg == NULL)
 			return(-1);
 		for (i = 0; i < n; i++) {
@@ -75,6 +80,18 @@ readfargs(			/* read function arguments from stream */
 #undef getstr
 }
 
+#undef faalloc
+
+
+int
+readfargs(			/* read function arguments from stream */
+	FUNARGS  *fa,
+	FILE  *fp
+)
+{
+	return(readfalloc(fa, fp, NULL, OVOID));
+}
+
 
 void
 freefargs(				/* free object arguments */
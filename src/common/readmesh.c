@@ -17,6 +17,7 @@ static const char RCSid[] = "$Id: readmesh.c,v 2.15 2016/03/04 00:21:21 greg Exp
 static char	*meshfn;	/* input file name */
 static FILE	*meshfp;	/* mesh file pointer */
 static int	objsize;	/* sizeof(OBJECT) from writer */
+static int	bvhwidth;	/* BVH width from header (0 if none) */
 
 
 static void
@@ -56,6 +57,19 @@ mgetflt()				/* get a floating point number */
 }
 	
 
+static int
+headline(s, p)				/* check mesh header line */
+char  *s;
+void  *p;
+{
+	if (isbvhline(s))
+		bvhwidth = atoi(s+LMBVHSTR);
+	if (!isformat(s) && p != NULL)
+		fputs(s, (FILE *)p);
+	return(0);
+}
+
+
 static OCTREE
 getfullnode()				/* get a set, return fullnode */
 {
@@ -230,6 +244,58 @@ nomem:
 }
 
 
+static void
+getbvh(mp)				/* load compressed BVH */
+register MESH	*mp;
+{
+	register MBVHNODE	*np;
+	int	i, j;
+
+	mp->nbvh = mgetint(4);
+	if (mp->nbvh <= 0)
+		mesherror(USER, "bad number of BVH nodes");
+	mp->bvh = (MBVHNODE *)calloc(mp->nbvh, sizeof(MBVHNODE));
+	if (mp->bvh == NULL)
+		goto nomem;
+	for (np = mp->bvh; np < mp->bvh + mp->nbvh; np++) {
+		for (j = 0; j < 3; j++)
+			np->org[j] = mgetint(4);
+		for (j = 0; j < 3; j++)
+			if ((np->qsh[j] = mgetint(1)) > 32)
+				mesherror(USER, "bad BVH node step");
+		if ((np->nkids = mgetint(1)) > MBVHWIDTH)
+			mesherror(USER, "bad BVH node width");
+		for (i = 0; i < np->nkids; i++) {
+			for (j = 0; j < 3; j++)
+				np->qlo[i][j] = mgetint(1);
+			for (j = 0; j < 3; j++)
+				np->qhi[i][j] = mgetint(1);
+			np->kid[i] = mgetint(4);
+			np->ntri[i] = mgetint(1);
+		}
+	}
+	mp->nbvtri = mgetint(4);
+	if (mp->nbvtri < 0)
+		mesherror(USER, "bad number of BVH triangles");
+	mp->bvtri = (OBJECT *)malloc((mp->nbvtri+1)*sizeof(OBJECT));
+	if (mp->bvtri == NULL)
+		goto nomem;
+	for (i = 0; i < mp->nbvtri; i++)
+		mp->bvtri[i] = mgetint(objsize);
+					/* check child references */
+	for (np = mp->bvh; np < mp->bvh + mp->nbvh; np++)
+		for (i = 0; i < np->nkids; i++)
+			if (np->ntri[i] ? np->kid[i] < 0 ||
+					np->kid[i] + np->ntri[i] > mp->nbvtri :
+					np->kid[i] <= np - mp->bvh ||
+					np->kid[i] >= mp->nbvh)
+				mesherror(USER, "damaged mesh BVH");
+	return;
+nomem:
+	error(SYSTEM, "out of mesh memory in getbvh");
+}
+
+
 void
 readmesh(mp, path, flags)		/* read in mesh structures */
 MESH	*mp;
@@ -238,6 +304,7 @@ int	flags;
 {
 	char	*err;
 	char	sbuf[64];
+	int	usebvh;
 	int	i;
 					/* check what's loaded */
 	flags &= (IO_INFO|IO_BOUNDS|IO_TREE|IO_SCENE) & ~mp->ldflags;
@@ -251,7 +318,8 @@ int	flags;
 	}
 	SET_FILE_BINARY(meshfp);
 					/* read header */
-	checkheader(meshfp, MESHFMT, flags&IO_INFO ? stdout : (FILE *)NULL);
+	bvhwidth = 0;
+	getheader(meshfp, headline, flags&IO_INFO ? (void *)stdout : NULL);
 					/* read format number */
 	objsize = getint(2, meshfp) - MESHMAGIC;
 	if (objsize <= 0 || objsize > MAXOBJSIZ || objsize > sizeof(long))
@@ -271,8 +339,11 @@ int	flags;
 		for (i = 0; i < 4; i++)
 			mgetflt();
 	}
+					/* BVH replaces octree if we can */
+	usebvh = (bvhwidth == MBVHWIDTH) &
+			((flags & (IO_TREE|IO_SCENE)) == (IO_TREE|IO_SCENE));
 					/* read the octree */
-	if (flags & IO_TREE)
+	if (flags & IO_TREE && !usebvh)
 		mp->mcube.cutree = gettree();
 	else if (flags & IO_SCENE)
 		skiptree();
@@ -289,6 +360,9 @@ int	flags;
 		for (i = 0; i < mp->npatches; i++)
 			getpatch(&mp->patch[i]);
 	}
+					/* read the BVH */
+	if (usebvh)
+		getbvh(mp);
 					/* clean up */
 	fclose(meshfp);
 	mp->ldflags |= flags;
@@ -4,6 +4,13 @@ static const char RCSid[] = "$Id: readobj.c,v 2.22 2017/04/08 03:56:44 greg Exp
 /*
  *  readobj.c - routines for reading in object descriptions.
  *
+ *  Object names and argument lists are carved from an arena kept
+ *  for each block of objects, and the whole arena is released when
+ *  the last object in its block is freed.  (String arguments still
+ *  come from savestr(), since they are shared.)  The OBJREC blocks
+ *  themselves are only freed once empty at the end of the list;
+ *  freed slots elsewhere are reused just by fillobjects().
+ *
  *  External symbols declared in object.h
  */
 
@@ -23,6 +30,33 @@ static const char RCSid[] = "$Id: readobj.c,v 2.22 2017/04/08 03:56:44 greg Exp
 OBJREC  *objblock[MAXOBJBLK];		/* our objects */
 OBJECT  nobjects = 0;			/* # of objects */
 
+#ifndef OBCHUNKMIN
+#define OBCHUNKMIN	4096		/* first arena chunk size */
+#endif
+#ifndef OBCHUNKMAX
+#define OBCHUNKMAX	(1L<<16)	/* largest shared chunk size */
+#endif
+#define OBALIGN		sizeof(double)	/* arena alignment */
+
+typedef struct obchunk {
+	struct obchunk	*next;		/* next chunk in list */
+	size_t		siz;		/* chunk size, with header */
+} OBCHUNK;
+
+static struct {
+	OBCHUNK		*chunk;		/* current chunk (list head) */
+	size_t		nleft;		/* bytes left in current chunk */
+	size_t		nused;		/* bytes allocated from arena */
+	int		nlive;		/* objects not yet freed */
+} obarena[MAXOBJBLK];
+
+static OBJECT  obfill = OVOID;		/* next freed slot to refill */
+static OBJECT  obfillend;		/* end of slots to refill */
+
+static long  obnchunks = 0;		/* arena chunks allocated */
+static size_t  obmemuse = 0;		/* memory in arena chunks */
+static size_t  obmemused = 0;		/* bytes handed out */
+
 
 void
 readobj(				/* read in an object file or stream */
@@ -118,7 +152,8 @@ getobject(				/* read the next object */
 					name, sbuf);
 		error(USER, errmsg);
 	}
-	objp->oname = savqstr(sbuf);
+	if ((objp->oname = obsavstr(obj, sbuf)) == NULL)
+		error(SYSTEM, "out of memory in getobject");
 					/* get arguments */
 	if (objp->otype == MOD_ALIAS) {
 		OBJECT  alias;
@@ -133,13 +168,14 @@ getobject(				/* read the next object */
 				objp->omod == objptr(alias)->omod) {
 			objp->omod = alias;
 		} else {
-			objp->oargs.sarg = (char **)malloc(sizeof(char *));
+			objp->oargs.sarg = (char **)oballoc(obj, sizeof(char *));
 			if (objp->oargs.sarg == NULL)
 				error(SYSTEM, "out of memory in getobject");
 			objp->oargs.nsargs = 1;
 			objp->oargs.sarg[0] = savestr(sbuf);
 		}
-	} else if ((rval = readfargs(&objp->oargs, fp)) == 0) {
+	} else if ((rval = readfalloc(&objp->oargs, fp,
+						oballoc, obj)) == 0) {
 		sprintf(errmsg, "(%s): bad arguments", name);
 		objerror(objp, USER, errmsg);
 	} else if (rval < 0) {
@@ -164,6 +200,13 @@ newobject(void)				/* get a new object */
 {
 	int  i;
 
+	if (obfill != OVOID) {			/* refilling freed slots? */
+		if ((obfill < obfillend) & (obfill < nobjects)) {
+			obarena[obfill >> OBJBLKSHFT].nlive++;
+			return(obfill++);
+		}
+		obfill = OVOID;			/* else append */
+	}
 	if ((nobjects & (OBJBLKSIZ-1)) == 0) {	/* new block */
 		errno = 0;
 		i = nobjects >> OBJBLKSHFT;
@@ -173,9 +216,143 @@ newobject(void)				/* get a new object */
 		if (objblock[i] == NULL)
 			return(OVOID);
 	}
+	obarena[nobjects >> OBJBLKSHFT].nlive++;
 	return(nobjects++);
 }
 
+
+OBJECT
+nextobject(void)			/* object newobject() will return */
+{
+	if ((obfill != OVOID) & (obfill < nobjects))
+		return(obfill);
+	return(nobjects);
+}
+
+
+int
+fillobjects(				/* refill a freed range, if clear */
+	OBJECT  firstobj,
+	OBJECT  nobjs
+)
+{
+	OBJECT  obj;
+
+	obfill = OVOID;
+	if ((firstobj < 0) | (nobjs <= 0) || firstobj >= nobjects)
+		return(0);
+	for (obj = firstobj; (obj < firstobj+nobjs) & (obj < nobjects); obj++)
+		if (objptr(obj)->oname != NULL)
+			return(0);		/* reused by someone else */
+	obfill = firstobj;
+	obfillend = firstobj + nobjs;
+	return(1);
+}
+
+
+void *
+oballoc(				/* allocate memory for object */
+	OBJECT  obj,
+	size_t  n
+)
+{
+	int  i = obj >> OBJBLKSHFT;
+	OBCHUNK  *cp;
+	size_t  csiz;
+
+	n = (n + (OBALIGN-1)) & ~(OBALIGN-1);
+	if (n <= obarena[i].nleft) {		/* fits in current chunk */
+		cp = obarena[i].chunk;
+		obarena[i].nleft -= n;
+		obarena[i].nused += n;
+		obmemused += n;
+		return((char *)cp + cp->siz - obarena[i].nleft - n);
+	}
+	if (n > OBCHUNKMAX/4) {			/* own chunk, behind current */
+		cp = (OBCHUNK *)malloc(sizeof(OBCHUNK) + n);
+		if (cp == NULL)
+			return(NULL);
+		cp->siz = sizeof(OBCHUNK) + n;
+		if (obarena[i].chunk == NULL) {
+			cp->next = NULL;
+			obarena[i].chunk = cp;
+		} else {
+			cp->next = obarena[i].chunk->next;
+			obarena[i].chunk->next = cp;
+		}
+	} else {				/* start a new chunk */
+		csiz = obarena[i].chunk == NULL ? OBCHUNKMIN :
+				obarena[i].chunk->siz << 1;
+		if (csiz > OBCHUNKMAX)
+			csiz = OBCHUNKMAX;
+		while (csiz < sizeof(OBCHUNK) + n)
+			csiz <<= 1;
+		cp = (OBCHUNK *)malloc(csiz);
+		if (cp == NULL)
+			return(NULL);
+		cp->siz = csiz;
+		cp->next = obarena[i].chunk;
+		obarena[i].chunk = cp;
+		obarena[i].nleft = csiz - sizeof(OBCHUNK) - n;
+	}
+	obnchunks++;
+	obmemuse += cp->siz;
+	obarena[i].nused += n;
+	obmemused += n;
+	return((void *)(cp+1));
+}
+
+
+char *
+obsavstr(				/* copy string into object's arena */
+	OBJECT  obj,
+	const char  *s
+)
+{
+	size_t  len = strlen(s) + 1;
+	char  *cp = (char *)oballoc(obj, len);
+
+	if (cp != NULL)
+		memcpy(cp, s, len);
+	return(cp);
+}
+
+
+static void
+obrelease(				/* release arena for object block */
+	int  i
+)
+{
+	OBCHUNK  *cp;
+
+	while ((cp = obarena[i].chunk) != NULL) {
+		obarena[i].chunk = cp->next;
+		obnchunks--;
+		obmemuse -= cp->siz;
+		free((void *)cp);
+	}
+	obmemused -= obarena[i].nused;
+	obarena[i].nused = obarena[i].nleft = 0;
+	obarena[i].nlive = 0;
+}
+
+
+void
+printobjstats(				/* print object memory statistics */
+	FILE  *fp
+)
+{
+	int  nblocks = (nobjects + OBJBLKSIZ-1) >> OBJBLKSHFT;
+
+	fprintf(fp, "Object statistics:\n");
+	fprintf(fp, "\t%ld objects in %d blocks (%.1f MBytes)\n",
+			(long)nobjects, nblocks,
+			nblocks*OBJBLKSIZ*sizeof(OBJREC)/(1024.*1024.));
+	fprintf(fp, "\t%ld arena chunks (%.1f MBytes, %.1f%% used)\n",
+			obnchunks, obmemuse/(1024.*1024.),
+			obmemuse ? 100.*obmemused/obmemuse : 0.);
+}
+
 void
 freeobjects(				/* free a range of objects */
 	int firstobj,
@@ -193,9 +370,15 @@ freeobjects(				/* free a range of objects */
 					/* clear objects */
 	for (obj = firstobj+nobjs; obj-- > firstobj; ) {
 		OBJREC  *o = objptr(obj);
+		int  i;
 		free_os(o);		/* free client memory */
-		freeqstr(o->oname);
-		freefargs(&o->oargs);
+		if (o->oname != NULL && !incscene(o->oname)) {
+			for (i = o->oargs.nsargs; i-- > 0; )
+				freestr(o->oargs.sarg[i]);
+			i = obj >> OBJBLKSHFT;
+			if (!--obarena[i].nlive)
+				obrelease(i);
+		}
 		memset((void *)o, '\0', sizeof(OBJREC));
 	}
 	clearobjndx();
@@ -207,7 +390,10 @@ freeobjects(				/* free a range of objects */
 	while (nobjects > obj)		/* free empty end blocks */
 		if ((--nobjects & (OBJBLKSIZ-1)) == 0) {
 			int	i = nobjects >> OBJBLKSHFT;
-			free((void *)objblock[i]);
+			if (!incscene(objblock[i]))
+				free((void *)objblock[i]);
 			objblock[i] = NULL;
 		}
+	if (!nobjects)			/* release compiled scene */
+		unmapcscene();
 }
@@ -80,7 +80,7 @@ readoct(				/* read in octree file or stream */
 		for (i = 0; i < 4; i++)
 			ogetstr(sbuf);
 	}
-	objorig = nobjects;		/* set object offset */
+	objorig = nextobject();		/* set object offset */
 	nf = 0;				/* get object files */
 	while (*ogetstr(sbuf)) {
 		if (load & IO_SCENE)
@@ -103,12 +103,13 @@ readoct(				/* read in octree file or stream */
 		
 	if (load & IO_SCENE) {		/* get the scene */
 	    if (nf == 0) {
-					/* load binary scene data */
-		readscene(infp, objsize);
+					/* map compiled or load binary scene */
+		if (!mapcscene(infp, fnobjects))
+			readscene(infp, objsize);
 
 	    } else {			/* consistency checks */
 				/* check object count */
-		if (nobjects != objorig+fnobjects)
+		if (nextobject() != objorig+fnobjects)
 			octerror(USER, "bad object count; octree stale?");
 				/* check for non-surfaces */
 		if (nonsurfintree(scene->cutree))
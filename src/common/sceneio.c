@@ -12,10 +12,53 @@ static const char RCSid[] = "$Id: sceneio.c,v 2.5 2011/09/22 02:15:56 greg Exp $
 #include "octree.h"
 #include "object.h"
 #include "otypes.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <stddef.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/*
+ *  A frozen octree may end with a compiled copy of its scene, laid
+ *  out just as the objects sit in memory, so a reader can map it and
+ *  point objblock[] straight at it.  It follows the portable scene
+ *  data, where older readers stop:
+ *	CSCHEAD
+ *	object records, padded to a whole number of blocks
+ *	string argument pointers
+ *	real arguments (then integer arguments if IARGS)
+ *	object names and string arguments
+ *	CSCMAGIC and section offset (8-byte big-endian)
+ *  Pointers are stored as if the section sat at csh.vbase, and are
+ *  relocated only if the mapping lands elsewhere.  Any difference
+ *  in machine or object types sends the reader to readscene().
+ */
+
+#define CSCMAGIC	"#?OCTCSC"	/* start and end of compiled scene */
+#define CSCALIGN	8		/* table alignment */
+#define calign(n)	(((n) + (CSCALIGN-1)) & ~(size_t)(CSCALIGN-1))
+					/* preferred address (mod 64K) */
+#define CSCPREFER	((size_t)0x6000 << (sizeof(char *) > 4 ? 32 : 16))
+
+typedef struct {
+	char	magic[8];		/* CSCMAGIC */
+	int	hdrsiz;			/* sizeof(CSCHEAD), also byte order */
+	short	objsiz, oidsiz;		/* sizeof(OBJREC), sizeof(OBJECT) */
+	short	ptrsiz, realsiz;	/* sizeof(char *), sizeof(RREAL) */
+	int	blksiz;			/* OBJBLKSIZ */
+	unsigned long	typsum;		/* checksum of object type names */
+	long	nobjs;			/* number of objects */
+	size_t	len;			/* section length before trailer */
+	char	*vbase;			/* address pointers assume */
+} CSCHEAD;		/* compiled scene header */
 
 static OBJECT  object0;			/* zeroeth object */
 static short  otypmap[NUMOTYPE+32];	/* object type map */
 
+static char  *cscmap = NULL;		/* mapped compiled scene */
+static size_t  cscmlen = 0;		/* length of mapping */
+
 
 static int
 getobj(				/* get next object */
@@ -43,10 +86,11 @@ getobj(				/* get next object */
 			error(INTERNAL, "too many objects in getobj");
 	}
 	objp->omod = m;
-	objp->oname = savqstr(getstr(sbuf, fp));
+	if ((objp->oname = obsavstr(obj, getstr(sbuf, fp))) == NULL)
+		goto memerr;
 	if ((objp->oargs.nsargs = getint(2, fp)) > 0) {
-		objp->oargs.sarg = (char **)malloc
-				(objp->oargs.nsargs*sizeof(char *));
+		objp->oargs.sarg = (char **)oballoc(obj,
+				objp->oargs.nsargs*sizeof(char *));
 		if (objp->oargs.sarg == NULL)
 			goto memerr;
 		for (i = 0; i < objp->oargs.nsargs; i++)
@@ -55,8 +99,8 @@ getobj(				/* get next object */
 		objp->oargs.sarg = NULL;
 #ifdef	IARGS
 	if ((objp->oargs.niargs = getint(2, fp)) > 0) {
-		objp->oargs.iarg = (long *)malloc
-				(objp->oargs.niargs*sizeof(long));
+		objp->oargs.iarg = (long *)oballoc(obj,
+				objp->oargs.niargs*sizeof(long));
 		if (objp->oargs.iarg == NULL)
 			goto memerr;
 		for (i = 0; i < objp->oargs.niargs; i++)
@@ -65,8 +109,8 @@ getobj(				/* get next object */
 		objp->oargs.iarg = NULL;
 #endif
 	if ((objp->oargs.nfargs = getint(2, fp)) > 0) {
-		objp->oargs.farg = (RREAL *)malloc
-				(objp->oargs.nfargs*sizeof(RREAL));
+		objp->oargs.farg = (RREAL *)oballoc(obj,
+				objp->oargs.nfargs*sizeof(RREAL));
 		if (objp->oargs.farg == NULL)
 			goto memerr;
 		for (i = 0; i < objp->oargs.nfargs; i++)
@@ -95,7 +139,7 @@ readscene(				/* read binary scene description */
 	char  sbuf[32];
 	int  i;
 					/* record starting object */
-	object0 = nobjects;
+	object0 = nextobject();
 					/* read type map */
 	for (i = 0; getstr(sbuf, fp) != NULL && sbuf[0]; i++)
 		if ((otypmap[i] = otype(sbuf)) < 0) {
@@ -157,3 +201,299 @@ writescene(				/* write binary scene description */
 	if (ferror(fp))
 		error(SYSTEM, "write error in writescene");
 }
+
+
+static unsigned long
+otypsum(void)			/* checksum object type names in order */
+{
+	unsigned long	sum = 0;
+	char	*cp;
+	int	i;
+
+	for (i = 0; i < NUMOTYPE; i++) {
+		for (cp = ofun[i].funame; *cp; cp++)
+			sum = sum*31 + *cp;
+		sum = sum*31;
+	}
+	return(sum);
+}
+
+
+static void
+cscpad(				/* write zeroes up to section offset */
+	size_t	*posp,
+	size_t	pos,
+	FILE	*fp
+)
+{
+	while (*posp < pos) {
+		putc(0, fp);
+		++*posp;
+	}
+}
+
+
+void
+writecscene(			/* append compiled scene section */
+	int	nobjs,
+	FILE	*fp
+)
+{
+	CSCHEAD	csh;
+	OBJREC	orec, *o;
+	long	off;
+	size_t	nblk, ns, nf, ni, nc;
+	size_t	ooff, soff, foff, ioff, coff;
+	size_t	pos, so, fo, co;
+#ifdef	IARGS
+	size_t	io;
+#endif
+	char	*sp;
+	int	i, j;
+
+	if ((off = ftell(fp)) < 0) {
+		error(WARNING, "output not seekable, compiled scene omitted");
+		return;
+	}
+	pos = off;			/* align section start */
+	cscpad(&pos, calign(pos), fp);
+	off = pos;
+	nblk = (nobjs + (OBJBLKSIZ-1)) >> OBJBLKSHFT;
+	ns = nf = ni = nc = 0;		/* measure tables */
+	for (i = 0; i < nobjs; i++) {
+		o = objptr(i);
+		if (o->oname != NULL)
+			nc += strlen(o->oname) + 1;
+		ns += o->oargs.nsargs;
+		for (j = 0; j < o->oargs.nsargs; j++)
+			nc += strlen(o->oargs.sarg[j]) + 1;
+		nf += o->oargs.nfargs;
+#ifdef	IARGS
+		ni += o->oargs.niargs;
+#endif
+	}
+	ooff = calign(sizeof(CSCHEAD));
+	soff = ooff + sizeof(OBJREC)*OBJBLKSIZ*nblk;
+	foff = calign(soff + sizeof(char *)*ns);
+	ioff = calign(foff + sizeof(RREAL)*nf);
+	coff = ioff + sizeof(long)*ni;
+	memset(&csh, 0, sizeof(csh));
+	memcpy(csh.magic, CSCMAGIC, 8);
+	csh.hdrsiz = sizeof(CSCHEAD);
+	csh.objsiz = sizeof(OBJREC);
+	csh.oidsiz = sizeof(OBJECT);
+	csh.ptrsiz = sizeof(char *);
+	csh.realsiz = sizeof(RREAL);
+	csh.blksiz = OBJBLKSIZ;
+	csh.typsum = otypsum();
+	csh.nobjs = nobjs;
+	csh.len = calign(coff + nc);
+	csh.vbase = (char *)CSCPREFER + (off & 0xffff);
+	fwrite(&csh, sizeof(csh), 1, fp);
+	pos = sizeof(csh);
+	cscpad(&pos, ooff, fp);
+	so = soff; fo = foff; co = coff;
+#ifdef	IARGS
+	io = ioff;
+#endif
+	for (i = 0; i < nblk*OBJBLKSIZ; i++) {	/* object records */
+		memset(&orec, 0, sizeof(orec));
+		if (i < nobjs) {
+			o = objptr(i);
+			orec.omod = o->omod;
+			orec.otype = o->otype;
+			if (o->oname != NULL) {
+				orec.oname = csh.vbase + co;
+				co += strlen(o->oname) + 1;
+			}
+			for (j = 0; j < o->oargs.nsargs; j++)
+				co += strlen(o->oargs.sarg[j]) + 1;
+			if ((orec.oargs.nsargs = o->oargs.nsargs) > 0) {
+				orec.oargs.sarg = (char **)(csh.vbase + so);
+				so += sizeof(char *)*o->oargs.nsargs;
+			}
+			if ((orec.oargs.nfargs = o->oargs.nfargs) > 0) {
+				orec.oargs.farg = (RREAL *)(csh.vbase + fo);
+				fo += sizeof(RREAL)*o->oargs.nfargs;
+			}
+#ifdef	IARGS
+			if ((orec.oargs.niargs = o->oargs.niargs) > 0) {
+				orec.oargs.iarg = (long *)(csh.vbase + io);
+				io += sizeof(long)*o->oargs.niargs;
+			}
+#endif
+		}
+		fwrite(&orec, sizeof(orec), 1, fp);
+	}
+	pos = soff;
+	co = coff;			/* string argument pointers */
+	for (i = 0; i < nobjs; i++) {
+		o = objptr(i);
+		if (o->oname != NULL)
+			co += strlen(o->oname) + 1;
+		for (j = 0; j < o->oargs.nsargs; j++) {
+			sp = csh.vbase + co;
+			fwrite(&sp, sizeof(sp), 1, fp);
+			co += strlen(o->oargs.sarg[j]) + 1;
+		}
+	}
+	pos += sizeof(char *)*ns;
+	cscpad(&pos, foff, fp);
+	for (i = 0; i < nobjs; i++) {	/* real arguments */
+		o = objptr(i);
+		if (o->oargs.nfargs > 0)
+			fwrite(o->oargs.farg, sizeof(RREAL),
+					o->oargs.nfargs, fp);
+	}
+	pos += sizeof(RREAL)*nf;
+	cscpad(&pos, ioff, fp);
+#ifdef	IARGS
+	for (i = 0; i < nobjs; i++) {	/* integer arguments */
+		o = objptr(i);
+		if (o->oargs.niargs > 0)
+			fwrite(o->oargs.iarg, sizeof(long),
+					o->oargs.niargs, fp);
+	}
+	pos += sizeof(long)*ni;
+#endif
+	for (i = 0; i < nobjs; i++) {	/* names and strings */
+		o = objptr(i);
+		if (o->oname != NULL)
+			fwrite(o->oname, 1, strlen(o->oname)+1, fp);
+		for (j = 0; j < o->oargs.nsargs; j++)
+			fwrite(o->oargs.sarg[j], 1,
+					strlen(o->oargs.sarg[j])+1, fp);
+	}
+	pos += nc;
+	cscpad(&pos, csh.len, fp);
+	fputs(CSCMAGIC, fp);		/* trailer */
+	putint(off, 8, fp);
+	if (ferror(fp))
+		error(SYSTEM, "write error in writecscene");
+}
+
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+static void
+cscreloc(			/* relocate mapped object pointers */
+	OBJREC	*op,
+	long	n,
+	ptrdiff_t	d
+)
+{
+	int	j;
+
+	for ( ; n-- > 0; op++) {
+		if (op->oname != NULL)
+			op->oname += d;
+		if (op->oargs.sarg != NULL) {
+			op->oargs.sarg = (char **)((char *)op->oargs.sarg + d);
+			for (j = op->oargs.nsargs; j--; )
+				op->oargs.sarg[j] += d;
+		}
+		if (op->oargs.farg != NULL)
+			op->oargs.farg = (RREAL *)((char *)op->oargs.farg + d);
+#ifdef	IARGS
+		if (op->oargs.iarg != NULL)
+			op->oargs.iarg = (long *)((char *)op->oargs.iarg + d);
+#endif
+	}
+}
+
+#endif
+
+
+int
+mapcscene(			/* map compiled scene if present, else 0 */
+	FILE	*fp,
+	long	nobjs
+)
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	CSCHEAD	csh;
+	struct stat	sbuf;
+	unsigned char	tbuf[16];
+	int	fd = fileno(fp);
+	off_t	flen, off, moff;
+	char	*mp, *sec;
+	OBJREC	*op;
+	long	i, nblk;
+					/* must start at object 0 */
+	if ((nobjects != 0) | (cscmap != NULL) | (nobjs <= 0))
+		return(0);
+	if (fstat(fd, &sbuf) < 0 || !S_ISREG(sbuf.st_mode) ||
+			sbuf.st_size < sizeof(CSCHEAD)+16)
+		return(0);
+	flen = sbuf.st_size - 16;	/* check trailer */
+	if (pread(fd, tbuf, 16, flen) != 16 || memcmp(tbuf, CSCMAGIC, 8))
+		return(0);
+	for (off = 0, i = 8; i < 16; i++)
+		off = off<<8 | tbuf[i];
+	if ((off < 0) | (off > flen - (off_t)sizeof(CSCHEAD)) ||
+			pread(fd, &csh, sizeof(csh), off) != sizeof(csh))
+		return(0);
+	if (memcmp(csh.magic, CSCMAGIC, 8) ||
+			(csh.hdrsiz != sizeof(CSCHEAD)) |
+			(csh.objsiz != sizeof(OBJREC)) |
+			(csh.oidsiz != sizeof(OBJECT)) |
+			(csh.ptrsiz != sizeof(char *)) |
+			(csh.realsiz != sizeof(RREAL)) |
+			(csh.blksiz != OBJBLKSIZ) ||
+			(csh.nobjs != nobjs) | (csh.len != flen - off) ||
+			csh.typsum != otypsum())
+		return(0);
+	nblk = (nobjs + (OBJBLKSIZ-1)) >> OBJBLKSHFT;
+	if ((nblk > MAXOBJBLK) | (calign(sizeof(CSCHEAD)) +
+			sizeof(OBJREC)*OBJBLKSIZ*nblk > csh.len))
+		return(0);
+	moff = off & ~(off_t)(sysconf(_SC_PAGESIZE)-1);
+	/*
+	 * Object pages get private copies once os (or a relocation)
+	 * writes them, so only untouched records, arguments and strings
+	 * stay shared between processes mapping the same file.
+	 */
+	mp = (char *)mmap(csh.vbase - (off - moff), flen - moff,
+			PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, moff);
+	if ((void *)mp == MAP_FAILED)
+		return(0);
+	cscmap = mp;
+	cscmlen = flen - moff;
+	sec = mp + (off - moff);
+	op = (OBJREC *)(sec + calign(sizeof(CSCHEAD)));
+	if (sec != csh.vbase)		/* not where we wanted it */
+		cscreloc(op, nobjs, sec - csh.vbase);
+	for (i = 0; i < nblk; i++)
+		objblock[i] = op + (i << OBJBLKSHFT);
+	for (i = 0; i < nobjs; i++) {	/* index new objects */
+		nobjects = i+1;
+		insertobject(i);
+	}
+	return(1);
+#else
+	return(0);
+#endif
+}
+
+
+int
+incscene(			/* is this memory in compiled scene? */
+	const void	*p
+)
+{
+	return((cscmap != NULL) & ((char *)p >= cscmap) &
+			((char *)p < cscmap + cscmlen));
+}
+
+
+void
+unmapcscene(void)		/* release compiled scene mapping */
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (cscmap == NULL)
+		return;
+	munmap(cscmap, cscmlen);
+	cscmap = NULL;
+	cscmlen = 0;
+#endif
+}
@@ -20,6 +20,12 @@ static const char	RCSid[] = "$Id: tmapcolrs.c,v 3.32 2018/08/02 18:33:42 greg Ex
 #endif
 #include	"tmprivat.h"
 #include	"resolu.h"
+#include	"picmap.h"
+#include	"rtprocess.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include	<sys/mman.h>
+#include	<sys/wait.h>
+#endif
 
 #define GAMTSZ	4096
 
@@ -41,6 +47,8 @@ static int	colrReg = -1;		/* our package registration number */
 
 static TMbright	logi[256];
 
+int	tmNumProcs = 1;			/* processes for tmMapPicture() */
+
 
 int
 tmCvColrs(				/* convert RGBE/XYZE colors */
@@ -346,6 +354,162 @@ char	*fname;
 #endif
 
 
+static int
+mapband(				/* histogram or map band of scanlines */
+TMstruct	*tms,
+PICMAP	*pm,
+uby8	*ps,
+int	y0,
+int	y1
+)
+{
+	const int	psiz = (tms->flags & TM_F_BW) ? 1 : 3;
+	COLR		*scan;
+	TMbright	*ls;
+	uby8		*cs = TM_NOCHROM;
+	int		err = TM_E_NOMEM;
+	int		y;
+
+	scan = (COLR *)malloc(sizeof(COLR)*pm->sl);
+	ls = (TMbright *)malloc(sizeof(TMbright)*pm->sl);
+	if ((ps != NULL) & (psiz == 3) &&
+			(cs = (uby8 *)malloc(3*sizeof(uby8)*pm->sl)) == NULL)
+		goto done;
+	if ((scan == NULL) | (ls == NULL))
+		goto done;
+	err = TM_E_OK;
+	for (y = y0; (y < y1) & (err == TM_E_OK); y++) {
+		if (pm_readcolrs(pm, scan, y) < 0) {
+			err = TM_E_BADFILE;
+			break;
+		}
+		err = tmCvColrs(tms, ls, cs, scan, pm->sl);
+		if (err != TM_E_OK)
+			break;
+		if (ps == NULL)			/* first pass */
+			err = tmAddHisto(tms, ls, pm->sl, 1);
+		else				/* second pass */
+			err = tmMapPixels(tms, ps + (size_t)psiz*pm->sl*y,
+						ls, cs, pm->sl);
+	}
+done:
+	free((MEM_PTR)scan);
+	free((MEM_PTR)ls);
+	if (cs != TM_NOCHROM)
+		free((MEM_PTR)cs);
+	return(err);
+}
+
+
+#if !defined(_WIN32) && !defined(_WIN64)
+static int
+mapbands(				/* histogram or map bands in parallel */
+TMstruct	*tms,
+PICMAP	*pm,
+uby8	*ps,
+int	np
+)
+{
+	const size_t	pslen = (size_t)((tms->flags & TM_F_BW) ? 1 : 3) *
+					pm->sl * pm->ns;
+	uby8	*shps = NULL;
+	int	*pid, *fd;
+	int	hinfo[4];
+	int	*histo;
+	int	err = TM_E_OK;
+	int	i, st;
+
+	pid = (int *)malloc(sizeof(int)*2*np);
+	if (pid == NULL)
+		return(TM_E_NOMEM);
+	fd = pid + np;
+	if (ps != NULL) {			/* output in shared memory */
+		shps = (uby8 *)mmap(NULL, pslen, PROT_READ|PROT_WRITE,
+				MAP_ANON|MAP_SHARED, -1, 0);
+		if ((void *)shps == MAP_FAILED) {
+			free((MEM_PTR)pid);
+			return(TM_E_NOMEM);
+		}
+	}
+	fflush(NULL);
+	for (i = 0; i < np; i++) {		/* start band processes */
+		int	p[2];
+		fd[i] = -1;
+		if (ps == NULL && pipe(p) < 0)
+			break;
+		if ((pid[i] = fork()) == 0) {
+			const int	y0 = (long)pm->ns*i/np;
+			const int	y1 = (long)pm->ns*(i+1)/np;
+			if (ps != NULL)
+				_exit(mapband(tms, pm, shps, y0, y1));
+			close(p[0]);		/* send back histogram */
+			hinfo[0] = mapband(tms, pm, NULL, y0, y1);
+			hinfo[1] = tms->hbrmin;
+			hinfo[2] = tms->hbrmax;
+			hinfo[3] = (tms->histo == NULL) ? 0 :
+				HISTI(tms->hbrmax) + 1 - HISTI(tms->hbrmin);
+			if (writebuf(p[1], (char *)hinfo, sizeof(hinfo)) !=
+						sizeof(hinfo) ||
+					writebuf(p[1], (char *)tms->histo,
+						sizeof(int)*hinfo[3]) !=
+						sizeof(int)*hinfo[3])
+				_exit(TM_E_CODERR1);
+			_exit(hinfo[0]);
+		}
+		if (ps == NULL) {
+			close(p[1]);
+			if (pid[i] < 0) {
+				close(p[0]);
+				break;
+			}
+			fd[i] = p[0];
+		} else if (pid[i] < 0)
+			break;
+	}
+	if (i < np)				/* couldn't start them all */
+		err = TM_E_NOMEM;
+	np = i;
+	for (i = 0; i < np; i++) {		/* gather results */
+		if (ps == NULL) {
+			if (readbuf(fd[i], (char *)hinfo, sizeof(hinfo)) !=
+						sizeof(hinfo) ||
+					(histo = (int *)malloc(sizeof(int) *
+						(hinfo[3]+1))) == NULL) {
+				if (err == TM_E_OK)
+					err = TM_E_CODERR1;
+			} else {
+				if (readbuf(fd[i], (char *)histo,
+						sizeof(int)*hinfo[3]) !=
+						sizeof(int)*hinfo[3])
+					hinfo[0] = TM_E_CODERR1;
+				else if (hinfo[0] == TM_E_OK && hinfo[3])
+					hinfo[0] = tmMergeHisto(tms, histo,
+							hinfo[1], hinfo[2]);
+				if (err == TM_E_OK)
+					err = hinfo[0];
+				free((MEM_PTR)histo);
+			}
+			close(fd[i]);
+		}
+		while (waitpid(pid[i], &st, 0) < 0)
+			if (errno != EINTR) {
+				st = 0;
+				break;
+			}
+		if (st && err == TM_E_OK)
+			err = WIFEXITED(st) ? WEXITSTATUS(st) : TM_E_CODERR2;
+	}
+	if (shps != NULL) {
+		if (err == TM_E_OK)
+			memcpy(ps, shps, pslen);
+		munmap(shps, pslen);
+	}
+	free((MEM_PTR)pid);
+	return(err);
+}
+#endif
+
+
 int					/* map a Radiance picture */
 tmMapPicture(psp, xp, yp, flags, monpri, gamval, Lddyn, Ldmax, fname, fp)
 uby8	**psp;
@@ -358,8 +522,12 @@ FILE	*fp;
 {
 	char	*funcName = fname==NULL ? "tmMapPicture" : fname;
 	TMstruct	*tms = NULL;
-	uby8	*cp;
-	TMbright	*lp;
+	struct radhead	info;
+	FILE	*inpf;
+	PICMAP	*pm = NULL;
+	TMbright	lsdum;
+	COLR	cdum;
+	int	np = tmNumProcs;
 	int	err;
 						/* check arguments */
 	if ((psp == NULL) | (xp == NULL) | (yp == NULL) | (monpri == NULL) |
@@ -379,43 +547,69 @@ FILE	*fp;
 						/* initialize tone mapping */
 	if ((tms = tmInit(flags, monpri, gamval)) == NULL)
 		returnErr(TM_E_NOMEM);
-						/* load & convert picture */
-	err = tmLoadPicture(tms, &lp, (flags&TM_F_BW) ? TM_NOCHROMP : &cp,
-			xp, yp, fname, fp);
-	if (err != TM_E_OK) {
-		tmDone(tms);
-		return(err);
+	*psp = NULL;
+	*xp = *yp = 0;
+						/* index picture scanlines */
+	if ((inpf = fp) == TM_GETFILE && (inpf = fopen(fname, "rb")) == NULL) {
+		err = TM_E_BADFILE;
+		goto done;
 	}
-						/* allocate space for result */
-	if (flags & TM_F_BW) {
-		*psp = (uby8 *)malloc(sizeof(uby8) * *xp * *yp);
-		if (*psp == NULL) {
-			free((MEM_PTR)lp);
-			tmDone(tms);
-			returnErr(TM_E_NOMEM);
-		}
-		cp = TM_NOCHROM;
-	} else
-		*psp = cp;
+	info = rhdefault;
+	pm = pm_load(inpf, headline, &info);
+	if (fp == TM_GETFILE)
+		fclose(inpf);
+	err = TM_E_BADFILE;
+	if (pm == NULL)
+		goto done;
+	if ((info.format == FMTBAD) | (info.expos <= 0.) |
+			(pm->nvalid < pm->ns))
+		goto done;
+	*xp = pm->sl; *yp = pm->ns;
+	if (info.format == FMTUNK)		/* assume RGBE format */
+		info.format = FMTRGB;
+	if (info.format == FMTRGB)
+		info.expos /= WHTEFFICACY;
+	else if (info.format == FMTCIE)
+		info.primp = TM_XYZPRIM;
+						/* prepare library */
+	if ((err = tmSetSpace(tms, info.primp, 1./info.expos, NULL)) != TM_E_OK)
+		goto done;
+	if ((err = tmCvColrs(tms, &lsdum, TM_NOCHROM, &cdum, 0)) != TM_E_OK)
+		goto done;			/* (builds tables before fork) */
+	err = TM_E_NOMEM;			/* allocate space for result */
+	*psp = (uby8 *)malloc(((flags & TM_F_BW) ? 1 : 3)*sizeof(uby8) *
+					*xp * *yp);
+	if (*psp == NULL)
+		goto done;
+	if (np > *yp) np = *yp;
 						/* compute color mapping */
-	err = tmAddHisto(tms, lp, *xp * *yp, 1);
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (np > 1)
+		err = mapbands(tms, pm, NULL, np);
+	else
+#endif
+		err = mapband(tms, pm, NULL, 0, *yp);
 	if (err != TM_E_OK)
 		goto done;
 	err = tmComputeMapping(tms, gamval, Lddyn, Ldmax);
 	if (err != TM_E_OK)
 		goto done;
 						/* map colors */
-	err = tmMapPixels(tms, *psp, lp, cp, *xp * *yp);
-
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (np > 1)
+		err = mapbands(tms, pm, *psp, np);
+	else
+#endif
+		err = mapband(tms, pm, *psp, 0, *yp);
 done:						/* clean up */
-	free((MEM_PTR)lp);
-	tmDone(tms);
+	pm_free(pm);
 	if (err != TM_E_OK) {			/* free memory on error */
 		free((MEM_PTR)*psp);
 		*psp = NULL;
-		returnErr(err);
+		err = tmErrorReturn(funcName, tms, err);
 	}
-	returnOK;
+	tmDone(tms);
+	return(err);
 }
 
 
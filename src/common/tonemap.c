@@ -28,6 +28,8 @@ static TMbright		*tmFloat2BrtLUT = NULL;
 
 #define tmCvLumLUfp(pf)	tmFloat2BrtLUT[*(int32 *)(pf) >> 15]
 
+#define CVBLOCK		256		/* pixels per tmCvColors() block */
+
 
 TMstruct *
 tmInit(					/* initialize new tone mapping */
@@ -260,9 +262,11 @@ int	len
 	static const char funcName[] = "tmCvColors";
 	static uby8	gamtab[1024];
 	static double	curgam = .0;
-	COLOR	cmon;
+	COLOR	cblk[CVBLOCK];
+	float	lblk[CVBLOCK];
+	float	*cmon;
 	float	lum, slum, d;
-	int	i;
+	int	b, n, i;
 
 	if (tms == NULL)
 		returnErr(TM_E_TMINVAL);
@@ -275,108 +279,103 @@ int	len
 		for (i = 1024; i--; )
 			gamtab[i] = (int)(256.*pow((i+.5)/1024., 1./curgam));
 	}
-	for (i = len; i--; ) {
+	for (b = 0; b < len; b += CVBLOCK) {	/* convert in blocks */
+		n = len - b;
+		if (n > CVBLOCK) n = CVBLOCK;
 		if (tmNeedMatrix(tms)) {		/* get monitor RGB */
-			colortrans(cmon, tms->cmat, scan[i]);
+			for (i = 0; i < n; i++)
+				colortrans(cblk[i], tms->cmat, scan[b+i]);
 		} else {
-			cmon[RED] = tms->inpsf*scan[i][RED];
-			cmon[GRN] = tms->inpsf*scan[i][GRN];
-			cmon[BLU] = tms->inpsf*scan[i][BLU];
+			for (i = 0; i < n; i++) {
+				cblk[i][RED] = tms->inpsf*scan[b+i][RED];
+				cblk[i][GRN] = tms->inpsf*scan[b+i][GRN];
+				cblk[i][BLU] = tms->inpsf*scan[b+i][BLU];
+			}
 		}
+		for (i = 0; i < n; i++) {
+			cmon = cblk[i];
 #ifdef isfinite
-		if (!isfinite(cmon[RED]) || cmon[RED] < .0f) cmon[RED] = .0f;
-		if (!isfinite(cmon[GRN]) || cmon[GRN] < .0f) cmon[GRN] = .0f;
-		if (!isfinite(cmon[BLU]) || cmon[BLU] < .0f) cmon[BLU] = .0f;
+			if (!isfinite(cmon[RED]) || cmon[RED] < .0f) cmon[RED] = .0f;
+			if (!isfinite(cmon[GRN]) || cmon[GRN] < .0f) cmon[GRN] = .0f;
+			if (!isfinite(cmon[BLU]) || cmon[BLU] < .0f) cmon[BLU] = .0f;
 #else
-		if (cmon[RED] < .0f) cmon[RED] = .0f;
-		if (cmon[GRN] < .0f) cmon[GRN] = .0f;
-		if (cmon[BLU] < .0f) cmon[BLU] = .0f;
+			if (cmon[RED] < .0f) cmon[RED] = .0f;
+			if (cmon[GRN] < .0f) cmon[GRN] = .0f;
+			if (cmon[BLU] < .0f) cmon[BLU] = .0f;
 #endif
-							/* world luminance */
-		lum =	tms->clf[RED]*cmon[RED] +
-			tms->clf[GRN]*cmon[GRN] +
-			tms->clf[BLU]*cmon[BLU] ;
-		if (lum <= TM_NOLUM) {			/* convert brightness */
-			lum = cmon[RED] = cmon[GRN] = cmon[BLU] = TM_NOLUM;
-			ls[i] = TM_NOBRT;
-		} else
-			ls[i] = tmCvLumLUfp(&lum);
-		if (cs == TM_NOCHROM)			/* no color? */
-			continue;
-		if (tms->flags & TM_F_MESOPIC && lum < LMESUPPER) {
-			slum = scotlum(cmon);		/* mesopic adj. */
-			if (lum < LMESLOWER) {
-				cmon[RED] = cmon[GRN] = cmon[BLU] = slum;
-			} else {
-				d = (lum - LMESLOWER)/(LMESUPPER - LMESLOWER);
-				if (tms->flags & TM_F_BW)
-					cmon[RED] = cmon[GRN] =
-							cmon[BLU] = d*lum;
-				else
-					scalecolor(cmon, d);
-				d = (1.f-d)*slum;
-				cmon[RED] += d;
-				cmon[GRN] += d;
-				cmon[BLU] += d;
+		}
+		for (i = 0; i < n; i++)			/* world luminance */
+			lblk[i] =	tms->clf[RED]*cblk[i][RED] +
+					tms->clf[GRN]*cblk[i][GRN] +
+					tms->clf[BLU]*cblk[i][BLU] ;
+		for (i = 0; i < n; i++) {
+			cmon = cblk[i];
+			if ((lum = lblk[i]) <= TM_NOLUM) {	/* convert brightness */
+				lum = cmon[RED] = cmon[GRN] = cmon[BLU] = TM_NOLUM;
+				ls[b+i] = TM_NOBRT;
+			} else
+				ls[b+i] = tmCvLumLUfp(&lum);
+			if (cs == TM_NOCHROM)		/* no color? */
+				continue;
+			if (tms->flags & TM_F_MESOPIC && lum < LMESUPPER) {
+				slum = scotlum(cmon);	/* mesopic adj. */
+				if (lum < LMESLOWER) {
+					cmon[RED] = cmon[GRN] = cmon[BLU] = slum;
+				} else {
+					d = (lum - LMESLOWER)/(LMESUPPER - LMESLOWER);
+					if (tms->flags & TM_F_BW)
+						cmon[RED] = cmon[GRN] =
+								cmon[BLU] = d*lum;
+					else
+						scalecolor(cmon, d);
+					d = (1.f-d)*slum;
+					cmon[RED] += d;
+					cmon[GRN] += d;
+					cmon[BLU] += d;
+				}
+			} else if (tms->flags & TM_F_BW) {
+				cmon[RED] = cmon[GRN] = cmon[BLU] = lum;
 			}
-		} else if (tms->flags & TM_F_BW) {
-			cmon[RED] = cmon[GRN] = cmon[BLU] = lum;
+			d = tms->clf[RED]*cmon[RED]/lum;
+			cs[3*(b+i)  ] = d>=.999f ? 255 : gamtab[(int)(1024.f*d)];
+			d = tms->clf[GRN]*cmon[GRN]/lum;
+			cs[3*(b+i)+1] = d>=.999f ? 255 : gamtab[(int)(1024.f*d)];
+			d = tms->clf[BLU]*cmon[BLU]/lum;
+			cs[3*(b+i)+2] = d>=.999f ? 255 : gamtab[(int)(1024.f*d)];
 		}
-		d = tms->clf[RED]*cmon[RED]/lum;
-		cs[3*i  ] = d>=.999f ? 255 : gamtab[(int)(1024.f*d)];
-		d = tms->clf[GRN]*cmon[GRN]/lum;
-		cs[3*i+1] = d>=.999f ? 255 : gamtab[(int)(1024.f*d)];
-		d = tms->clf[BLU]*cmon[BLU]/lum;
-		cs[3*i+2] = d>=.999f ? 255 : gamtab[(int)(1024.f*d)];
 	}
 	returnOK;
 }
 
 
-int
-tmAddHisto(				/* add values to histogram */
+static int
+growhisto(				/* extend histogram to cover range */
 TMstruct	*tms,
-TMbright	*ls,
-int	len,
-int	wt
+int	brmin,
+int	brmax
 )
 {
-	static const char funcName[] = "tmAddHisto";
 	int	oldorig=0, oldlen, horig, hlen;
 	int	i, j;
 
-	if (tms == NULL)
-		returnErr(TM_E_TMINVAL);
-	if (len < 0)
-		returnErr(TM_E_ILLEGAL);
-	if (len == 0)
-		returnOK;
-						/* first, grow limits */
 	if (tms->histo == NULL) {
-		for (i = len; i-- && ls[i] < MINBRT; )
-			;
-		if (i < 0)
-			returnOK;
-		tms->hbrmin = tms->hbrmax = ls[i];
+		tms->hbrmin = brmin;
+		tms->hbrmax = brmax;
 		oldlen = 0;
 	} else {
 		oldorig = HISTI(tms->hbrmin);
 		oldlen = HISTI(tms->hbrmax) + 1 - oldorig;
-	}
-	for (i = len; i--; ) {
-		if ((j = ls[i]) < MINBRT)
-			continue;
-		if (j < tms->hbrmin)
-			tms->hbrmin = j;
-		else if (j > tms->hbrmax)
-			tms->hbrmax = j;
+		if (brmin < tms->hbrmin)
+			tms->hbrmin = brmin;
+		if (brmax > tms->hbrmax)
+			tms->hbrmax = brmax;
 	}
 	horig = HISTI(tms->hbrmin);
 	hlen = HISTI(tms->hbrmax) + 1 - horig;
 	if (hlen > oldlen) {			/* (re)allocate histogram */
 		int	*newhist = (int *)calloc(hlen, sizeof(int));
 		if (newhist == NULL)
-			returnErr(TM_E_NOMEM);
+			return(TM_E_NOMEM);
 		if (oldlen) {			/* copy and free old */
 			for (i = oldlen, j = i+oldorig-horig; i; )
 				newhist[--j] = tms->histo[--i];
@@ -384,8 +383,45 @@ int	wt
 		}
 		tms->histo = newhist;
 	}
+	return(TM_E_OK);
+}
+
+
+int
+tmAddHisto(				/* add values to histogram */
+TMstruct	*tms,
+TMbright	*ls,
+int	len,
+int	wt
+)
+{
+	static const char funcName[] = "tmAddHisto";
+	int	brmin, brmax, horig;
+	int	i, j;
+
+	if (tms == NULL)
+		returnErr(TM_E_TMINVAL);
+	if (len < 0)
+		returnErr(TM_E_ILLEGAL);
+	if (len == 0)
+		returnOK;
+						/* first, grow limits */
+	brmin = 1<<15; brmax = MINBRT-1;
+	for (i = len; i--; ) {
+		if ((j = ls[i]) < MINBRT)
+			continue;
+		if (j < brmin)
+			brmin = j;
+		if (j > brmax)
+			brmax = j;
+	}
+	if (brmax < MINBRT)			/* nothing to add */
+		returnOK;
+	if ((i = growhisto(tms, brmin, brmax)) != TM_E_OK)
+		returnErr(i);
 	if (wt == 0)
 		returnOK;
+	horig = HISTI(tms->hbrmin);
 	for (i = len; i--; )			/* add in new counts */
 		if (ls[i] >= MINBRT)
 			tms->histo[ HISTI(ls[i]) - horig ] += wt;
@@ -393,6 +429,33 @@ int	wt
 }
 
 
+int
+tmMergeHisto(				/* add histogram from another mapping */
+TMstruct	*tms,
+int	*histo,
+int	brmin,
+int	brmax
+)
+{
+	static const char funcName[] = "tmMergeHisto";
+	int	horig;
+	int	i;
+
+	if (tms == NULL)
+		returnErr(TM_E_TMINVAL);
+	if (histo == NULL)
+		returnOK;
+	if ((brmin < MINBRT) | (brmax < brmin))
+		returnErr(TM_E_ILLEGAL);
+	if ((i = growhisto(tms, brmin, brmax)) != TM_E_OK)
+		returnErr(i);
+	horig = HISTI(brmin) - HISTI(tms->hbrmin);
+	for (i = HISTI(brmax) + 1 - HISTI(brmin); i--; )
+		tms->histo[horig + i] += histo[i];
+	returnOK;
+}
+
+
 static double
 htcontrs(		/* human threshold contrast sensitivity, dL(La) */
 double	La
@@ -99,6 +99,8 @@ struct tmPackage {
 extern struct tmPackage	*tmPkg[TM_MAXPKG];
 extern int	tmNumPkgs;	/* number of registered packages */
 
+extern int	tmNumProcs;	/* processes for tmMapPicture() */
+
 
 /****    Useful Macros    ****/
 
@@ -182,6 +184,20 @@ tmAddHisto(TMstruct *tms, TMbright *ls, int len, int wt);
 	returns	-	0 on success, TM_E_* on error.
 */
 
+extern int
+tmMergeHisto(TMstruct *tms, int *histo, int brmin, int brmax);
+/*
+	Add another histogram into the current one, for example one
+	built from part of a picture by a separate process.
+
+	tms	-	tone mapping structure pointer.
+	histo	-	histogram counts (as in TMstruct).
+	brmin	-	minimum brightness of histogram (hbrmin).
+	brmax	-	maximum brightness of histogram (hbrmax).
+
+	returns	-	0 on success, TM_E_* on error.
+*/
+
 extern int
 tmFixedMapping(TMstruct *tms, double expmult, double gamval);
 /*
@@ -315,6 +331,8 @@ tmMapPicture(uby8 **psp, int *xp, int *yp, int flags,
 	If fp is TM_GETFILE and (flags&TM_F_UNIMPL)!=0, tmMapPicture()
 	calls pcond to perform the actual conversion, which takes
 	longer but gives access to all the TM_F_* features.
+	Otherwise, the picture is mapped in two streaming passes, split
+	over tmNumProcs processes if greater than 1 (see Notes below).
 	Memory for the final pixel array is allocated using malloc(3),
 	and should be freed with free(3) when it is no longer needed.
 
@@ -385,7 +403,15 @@ tmCvGray16(TMstruct *tms, TMbright *ls, uint16 *scan, int len, double gv);
 	same array to store the mapped pixels as used to store
 	the encoded chroma values.  This way, only two extra bytes
 	for storing encoded luminances are required per pixel.  This
-	is the method employed by tmMapPicture(), for example.
+	is the method employed by tmLoadPicture(), for example.
+
+	For pictures, tmMapPicture() streams instead:  the first pass
+	converts luminances a scanline at a time into the histogram,
+	and the second pass converts them again with chroma and maps
+	them straight into the output array.  Since any scanline may
+	be decoded on its own, each pass may be split into bands over
+	tmNumProcs processes, whose histograms are then combined with
+	tmMergeHisto().
 */
 /*
 	Note 1:
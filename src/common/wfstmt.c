@@ -0,0 +1,378 @@
+#ifndef lint
+static const char	RCSid[] = "$Id$";
+#endif
+/*
+ *  wfstmt.c - read Wavefront .OBJ statements, optionally in parallel.
+ *
+ *  Each parsing process writes the statements of its chunk to an
+ *  unlinked temporary file, which we read back once that process
+ *  has finished, so no chunk waits for the reader to catch up.
+ *
+ *  External symbols declared in wfstmt.h
+ */
+
+#include "copyright.h"
+
+#include  <stdlib.h>
+#include  <ctype.h>
+
+#include  "platform.h"
+#include  "rtio.h"
+#include  "rterror.h"
+#include  "wfstmt.h"
+
+#if !defined(_WIN32) && !defined(_WIN64)
+#include  <signal.h>
+#include  <sys/stat.h>
+#include  <sys/wait.h>
+#endif
+
+#define MINCHUNK	(1L<<20)	/* smallest chunk worth a process */
+
+typedef struct {
+	int	lineno;			/* line count after statement */
+	int	ac;			/* argument count (0 ends chunk) */
+	int	toomany;		/* arguments were dropped? */
+	int	nfv;			/* converted vertex values */
+	int	nbytes;			/* argument string bytes */
+} WFREC;		/* statement record in chunk file */
+
+static FILE	*wfp = NULL;		/* sequential input */
+static int	wf_lineno;		/* lines read so far */
+static int	wf_nchunks = 0;		/* parallel chunks (0 if none) */
+static int	wf_cur;			/* chunk being read */
+static FILE	*wf_cfp[WF_MAXPROC];	/* chunk statement files */
+static int	wf_pid[WF_MAXPROC];	/* chunk parsing processes */
+
+static char	sbuf[WF_MAXARG*16];	/* current statement text */
+
+
+static int
+wf_split(			/* break line into arguments */
+	WFSTMT	*sp,
+	char	*cp,
+	int	*lnp
+)
+{
+	int	i = 0;
+
+	sp->toomany = 0;
+	for ( ; ; ) {
+		while (isspace(*cp) || *cp == '\\') {
+			if (*cp == '\n')
+				++*lnp;
+			*cp++ = '\0';
+		}
+		if (!*cp)
+			break;
+		if (i >= WF_MAXARG-1) {
+			sp->toomany = 1;
+			break;
+		}
+		sp->av[i++] = cp;
+		while (*++cp && !isspace(*cp))
+			;
+	}
+	sp->av[i] = NULL;
+	sp->lineno = ++*lnp;
+	return(sp->ac = i);
+}
+
+
+static void
+wf_convert(			/* convert vertex values if valid */
+	WFSTMT	*sp
+)
+{
+	int	i;
+
+	sp->nfv = 0;
+	if (sp->av[0][0] != 'v')
+		return;
+	switch (sp->av[0][1]) {
+	case '\0':				/* point */
+		if (!badarg(sp->ac-1, sp->av+1, "fff"))
+			sp->nfv = 3;
+		break;
+	case 'n':				/* normal */
+		if (!sp->av[0][2] && !badarg(sp->ac-1, sp->av+1, "fff"))
+			sp->nfv = 3;
+		break;
+	case 't':				/* texture coordinate */
+		if (!sp->av[0][2] && !badarg(sp->ac-1, sp->av+1, "ff"))
+			sp->nfv = 2;
+		break;
+	}
+	for (i = 0; i < sp->nfv; i++)
+		sp->fv[i] = atof(sp->av[i+1]);
+}
+
+
+#if !defined(_WIN32) && !defined(_WIN64)
+
+static char *
+bufline(			/* fgetline() from memory */
+	char	*s,
+	int	n,
+	char	**pp,
+	char	*end
+)
+{
+	char	*cp = s;
+	int	c = EOF;
+
+	while (--n > 0 && *pp < end) {
+		c = *(*pp)++;
+		if (c == '\r') {		/* CR-LF or Apple file */
+			if (*pp < end && **pp == '\n')
+				(*pp)++;
+			c = '\n';
+		}
+		if (c == '\n' && (cp == s || cp[-1] != '\\'))
+			break;
+		*cp++ = c;
+	}
+	if ((cp == s) & (c == EOF))
+		return(NULL);
+	*cp = '\0';
+	return(s);
+}
+
+
+static long
+linestart(			/* find statement start at or after pos */
+	FILE	*fp,
+	long	pos,
+	long	flen
+)
+{
+	int	c, p1 = 0, p2 = 0;
+	long	n = pos < 2 ? 0 : pos-2;
+
+	if (fseek(fp, n, SEEK_SET) < 0)
+		return(-1);
+	while ((c = getc(fp)) != EOF) {
+		n++;
+		if (c == '\n' && n > pos &&
+				(p1 == '\r' ? p2 : p1) != '\\')
+			return(n);
+		p2 = p1; p1 = c;
+	}
+	return(flen);
+}
+
+
+static void
+parsechunk(			/* child: write chunk statements to ofp */
+	char	*fname,
+	long	start,
+	long	end,
+	FILE	*ofp
+)
+{
+	static WFSTMT	st;
+	WFREC	rec;
+	char	*buf, *cp;
+	FILE	*fp;
+	int	ln = 0;
+
+	buf = (char *)malloc(end - start + 1);
+	if (buf == NULL || (fp = fopen(fname, "r")) == NULL)
+		_exit(1);
+	if (fseek(fp, start, SEEK_SET) < 0 ||
+			fread(buf, 1, end-start, fp) != end-start)
+		_exit(1);
+	fclose(fp);
+	cp = buf;
+	while (bufline(sbuf, sizeof(sbuf), &cp, buf + (end-start)) != NULL) {
+		if (!wf_split(&st, sbuf, &ln))
+			continue;
+		wf_convert(&st);
+		rec.lineno = st.lineno;
+		rec.ac = st.ac;
+		rec.toomany = st.toomany;
+		rec.nfv = st.nfv;
+		rec.nbytes = st.av[st.ac-1] + strlen(st.av[st.ac-1]) + 1 -
+				st.av[0];
+		fwrite(&rec, sizeof(rec), 1, ofp);
+		fwrite(st.fv, sizeof(double), st.nfv, ofp);
+		fwrite(st.av[0], 1, rec.nbytes, ofp);
+	}
+	memset(&rec, 0, sizeof(rec));	/* end record has line count */
+	rec.lineno = ln;
+	fwrite(&rec, sizeof(rec), 1, ofp);
+	_exit((fflush(ofp) == EOF) | ferror(ofp));
+}
+
+
+static int
+startchunks(			/* start parsing processes on file */
+	char	*fname,
+	int	nproc
+)
+{
+	long	cstart[WF_MAXPROC+1];
+	struct stat	st;
+	int	i;
+
+	if (fstat(fileno(wfp), &st) < 0 || !S_ISREG(st.st_mode))
+		return(0);
+	if (nproc > WF_MAXPROC)
+		nproc = WF_MAXPROC;
+	if (nproc > st.st_size/MINCHUNK)
+		nproc = st.st_size/MINCHUNK;
+	if (nproc < 2)
+		return(0);
+	cstart[0] = 0;			/* split at statement starts */
+	for (i = 1; i < nproc; i++) {
+		cstart[i] = linestart(wfp, st.st_size/nproc*i, st.st_size);
+		if (cstart[i] < cstart[i-1]) {
+			rewind(wfp);
+			return(0);
+		}
+	}
+	cstart[nproc] = st.st_size;
+	fflush(NULL);
+	for (wf_nchunks = 0; wf_nchunks < nproc; wf_nchunks++) {
+		if ((wf_cfp[wf_nchunks] = tmpfile()) == NULL)
+			error(SYSTEM, "cannot create Wavefront chunk file");
+		wf_pid[wf_nchunks] = fork();
+		if (wf_pid[wf_nchunks] == 0)
+			parsechunk(fname, cstart[wf_nchunks],
+					cstart[wf_nchunks+1],
+					wf_cfp[wf_nchunks]);
+		if (wf_pid[wf_nchunks] < 0)
+			error(SYSTEM, "cannot fork Wavefront parsing process");
+	}
+	wf_cur = -1;
+	return(1);
+}
+
+
+static int
+nextchunk(void)			/* wait for next chunk, 0 if none */
+{
+	int	status;
+
+	if (wf_cur >= 0)
+		fclose(wf_cfp[wf_cur]);
+	if (++wf_cur >= wf_nchunks)
+		return(0);
+	if (waitpid(wf_pid[wf_cur], &status, 0) != wf_pid[wf_cur] ||
+			status != 0)
+		error(SYSTEM, "Wavefront parsing process failed");
+	wf_pid[wf_cur] = -1;
+	rewind(wf_cfp[wf_cur]);
+	return(1);
+}
+
+
+static int
+getrecord(			/* get next statement from chunk files */
+	WFSTMT	*sp
+)
+{
+	WFREC	rec;
+	char	*cp;
+	int	i;
+
+	while (wf_cur < 0 || fread(&rec, sizeof(rec), 1, wf_cfp[wf_cur]) != 1 ||
+			!rec.ac) {
+		if (wf_cur >= 0) {		/* end of chunk? */
+			if (feof(wf_cfp[wf_cur]))
+				error(SYSTEM, "truncated Wavefront chunk file");
+			wf_lineno += rec.lineno;
+		}
+		if (!nextchunk())
+			return(0);
+	}
+	if (fread(sp->fv, sizeof(double), rec.nfv, wf_cfp[wf_cur]) != rec.nfv ||
+			rec.nbytes > (int)sizeof(sbuf) ||
+			fread(sbuf, 1, rec.nbytes, wf_cfp[wf_cur]) != rec.nbytes)
+		error(SYSTEM, "read error on Wavefront chunk file");
+	cp = sbuf;			/* point to arguments */
+	for (i = 0; i < rec.ac; i++) {
+		while (!*cp)
+			cp++;
+		sp->av[i] = cp;
+		while (*cp++)
+			;
+	}
+	sp->av[i] = NULL;
+	sp->ac = rec.ac;
+	sp->lineno = wf_lineno + rec.lineno;
+	sp->toomany = rec.toomany;
+	sp->nfv = rec.nfv;
+	return(sp->ac);
+}
+
+#endif	/* ! _WIN32 */
+
+
+int
+wf_open(			/* open .OBJ file (NULL for stdin) */
+	char	*fname,
+	int	nproc
+)
+{
+	wf_close();
+	wf_lineno = 0;
+	if (fname == NULL) {
+		wfp = stdin;
+		return(0);
+	}
+	if ((wfp = fopen(fname, "r")) == NULL)
+		return(-1);
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (nproc > 1 && startchunks(fname, nproc)) {
+		fclose(wfp);
+		wfp = NULL;
+	}
+#endif
+	return(0);
+}
+
+
+int
+wf_getstmt(			/* get next statement, 0 at EOF */
+	WFSTMT	*sp
+)
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (wf_nchunks > 0) {
+		if (getrecord(sp))
+			return(sp->ac);
+	} else
+#endif
+	if (wfp != NULL) {
+		while (fgetline(sbuf, sizeof(sbuf), wfp) != NULL)
+			if (wf_split(sp, sbuf, &wf_lineno)) {
+				wf_convert(sp);
+				return(sp->ac);
+			}
+	}
+	sp->av[0] = NULL;		/* EOF gets total line count */
+	sp->ac = sp->toomany = sp->nfv = 0;
+	sp->lineno = wf_lineno;
+	return(0);
+}
+
+
+void
+wf_close(void)			/* done with input */
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	for ( ; wf_nchunks > 0; wf_nchunks--) {
+		int	i = wf_nchunks-1;
+		if (wf_pid[i] > 0) {	/* abandoned early */
+			kill(wf_pid[i], SIGTERM);
+			waitpid(wf_pid[i], NULL, 0);
+		}
+		if (i >= wf_cur)
+			fclose(wf_cfp[i]);
+	}
+#endif
+	if ((wfp != NULL) & (wfp != stdin))
+		fclose(wfp);
+	wfp = NULL;
+}
@@ -0,0 +1,39 @@
+/* RCSid $Id$ */
+/*
+ * Header for reading Wavefront .OBJ statements, optionally in parallel
+ *
+ * A named input file may be split at line boundaries into chunks that
+ * are tokenized by separate processes, with vertex coordinates already
+ * converted.  Statements are still returned strictly in file order,
+ * with the same arguments and line numbers as a sequential read, so
+ * converters produce identical output however many processes are used.
+ *
+ *  Include after rtio.h
+ */
+#ifndef _RAD_WFSTMT_H_
+#define _RAD_WFSTMT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define WF_MAXARG	512		/* maximum # arguments in a statement */
+#define WF_MAXPROC	64		/* maximum # parsing processes */
+
+typedef struct {
+	char	*av[WF_MAXARG];		/* arguments (NULL-terminated) */
+	int	ac;			/* argument count */
+	int	lineno;			/* last line of statement (or file) */
+	int	toomany;		/* arguments were dropped? */
+	int	nfv;			/* converted vertex values */
+	double	fv[3];			/* v, vn or vt values if valid */
+} WFSTMT;
+
+extern int	wf_open(char *fname, int nproc);
+extern int	wf_getstmt(WFSTMT *sp);
+extern void	wf_close(void);
+
+#ifdef __cplusplus
+}
+#endif
+#endif	/* _RAD_WFSTMT_H_ */
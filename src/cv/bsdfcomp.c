@@ -0,0 +1,82 @@
+#ifndef lint
+static const char RCSid[] = "$Id$";
+#endif
+/*
+ * Compile BSDF XML files into binary sidecars for fast, shared loading
+ */
+
+#include "rtio.h"
+#include "paths.h"
+#include "bsdf.h"
+
+int	verbose = 0;			/* report what we do? */
+int	do_check = 0;			/* just check compiled files? */
+
+
+/* Compile (or check) a single BSDF file */
+static int
+compBSDF(char *fname)
+{
+	SDData	myBSDF;
+	SDError	ec;
+	char	*pname;
+					/* find and load the XML file */
+	pname = getpath(fname, getrlibpath(), R_OK);
+	if (pname == NULL) {
+		fprintf(stderr, "%s: cannot find BSDF file\n", fname);
+		return(0);
+	}
+	SDclearBSDF(&myBSDF, pname);
+	if (do_check) {
+		ec = SDloadCompiled(&myBSDF, pname);
+		if (verbose | !ec)
+			printf("%s: %s\n", pname, ec ? SDerrorDetail :
+					"compiled BSDF is current");
+		SDfreeBSDF(&myBSDF);
+		return(!ec);
+	}
+	if (SDreportError(SDloadFile(&myBSDF, pname), stderr))
+		return(0);
+	ec = SDsaveCompiled(&myBSDF, pname);
+	SDfreeBSDF(&myBSDF);
+	if (SDreportError(ec, stderr))
+		return(0);
+	if (verbose)
+		fprintf(stderr, "%s: compiled\n", pname);
+	return(1);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	int	status = 0;
+	int	i;
+
+	for (i = 1; i < argc && argv[i][0] == '-'; i++)
+		switch (argv[i][1]) {
+		case 'v':
+			verbose = 1;
+			break;
+		case 'c':
+			do_check = 1;
+			break;
+		default:
+			goto userr;
+		}
+	if (i >= argc) {
+		fprintf(stderr, "%s: missing XML input\n", argv[0]);
+		goto userr;
+	}
+	for ( ; i < argc; i++)
+		if (!compBSDF(argv[i])) {
+			fprintf(stderr, "%s: %s of '%s' failed\n", argv[0],
+					do_check ? "check" : "compilation",
+					argv[i]);
+			status = 1;
+		}
+	return(status);
+userr:
+	fprintf(stderr, "Usage: %s [-c][-v] input.xml ..\n", argv[0]);
+	return(1);
+}
@@ -19,6 +19,7 @@ static const char	RCSid[] = "$Id: obj2rad.c,v 2.29 2013/11/08 16:49:04 greg Exp
 #include "resolu.h"
 #include "trans.h"
 #include "tmesh.h"
+#include "wfstmt.h"
 
 
 #define PATNAME		"M-pat"		/* mesh pattern name (reused) */
@@ -42,7 +43,7 @@ typedef int	VNDX[3];	/* vertex index (point,map,normal) */
 
 #define CHUNKSIZ	1024	/* vertex allocation chunk size */
 
-#define MAXARG		512	/* maximum # arguments in a statement */
+#define MAXARG		WF_MAXARG	/* maximum # arguments in a statement */
 
 				/* qualifiers */
 #define Q_MTL		0
@@ -71,6 +72,8 @@ char	*defobj = DEFOBJ;	/* default (starting) object name */
 
 int	flatten = 0;		/* discard surface normal information */
 
+int	nproc = 1;		/* parsing processes */
+
 char	mapname[256];		/* current picture file */
 char	matname[256];		/* current material name */
 char	group[8][256];		/* current group name(s) */
@@ -79,9 +82,9 @@ char	*inpfile;		/* input file name */
 int	lineno;			/* current line number */
 int	faceno;			/* current face number */
 
-static void getnames(FILE *fp);
-static void convert(FILE *fp);
-static int getstmt(char *av[MAXARG], FILE *fp);
+static void getnames(void);
+static void convert(void);
+static int getstmt(WFSTMT *sp);
 static char * getmtl(void);
 static char * getonm(void);
 static int matchrule(RULEHD *rp);
@@ -119,19 +122,23 @@ main(		/* read in .OBJ file and convert */
 		case 'f':		/* flatten surfaces */
 			flatten++;
 			break;
+		case 'p':		/* parsing processes */
+			if (i >= argc-1)
+				goto userr;
+			nproc = atoi(argv[++i]);
+			break;
 		default:
 			goto userr;
 		}
 	if ((i > argc) | (i < argc-1))
 		goto userr;
-	if (i == argc)
-		inpfile = "<stdin>";
-	else if (freopen(inpfile=argv[i], "r", stdin) == NULL) {
+	inpfile = i==argc ? "<stdin>" : argv[i];
+	if (wf_open(i==argc ? (char *)NULL : argv[i], nproc) < 0) {
 		fprintf(stderr, "%s: cannot open\n", inpfile);
 		exit(1);
 	}
 	if (donames) {				/* scan for ids */
-		getnames(stdin);
+		getnames();
 		printf("filename \"%s\"\n", inpfile);
 		printf("filetype \"Wavefront\"\n");
 		write_quals(&qlist, qual, stdout);
@@ -141,31 +148,31 @@ main(		/* read in .OBJ file and convert */
 	} else {				/* translate file */
 		printf("# ");
 		printargs(argc, argv, stdout);
-		convert(stdin);
+		convert();
 	}
+	wf_close();
 	if (ndegen)
 		printf("# %d degenerate faces\n", ndegen);
 	if (n0norm)
 		printf("# %d invalid (zero) normals\n", n0norm);
 	exit(0);
 userr:
-	fprintf(stderr, "Usage: %s [-o obj][-m mapping][-n][-f] [file.obj]\n",
+	fprintf(stderr, "Usage: %s [-o obj][-m mapping][-n][-f][-p nproc] [file.obj]\n",
 			argv[0]);
 	exit(1);
 }
 
 
 void
-getnames(			/* get valid qualifier names */
-	FILE	*fp
-)
+getnames(void)			/* get valid qualifier names */
 {
-	char	*argv[MAXARG];
+	static WFSTMT	st;
+	char	**argv = st.av;
 	int	argc;
 	ID	tmpid;
 	int	i;
 
-	while ( (argc = getstmt(argv, fp)) )
+	while ( (argc = getstmt(&st)) )
 		switch (argv[0][0]) {
 		case 'f':				/* face */
 			if (!argv[0][1])
@@ -207,42 +214,39 @@ getnames(			/* get valid qualifier names */
 
 
 void
-convert(			/* convert an OBJ stream */
-	FILE	*fp
-)
+convert(void)			/* convert an OBJ stream */
 {
-	char	*argv[MAXARG];
+	static WFSTMT	st;
+	char	**argv = st.av;
 	int	argc;
 	int	nstats, nunknown;
 	int	i;
 
 	nstats = nunknown = 0;
 					/* scan until EOF */
-	while ( (argc = getstmt(argv, fp)) ) {
+	while ( (argc = getstmt(&st)) ) {
 		switch (argv[0][0]) {
 		case 'v':		/* vertex */
 			switch (argv[0][1]) {
 			case '\0':			/* point */
-				if (badarg(argc-1,argv+1,"fff"))
+				if (st.nfv != 3)
 					syntax("Bad vertex");
-				newv(atof(argv[1]), atof(argv[2]),
-						atof(argv[3]));
+				newv(st.fv[0], st.fv[1], st.fv[2]);
 				break;
 			case 'n':			/* normal */
 				if (argv[0][2])
 					goto unknown;
-				if (badarg(argc-1,argv+1,"fff"))
+				if (st.nfv != 3)
 					syntax("Bad normal");
-				if (!newvn(atof(argv[1]), atof(argv[2]),
-						atof(argv[3])))
+				if (!newvn(st.fv[0], st.fv[1], st.fv[2]))
 					syntax("Zero normal");
 				break;
 			case 't':			/* texture map */
 				if (argv[0][2])
 					goto unknown;
-				if (badarg(argc-1,argv+1,"ff"))
+				if (st.nfv != 2)
 					goto unknown;
-				newvt(atof(argv[1]), atof(argv[2]));
+				newvt(st.fv[0], st.fv[1]);
 				break;
 			default:
 				goto unknown;
@@ -312,42 +316,18 @@ convert(			/* convert an OBJ stream */
 
 
 int
-getstmt(				/* read the next statement from fp */
-	char	*av[MAXARG],
-	FILE	*fp
+getstmt(				/* read the next statement */
+	WFSTMT	*sp
 )
 {
-	static char	sbuf[MAXARG*16];
-	char	*cp;
-	int	i;
+	int	ac = wf_getstmt(sp);
 
-	do {
-		if (fgetline(cp=sbuf, sizeof(sbuf), fp) == NULL)
-			return(0);
-		i = 0;
-		for ( ; ; ) {
-			while (isspace(*cp) || *cp == '\\') {
-				if (*cp == '\n')
-					lineno++;
-				*cp++ = '\0';
-			}
-			if (!*cp)
-				break;
-			if (i >= MAXARG-1) {
-				fprintf(stderr,
+	lineno = sp->lineno;
+	if (sp->toomany)
+		fprintf(stderr,
 			"warning: line %d: too many arguments (limit %d)\n",
-					lineno+1, MAXARG-1);
-				break;
-			}
-			av[i++] = cp;
-			while (*++cp && !isspace(*cp))
-				;
-		}
-		av[i] = NULL;
-		lineno++;
-	} while (!i);
-
-	return(i);
+				lineno, MAXARG-1);
+	return(ac);
 }
 
 
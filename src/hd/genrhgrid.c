@@ -64,7 +64,7 @@ gridsect(		/* get specified section(s) and print grids */
 		error(SYSTEM, errmsg);
 	}
 					/* check header and magic number */
-	if (checkheader(fp, HOLOFMT, NULL) < 0 || getw(fp) != HOLOMAGIC) {
+	if (checkheader(fp, HOLOFMT, NULL) < 0 || !hdmagicOK(getw(fp))) {
 		sprintf(errmsg, "file \"%s\" not in holodeck format", fname);
 		error(USER, errmsg);
 	}
@@ -50,9 +50,18 @@ typedef struct {
 
 typedef struct {
 	uint32	nrd;		/* number of beam rays bundled on disk */
+	uint32	nsd;		/* RAYVAL slots used if beam is coded, else 0 */
 	off_t	fo;		/* position in file */
 } BEAMI;		/* beam index */
 
+typedef struct {
+	uint32	nrd;
+	off_t	fo;
+} BEAMI0;		/* version 0 beam index, sets on-disk entry size */
+
+				/* nsd must fit in padding after nrd */
+typedef char	BEAMIsizeOK[sizeof(BEAMI)==sizeof(BEAMI0) ? 1 : -1];
+
 typedef struct {
 	uint32	nrm;		/* number of beam rays bundled in memory */
 	uint32	tick;		/* clock tick for LRU replacement */
@@ -105,6 +114,8 @@ typedef struct {
 #define FF_KILL		010		/* free fragment on beam kill */
 
 extern int	hdfragflags;		/* tells when to free fragments */
+extern int	hdcompress;		/* beam coding (0 none, 1 lossless, >1 lossy) */
+extern int	hdwritebehind;		/* write in background process? */
 extern unsigned	hdcachesize;		/* target cache size (bytes) */
 extern unsigned long	hdclock;	/* holodeck system clock */
 extern HOLO	*hdlist[HDMAX+1];	/* holodeck pointers (NULL term.) */
@@ -120,8 +131,13 @@ extern int	hdwg1[6];		/* wall grid 1 index */
 					((dc)+.5)/DCLIN ) )
 
 #define HOLOFMT		"Holodeck"	/* file format identifier */
-#define HOLOVERS	0		/* file format version number */
-#define HOLOMAGIC	(324+sizeof(BEAMI)+16*HOLOVERS)	/* file magic number */
+#define HOLOVERS	1		/* file format version number */
+#define HOLOMAGIC0	(324+sizeof(BEAMI0))	/* version 0 (no coded beams) */
+#define HOLOMAGIC	(HOLOMAGIC0+16*HOLOVERS)	/* file magic number */
+
+				/* accept either version (m used once) */
+#define hdmagicOK(m)	((((unsigned)(m)-HOLOMAGIC0) | 16*HOLOVERS) \
+					== 16*HOLOVERS)
 
 /*
  * A holodeck file consists of an information header terminated by a
@@ -134,6 +150,12 @@ extern int	hdwg1[6];		/* wall grid 1 index */
  * section header and directory.
  * Similarly, every holodeck section in the file is preceeded by
  * a pointer to the following section, or 0 for the final section.
+ * Beginning with version 1, a beam may be stored in coded form, in
+ * which case its directory entry gives the number of RAYVAL-sized
+ * slots it occupies in nsd, which is always less than nrd.
+ * This field occupies what was alignment padding after nrd, so the
+ * directory layout is unchanged and version 0 files (which have a zero
+ * there) remain readable by both old and new programs.
  * Since holodeck files consist of directly written C data structures, 
  * they are not generally portable between different machine architectures.
  * In particular, different floating point formats or bit/byte ordering
@@ -170,6 +192,7 @@ extern int hdfreebeam(HOLO *hp, int i);
 extern int hdfreefrag(HOLO *hp, int i);
 extern int hdfragOK(int fd, int *listlen, int32 *listsiz);
 extern int hdkillbeam(HOLO *hp, int i);
+extern void hdwbsync(void);
 
 
 #ifdef __cplusplus
@@ -16,6 +16,11 @@ static const char	RCSid[] = "$Id: holofile.c,v 3.61 2018/10/05 19:19:16 greg Exp
 
 #include "holo.h"
 
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
 #ifndef CACHESIZE
 #ifdef SMLMEM
 #define CACHESIZE	10
@@ -54,7 +59,16 @@ static const char	RCSid[] = "$Id: holofile.c,v 3.61 2018/10/05 19:19:16 greg Exp
 
 #define FRAGBLK		512	/* number of fragments to allocate at a time */
 
+#define HCBLK		32	/* rays per coded block */
+#define NHCPL		9	/* coded planes per ray */
+				/* maximum coded size for nr rays */
+#define hdcodesiz(nr)	(1 + ((nr)+HCBLK-1)/HCBLK*NHCPL + (nr)*sizeof(RAYVAL))
+				/* RAYVAL slots occupied on disk */
+#define hdslots(bip)	((bip)->nsd ? (bip)->nsd : (bip)->nrd)
+
 int	hdfragflags = FF_DEFAULT;	/* tells when to free fragments */
+int	hdcompress = 0;			/* beam coding (0 none, 1 lossless, >1 lossy) */
+int	hdwritebehind = 0;		/* write in background process? */
 unsigned	hdcachesize = CACHESIZE*1024*1024;	/* target cache size */
 unsigned long	hdclock;		/* clock value */
 
@@ -70,6 +84,43 @@ static struct fraglist {
 
 static int	nhdfragls;	/* size of hdfragl array */
 
+static struct lruent {
+	HOLO	*h;		/* holodeck section */
+	int	b;		/* beam index */
+	uint32	tick;		/* clock tick when listed */
+} hdlru[FREEBEAMS];	/* least recently used beams, oldest first */
+
+static int	hdlrupos, hdlrulen;	/* next and end of hdlru list */
+
+typedef struct {
+	int	fd;		/* file descriptor */
+	off_t	pos;		/* file position */
+	long	n;		/* number of bytes */
+	long	bo;		/* offset in buffer */
+} WBSEG;		/* write-behind segment */
+
+static struct wbqueue {
+	WBSEG	*sl;		/* segment list */
+	int	nsegs, nalloc;	/* segments used & allocated */
+	char	*buf;		/* data buffer */
+	long	len, blen;	/* bytes used & allocated */
+} hdwbq[2];		/* pending and in-flight write queues */
+
+#define wbpend		(&hdwbq[0])
+#define wbflight	(&hdwbq[1])
+
+typedef struct {
+	int	nsegs;		/* number of segments (-1 to stop) */
+	long	len;		/* bytes of data following segments */
+} WBHDR;		/* queue header sent to writer */
+
+static RT_PID	hdwbpid = -1;	/* persistent writer process */
+static int	hdwbcmd = -1;	/* pipe to writer */
+static int	hdwback = -1;	/* acknowledgements from writer */
+static int	hdwbbusy = 0;	/* writer has a queue in flight? */
+
+#define WBXFER		(1L<<20)	/* maximum bytes per pipe transfer */
+
 static HOLO *hdalloc(HDGRID *hproto);
 static char *hdrealloc(char *ptr, unsigned siz, char *rout);
 static void hdattach(int fd, int wr);
@@ -77,10 +128,17 @@ static void hdrelease(int fd);
 static void hdmarkdirty(HOLO *hp, int i);
 static unsigned int hdmemuse(int all);
 static int hdfilord(const void *hb1, const void *hb2);
-static off_t hdallocfrag(int fd, uint32 nrays);
+static void hdreadbeam(HOLO *hp, int i);
+static off_t hdallocfrag(int fd, uint32 nslots);
 static int hdsyncbeam(HOLO *hp, int i);
-static int hdlrulist(HDBEAMI *hb, int nents, int n, HOLO *hp);
+static int hdlrulist(struct lruent *lr, int nents, int n, HOLO *hp);
 static int hdfreecache(int pct, HOLO *honly);
+static long hdcodebeam(uby8 *cp, RAYVAL *rv, int nr, int q);
+static int hddecodebeam(RAYVAL *rv, int nr, uby8 *cp, long len);
+static int hdwrite(int fd, off_t pos, char *bp, long n);
+static void hdwbflush(void);
+static void hdwbcheck(int fd, off_t pos, long n);
+static void hdwblaunch(void);
 
 
 
@@ -193,6 +251,8 @@ hdinit(	/* initialize a holodeck section in a file */
 	int	writable;
 	HOLO	*hp;
 	int	n;
+					/* finish background writes */
+	hdwbsync();
 					/* prepare for system errors */
 	errno = 0;
 	if ((fpos = lseek(fd, (off_t)0, SEEK_CUR)) < 0)
@@ -216,6 +276,10 @@ hdinit(	/* initialize a holodeck section in a file */
 				error(WARNING, "dirty holodeck section");
 				break;
 			}
+						/* coded beams are smaller */
+		for (n = nbeams(hp); n > 0; n--)
+			if (hp->bi[n].nsd >= hp->bi[n].nrd)
+				hp->bi[n].nsd = 0;
 						/* check writability */
 		if (fd < nhdfragls && hdfragl[fd].nlinks)
 			writable = hdfragl[fd].writable;
@@ -241,14 +305,17 @@ hdinit(	/* initialize a holodeck section in a file */
 	hdattach(fd, writable);
 					/* check rays on disk */
 	fpos = hdfilen(fd);
-	biglob(hp)->nrd = rtrunc = 0;
+	biglob(hp)->nrd = biglob(hp)->nsd = rtrunc = 0;
 	for (n = hproto == NULL ? nbeams(hp) : 0; n > 0; n--)
 		if (hp->bi[n].nrd) {
-			if (hp->bi[n].fo+hp->bi[n].nrd*sizeof(RAYVAL) > fpos) {
+			if (hp->bi[n].fo+hdslots(&hp->bi[n])*sizeof(RAYVAL)
+					> fpos) {
 				rtrunc += hp->bi[n].nrd;
-				hp->bi[n].nrd = 0;
-			} else
+				hp->bi[n].nrd = hp->bi[n].nsd = 0;
+			} else {
 				biglob(hp)->nrd += hp->bi[n].nrd;
+				biglob(hp)->nsd += hdslots(&hp->bi[n]);
+			}
 		}
 	if (rtrunc) {
 		sprintf(errmsg, "truncated section, %ld rays lost (%.1f%%)",
@@ -276,15 +343,13 @@ hdmarkdirty(		/* mark holodeck directory position dirty */
 	int	i
 )
 {
-	static BEAMI	smudge = {0, -1};
+	static BEAMI	smudge = {0, 0, -1};
 	int	mindist, minpos;
 	int	j;
 
 	if (!hp->dirty++) {			/* write smudge first time */
-		if (lseek(hp->fd, biglob(hp)->fo+(i-1)*sizeof(BEAMI),
-					SEEK_SET) < 0 ||
-				write(hp->fd, (char *)&smudge,
-					sizeof(BEAMI)) != sizeof(BEAMI))
+		if (hdwrite(hp->fd, biglob(hp)->fo+(i-1)*sizeof(BEAMI),
+				(char *)&smudge, sizeof(BEAMI)) != sizeof(BEAMI))
 			error(SYSTEM, "seek/write error in hdmarkdirty");
 		hp->dirseg[0].s = i;
 		hp->dirseg[0].n = 1;
@@ -324,20 +389,13 @@ hdmarkdirty(		/* mark holodeck directory position dirty */
 }
 
 
-int
-hdsync(			/* update beams and directory on disk */
+static int
+hdsyncsect(		/* update section beams and directory */
 	HOLO	*hp,
 	int	all
 )
 {
 	int	j, n;
-
-	if (hp == NULL) {		/* do all holodecks */
-		n = 0;
-		for (j = 0; hdlist[j] != NULL; j++)
-			n += hdsync(hdlist[j], all);
-		return(n);
-	}
 					/* sync the beams */
 	for (j = (all ? nbeams(hp) : 0); j > 0; j--)
 		if (hp->bl[j] != NULL)
@@ -346,11 +404,10 @@ hdsync(			/* update beams and directory on disk */
 		return(0);
 	errno = 0;			/* write dirty segments */
 	for (j = 0; j < hp->dirty; j++) {
-		if (lseek(hp->fd, biglob(hp)->fo +
-			    (hp->dirseg[j].s-1)*sizeof(BEAMI), SEEK_SET) < 0)
-			error(SYSTEM, "cannot seek on holodeck file");
 		n = hp->dirseg[j].n * sizeof(BEAMI);
-		if (write(hp->fd, (char *)(hp->bi+hp->dirseg[j].s), n) != n)
+		if (hdwrite(hp->fd, biglob(hp)->fo +
+				(hp->dirseg[j].s-1)*sizeof(BEAMI),
+				(char *)(hp->bi+hp->dirseg[j].s), n) != n)
 			error(SYSTEM, "cannot update section directory");
 	}
 	hp->dirty = 0;			/* all clean */
@@ -358,6 +415,25 @@ hdsync(			/* update beams and directory on disk */
 }
 
 
+int
+hdsync(			/* update beams and directory on disk */
+	HOLO	*hp,
+	int	all
+)
+{
+	int	j, n;
+
+	if (hp == NULL) {		/* do all holodecks */
+		n = 0;
+		for (j = 0; hdlist[j] != NULL; j++)
+			n += hdsyncsect(hdlist[j], all);
+	} else
+		n = hdsyncsect(hp, all);
+	hdwblaunch();			/* start any background writes */
+	return(n);
+}
+
+
 unsigned int
 hdmemuse(		/* return memory usage (in bytes) */
 	int	all			/* include overhead (painful) */
@@ -419,7 +495,7 @@ hdfiluse(	/* compute file usage (in bytes) */
 	for (j = 0; hdlist[j] != NULL; j++) {
 		if (hdlist[j]->fd != fd)
 			continue;
-		total += biglob(hdlist[j])->nrd * sizeof(RAYVAL);
+		total += biglob(hdlist[j])->nsd * sizeof(RAYVAL);
 		total += nbeams(hdlist[j])*sizeof(BEAMI) + sizeof(HDGRID);
 #if 0
 		for (i = nbeams(hdlist[j]); i > 0; i--)
@@ -433,6 +509,35 @@ hdfiluse(	/* compute file usage (in bytes) */
 }
 
 
+void
+hdreadbeam(		/* read allocated beam from holodeck file */
+	HOLO	*hp,
+	int	i
+)
+{
+	static uby8	*cbuf = NULL;
+	static int	cbufsiz = 0;
+	char	*dp = (char *)hdbray(hp->bl[i]);
+	int	n = hdslots(&hp->bi[i])*sizeof(RAYVAL);
+
+	hdwbcheck(hp->fd, hp->bi[i].fo, n);	/* wait for pending write */
+	if (hp->bi[i].nsd) {			/* read coded beam to buffer */
+		if (n > cbufsiz)
+			cbuf = (uby8 *)hdrealloc((char *)cbuf,
+					cbufsiz = n, "hdreadbeam");
+		dp = (char *)cbuf;
+	}
+	errno = 0;
+	if (lseek(hp->fd, hp->bi[i].fo, SEEK_SET) < 0)
+		error(SYSTEM, "seek error on holodeck file");
+	if (read(hp->fd, dp, n) != n)
+		error(SYSTEM, "error reading beam from holodeck file");
+	if (hp->bi[i].nsd && hddecodebeam(hdbray(hp->bl[i]),
+				hp->bi[i].nrd, cbuf, n) < 0)
+		error(USER, "bad coded beam in holodeck file");
+}
+
+
 RAYVAL *
 hdnewrays(	/* allocate space for add'l rays and return pointer */
 	HOLO	*hp,
@@ -454,15 +559,8 @@ hdnewrays(	/* allocate space for add'l rays and return pointer */
 		n = hp->bi[i].nrd + nr;
 		hp->bl[i] = (BEAM *)hdrealloc(NULL, hdbsiz(n), "hdnewrays");
 		blglob(hp)->nrm += n;
-		if ((n = hp->bl[i]->nrm = hp->bi[i].nrd)) {
-			errno = 0;
-			if (lseek(hp->fd, hp->bi[i].fo, SEEK_SET) < 0)
-				error(SYSTEM, "seek error on holodeck file");
-			n *= sizeof(RAYVAL);
-			if (read(hp->fd, (char *)hdbray(hp->bl[i]), n) != n)
-				error(SYSTEM,
-				"error reading beam from holodeck file");
-		}
+		if ((hp->bl[i]->nrm = hp->bi[i].nrd))
+			hdreadbeam(hp, i);
 	} else {				/* just grow in memory */
 		hp->bl[i] = (BEAM *)hdrealloc((char *)hp->bl[i],
 				hdbsiz(hp->bl[i]->nrm + nr), "hdnewrays");
@@ -495,12 +593,7 @@ hdgetbeam(	/* get beam (from file if necessary) */
 			hdfreecache(PCTFREE, NULL);	/* get free space */
 		hp->bl[i] = (BEAM *)hdrealloc(NULL, hdbsiz(n), "hdgetbeam");
 		blglob(hp)->nrm += hp->bl[i]->nrm = n;
-		errno = 0;
-		if (lseek(hp->fd, hp->bi[i].fo, SEEK_SET) < 0)
-			error(SYSTEM, "seek error on holodeck file");
-		n *= sizeof(RAYVAL);
-		if (read(hp->fd, (char *)hdbray(hp->bl[i]), n) != n)
-			error(SYSTEM, "error reading beam from holodeck file");
+		hdreadbeam(hp, i);
 		if (hdfragflags&FF_READ)
 			hdfreefrag(hp, i);	/* relinquish old frag. */
 	}
@@ -585,6 +678,7 @@ hdfreefrag(			/* free a file fragment */
 )
 {
 	BEAMI	*bi = &hp->bi[i];
+	uint32	ns = hdslots(bi);
 	struct fraglist	*f;
 	int	j, k;
 
@@ -610,7 +704,7 @@ hdfreefrag(			/* free a file fragment */
 #if MAXFRAGB
 	if (j >= MAXFRAGB*FRAGBLK) {
 		f->nfrags = j--;	/* stop list growth */
-		if (bi->nrd <= f->fi[j].nrd)
+		if (ns <= f->fi[j].nrd)
 			return(0);	/* new one no better than discard */
 	}
 #endif
@@ -630,7 +724,7 @@ hdfreefrag(			/* free a file fragment */
 	for ( ; ; j--) {		/* insert in descending list */
 		if (!j || bi->fo < f->fi[j-1].fo) {
 			f->fi[j].fo = bi->fo;
-			f->fi[j].nrd = bi->nrd;
+			f->fi[j].nrd = ns;
 			break;
 		}
 		*(f->fi+j) = *(f->fi+(j-1));
@@ -651,7 +745,8 @@ hdfreefrag(			/* free a file fragment */
 			break;
 		}
 	biglob(hp)->nrd -= bi->nrd;		/* tell fragment it's free */
-	bi->nrd = 0;
+	biglob(hp)->nsd -= ns;
+	bi->nrd = bi->nsd = 0;
 	bi->fo = 0;
 	hdmarkdirty(hp, i);			/* assume we'll reallocate */
 	return(1);
@@ -686,28 +781,28 @@ hdfragOK(	/* get fragment list status for file */
 off_t
 hdallocfrag(		/* allocate a file fragment */
 	int	fd,
-	uint32	nrays
+	uint32	nslots
 )
 {
 	struct fraglist	*f;
 	int	j;
 	off_t	nfo;
 
-	if (nrays == 0)
+	if (nslots == 0)
 		return(-1L);
 	DCHECK(fd < 0 | fd >= nhdfragls || !hdfragl[fd].nlinks,
 			CONSISTENCY, "bad file descriptor in hdallocfrag");
 	f = &hdfragl[fd];
 	for (j = f->nfrags; j-- > 0; )	/* first fit algorithm */
-		if (f->fi[j].nrd >= nrays)
+		if (f->fi[j].nrd >= nslots)
 			break;
 	if (j < 0) {			/* no fragment -- extend file */
 		nfo = f->flen;
-		f->flen += nrays*sizeof(RAYVAL);
+		f->flen += nslots*sizeof(RAYVAL);
 	} else {			/* else use fragment */
 		nfo = f->fi[j].fo;
-		f->fi[j].fo += nrays*sizeof(RAYVAL);
-		f->fi[j].nrd -= nrays;
+		f->fi[j].fo += nslots*sizeof(RAYVAL);
+		f->fi[j].nrd -= nslots;
 	}
 	return(nfo);
 }
@@ -719,9 +814,12 @@ hdsyncbeam(		/* sync beam in memory with beam on disk */
 	int	i
 )
 {
+	static uby8	*cbuf = NULL;
+	static long	cbufsiz = 0;
 	int	fragfreed;
-	uint32	nrays;
-	unsigned int	n;
+	uint32	nrays, nslots;
+	char	*dp;
+	long	n;
 	off_t	nfo;
 					/* check file status */
 	if (hdfragl[hp->fd].writable <= 0)
@@ -734,21 +832,37 @@ hdsyncbeam(		/* sync beam in memory with beam on disk */
 					/* relinquish old fragment? */
 	fragfreed = hdfragflags&FF_WRITE && hp->bi[i].nrd && hdfreefrag(hp,i);
 	if (nrays) {			/* get and write new fragment */
-		nfo = hdallocfrag(hp->fd, nrays);
+		dp = (char *)hdbray(hp->bl[i]);
+		nslots = nrays;
+		if (hdcompress > 0) {	/* use coded beam if smaller */
+			n = hdcodesiz(nrays);
+			if (n > cbufsiz)
+				cbuf = (uby8 *)hdrealloc((char *)cbuf,
+						cbufsiz = n, "hdsyncbeam");
+			n = hdcodebeam(cbuf, hdbray(hp->bl[i]), nrays,
+					hdcompress-1);
+			if ((n += sizeof(RAYVAL)-1)/sizeof(RAYVAL) < nrays) {
+				nslots = n/sizeof(RAYVAL);
+				n -= sizeof(RAYVAL)-1;
+				memset(cbuf+n, '\0', nslots*sizeof(RAYVAL)-n);
+				dp = (char *)cbuf;
+			}
+		}
+		nfo = hdallocfrag(hp->fd, nslots);
 		errno = 0;
-		if (lseek(hp->fd, nfo, SEEK_SET) < 0)
-			error(SYSTEM, "cannot seek on holodeck file");
-		n = hp->bl[i]->nrm * sizeof(RAYVAL);
-		if (write(hp->fd, (char *)hdbray(hp->bl[i]), n) != n) {
+		n = nslots * sizeof(RAYVAL);
+		if (hdwrite(hp->fd, nfo, dp, n) != n) {
 			hdfragl[hp->fd].writable = -1;
 			hdsync(NULL, 0);	/* sync directories */
 			error(SYSTEM, "write error in hdsyncbeam");
 		}
 		hp->bi[i].fo = nfo;
 	} else
-		hp->bi[i].fo = 0;
+		hp->bi[i].fo = nslots = 0;
 	biglob(hp)->nrd += nrays - hp->bi[i].nrd;
+	biglob(hp)->nsd += nslots - hdslots(&hp->bi[i]);
 	hp->bi[i].nrd = nrays;
+	hp->bi[i].nsd = nslots < nrays ? nslots : 0;
 	if (!fragfreed)
 		hdmarkdirty(hp, i);		/* need to flag dir. ent. */
 	return(1);
@@ -835,7 +949,8 @@ hdkillbeam(		/* delete beam from holodeck */
 		nchanged = hp->bi[i].nrd;
 	if (hp->bi[i].nrd && !(hdfragflags&FF_KILL && hdfreefrag(hp,i))) {
 		biglob(hp)->nrd -= hp->bi[i].nrd;	/* free failed */
-		hp->bi[i].nrd = 0;
+		biglob(hp)->nsd -= hdslots(&hp->bi[i]);
+		hp->bi[i].nrd = hp->bi[i].nsd = 0;
 		hp->bi[i].fo = 0;
 		hdmarkdirty(hp, i);
 	}
@@ -843,36 +958,78 @@ hdkillbeam(		/* delete beam from holodeck */
 }
 
 
+static void
+hdlrusift(		/* sift entry down LRU heap (newest on top) */
+	struct lruent	*lr,
+	int	i,
+	int	n
+)
+{
+	struct lruent	le = lr[i];
+	int	j;
+
+	while ((j = 2*i + 1) < n) {
+		if (j+1 < n && lr[j+1].tick > lr[j].tick)
+			j++;
+		if (lr[j].tick <= le.tick)
+			break;
+		lr[i] = lr[j];
+		i = j;
+	}
+	lr[i] = le;
+}
+
+
 int
-hdlrulist(	/* add beams from holodeck to LRU list */
-	HDBEAMI	*hb,		/* beam list */
-	int	nents,				/* current list length */
-	int	n,				/* maximum list length */
+hdlrulist(	/* add beams from holodeck to LRU heap */
+	struct lruent	*lr,		/* beam heap */
+	int	nents,				/* current heap size */
+	int	n,				/* maximum heap size */
 	HOLO	*hp			/* section we're adding from */
 )
 {
-	int	i, j;
-					/* insert each beam from hp */
+	uint32	tick;
+	int	i, j, k;
+					/* keep the n oldest beams */
 	for (i = 1; i <= nbeams(hp); i++) {
 		if (hp->bl[i] == NULL)		/* check if loaded */
 			continue;
-#if 0
-		if (hp->bl[i]->tick == hdclock)	/* preempt swap? */
-			continue;
-#endif
-		if ((j = ++nents) >= n)		/* grow list if we can */
-			nents--;
-		for ( ; ; ) {			/* bubble into place */
-			if (!--j || hp->bl[i]->tick >=
-					hb[j-1].h->bl[hb[j-1].b]->tick) {
-				hb[j].h = hp;
-				hb[j].b = i;
-				break;
+		tick = hp->bl[i]->tick;
+		if (nents < n) {		/* grow heap */
+			for (j = nents++; j > 0; j = k) {
+				k = (j-1) >> 1;
+				if (lr[k].tick >= tick)
+					break;
+				lr[j] = lr[k];
 			}
-			*(hb+j) = *(hb+(j-1));
-		}
+		} else if (tick < lr[0].tick)	/* replace newest */
+			j = 0;
+		else
+			continue;
+		lr[j].h = hp;
+		lr[j].b = i;
+		lr[j].tick = tick;
+		if (nents == n && !j)
+			hdlrusift(lr, 0, nents);
+	}
+	return(nents);			/* return new heap size */
+}
+
+
+static int
+hdlrusort(	/* sort LRU heap, oldest first */
+	struct lruent	*lr,
+	int	n
+)
+{
+	struct lruent	le;
+	int	i;
+
+	for (i = n; --i > 0; ) {
+		le = lr[0]; lr[0] = lr[i]; lr[i] = le;
+		hdlrusift(lr, 0, i);
 	}
-	return(nents);			/* return new list length */
+	return(n);
 }
 
 
@@ -882,8 +1039,10 @@ hdfreecache(		/* free up cache space, writing changes */
 	HOLO	*honly			/* NULL means check all */
 )
 {
-	HDBEAMI	hb[FREEBEAMS];
+	struct lruent	hb[FREEBEAMS];
+	struct lruent	*lp;
 	int	freetarget;
+	int	relisted = 0;
 	int	n;
 	int	i;
 #ifdef DEBUG
@@ -897,19 +1056,36 @@ hdfreecache(		/* free up cache space, writing changes */
 	freetarget = freetarget*pct/100;
 	if (freetarget <= 0)
 		return(0);
-						/* find least recently used */
-	n = 0;
-	if (honly != NULL)
-		n = hdlrulist(hb, n, FREEBEAMS, honly);
-	else
-		for (i = 0; hdlist[i] != NULL; i++)
-			n = hdlrulist(hb, n, FREEBEAMS, hdlist[i]);
-						/* free LRU beams */
-	for (i = 0; i < n; i++) {
-		hdfreebeam(hb[i].h, hb[i].b);
-		if ((freetarget -= hb[i].h->bi[hb[i].b].nrd) <= 0)
-			break;
-	}
+	if (honly != NULL) {			/* free from one section */
+		n = hdlrusort(hb, hdlrulist(hb, 0, FREEBEAMS, honly));
+		for (i = 0; i < n; i++) {
+			hdfreebeam(hb[i].h, hb[i].b);
+			if ((freetarget -= hb[i].h->bi[hb[i].b].nrd) <= 0)
+				break;
+		}
+	} else					/* else use saved LRU list */
+		for ( ; ; ) {
+			if (hdlrupos >= hdlrulen) {	/* need new list */
+				if (relisted++)
+					break;
+				hdlrulen = 0;
+				for (i = 0; hdlist[i] != NULL; i++)
+					hdlrulen = hdlrulist(hdlru, hdlrulen,
+							FREEBEAMS, hdlist[i]);
+				hdlrusort(hdlru, hdlrulen);
+				if (!hdlrulen)
+					break;
+				hdlrupos = 0;
+			}
+			lp = &hdlru[hdlrupos++];
+						/* since touched or freed? */
+			if (lp->h->bl[lp->b] == NULL ||
+					lp->h->bl[lp->b]->tick != lp->tick)
+				continue;
+			hdfreebeam(lp->h, lp->b);
+			if ((freetarget -= lp->h->bi[lp->b].nrd) <= 0)
+				break;
+		}
 	hdsync(honly, 0);	/* synchronize directories as necessary */
 #ifdef DEBUG
 	sprintf(errmsg,
@@ -937,6 +1113,8 @@ hddone(		/* clean up holodeck section and free */
 	}
 					/* flush all data and free memory */
 	hdflush(hp);
+	hdwbsync();
+	hdlrupos = hdlrulen = 0;	/* forget saved LRU list */
 					/* release fragment resources */
 	hdrelease(hp->fd);
 					/* remove hp from active list */
@@ -949,3 +1127,496 @@ hddone(		/* clean up holodeck section and free */
 	free((void *)hp->bl);		/* free beam list */
 	free((void *)hp);		/* free holodeck struct */
 }
+
+
+#define HCDELTA		0100	/* block coded as differences */
+#define HCWMASK		037	/* block bit width mask */
+#define HCMAXQ		4	/* maximum mantissa bits to drop */
+
+static unsigned
+hcgetv(			/* get ray value for coded plane */
+	RAYVAL	*rv,
+	int	p
+)
+{
+	if (p < 4)
+		return(rv->r[p>>1][p&1]);
+	if (p < 8)
+		return(rv->v[p-4]);
+	return(rv->d);
+}
+
+
+static void
+hcsetv(			/* set ray value for coded plane */
+	RAYVAL	*rv,
+	int	p,
+	unsigned	v
+)
+{
+	if (p < 4)
+		rv->r[p>>1][p&1] = v;
+	else if (p < 8)
+		rv->v[p-4] = v;
+	else
+		rv->d = v;
+}
+
+
+static int
+hcbits(			/* count significant bits */
+	unsigned	v
+)
+{
+	int	w;
+
+	for (w = 0; v; w++)
+		v >>= 1;
+	return(w);
+}
+
+
+static uby8 *
+hcputbits(		/* pack m values of w bits */
+	uby8	*cp,
+	unsigned	*x,
+	int	m,
+	int	w
+)
+{
+	unsigned long	acc = 0;
+	int	nb = 0;
+
+	while (m-- > 0) {
+		acc |= (unsigned long)*x++ << nb;
+		for (nb += w; nb >= 8; nb -= 8) {
+			*cp++ = acc & 0xff;
+			acc >>= 8;
+		}
+	}
+	if (nb > 0)
+		*cp++ = acc;
+	return(cp);
+}
+
+
+static uby8 *
+hcgetbits(		/* unpack m values of w bits */
+	unsigned	*x,
+	int	m,
+	int	w,
+	uby8	*cp
+)
+{
+	unsigned long	acc = 0;
+	int	nb = 0;
+
+	while (m-- > 0) {
+		for ( ; nb < w; nb += 8)
+			acc |= (unsigned long)*cp++ << nb;
+		*x++ = acc & ((1L<<w) - 1);
+		acc >>= w;
+		nb -= w;
+	}
+	return(cp);
+}
+
+
+long
+hdcodebeam(		/* code beam rays, returning length in bytes */
+	uby8	*cp,
+	RAYVAL	*rv,
+	int	nr,
+	int	q			/* mantissa bits to drop */
+)
+{
+	unsigned	x[HCBLK], z[HCBLK], last[NHCPL];
+	unsigned	xbits, zbits;
+	uby8	*cp0 = cp;
+	int	p, m, k, s, d;
+
+	if (q < 0)
+		q = 0;
+	else if (q > HCMAXQ)
+		q = HCMAXQ;
+	*cp++ = q;
+	memset((void *)last, '\0', sizeof(last));
+					/* blocks of rays by plane */
+	for ( ; nr > 0; nr -= HCBLK, rv += HCBLK) {
+		m = nr < HCBLK ? nr : HCBLK;
+		for (p = 0; p < NHCPL; p++) {
+			s = (p >= 4+RED) & (p <= 4+BLU) ? q : 0;
+			xbits = zbits = 0;
+			for (k = 0; k < m; k++) {
+				x[k] = hcgetv(rv+k, p) >> s;
+				xbits |= x[k];
+				d = (int)x[k] - (int)(k ? x[k-1] : last[p]);
+				zbits |= z[k] = d < 0 ? -2*d - 1 : 2*d;
+			}
+			last[p] = x[m-1];
+			if ((d = hcbits(zbits)) < (k = hcbits(xbits))) {
+				*cp++ = d | HCDELTA;
+				cp = hcputbits(cp, z, m, d);
+			} else {
+				*cp++ = k;
+				cp = hcputbits(cp, x, m, k);
+			}
+		}
+	}
+	return(cp - cp0);
+}
+
+
+int
+hddecodebeam(		/* decode beam rays, returning 0 if OK */
+	RAYVAL	*rv,
+	int	nr,
+	uby8	*cp,
+	long	len
+)
+{
+	unsigned	x[HCBLK], last[NHCPL];
+	uby8	*ep = cp + len;
+	int	q, p, m, k, s, w, hc;
+
+	if ((len < 1) | ((q = *cp++) > HCMAXQ))
+		return(-1);
+	memset((void *)last, '\0', sizeof(last));
+	for ( ; nr > 0; nr -= HCBLK, rv += HCBLK) {
+		m = nr < HCBLK ? nr : HCBLK;
+		for (p = 0; p < NHCPL; p++) {
+			if (cp >= ep)
+				return(-1);
+			w = (hc = *cp++) & HCWMASK;
+			if ((w > 17) | (cp + (m*w+7)/8 > ep))
+				return(-1);
+			cp = hcgetbits(x, m, w, cp);
+			if (hc & HCDELTA)
+				for (k = 0; k < m; k++)
+					x[k] = (k ? x[k-1] : last[p]) +
+						(x[k] & 1 ? -(int)((x[k]+1)>>1) :
+							(int)(x[k]>>1));
+			last[p] = x[m-1];
+			s = (p >= 4+RED) & (p <= 4+BLU) ? q : 0;
+			for (k = 0; k < m; k++)
+				hcsetv(rv+k, p, s ? x[k]<<s | 1<<(s-1) : x[k]);
+		}
+	}
+	return(0);
+}
+
+
+static int
+hdwboverlap(		/* check queue for overlapping segment */
+	struct wbqueue	*wq,
+	int	fd,
+	off_t	pos,
+	long	n
+)
+{
+	WBSEG	*sp;
+
+	for (sp = wq->sl + wq->nsegs; sp-- > wq->sl; )
+		if ((sp->fd == fd) & (sp->pos < pos+n) & (pos < sp->pos+sp->n))
+			return(1);
+	return(0);
+}
+
+
+static int
+hdwbwriteq(		/* write out queued segments, -1 on error */
+	struct wbqueue	*wq
+)
+{
+	WBSEG	*sp;
+	char	*bp;
+	long	n, nw;
+
+	for (sp = wq->sl; sp < wq->sl + wq->nsegs; sp++) {
+		bp = wq->buf + sp->bo;
+#if !defined(_WIN32) && !defined(_WIN64)
+		for (n = 0; n < sp->n; n += nw)	/* leave file offset alone */
+			if ((nw = pwrite(sp->fd, bp+n, sp->n-n, sp->pos+n)) <= 0)
+				return(-1);
+#else
+		if (lseek(sp->fd, sp->pos, SEEK_SET) < 0 ||
+				write(sp->fd, bp, sp->n) != sp->n)
+			return(-1);
+#endif
+	}
+	return(0);
+}
+
+
+static void
+hdwbfail(		/* mark files in queue unwritable and report */
+	struct wbqueue	*wq,
+	char	*rout
+)
+{
+	int	i;
+
+	for (i = wq->nsegs; i--; )
+		if (wq->sl[i].fd < nhdfragls)
+			hdfragl[wq->sl[i].fd].writable = -1;
+	wq->nsegs = 0; wq->len = 0;
+	sprintf(errmsg, "write error in %s", rout);
+	error(SYSTEM, errmsg);
+}
+
+
+static int
+hdwbxfer(		/* move n bytes through pipe, -1 on error */
+	int	fd,
+	char	*bp,
+	long	n,
+	int	wr
+)
+{
+	long	m;
+
+	for ( ; n > 0; n -= m, bp += m) {
+		m = n < WBXFER ? n : WBXFER;
+		if ((wr ? writebuf(fd, bp, m) : readbuf(fd, bp, m)) != m)
+			return(-1);
+	}
+	return(0);
+}
+
+
+#if !defined(_WIN32) && !defined(_WIN64)
+static void
+hdwbserve(void)			/* writer process loop (does not return) */
+{
+	struct wbqueue	wq;
+	WBHDR	wh;
+	char	st;
+
+	memset((void *)&wq, 0, sizeof(wq));
+	while (hdwbxfer(hdwbcmd, (char *)&wh, sizeof(wh), 0) == 0 &&
+			wh.nsegs >= 0) {
+		if (wh.nsegs > wq.nalloc) {
+			free((void *)wq.sl);
+			wq.sl = (WBSEG *)malloc(wh.nsegs*sizeof(WBSEG));
+			if (wq.sl == NULL)
+				_exit(1);
+			wq.nalloc = wh.nsegs;
+		}
+		if (wh.len > wq.blen) {
+			free((void *)wq.buf);
+			if ((wq.buf = (char *)malloc(wh.len)) == NULL)
+				_exit(1);
+			wq.blen = wh.len;
+		}
+		if (hdwbxfer(hdwbcmd, (char *)wq.sl,
+					wh.nsegs*sizeof(WBSEG), 0) < 0 ||
+				hdwbxfer(hdwbcmd, wq.buf, wh.len, 0) < 0)
+			_exit(1);
+		wq.nsegs = wh.nsegs; wq.len = wh.len;
+		st = (hdwbwriteq(&wq) < 0);
+		write(hdwback, &st, 1);	/* ignored if parent is gone */
+	}
+	_exit(0);			/* stopped, or parent exited */
+}
+
+
+static int
+hdwbstart(void)			/* start persistent writer, 0 on failure */
+{
+	int	p1[2], p2[2];
+	int	fd, maxfd;
+
+	if (pipe(p1) < 0)
+		return(0);
+	if (pipe(p2) < 0) {
+		close(p1[0]); close(p1[1]);
+		return(0);
+	}
+	if ((hdwbpid = fork()) == 0) {	/* child keeps only holodecks */
+		signal(SIGINT, SIG_IGN);
+		signal(SIGHUP, SIG_IGN);
+		signal(SIGTERM, SIG_IGN);
+		signal(SIGPIPE, SIG_IGN);
+		hdwbcmd = p1[0]; hdwback = p2[1];
+		if ((maxfd = sysconf(_SC_OPEN_MAX)) < 0)
+			maxfd = 256;
+		for (fd = 3; fd < maxfd; fd++)
+			if ((fd != hdwbcmd) & (fd != hdwback) &&
+					(fd >= nhdfragls || !hdfragl[fd].nlinks))
+				close(fd);
+		hdwbserve();
+	}
+	close(p1[0]); close(p2[1]);
+	if (hdwbpid < 0) {
+		close(p1[1]); close(p2[0]);
+		return(0);
+	}
+	hdwbcmd = p1[1]; hdwback = p2[0];
+	fcntl(hdwbcmd, F_SETFD, FD_CLOEXEC);
+	fcntl(hdwback, F_SETFD, FD_CLOEXEC);
+	return(1);
+}
+
+
+static void
+hdwbstop(			/* stop persistent writer */
+	int	tell		/* send stop request (else it died)? */
+)
+{
+	WBHDR	wh;
+	int	status;
+
+	if (hdwbpid <= 0)
+		return;
+	wh.nsegs = -1; wh.len = 0;
+	if (tell)
+		writebuf(hdwbcmd, (char *)&wh, sizeof(wh));
+	close(hdwbcmd); close(hdwback);
+	hdwbcmd = hdwback = -1;
+	while (waitpid(hdwbpid, &status, 0) < 0 && errno == EINTR)
+		;
+	hdwbpid = -1;
+	hdwbbusy = 0;
+}
+#endif
+
+
+static void
+hdwbwait(void)			/* wait for writer to finish its queue */
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	char	st = 1;
+
+	if (!hdwbbusy)
+		return;
+	hdwbbusy = 0;
+	if (readbuf(hdwback, &st, 1) != 1 || st) {
+		hdwbstop(0);		/* don't use it again */
+		hdwbfail(wbflight, "holodeck write-behind");
+	}
+	wbflight->nsegs = 0; wbflight->len = 0;
+#endif
+}
+
+
+void
+hdwbflush(void)			/* finish pending writes, keeping writer */
+{
+	hdwbwait();
+	if (!wbpend->nsegs)
+		return;
+	if (hdwbwriteq(wbpend) < 0)
+		hdwbfail(wbpend, "hdwbsync");
+	wbpend->nsegs = 0; wbpend->len = 0;
+}
+
+
+void
+hdwbsync(void)			/* finish all pending writes, stop writer */
+{
+	hdwbflush();
+#if !defined(_WIN32) && !defined(_WIN64)
+	hdwbstop(1);
+#endif
+}
+
+
+void
+hdwbcheck(		/* finish writes overlapping the given region */
+	int	fd,
+	off_t	pos,
+	long	n
+)
+{
+	if (hdwbbusy && hdwboverlap(wbflight, fd, pos, n))
+		hdwbwait();
+	if (wbpend->nsegs && hdwboverlap(wbpend, fd, pos, n))
+		hdwbflush();
+}
+
+
+void
+hdwblaunch(void)		/* hand pending queue to writer */
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	struct wbqueue	wq;
+	WBHDR	wh;
+	int	status;
+
+	if (!wbpend->nsegs)
+		return;
+	hdwbwait();			/* one queue at a time */
+	if (hdwbpid > 0 && waitpid(hdwbpid, &status, WNOHANG) != 0)
+		hdwbstop(0);		/* exited on its own */
+	if (hdwbpid > 0 || hdwbstart()) {
+		wh.nsegs = wbpend->nsegs; wh.len = wbpend->len;
+		if (hdwbxfer(hdwbcmd, (char *)&wh, sizeof(wh), 1) == 0 &&
+				hdwbxfer(hdwbcmd, (char *)wbpend->sl,
+					wh.nsegs*sizeof(WBSEG), 1) == 0 &&
+				hdwbxfer(hdwbcmd, wbpend->buf, wh.len, 1) == 0) {
+			wq = *wbflight; *wbflight = *wbpend; *wbpend = wq;
+			wbpend->nsegs = 0; wbpend->len = 0;
+			hdwbbusy = 1;	/* writer has it now */
+			return;
+		}
+		hdwbstop(0);		/* writer gone -- write it ourselves */
+	}
+#endif
+	hdwbflush();			/* else write them ourselves */
+}
+
+
+int
+hdwrite(		/* write data to holodeck file, or queue it */
+	int	fd,
+	off_t	pos,
+	char	*bp,
+	long	n
+)
+{
+	struct wbqueue	*wq = wbpend;
+	WBSEG	*sp = NULL;
+
+	hdwbcheck(fd, pos, n);		/* keep writes in order */
+	if (!hdwritebehind)
+		goto dowrite;
+	if (wq->nsegs)			/* extends previous segment? */
+		sp = wq->sl + wq->nsegs-1;
+	if (sp == NULL || (sp->fd != fd) | (sp->pos + sp->n != pos)) {
+		sp = NULL;
+		if (wq->nsegs >= wq->nalloc) {
+			WBSEG	*newl = (WBSEG *)realloc((void *)wq->sl,
+					(wq->nalloc+256)*sizeof(WBSEG));
+			if (newl == NULL)
+				goto syncwrite;
+			wq->sl = newl;
+			wq->nalloc += 256;
+		}
+	}
+	if (wq->len + n > wq->blen) {
+		char	*newb = (char *)realloc((void *)wq->buf,
+						2*wq->blen + n);
+		if (newb == NULL)
+			goto syncwrite;
+		wq->buf = newb;
+		wq->blen = 2*wq->blen + n;
+	}
+	if (sp != NULL)
+		sp->n += n;
+	else {
+		sp = wq->sl + wq->nsegs++;
+		sp->fd = fd;
+		sp->pos = pos;
+		sp->n = n;
+		sp->bo = wq->len;
+	}
+	memcpy((void *)(wq->buf + wq->len), (void *)bp, n);
+	wq->len += n;
+	return(n);
+syncwrite:				/* out of memory -- write it now */
+	hdwbflush();
+dowrite:
+	if (lseek(fd, pos, SEEK_SET) < 0)
+		return(-1);
+	return(write(fd, bp, n));
+}
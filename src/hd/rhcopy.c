@@ -144,7 +144,7 @@ openholo(		/* open existing holodeck file for i/o */
 	}
 					/* check header and magic number */
 	if (getheader(fp, holheadline, &hflags) < 0 ||
-			hflags&H_BADF || getw(fp) != HOLOMAGIC) {
+			hflags&H_BADF || !hdmagicOK(getw(fp))) {
 		sprintf(errmsg, "file \"%s\" not in holodeck format", fname);
 		error(USER, errmsg);
 	}
@@ -57,7 +57,7 @@ gethdinfo(		/* get information on holodeck */
 		error(SYSTEM, errmsg);
 	}
 					/* check header and magic number */
-	if (checkheader(fp, HOLOFMT, fout) < 0 || getw(fp) != HOLOMAGIC) {
+	if (checkheader(fp, HOLOFMT, fout) < 0 || !hdmagicOK(getw(fp))) {
 		sprintf(errmsg, "file \"%s\" not in holodeck format", fname);
 		error(USER, errmsg);
 	}
@@ -36,12 +36,13 @@ int	NVARS = NRHVARS;		/* total number of variables */
 
 VARIABLE	vv[] = RHVINIT;		/* variable-value pairs */
 
-char	*progname;		/* our program name */
 char	*hdkfile;		/* holodeck file name */
 char	froot[256];		/* root file name */
 
 int	ncprocs = 0;		/* desired number of compute processes */
 
+int	rtlinked = 0;		/* compute rays in-process? */
+
 char	*outdev = NULL;		/* output device name */
 
 int	readinp = 0;		/* read commands from stdin */
@@ -59,6 +60,8 @@ char	*rtargv[MAXRTARGC] = {"rtrace", NULL};
 
 int	orig_mode = -1;		/* original file mode (-1 if unchanged) */
 
+static off_t	oldmagicloc = -1;	/* version 0 magic number position */
+
 long	nraysdone = 0L;		/* number of rays done */
 long	npacksdone = 0L;	/* number of packets done */
 
@@ -106,8 +109,10 @@ main(
 			readinp++;
 			break;
 		case 'n':			/* compute processes */
+		case 'N':			/* linked compute processes */
 			if (i >= argc-2)
 				goto userr;
+			rtlinked = (argv[i][1] == 'N');
 			ncprocs = atoi(argv[++i]);
 			break;
 		case 'o':			/* output display */
@@ -164,7 +169,7 @@ main(
 	quit(0);
 userr:
 	fprintf(stderr,
-"Usage: %s [-n nprocs][-o disp][-i][-w][-r|-f] output.hdk [control.hif|+|- [VAR=val ..]]\n",
+"Usage: %s [-n|-N nprocs][-o disp][-i][-w][-r|-f] output.hdk [control.hif|+|- [VAR=val ..]]\n",
 			progname);
 	quit(1);
 	return 1; /* pro forma return */
@@ -182,6 +187,7 @@ onsig(				/* fatal signal */
 		return;
 	if (gotsig++) {			/* two signals and we split */
 		hdsync(NULL, 0);	/* don't leave w/o saying goodbye */
+		hdwbsync();
 		_exit(signo);
 	}
 	alarm(300);			/* allow 10 minutes to clean up */
@@ -248,6 +254,16 @@ initrholo(void)			/* get our holodeck running */
 		hdcachesize = 0;		/* manual flushing */
 	else if (vdef(CACHE))
 		hdcachesize = 1024.*1024.*vflt(CACHE);
+	hdwritebehind = 1;			/* write beams in background */
+						/* set beam coding */
+	if (vdef(COMPRESS) && (hdcompress = vint(COMPRESS)) > 0 &&
+			oldmagicloc >= 0 && (ncprocs > 0) & (force >= 0)) {
+		i = HOLOMAGIC;			/* update file version */
+		if (lseek(hdlist[0]->fd, oldmagicloc, SEEK_SET) < 0 ||
+				write(hdlist[0]->fd, (char *)&i,
+					sizeof(i)) != sizeof(i))
+			error(SYSTEM, "cannot update holodeck file version");
+	}
 						/* open report file */
 	if (vdef(REPORT)) {
 		char	*s = sskip2(vval(REPORT), 1);
@@ -468,7 +484,8 @@ creatholo(			/* create a holodeck output file */
 	printvars(fp);
 	fputformat(HOLOFMT, fp);
 	fputc('\n', fp);
-	putw(HOLOMAGIC, fp);		/* put magic number */
+	oldmagicloc = ftell(fp);	/* version 0 until beams are coded */
+	putw(HOLOMAGIC0, fp);		/* put magic number */
 	fd = dup(fileno(fp));
 	fclose(fp);			/* flush and close stdio stream */
 	lastloc = lseek(fd, (off_t)0, SEEK_END);
@@ -545,12 +562,14 @@ loadholo(void)			/* start loading a holodeck from fname */
 					/* load variables from header */
 	getheader(fp, headline, NULL);
 					/* check magic number */
-	if (getw(fp) != HOLOMAGIC) {
+	if (!hdmagicOK(n = getw(fp))) {
 		sprintf(errmsg, "bad magic number in holodeck file \"%s\"",
 				hdkfile);
 		error(USER, errmsg);
 	}
 	nextloc = ftell(fp);			/* get stdio position */
+	if (n != HOLOMAGIC)			/* no coded beams yet */
+		oldmagicloc = nextloc - sizeof(n);
 	fd = dup(fileno(fp));
 	fclose(fp);				/* done with stdio */
 	for (n = 0; nextloc > 0L; n++) {	/* initialize each section */
@@ -656,9 +675,12 @@ int	ec;
 {
 	int	status = 0;
 
+	if (nprocs < 0)			/* in-process ray worker */
+		_exit(ec);
 	if (hdlist[0] != NULL) {	/* close holodeck */
 		if (nprocs > 0)
 			status = done_rtrace();		/* calls hdsync() */
+		hdwbsync();			/* finish background writes */
 		if ((ncprocs > 0) & (force >= 0) && vdef(REPORT)) {
 			off_t	fsiz, fuse;
 			fsiz = hdfilen(hdlist[0]->fd);
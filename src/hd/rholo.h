@@ -49,24 +49,26 @@ typedef struct {
 
 				/* input variables */
 #define CACHE		0		/* amount of memory to use as cache */
-#define DISKSPACE	1		/* how much disk space to use */
-#define EYESEP		2		/* eye separation distance */
-#define GEOMETRY	3		/* section geometry */
-#define GRID		4		/* target grid size */
-#define OBSTRUCTIONS	5		/* shall we track obstructions? */
-#define OCTREE		6		/* octree file name */
-#define PORTS		7		/* section portals */
-#define RENDER		8		/* rendering options */
-#define REPORT		9		/* report interval and error file */
-#define RIF		10		/* rad input file */
-#define SECTION		11		/* holodeck section boundaries */
-#define TIME		12		/* maximum rendering time */
-#define VDIST		13		/* virtual distance calculation */
-
-#define NRHVARS		14		/* number of variables */
+#define COMPRESS	1		/* beam coding on disk */
+#define DISKSPACE	2		/* how much disk space to use */
+#define EYESEP		3		/* eye separation distance */
+#define GEOMETRY	4		/* section geometry */
+#define GRID		5		/* target grid size */
+#define OBSTRUCTIONS	6		/* shall we track obstructions? */
+#define OCTREE		7		/* octree file name */
+#define PORTS		8		/* section portals */
+#define RENDER		9		/* rendering options */
+#define REPORT		10		/* report interval and error file */
+#define RIF		11		/* rad input file */
+#define SECTION		12		/* holodeck section boundaries */
+#define TIME		13		/* maximum rendering time */
+#define VDIST		14		/* virtual distance calculation */
+
+#define NRHVARS		15		/* number of variables */
 
 #define RHVINIT { \
 	{"CACHE",	2,	0,	NULL,	fltvalue}, \
+	{"COMPRESS",	2,	0,	NULL,	intvalue}, \
 	{"DISKSPACE",	3,	0,	NULL,	fltvalue}, \
 	{"EYESEP",	3,	0,	NULL,	fltvalue}, \
 	{"geometry",	3,	0,	NULL,	NULL}, \
@@ -103,6 +105,7 @@ extern int	nowarn;		/* turn warnings off? */
 
 extern int	ncprocs;	/* number of requested compute processes */
 extern int	nprocs;		/* number of running compute processes */
+extern int	rtlinked;	/* compute rays in-process? */
 
 extern int	chunkycmp;	/* using "chunky" comparison mode */
 
@@ -133,6 +136,11 @@ extern int start_rtrace(void);
 extern int end_rtrace(void);
 extern PACKET *do_packets(PACKET *pl);
 extern PACKET *flush_queue(void);
+	/* rholo2r.c */
+extern int start_raycalc(void);
+extern int end_raycalc(void);
+extern PACKET *do_raycalc(PACKET *pl);
+extern PACKET *flush_raycalc(void);
 	/* rholo3.c */
 extern void init_global(void);
 extern int next_packet(PACKET *p, int	n);
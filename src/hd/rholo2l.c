@@ -53,6 +53,8 @@ start_rtrace(void)			/* start rtrace process */
 		error(WARNING, errmsg);
 		ncprocs = MAXPROC;
 	}
+	if (rtlinked)				/* in-process calculation? */
+		return(start_raycalc());
 	if (rtargv[rtargc-1] != vval(OCTREE)) {
 						/* add compulsory options */
 		rtargv[rtargc++] = "-i-";
@@ -249,6 +251,8 @@ do_packets(			/* queue a packet list, return finished */
 					/* consistency check */
 	if (nprocs < 1)
 		error(CONSISTENCY, "do_packets called with no active process");
+	if (rtlinked)
+		return(do_raycalc(pl));
 					/* queue each new packet */
 	while (pl != NULL) {
 		p = pl; pl = p->next; p->next = NULL;
@@ -267,6 +271,8 @@ flush_queue(void)			/* empty all rtrace queues */
 	PACKET	*p;
 	int	i, n, nr;
 
+	if (rtlinked)
+		return(flush_raycalc());
 	for (i = 0; i < nprocs; i++)
 		if (pqlen[i]) {
 			if (rpdone == NULL) {		/* tack on queue */
@@ -322,6 +328,8 @@ end_rtrace(void)			/* close rtrace process(es) */
 {
 	int	status = 0, rv;
 
+	if (rtlinked)
+		return(end_raycalc());
 	if (nprocs > 1)
 		killpersist();
 	status = close_processes(rtpd, nprocs);
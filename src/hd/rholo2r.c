@@ -0,0 +1,361 @@
+#ifndef lint
+static const char	RCSid[] = "$Id$";
+#endif
+/*
+ * Routines for in-process ray calculation (linked renderer)
+ *
+ *	The scene is loaded once with ray_init() and shared copy-on-write
+ *	by forked worker processes.  Packets are passed in shared memory
+ *	slots, so only the slot index travels over each worker's pipe.
+ *	Finished values go straight to donerays() without conversion.
+ */
+
+#include <signal.h>
+#include <sys/time.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <string.h>
+
+#include "ray.h"
+#include "ambient.h"
+#undef OCTREE				/* rholo variable, not octree type */
+#include "rholo.h"
+#include "random.h"
+#include "selcall.h"
+#include "rtprocess.h"
+
+#ifndef MAXPROC
+#define MAXPROC		64
+#endif
+#ifndef RCQLEN
+#define RCQLEN		64		/* packet slots per worker */
+#endif
+
+extern char	*shm_boundary;		/* boundary of shared memory */
+
+typedef struct {
+	int	nr;			/* number of rays in slot */
+	float	rod[6*RPACKSIZ];	/* ray origins and directions */
+	float	rvl[4*RPACKSIZ];	/* ray values and distances */
+} RAYSLOT;		/* a packet in shared memory */
+
+static struct {
+	int	pid;			/* worker process id */
+	int	fd_send, fd_recv;	/* slot index pipes */
+	int	npending;		/* slots in progress */
+} rcw[MAXPROC];			/* worker processes */
+
+static RAYSLOT	*rslot = NULL;		/* shared packet slots */
+static size_t	rslotsiz = 0;		/* size of shared memory */
+static PACKET	*rspack[MAXPROC*RCQLEN];	/* packet in each slot */
+
+static int	samplestep = 1;		/* sample index step */
+
+static void rc_child(int fd_in, int fd_out);
+static int rc_bestout(void);
+static void rc_queue(PACKET *p);
+static PACKET * rc_results(int pn, int *sl, int n, PACKET *pl);
+static PACKET * rc_get(int poll);
+
+
+int
+start_raycalc(void)			/* fork in-process ray workers */
+{
+	static int	optsdone = 0;
+	int	rval, i;
+
+	if (!optsdone) {			/* set rendering options */
+		for (i = 1; i < rtargc; i++) {
+			rval = getrenderopt(rtargc-i, rtargv+i);
+			if (rval < 0) {
+				sprintf(errmsg, "bad rendering option \"%s\"",
+						rtargv[i]);
+				error(USER, errmsg);
+			}
+			i += rval;
+		}
+		optsdone++;
+	}
+	ray_init(vval(OCTREE));			/* load scene (again) */
+	ambsync();
+	if (shm_boundary == NULL) {
+		preload_objs();			/* preload auxiliary data */
+		shm_boundary = (char *)malloc(16);
+		strcpy(shm_boundary, "SHM_BOUNDARY");
+	}
+	rslotsiz = sizeof(RAYSLOT)*RCQLEN*ncprocs;
+	rslot = (RAYSLOT *)mmap(NULL, rslotsiz, PROT_READ|PROT_WRITE,
+			MAP_ANON|MAP_SHARED, -1, 0);
+	if ((void *)rslot == MAP_FAILED)
+		error(SYSTEM, "cannot map shared packet slots");
+	memset((void *)rspack, 0, sizeof(rspack));
+	fflush(NULL);				/* clear pending output */
+	samplestep = ncprocs;
+	for (nprocs = 0; nprocs < ncprocs; nprocs++) {
+		int	p0[2], p1[2];
+		if (pipe(p0) < 0 || pipe(p1) < 0)
+			error(SYSTEM, "cannot create pipe");
+		if ((rcw[nprocs].pid = fork()) == 0) {
+			for (i = nprocs; i--; ) {	/* close others' */
+				close(rcw[i].fd_send);
+				close(rcw[i].fd_recv);
+			}
+			close(p0[0]); close(p1[1]);
+			rc_child(p1[0], p0[1]);		/* never returns */
+		}
+		if (rcw[nprocs].pid < 0)
+			error(SYSTEM, "cannot fork ray worker");
+		close(p1[0]); close(p0[1]);
+		if (rand_samp)			/* decorrelate random sequence */
+			srandom(random());
+		else
+			samplendx++;
+		rcw[nprocs].fd_send = p1[1];
+		rcw[nprocs].fd_recv = p0[0];
+		rcw[nprocs].npending = 0;
+	}
+	return(nprocs*RCQLEN);
+}
+
+
+static void
+rc_child(			/* trace packets in slots (never returns) */
+	int	fd_in,
+	int	fd_out
+)
+{
+	int	sl[RCQLEN];
+	RAY	myRay;
+	RAYSLOT	*sp;
+	float	*rod, *rvl;
+	int	n, i, j;
+
+	nprocs = -1;			/* flag worker process for quit() */
+	close(0);			/* don't share stdin */
+	while ((n = read(fd_in, (char *)sl, sizeof(sl))) > 0) {
+		if (n % sizeof(int) && (i = sizeof(int) - n%sizeof(int),
+				readbuf(fd_in, (char *)sl + n, i) != i))
+			break;
+		n = (n + sizeof(int)-1)/sizeof(int);
+		for (i = 0; i < n; i++) {
+			sp = rslot + sl[i];
+			rod = sp->rod; rvl = sp->rvl;
+			for (j = sp->nr; j--; rod += 6, rvl += 4) {
+				VCOPY(myRay.rorg, rod);
+				VCOPY(myRay.rdir, rod+3);
+				if (normalize(myRay.rdir) == 0.0) {
+					memset(rvl, 0, 4*sizeof(float));
+					continue;
+				}
+				myRay.rmax = 0.0;
+				rayorigin(&myRay, PRIMARY, NULL, NULL);
+				samplendx += samplestep;
+				rayvalue(&myRay);
+				rvl[0] = colval(myRay.rcol,RED);
+				rvl[1] = colval(myRay.rcol,GRN);
+				rvl[2] = colval(myRay.rcol,BLU);
+				rvl[3] = vbool(VDIST) ? myRay.rt : myRay.rot;
+			}
+			if (writebuf(fd_out, (char *)&sl[i], sizeof(int))
+					!= sizeof(int))
+				error(SYSTEM, "write error in ray worker");
+		}
+	}
+	if (n < 0)
+		error(SYSTEM, "read error in ray worker");
+	ambsync();
+	quit(0);			/* normal exit */
+}
+
+
+static int
+rc_bestout(void)		/* get best worker to process packet */
+{
+	int	cnt;
+	int	pn, i;
+
+	pn = 0;			/* find shortest queue */
+	for (i = 1; i < nprocs; i++)
+		if (rcw[i].npending < rcw[pn].npending)
+			pn = i;
+	if (rcw[pn].npending == RCQLEN)
+		return(-1);
+	cnt = 0;		/* break ties fairly */
+	for (i = pn; i < nprocs; i++)
+		if (rcw[i].npending == rcw[pn].npending)
+			cnt++;
+	if ((cnt = random() % cnt))
+		for (i = pn; i < nprocs; i++)
+			if (rcw[i].npending == rcw[pn].npending && !cnt--)
+				return(i);
+	return(pn);
+}
+
+
+static void
+rc_queue(			/* put packet in a slot for a worker */
+	PACKET	*p
+)
+{
+	int	pn, sn;
+
+	if ((pn = rc_bestout()) < 0)
+		error(INTERNAL, "ray worker queues are full!");
+	for (sn = pn*RCQLEN; rspack[sn] != NULL; sn++)
+		;
+	packrays(rslot[sn].rod, p);
+	rslot[sn].nr = p->nr;
+	p->next = NULL;
+	rspack[sn] = p;
+	if (writebuf(rcw[pn].fd_send, (char *)&sn, sizeof(int)) != sizeof(int))
+		error(SYSTEM, "write error in rc_queue");
+	rcw[pn].npending++;
+}
+
+
+static PACKET *
+rc_results(			/* finish returned slots, add to list */
+	int	pn,
+	int	*sl,
+	int	n,
+	PACKET	*pl
+)
+{
+	PACKET	*p;
+
+	while (n-- > 0) {
+		if ((*sl < pn*RCQLEN) | (*sl >= (pn+1)*RCQLEN))
+			error(INTERNAL, "slot range error in rc_results");
+		if ((p = rspack[*sl]) == NULL)
+			error(INTERNAL, "slot sync error in rc_results");
+		donerays(p, rslot[*sl].rvl);
+		rspack[*sl++] = NULL;
+		rcw[pn].npending--;
+		p->next = pl;
+		pl = p;
+	}
+	return(pl);
+}
+
+
+static PACKET *
+rc_get(				/* get packets back from workers */
+	int	poll
+)
+{
+	static struct timeval	tpoll;	/* zero timeval struct */
+	fd_set	readset, errset;
+	PACKET	*pldone = NULL;
+	int	sl[RCQLEN];
+	int	n, pn;
+					/* prepare select call */
+	FD_ZERO(&readset); FD_ZERO(&errset); n = 0;
+	for (pn = nprocs; pn--; ) {
+		if (rcw[pn].npending)
+			FD_SET(rcw[pn].fd_recv, &readset);
+		FD_SET(rcw[pn].fd_recv, &errset);
+		if (rcw[pn].fd_recv >= n)
+			n = rcw[pn].fd_recv + 1;
+	}
+	n = select(n, &readset, (fd_set *)NULL, &errset,
+			poll ? &tpoll : (struct timeval *)NULL);
+	if (n < 0) {
+		if (errno == EINTR)	/* interrupted select call */
+			return(NULL);
+		error(SYSTEM, "select call failure in rc_get");
+	}
+	if (n == 0)			/* is nothing ready? */
+		return(NULL);
+	for (pn = 0; pn < nprocs; pn++) {
+		if (!rcw[pn].npending ||
+				(!FD_ISSET(rcw[pn].fd_recv, &readset) &&
+				!FD_ISSET(rcw[pn].fd_recv, &errset)))
+			continue;
+		n = read(rcw[pn].fd_recv, (char *)sl,
+				sizeof(int)*rcw[pn].npending);
+		if (n < 0) {
+			if ((errno == EINTR) | (errno == EAGAIN))
+				continue;
+			error(SYSTEM, "read error in rc_get");
+		}
+		if (n == 0 || (n % sizeof(int) &&
+				readbuf(rcw[pn].fd_recv, (char *)sl + n,
+					sizeof(int) - n%sizeof(int)) <= 0))
+			error(USER, "ray worker process died");
+		pldone = rc_results(pn, sl, (n + sizeof(int)-1)/sizeof(int),
+					pldone);
+	}
+	return(pldone);
+}
+
+
+PACKET *
+do_raycalc(			/* queue a packet list, return finished */
+	PACKET	*pl
+)
+{
+	PACKET	*p;
+	int	nslots, i;
+
+	while (pl != NULL) {
+		p = pl; pl = p->next; p->next = NULL;
+		rc_queue(p);
+	}
+	nslots = 0;
+	for (i = nprocs; i--; )
+		nslots += RCQLEN - rcw[i].npending;
+	return(rc_get(nslots));
+}
+
+
+PACKET *
+flush_raycalc(void)			/* wait for all workers to finish */
+{
+	PACKET	*pldone = NULL;
+	int	sl[RCQLEN];
+	int	pn, n;
+
+	for (pn = 0; pn < nprocs; pn++) {
+		n = rcw[pn].npending;
+		if (readbuf(rcw[pn].fd_recv, (char *)sl, sizeof(int)*n)
+				== sizeof(int)*n) {
+			pldone = rc_results(pn, sl, n, pldone);
+			continue;
+		}
+		for (n = pn*RCQLEN; n < (pn+1)*RCQLEN; n++)
+			if (rspack[n] != NULL) {	/* lost packets */
+				rspack[n]->nr = 0;
+				rspack[n]->next = pldone;
+				pldone = rspack[n];
+				rspack[n] = NULL;
+			}
+		rcw[pn].npending = 0;
+	}
+	return(pldone);
+}
+
+
+int
+end_raycalc(void)			/* close ray workers */
+{
+	int	status = 0;
+	int	pn, rv;
+
+	for (pn = nprocs; pn--; )
+		close(rcw[pn].fd_send);
+	for (pn = 0; pn < nprocs; pn++) {
+		close(rcw[pn].fd_recv);
+		while (waitpid(rcw[pn].pid, &rv, 0) < 0)
+			if (errno != EINTR) {
+				rv = 0;		/* reaped elsewhere */
+				break;
+			}
+		if (rv && !status)
+			status = WIFEXITED(rv) ? WEXITSTATUS(rv) : -1;
+	}
+	nprocs = 0;
+	munmap((void *)rslot, rslotsiz);
+	rslot = NULL;
+	rslotsiz = 0;
+	return(status);
+}
@@ -139,11 +139,11 @@ rhinitcopy(	/* open files and copy header */
 	if (signal(SIGXFSZ, quit) == SIG_IGN) signal(SIGXFSZ, SIG_IGN);
 #endif
 					/* copy and verify header */
-	if (checkheader(infp, HOLOFMT, outfp) < 0 || getw(infp) != HOLOMAGIC)
+	if (checkheader(infp, HOLOFMT, outfp) < 0 || !hdmagicOK(getw(infp)))
 		error(USER, "input not in holodeck format");
 	fputformat(HOLOFMT, outfp);
 	fputc('\n', outfp);
-	putw(HOLOMAGIC, outfp);
+	putw(HOLOMAGIC0, outfp);	/* beams are copied uncoded */
 					/* get descriptors and free stdio */
 	if ((hfd[0] = dup(fileno(infp))) < 0 ||
 			(hfd[1] = dup(fileno(outfp))) < 0)
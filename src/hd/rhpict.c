@@ -294,7 +294,7 @@ initialize(void)			/* initialize holodeck and buffers */
 					/* check header format */
 	checkheader(fp, HOLOFMT, NULL);
 					/* check magic number */
-	if (getw(fp) != HOLOMAGIC) {
+	if (!hdmagicOK(getw(fp))) {
 		sprintf(errmsg, "bad magic number in holodeck file \"%s\"",
 				hdkfile);
 		error(USER, errmsg);
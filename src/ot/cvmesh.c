@@ -33,6 +33,17 @@ typedef struct {
 
 #define	 OMARGIN	(10*FTINY)	/* margin around global cube */
 
+#define	 BVBINS		16		/* split candidates per axis */
+
+/* Triangle being placed in BVH */
+struct BVTri {
+	OBJECT		ti;		/* mesh triangle ID */
+	uint32		lo[3], hi[3];	/* bounds in cube coordinates */
+};
+
+static struct BVTri	*bvtl;		/* triangles in leaf order */
+static int		bvnalloc;	/* BVH nodes allocated */
+
 MESH	*ourmesh = NULL;		/* our global mesh data structure */
 
 FVECT	meshbounds[2];			/* mesh bounding box */
@@ -40,6 +51,8 @@ FVECT	meshbounds[2];			/* mesh bounding box */
 static void add2bounds(FVECT vp, RREAL vc[2]);
 static OBJECT cvmeshtri(OBJECT obj);
 static OCTREE cvmeshoct(OCTREE ot);
+static int bvsplit(struct BVTri *tp, int n);
+static int bvnode(struct BVTri *tp, int n, uint32 lo[3], uint32 hi[3]);
 
 
 
@@ -156,10 +169,10 @@ cvtri(
 		fop->omod = mo;
 		fop->otype = OBJ_FACE;
 		sprintf(buf, "t%ld", (long)fobj);
-		fop->oname = savqstr(buf);
+		fop->oname = obsavstr(fobj, buf);
 		fop->oargs.nfargs = 9;
-		fop->oargs.farg = (RREAL *)malloc(9*sizeof(RREAL));
-		if (fop->oargs.farg == NULL)
+		fop->oargs.farg = (RREAL *)oballoc(fobj, 9*sizeof(RREAL));
+		if ((fop->oname == NULL) | (fop->oargs.farg == NULL))
 			goto nomem;
 	} else {		/* else reuse failed one */
 		fop = objptr(fobj);
@@ -325,3 +338,248 @@ cvmesh(void)			/* convert mesh and octree leaf nodes */
 
 	return(ourmesh);
 }
+
+
+static void
+bvbounds(			/* get bounds of triangle run */
+	uint32	lo[3],
+	uint32	hi[3],
+	struct BVTri	*tp,
+	int	n
+)
+{
+	int	i;
+
+	lo[0] = lo[1] = lo[2] = 0xffffffff;
+	hi[0] = hi[1] = hi[2] = 0;
+	for ( ; n-- > 0; tp++)
+		for (i = 0; i < 3; i++) {
+			if (tp->lo[i] < lo[i]) lo[i] = tp->lo[i];
+			if (tp->hi[i] > hi[i]) hi[i] = tp->hi[i];
+		}
+}
+
+
+static double
+bvarea(				/* half surface area of box */
+	double	lo[3],
+	double	hi[3]
+)
+{
+	double	d0 = hi[0]-lo[0], d1 = hi[1]-lo[1], d2 = hi[2]-lo[2];
+
+	return(d0*d1 + d1*d2 + d2*d0);
+}
+
+
+static int
+bvsplit(			/* split triangle run, return left count */
+	struct BVTri	*tp,
+	int	n
+)
+{
+	int	bcnt[BVBINS];
+	double	blo[BVBINS][3], bhi[BVBINS][3];
+	double	rarea[BVBINS];
+	double	llo[3], lhi[3];
+	double	cmin[3], cmax[3], scale, c, cost;
+	double	bestcost = 0;
+	int	bestax = -1, bestb = 0;
+	int	ax, b, i, j, nl;
+	struct BVTri	t;
+					/* centroid extent */
+	cmin[0] = cmin[1] = cmin[2] = FHUGE;
+	cmax[0] = cmax[1] = cmax[2] = -FHUGE;
+	for (j = n; j--; )
+		for (i = 0; i < 3; i++) {
+			c = (double)tp[j].lo[i] + tp[j].hi[i];
+			if (c < cmin[i]) cmin[i] = c;
+			if (c > cmax[i]) cmax[i] = c;
+		}
+	for (ax = 0; ax < 3; ax++) {	/* bin centroids on each axis */
+		if (cmax[ax] <= cmin[ax])
+			continue;
+		scale = BVBINS*(1.-1e-9)/(cmax[ax] - cmin[ax]);
+		for (b = BVBINS; b--; ) {
+			bcnt[b] = 0;
+			blo[b][0] = blo[b][1] = blo[b][2] = FHUGE;
+			bhi[b][0] = bhi[b][1] = bhi[b][2] = -FHUGE;
+		}
+		for (j = n; j--; ) {
+			b = ((double)tp[j].lo[ax] + tp[j].hi[ax] - cmin[ax])*scale;
+			bcnt[b]++;
+			for (i = 0; i < 3; i++) {
+				if (tp[j].lo[i] < blo[b][i]) blo[b][i] = tp[j].lo[i];
+				if (tp[j].hi[i]+1. > bhi[b][i]) bhi[b][i] = tp[j].hi[i]+1.;
+			}
+		}
+		llo[0] = llo[1] = llo[2] = FHUGE;
+		lhi[0] = lhi[1] = lhi[2] = -FHUGE;
+		for (b = BVBINS; --b > 0; ) {	/* sweep from right */
+			for (i = 0; i < 3; i++) {
+				if (blo[b][i] < llo[i]) llo[i] = blo[b][i];
+				if (bhi[b][i] > lhi[i]) lhi[i] = bhi[b][i];
+			}
+			rarea[b] = bvarea(llo, lhi);
+		}
+		llo[0] = llo[1] = llo[2] = FHUGE;
+		lhi[0] = lhi[1] = lhi[2] = -FHUGE;
+		nl = 0;
+		for (b = 0; b < BVBINS-1; b++) {	/* sweep from left */
+			for (i = 0; i < 3; i++) {
+				if (blo[b][i] < llo[i]) llo[i] = blo[b][i];
+				if (bhi[b][i] > lhi[i]) lhi[i] = bhi[b][i];
+			}
+			nl += bcnt[b];
+			if (!nl || nl == n)
+				continue;
+			cost = nl*bvarea(llo, lhi) + (n-nl)*rarea[b+1];
+			if ((bestax < 0) | (cost < bestcost)) {
+				bestcost = cost;
+				bestax = ax;
+				bestb = b;
+			}
+		}
+	}
+	if (bestax < 0)			/* all centroids coincide */
+		return(n/2);
+					/* partition about best plane */
+	scale = BVBINS*(1.-1e-9)/(cmax[bestax] - cmin[bestax]);
+	i = 0; j = n;
+	while (i < j) {
+		b = ((double)tp[i].lo[bestax] + tp[i].hi[bestax] -
+				cmin[bestax])*scale;
+		if (b <= bestb) {
+			i++;
+			continue;
+		}
+		t = tp[i]; tp[i] = tp[--j]; tp[j] = t;
+	}
+	return(i);
+}
+
+
+static int
+bvnode(				/* build BVH node over run, return index */
+	struct BVTri	*tp,
+	int	n,
+	uint32	lo[3],
+	uint32	hi[3]
+)
+{
+	int	gstart[MBVHWIDTH], gcnt[MBVHWIDTH];
+	uint32	clo[MBVHWIDTH][3], chi[MBVHWIDTH][3];
+	MBVHNODE	*np;
+	double	ext, d;
+	int	ni, ng, g, i, j, nl;
+					/* allocate node */
+	if ((ni = ourmesh->nbvh++) >= bvnalloc) {
+		bvnalloc += bvnalloc/2 + 64;
+		ourmesh->bvh = (MBVHNODE *)realloc((void *)ourmesh->bvh,
+					bvnalloc*sizeof(MBVHNODE));
+		if (ourmesh->bvh == NULL)
+			error(SYSTEM, "out of memory in bvnode");
+	}
+	ng = 0;				/* divide run into groups */
+	if (n > 0) {
+		gstart[0] = 0; gcnt[0] = n;
+		ng = 1;
+	}
+	while (ng < MBVHWIDTH) {	/* split largest until full */
+		for (g = -1, i = ng; i--; )
+			if (gcnt[i] > MBVHLEAF && (g < 0 || gcnt[i] > gcnt[g]))
+				g = i;
+		if (g < 0)
+			break;
+		nl = bvsplit(tp + gstart[g], gcnt[g]);
+		gstart[ng] = gstart[g] + nl;
+		gcnt[ng++] = gcnt[g] - nl;
+		gcnt[g] = nl;
+	}
+	for (g = 0; g < ng; g++)	/* make children */
+		if (gcnt[g] <= MBVHLEAF) {
+			bvbounds(clo[g], chi[g], tp+gstart[g], gcnt[g]);
+			ourmesh->bvh[ni].kid[g] = tp + gstart[g] - bvtl;
+			ourmesh->bvh[ni].ntri[g] = gcnt[g];
+		} else {
+			i = bvnode(tp+gstart[g], gcnt[g], clo[g], chi[g]);
+			ourmesh->bvh[ni].kid[g] = i;
+			ourmesh->bvh[ni].ntri[g] = 0;
+		}
+	np = &ourmesh->bvh[ni];		/* quantize child bounds */
+	np->nkids = ng;
+	for (i = 0; i < 3; i++) {
+		lo[i] = 0xffffffff; hi[i] = 0;
+		for (g = ng; g--; ) {
+			if (clo[g][i] < lo[i]) lo[i] = clo[g][i];
+			if (chi[g][i] > hi[i]) hi[i] = chi[g][i];
+		}
+		if (!ng)
+			lo[i] = hi[i] = 0;
+		np->org[i] = lo[i];
+		ext = (double)hi[i] + 1. - lo[i];
+		for (j = 0; ldexp(ext, -j) > 255.; j++)
+			;
+		np->qsh[i] = j;
+		d = ldexp(1., -j);
+		for (g = ng; g--; ) {
+			np->qlo[g][i] = floor((clo[g][i] - (double)lo[i])*d);
+			np->qhi[g][i] = ceil((chi[g][i] + 1. - lo[i])*d);
+		}
+	}
+	return(ni);
+}
+
+
+void
+cvmeshbvh(void)			/* build compressed BVH for our mesh */
+{
+	OBJECT		ti;
+	OBJECT		mo;
+	int32		tvid[3];
+	uint32		*xyz;
+	uint32		lo[3], hi[3];
+	int		n, i, j;
+
+	if (ourmesh == NULL || !(ourmesh->ldflags & IO_SCENE))
+		return;
+	n = 0;				/* count triangles */
+	for (ti = OVOID; nextmeshtri(&ti, ourmesh); )
+		n++;
+	bvtl = (struct BVTri *)malloc((n+1)*sizeof(struct BVTri));
+	if (bvtl == NULL)
+		error(SYSTEM, "out of memory in cvmeshbvh");
+	n = 0;				/* get triangle bounds */
+	for (ti = OVOID; nextmeshtri(&ti, ourmesh); n++) {
+		if (!getmeshtrivid(tvid, &mo, ourmesh, ti))
+			error(INTERNAL, "missing triangle vertices in cvmeshbvh");
+		bvtl[n].ti = ti;
+		for (j = 0; j < 3; j++) {
+			xyz = ourmesh->patch[tvid[j]>>8].xyz[tvid[j]&0xff];
+			for (i = 0; i < 3; i++) {
+				if (!j || xyz[i] < bvtl[n].lo[i])
+					bvtl[n].lo[i] = xyz[i];
+				if (!j || xyz[i] > bvtl[n].hi[i])
+					bvtl[n].hi[i] = xyz[i];
+			}
+		}
+	}
+	if (ourmesh->bvh != NULL)
+		free((void *)ourmesh->bvh);
+	ourmesh->bvh = NULL;
+	ourmesh->nbvh = bvnalloc = 0;
+	bvnode(bvtl, n, lo, hi);	/* build tree from root */
+	ourmesh->bvh = (MBVHNODE *)realloc((void *)ourmesh->bvh,
+				ourmesh->nbvh*sizeof(MBVHNODE));
+					/* record leaf order */
+	if (ourmesh->bvtri != NULL)
+		free((void *)ourmesh->bvtri);
+	ourmesh->bvtri = (OBJECT *)malloc((n+1)*sizeof(OBJECT));
+	if ((ourmesh->bvh == NULL) | (ourmesh->bvtri == NULL))
+		error(SYSTEM, "out of memory in cvmeshbvh");
+	for (i = 0; i < n; i++)
+		ourmesh->bvtri[i] = bvtl[i].ti;
+	ourmesh->nbvtri = n;
+	free((void *)bvtl);
+	bvtl = NULL;
+}
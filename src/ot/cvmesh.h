@@ -26,8 +26,9 @@ extern int	cvtri(OBJECT mo, FVECT vp1, FVECT vp2, FVECT vp3,
 			RREAL vc1[2], RREAL vc2[2], RREAL vc3[2]);
 extern void	cvmeshbounds(void);
 extern MESH	*cvmesh(void);
+extern void	cvmeshbvh(void);
 					/* defined in wfconv.c */
-void		wfreadobj(char *objfn);
+void		wfreadobj(char *objfn, int nproc);
 
 
 #ifdef __cplusplus
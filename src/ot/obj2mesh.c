@@ -27,6 +27,10 @@ int  objlim = 9;			/* # of objects before split */
 
 int  resolu = 16384;			/* octree resolution limit */
 
+int  dobvh = 0;				/* add compressed BVH? */
+
+int  nproc = 1;				/* parsing processes */
+
 double	mincusize;			/* minimum cube size from resolu */
 
 static void addface(CUBE  *cu, OBJECT	obj);
@@ -73,6 +77,14 @@ main(		/* compile a .OBJ file into a mesh */
 			while (*pns++)
 				;
 			break;
+		case 'p':				/* parsing processes */
+			if (i >= argc-1)
+				error(USER, "missing argument for -p");
+			nproc = atoi(argv[++i]);
+			break;
+		case 'b':				/* add BVH */
+			dobvh = 1;
+			break;
 		case 'w':				/* supress warnings */
 			nowarn = 1;
 			break;
@@ -94,9 +106,9 @@ main(		/* compile a .OBJ file into a mesh */
 		readobj(matinp[j]);
 					/* read .OBJ file into triangles */
 	if (i == argc)
-		wfreadobj(NULL);
+		wfreadobj(NULL, nproc);
 	else
-		wfreadobj(argv[i]);
+		wfreadobj(argv[i], nproc);
 	
 	cvmeshbounds();			/* set octree boundaries */
 
@@ -106,6 +118,8 @@ main(		/* compile a .OBJ file into a mesh */
 	SET_FILE_BINARY(stdout);
 	newheader("RADIANCE", stdout);	/* new binary file header */
 	printargs(i<argc ? i+1 : argc, argv, stdout);
+	if (dobvh)
+		fprintf(stdout, "%s%d\n", MBVHSTR, MBVHWIDTH);
 	fputformat(MESHFMT, stdout);
 	fputc('\n', stdout);
 
@@ -123,10 +137,15 @@ main(		/* compile a .OBJ file into a mesh */
 	
 	cvmesh();			/* convert mesh and leaf nodes */
 
+	if (dobvh)			/* build BVH for rendering */
+		cvmeshbvh();
+
 	writemesh(ourmesh, stdout);	/* write mesh to output */
 	
-	if (verbose)
+	if (verbose) {
 		printmeshstats(ourmesh, stderr);
+		printobjstats(stderr);
+	}
 
 	quit(0);
 	return 0; /* pro forma return */
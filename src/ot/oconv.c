@@ -28,6 +28,8 @@ int  objlim = 6;			/* # of objects before split */
 
 int  resolu = 16384;			/* octree resolution limit */
 
+int  compiled = 0;			/* add compiled scene? */
+
 CUBE  thescene = {{0.0, 0.0, 0.0}, 0.0, EMPTY};		/* our scene */
 
 char  *ofname[MAXOBJFIL+1];		/* object file names */
@@ -80,6 +82,10 @@ main(		/* convert object files to an octree */
 		case 'f':				/* freeze octree */
 			outflags &= ~IO_FILES;
 			break;
+		case 'c':				/* compiled scene */
+			outflags &= ~IO_FILES;
+			compiled = 1;
+			break;
 		case 'w':				/* supress warnings */
 			nowarn = 1;
 			break;
@@ -16,6 +16,9 @@ extern "C" {
 	/* defined in initotypes.c */
 void ot_initotypes(void);
 
+	/* defined in oconv.c */
+extern int  compiled;			/* add compiled scene? */
+
 	/* defined in writeoct.c */
 extern void writeoct(int  store, CUBE  *scene, char  *ofn[]);
 
@@ -10,14 +10,12 @@ static const char RCSid[] = "$Id: wfconv.c,v 2.14 2014/06/11 00:08:30 greg Exp $
 #include "standard.h"
 #include "cvmesh.h"
 #include "triangulate.h"
-#include <ctype.h>
+#include "wfstmt.h"
 
 typedef int	VNDX[3];	/* vertex index (point,map,normal) */
 
 #define CHUNKSIZ	1024	/* vertex allocation chunk size */
 
-#define MAXARG		512	/* maximum # arguments in a statement */
-
 static FVECT	*vlist;		/* our vertex list */
 static int	nvs;		/* number of vertices in our list */
 static FVECT	*vnlist;	/* vertex normal list */
@@ -32,7 +30,6 @@ static char	group[256];	/* current group name */
 static int	lineno;		/* current line number */
 static int	faceno;		/* current face number */
 
-static int getstmt(char	*av[MAXARG], FILE *fp);
 static int cvtndx(VNDX vi, char *vs);
 static int putface(int ac, char **av);
 static OBJECT getmod(void);
@@ -46,18 +43,17 @@ static void syntax(char	*er);
 
 void
 wfreadobj(		/* read in .OBJ file and convert */
-	char	*objfn
+	char	*objfn,
+	int	nproc
 )
 {
-	FILE	*fp;
-	char	*argv[MAXARG];
+	WFSTMT	st;
+	char	**argv = st.av;
 	int	argc;
 	int	nstats, nunknown;
 
-	if (objfn == NULL) {
-		inpfile = "<stdin>";
-		fp = stdin;
-	} else if ((fp = fopen(inpfile=objfn, "r")) == NULL) {
+	inpfile = objfn==NULL ? "<stdin>" : objfn;
+	if (wf_open(objfn, nproc) < 0) {
 		sprintf(errmsg, "cannot open \"%s\"", inpfile);
 		error(USER, errmsg);
 	}
@@ -67,31 +63,30 @@ wfreadobj(		/* read in .OBJ file and convert */
 	group[0] = '\0';
 	lineno = 0; faceno = 0;
 					/* scan until EOF */
-	while ( (argc = getstmt(argv, fp)) ) {
+	while ( (argc = wf_getstmt(&st)) ) {
+		lineno = st.lineno;
 		switch (argv[0][0]) {
 		case 'v':		/* vertex */
 			switch (argv[0][1]) {
 			case '\0':			/* point */
-				if (badarg(argc-1,argv+1,"fff"))
+				if (st.nfv != 3)
 					syntax("bad vertex");
-				newv(atof(argv[1]), atof(argv[2]),
-						atof(argv[3]));
+				newv(st.fv[0], st.fv[1], st.fv[2]);
 				break;
 			case 'n':			/* normal */
 				if (argv[0][2])
 					goto unknown;
-				if (badarg(argc-1,argv+1,"fff"))
+				if (st.nfv != 3)
 					syntax("bad normal");
-				if (!newvn(atof(argv[1]), atof(argv[2]),
-						atof(argv[3])))
+				if (!newvn(st.fv[0], st.fv[1], st.fv[2]))
 					syntax("zero normal");
 				break;
 			case 't':			/* coordinate */
 				if (argv[0][2])
 					goto unknown;
-				if (badarg(argc-1,argv+1,"ff"))
+				if (st.nfv != 2)
 					goto unknown;
-				newvt(atof(argv[1]), atof(argv[2]));
+				newvt(st.fv[0], st.fv[1]);
 				break;
 			default:
 				goto unknown;
@@ -148,7 +143,7 @@ wfreadobj(		/* read in .OBJ file and convert */
 	}
 				/* clean up */
 	freeverts();
-	fclose(fp);
+	wf_close();
 	if (nunknown > 0) {
 		sprintf(errmsg, "%d of %d statements unrecognized",
 				nunknown, nstats);
@@ -157,46 +152,6 @@ wfreadobj(		/* read in .OBJ file and convert */
 }
 
 
-static int
-getstmt(				/* read the next statement from fp */
-	char	*av[MAXARG],
-	FILE	*fp
-)
-{
-	static char	sbuf[MAXARG*16];
-	char	*cp;
-	int	i;
-
-	do {
-		if (fgetline(cp=sbuf, sizeof(sbuf), fp) == NULL)
-			return(0);
-		i = 0;
-		for ( ; ; ) {
-			while (isspace(*cp) || *cp == '\\') {
-				if (*cp == '\n')
-					lineno++;
-				*cp++ = '\0';
-			}
-			if (!*cp)
-				break;
-			if (i >= MAXARG-1) {
-				sprintf(errmsg,
-			"%s: too many arguments near line %d (limit %d)\n",
-					inpfile, lineno+1, MAXARG-1);
-				break;
-			}
-			av[i++] = cp;
-			while (*++cp && !isspace(*cp))
-				;
-		}
-		av[i] = NULL;
-		lineno++;
-	} while (!i);
-
-	return(i);
-}
-
-
 static int
 cvtndx(				/* convert vertex string to index */
 	VNDX	vi,
@@ -17,6 +17,7 @@ static const char RCSid[] = "$Id: writemesh.c,v 2.6 2004/04/29 14:36:49 greg Exp
 static void putfullnode(OCTREE fn, FILE *fp);
 static void puttree(OCTREE ot, FILE *fp);
 static void putpatch(MESHPATCH *pp, FILE *fp);
+static void putbvh(MESH *mp, FILE *fp);
 
 
 static void
@@ -121,6 +122,37 @@ putpatch(			/* write out a mesh patch */
 }
 
 
+static void
+putbvh(				/* write out compressed BVH */
+	MESH	*mp,
+	FILE	*fp
+)
+{
+	MBVHNODE	*np;
+	int		i, j;
+
+	putint((long)mp->nbvh, 4, fp);
+	for (np = mp->bvh; np < mp->bvh + mp->nbvh; np++) {
+		for (j = 0; j < 3; j++)
+			putint((long)np->org[j], 4, fp);
+		for (j = 0; j < 3; j++)
+			putint((long)np->qsh[j], 1, fp);
+		putint((long)np->nkids, 1, fp);
+		for (i = 0; i < np->nkids; i++) {
+			for (j = 0; j < 3; j++)
+				putint((long)np->qlo[i][j], 1, fp);
+			for (j = 0; j < 3; j++)
+				putint((long)np->qhi[i][j], 1, fp);
+			putint((long)np->kid[i], 4, fp);
+			putint((long)np->ntri[i], 1, fp);
+		}
+	}
+	putint((long)mp->nbvtri, 4, fp);
+	for (i = 0; i < mp->nbvtri; i++)
+		putint((long)mp->bvtri[i], sizeof(OBJECT), fp);
+}
+
+
 void
 writemesh(mp, fp)			/* write mesh structures to fp */
 MESH	*mp;
@@ -157,6 +189,9 @@ FILE	*fp;
 	putint((long)mp->npatches, 4, fp);
 	for (i = 0; i < mp->npatches; i++)
 		putpatch(&mp->patch[i], fp);
+					/* write the BVH (header says so) */
+	if (mp->bvh != NULL)
+		putbvh(mp, fp);
 	if (ferror(fp))
 		error(SYSTEM, "write error in writemesh");
 }
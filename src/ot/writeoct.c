@@ -63,6 +63,9 @@ writeoct(		/* write octree structures to stdout */
 		return;
 					/* write the scene */
 	writescene(0, nobjects, stdout);
+					/* and a copy ready to map */
+	if (compiled)
+		writecscene(nobjects, stdout);
 }
 
 
@@ -100,6 +100,10 @@ main(
 		case 'z':			/* LZW compression */
 			comp = COMPRESSION_LZW;
 			break;
+		case 'n':			/* number of processes */
+			if (argc-i < 2) goto userr;
+			tmNumProcs = atoi(argv[++i]);
+			break;
 		case 'p':			/* set display primaries */
 			if (argc-i < 9) goto userr;
 			myprims[RED][CIEX] = atof(argv[++i]);
@@ -138,7 +142,7 @@ main(
 	exit(rval==0 ? 0 : 1);
 userr:
 	fprintf(stderr,
-"Usage: %s [-h][-s][-c][-l][-b][-g gv][-d ld][-u lm][-z][-p xr yr xg yg xb yb xw yw] input.{tif|hdr} output.tif\n",
+"Usage: %s [-h][-s][-c][-l][-b][-g gv][-d ld][-u lm][-z][-n nproc][-p xr yr xg yg xb yb xw yw] input.{tif|hdr} output.tif\n",
 			argv[0]);
 	exit(1);
 }
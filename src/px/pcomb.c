@@ -13,10 +13,16 @@ static const char	RCSid[] = "$Id: pcomb.c,v 2.51 2018/08/02 18:33:43 greg Exp $"
 #include "color.h"
 #include "calcomp.h"
 #include "view.h"
+#include "rtprocess.h"
+#include "picmap.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/wait.h>
+#endif
 
 #define MAXINP		1024		/* maximum number of input files */
 #define WINSIZ		127		/* scanline window size */
 #define MIDSCN		((WINSIZ-1)/2+1)
+#define MAXBROWS	64		/* maximum rows per parallel band */
 
 struct {
 	char	*name;		/* file or command name */
@@ -27,6 +33,7 @@ struct {
 	COLOR	*scan[WINSIZ];	/* input scanline window */
 	COLOR	coef;		/* coefficient */
 	COLOR	expos;		/* recorded exposure */
+	PICMAP	*pm;		/* mapped picture (parallel only) */
 }	input[MAXINP];			/* input pictures */
 
 int	nfiles;				/* number of input files */
@@ -68,6 +75,8 @@ int	xres, yres;			/* output resolution */
 
 int	xpos, ypos;			/* output position */
 
+int	nproc = 1;			/* number of combining processes */
+
 char	*progname;			/* global argv[0] */
 
 int	echoheader = 1;
@@ -81,6 +90,8 @@ static double rgb_bright(COLOR  clr);
 static double xyz_bright(COLOR  clr);
 static void init(void);
 static void combine(void);
+static void combrow(COLOR *scanout);
+static int pcombine(void);
 static void advance(void);
 static double l_expos(char	*nam);
 static double l_pixaspect(char *nm);
@@ -119,6 +130,9 @@ main(
 			case 'h':
 				echoheader = !echoheader;
 				continue;
+			case 'n':
+				nproc = atoi(argv[++a]);
+				continue;
 			case 'f':
 			case 'e':
 				a++;
@@ -206,6 +220,9 @@ main(
 				continue;
 			case 'h':
 				continue;
+			case 'n':
+				a++;
+				continue;
 			case 'f':
 				fpath = getpath(argv[++a], getrlibpath(), 0);
 				if (fpath == NULL) {
@@ -249,7 +266,7 @@ usage:
 	eputs("Usage: ");
 	eputs(argv[0]);
 	eputs(
-" [-w][-h][-x xr][-y yr][-e expr][-f file] [ [-o][-s f][-c r g b] hdr ..]\n");
+" [-w][-h][-n nproc][-x xr][-y yr][-e expr][-f file] [ [-o][-s f][-c r g b] hdr ..]\n");
 	quit(1);
 	return 1; /* pro forma return */
 }
@@ -391,13 +408,14 @@ init(void)					/* perform final setup */
 }
 
 
+static EPNODE	*coldef[3], *brtdef;	/* output expressions */
+
+
 static void
 combine(void)			/* combine pictures */
 {
-	EPNODE	*coldef[3], *brtdef;
 	COLOR	*scanout;
-	double	d;
-	int	i, j;
+	int	j;
 						/* check defined variables */
 	for (j = 0; j < 3; j++) {
 		if (vardefined(vcolout[j]))
@@ -409,6 +427,8 @@ combine(void)			/* combine pictures */
 		brtdef = eparse(vbrtout);
 	else
 		brtdef = NULL;
+	if (nproc > 1 && pcombine())
+		return;
 						/* allocate scanline */
 	scanout = (COLOR *)emalloc(xres*sizeof(COLOR));
 						/* set input position */
@@ -416,31 +436,7 @@ combine(void)			/* combine pictures */
 						/* combine files */
 	for (ypos = yres-1; ypos >= 0; ypos--) {
 	    advance();
-	    varset(vypos, '=', (double)ypos);
-	    for (xpos = 0; xpos < xres; xpos++) {
-		xscan = (xpos+.5)*xmax/xres;
-		varset(vxpos, '=', (double)xpos);
-		eclock++;
-		if (brtdef != NULL) {
-		    d = evalue(brtdef);
-		    if (d < 0.0)
-			d = 0.0;
-		    setcolor(scanout[xpos], d, d, d);
-		} else {
-		    for (j = 0; j < 3; j++) {
-			if (coldef[j] != NULL) {
-				d = evalue(coldef[j]);
-			} else {
-			    d = 0.0;
-			    for (i = 0; i < nfiles; i++)
-				d += colval(input[i].scan[MIDSCN][xscan],j);
-			}
-			if (d < 0.0)
-			    d = 0.0;
-			colval(scanout[xpos],j) = d;
-		    }
-		}
-	    }
+	    combrow(scanout);
 	    if (fwritescan(scanout, xres, stdout) < 0) {
 		    perror("write error");
 		    quit(1);
@@ -450,12 +446,157 @@ combine(void)			/* combine pictures */
 }
 
 
+static void
+combrow(			/* compute output scanline at ypos */
+	COLOR	*scanout
+)
+{
+	double	d;
+	int	i, j;
+
+	varset(vypos, '=', (double)ypos);
+	for (xpos = 0; xpos < xres; xpos++) {
+	    xscan = (xpos+.5)*xmax/xres;
+	    varset(vxpos, '=', (double)xpos);
+	    eclock++;
+	    if (brtdef != NULL) {
+		d = evalue(brtdef);
+		if (d < 0.0)
+		    d = 0.0;
+		setcolor(scanout[xpos], d, d, d);
+	    } else {
+		for (j = 0; j < 3; j++) {
+		    if (coldef[j] != NULL) {
+			    d = evalue(coldef[j]);
+		    } else {
+			d = 0.0;
+			for (i = 0; i < nfiles; i++)
+			    d += colval(input[i].scan[MIDSCN][xscan],j);
+		    }
+		    if (d < 0.0)
+			d = 0.0;
+		    colval(scanout[xpos],j) = d;
+		}
+	    }
+	}
+}
+
+
+#if !defined(_WIN32) && !defined(_WIN64)
+static int
+pcombine(void)			/* combine bands in parallel, or return 0 */
+{
+	COLOR	*scanout;
+	COLR	*cbuf;
+	uby8	*obuf;
+	long	olen;
+	int	*pfd;
+	int	nbands, brows;
+	int	b, i, n;
+	int	cfd[2];
+					/* need random access to inputs */
+	for (i = 0; i < nfiles; i++)
+		if ((input[i].name == Command) | (input[i].name == StandardInput)
+				|| ftell(input[i].fp) < 0)
+			return(0);
+	for (i = 0; i < nfiles; i++)	/* map input pictures */
+		if (fseek(input[i].fp, 0L, SEEK_SET) < 0 ||
+				(input[i].pm = pm_load(input[i].fp,
+						NULL, NULL)) == NULL ||
+				input[i].pm->nvalid < ymax) {
+			eputs(input[i].name);
+			eputs(": read error\n");
+			quit(1);
+		}
+	brows = yres/(4*nproc) + 1;
+	if (brows > MAXBROWS) brows = MAXBROWS;
+	nbands = (yres + brows-1)/brows;
+	if (nproc > nbands)
+		nproc = nbands;
+	pfd = (int *)emalloc(nproc*sizeof(int));
+	obuf = (uby8 *)emalloc(COLRBUFSIZ(xres)*brows);
+	cbuf = (COLR *)emalloc(xres*sizeof(COLR));
+	scanout = (COLOR *)emalloc(xres*sizeof(COLOR));
+	fflush(stdout);
+	for (i = 0; i < nproc; i++) {	/* start combining processes */
+		if (pipe(cfd) < 0) {
+			perror("pipe");
+			quit(1);
+		}
+		if ((n = fork()) == 0) {	/* child does every nproc band */
+			close(cfd[0]);
+			for (b = 0; b < i; b++)
+				close(pfd[b]);
+			for (b = i; b < nbands; b += nproc) {
+				ypos = yres-1 - b*brows;
+					/* refill window as of band start */
+				yscan = (ypos+.5)*ymax/yres + WINSIZ;
+				if (yscan > ymax+MIDSCN)
+					yscan = ymax+MIDSCN;
+				for (olen = 0; (ypos > yres-1 - (b+1)*brows) &
+						(ypos >= 0); ypos--) {
+					advance();
+					combrow(scanout);
+					setcolrs(cbuf, scanout, xres);
+					olen += encodecolrs(obuf+olen, cbuf, xres);
+				}
+				if (writebuf(cfd[1], (char *)&olen,
+						sizeof(olen)) != sizeof(olen) ||
+						writebuf(cfd[1], (char *)obuf,
+							olen) != olen)
+					_exit(1);
+			}
+			_exit(0);
+		}
+		if (n < 0) {
+			perror("fork");
+			quit(1);
+		}
+		close(cfd[1]);
+		pfd[i] = cfd[0];
+	}
+	for (b = 0; b < nbands; b++) {	/* copy bands out in order */
+		i = b % nproc;
+		if (readbuf(pfd[i], (char *)&olen, sizeof(olen)) != sizeof(olen)
+				|| readbuf(pfd[i], (char *)obuf, olen) != olen) {
+			eputs(progname);
+			eputs(": combining process failed\n");
+			quit(1);
+		}
+		if (fwrite(obuf, 1, olen, stdout) != olen) {
+			perror("write error");
+			quit(1);
+		}
+	}
+	for (i = 0; i < nproc; i++)
+		close(pfd[i]);
+	while (wait(&n) >= 0)
+		if (n) {
+			eputs(progname);
+			eputs(": combining process error\n");
+			quit(1);
+		}
+	efree((char *)pfd);
+	efree((char *)obuf);
+	efree((char *)cbuf);
+	efree((char *)scanout);
+	return(1);
+}
+#else
+static int
+pcombine(void)
+{
+	return(0);
+}
+#endif
+
+
 static void
 advance(void)			/* read in data for next scanline */
 {
 	int	ytarget;
 	COLOR	*st;
-	int	i, j;
+	int	i, j, rv;
 
 	for (ytarget = (ypos+.5)*ymax/yres; yscan > ytarget; yscan--)
 		for (i = 0; i < nfiles; i++) {
@@ -465,7 +606,14 @@ advance(void)			/* read in data for next scanline */
 			input[i].scan[0] = st;
 			if (yscan <= MIDSCN)		/* hit bottom? */
 				continue;
-			if (freadscan(st, xmax, input[i].fp) < 0) {  /* read */
+			if (input[i].pm == NULL)	/* read */
+				rv = freadscan(st, xmax, input[i].fp);
+			else if (yscan > ymax+MIDSCN)	/* before top */
+				continue;
+			else				/* mapped */
+				rv = pm_readscan(input[i].pm, st,
+						ymax+MIDSCN-yscan);
+			if (rv < 0) {
 				eputs(input[i].name);
 				eputs(": read error\n");
 				quit(1);
@@ -8,13 +8,21 @@ static const char	RCSid[] = "$Id: pcond.c,v 3.29 2018/08/02 18:33:44 greg Exp $"
 
 #include "platform.h"
 #include "paths.h"
-#include "paths.h"
+#include "rtprocess.h"
 #include "pcond.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/wait.h>
+#endif
 
 
 #define	LDMAX		100		/* default max. display luminance */
 #define LDDYN		32		/* default dynamic range */
 
+#ifndef MAXPROC
+#define MAXPROC		64		/* maximum mapping processes */
+#endif
+#define MAPCHUNK	16		/* scanlines per process chunk */
+
 int	what2do = 0;			/* desired adjustments */
 
 double	ldmax = LDMAX;			/* maximum output luminance */
@@ -31,6 +39,9 @@ int	gotview = 0;			/* picture has view */
 double	pixaspect = 1.0;		/* pixel aspect ratio */
 double	fixfrac = 0.;			/* histogram share due to fixations */
 RESOLU	inpres;				/* input picture resolution */
+long	datapos;			/* file position of first scanline */
+long	*choff = NULL;			/* file position of each chunk */
+int	nprocs = 1;			/* number of mapping processes */
 
 COLOR	*fovimg;			/* foveal (1 degree) averaged image */
 int	fvxr, fvyr;			/* foveal image resolution */
@@ -48,6 +59,9 @@ static gethfunc headline;
 static void getahead(void);
 static void mapimage(void);
 static void getfovimg(void);
+static void scanpass(int dofov);
+static void mapchunks(void);
+static void mapworker(int wn, int fd);
 static void check2do(void);
 
 
@@ -139,6 +153,12 @@ main(
 			if (i+1 >= argc) goto userr;
 			lddyn = atof(argv[++i]);
 			break;
+		case 'n':
+			if (i+1 >= argc) goto userr;
+			nprocs = atoi(argv[++i]);
+			if (nprocs <= 0)
+				goto userr;
+			break;
 		case 'x':
 			if (i+1 >= argc) goto userr;
 			if ((mapfp = fopen(argv[++i], "w")) == NULL) {
@@ -164,6 +184,12 @@ main(
 	}
 	if ((outprims == stdprims) & (inprims != stdprims))
 		outprims = inprims;
+#if defined(_WIN32) || defined(_WIN64)
+	nprocs = 1;
+#else
+	if (nprocs > MAXPROC)
+		nprocs = MAXPROC;
+#endif
 	Bldmin = Bl(ldmax/lddyn);
 	Bldmax = Bl(ldmax);
 	if (i >= argc || i+2 < argc)
@@ -182,6 +208,8 @@ main(
 		fputprims(outprims, stdout);
 	if ((what2do & (DO_PREHIST|DO_VEIL|DO_ACUITY)) != DO_PREHIST)
 		getfovimg();		/* get foveal sample image? */
+	else if (nprocs > 1)
+		scanpass(0);		/* else just find chunks */
 	if (what2do&DO_PREHIST)		/* get histogram? */
 		gethisto(stdin);
 	else if (what2do&DO_FIXHIST)	/* get fixation history? */
@@ -191,7 +219,7 @@ main(
 		putmapping(mapfp);
 	exit(0);
 userr:
-	fprintf(stderr, "Usage: %s [-{h|a|v|s|c|l|w}[+-]][-I|-i ffrac][-e ev][-p xr yr xg yg xb yb xw yw|-f mbf.cal|-m rgb.cwp][-u Ldmax][-d Lddyn][-x mapfile] inpic [outpic]\n",
+	fprintf(stderr, "Usage: %s [-{h|a|v|s|c|l|w}[+-]][-I|-i ffrac][-e ev][-p xr yr xg yg xb yb xw yw|-f mbf.cal|-m rgb.cwp][-u Ldmax][-d Lddyn][-n nproc][-x mapfile] inpic [outpic]\n",
 			progname);
 	exit(1);
 	return 1; /* pro forma return */
@@ -253,6 +281,8 @@ getahead(void)			/* load picture header */
 			progname, infn);
 		exit(1);
 	}
+	if ((datapos = ftell(infp)) < 0)
+		syserror(infn);
 	if (lumf == rgblum)
 		comprgb2xyzWBmat(inrgb2xyz, inprims);
 	else if (mbcalfile != NULL) {
@@ -314,6 +344,12 @@ mapimage(void)				/* map picture and send to stdout */
 	putchar('\n');
 	fputsresolu(&inpres, stdout);	/* resolution doesn't change */
 					/* condition our image */
+	if (nprocs > 1) {
+		mapchunks();
+		return;
+	}
+	if (fseek(infp, datapos, SEEK_SET) < 0)
+		syserror(infn);
 	for (scan = firstscan(); scan != NULL; scan = nextscan())
 		if (fwritescan(scan, scanlen(&inpres), stdout) < 0) {
 			fprintf(stderr, "%s: scanline write error\n",
@@ -323,6 +359,104 @@ mapimage(void)				/* map picture and send to stdout */
 }
 
 
+static void
+mapworker(			/* map every nprocs'th chunk to fd */
+	int	wn,
+	int	fd
+)
+{
+	const int	sl = scanlen(&inpres);
+	const int	ns = numscans(&inpres);
+	COLOR	*scan;
+	COLR	*cscan;
+	uby8	*ebuf;
+	int	n, c, y;
+					/* don't share file position */
+	if ((infp = fopen(infn, "r")) == NULL)
+		syserror(infn);
+	SET_FILE_BINARY(infp);
+	if (fseek(infp, datapos, SEEK_SET) < 0)
+		syserror(infn);
+	cscan = (COLR *)malloc(sizeof(COLR)*sl);
+	ebuf = (uby8 *)malloc(COLRBUFSIZ(sl));
+	if ((cscan == NULL) | (ebuf == NULL))
+		syserror("malloc");
+	for (c = wn; (y = c*MAPCHUNK) < ns; c += nprocs)
+		for (scan = seekscan(y, choff[c]); ; scan = nextscan()) {
+			setcolrs(cscan, scan, sl);
+			n = encodecolrs(ebuf, cscan, sl);
+			if (writebuf(fd, (char *)&n, sizeof(int)) != sizeof(int) ||
+					writebuf(fd, (char *)ebuf, n) != n)
+				syserror("write");
+			if (++y >= ns || !(y % MAPCHUNK))
+				break;
+		}
+	close(fd);
+	_exit(0);
+}
+
+
+static void
+mapchunks(void)			/* map picture in parallel processes */
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	const int	sl = scanlen(&inpres);
+	const int	ns = numscans(&inpres);
+	int	pid[MAXPROC], fd[MAXPROC];
+	uby8	*ebuf;
+	int	n, i, y, st;
+
+	initscan();			/* everything shared before fork */
+	if ((ebuf = (uby8 *)malloc(COLRBUFSIZ(sl))) == NULL)
+		syserror("malloc");
+	fflush(NULL);
+	for (i = 0; i < nprocs; i++) {
+		int	p[2];
+		if (pipe(p) < 0)
+			syserror("pipe");
+		if ((pid[i] = fork()) == 0) {
+			close(p[0]);
+			for (n = i; n--; )
+				close(fd[n]);
+			mapworker(i, p[1]);
+		}
+		if (pid[i] < 0)
+			syserror("fork");
+		close(p[1]);
+		fd[i] = p[0];
+	}
+					/* collect chunks in order */
+	for (y = 0; y < ns; y++) {
+		i = y/MAPCHUNK % nprocs;
+		if (readbuf(fd[i], (char *)&n, sizeof(int)) != sizeof(int) ||
+				(n <= 0) | (n > COLRBUFSIZ(sl)) ||
+				readbuf(fd[i], (char *)ebuf, n) != n) {
+			fprintf(stderr, "%s: mapping process died\n",
+					progname);
+			exit(1);
+		}
+		if (fwrite(ebuf, 1, n, stdout) != n) {
+			fprintf(stderr, "%s: scanline write error\n",
+					progname);
+			exit(1);
+		}
+	}
+	free(ebuf);
+	for (i = 0; i < nprocs; i++) {
+		close(fd[i]);
+		while (waitpid(pid[i], &st, 0) < 0)
+			if (errno != EINTR)
+				syserror("waitpid");
+		if (st) {
+			fprintf(stderr, "%s: mapping process failed\n",
+					progname);
+			exit(1);
+		}
+	}
+#endif
+}
+
+
 static void
 getfovimg(void)			/* load foveal sampled image */
 {
@@ -341,6 +475,12 @@ getfovimg(void)			/* load foveal sampled image */
 	}
 	if ((fovimg = (COLOR *)malloc(fvxr*fvyr*sizeof(COLOR))) == NULL)
 		syserror("malloc");
+	if ((fvxr <= scanlen(&inpres)) & (fvyr <= numscans(&inpres))) {
+		scanpass(1);		/* average it ourselves */
+		return;
+	}
+	if (nprocs > 1)			/* tiny picture, so ask pfilt */
+		scanpass(0);
 	sprintf(combuf, "pfilt -1 -b -pa 0 -x %d -y %d \"%s\"", fvxr, fvyr, infn);
 	if ((fp = popen(combuf, "r")) == NULL)
 		syserror("popen");
@@ -360,6 +500,68 @@ readerr:
 }
 
 
+static void
+scanpass(			/* read picture once for foveal image & chunks */
+	int	dofov
+)
+{
+	const int	sl = scanlen(&inpres);
+	const int	ns = numscans(&inpres);
+	const double	x_c = (double)fvxr/sl;
+	const double	y_r = (double)fvyr/ns;
+	COLOR	*scan, *fsum = NULL;
+	COLR	*cscan = NULL;
+	int	*fcol = NULL, *fcnt = NULL;
+	int	x, y, fy, ny, n;
+
+	if (nprocs > 1 && (choff = (long *)malloc(sizeof(long) *
+			((ns+MAPCHUNK-1)/MAPCHUNK))) == NULL)
+		syserror("malloc");
+	if ((scan = (COLOR *)malloc(sl*sizeof(COLOR))) == NULL)
+		syserror("malloc");
+	if (dofov) {			/* same box filter as pfilt -1 -b */
+		fsum = (COLOR *)calloc(fvxr, sizeof(COLOR));
+		cscan = (COLR *)malloc(fvxr*sizeof(COLR));
+		fcol = (int *)malloc(sl*sizeof(int));
+		fcnt = (int *)calloc(fvxr, sizeof(int));
+		if ((fsum == NULL) | (cscan == NULL) |
+				(fcol == NULL) | (fcnt == NULL))
+			syserror("malloc");
+		for (x = 0; x < sl; x++)
+			fcnt[fcol[x] = x_c*x]++;
+	}
+	fy = ny = 0;
+	for (y = 0; y < ns; y++) {
+		if (choff != NULL && !(y % MAPCHUNK))
+			choff[y/MAPCHUNK] = ftell(infp);
+		if (freadscan(scan, sl, infp) < 0) {
+			fprintf(stderr, "%s: %s: scanline read error\n",
+					progname, infn);
+			exit(1);
+		}
+		if (!dofov)
+			continue;
+		for (x = 0; x < sl; x++)
+			addcolor(fsum[fcol[x]], scan[x]);
+		ny++;
+		if ((y < ns-1) && (int)(y_r*(y+1)) == fy)
+			continue;
+		for (x = 0; x < fvxr; x++)	/* finish foveal scanline */
+			if ((n = fcnt[x]*ny) > 1)
+				scalecolor(fsum[x], 1.0/n);
+		setcolrs(cscan, fsum, fvxr);	/* pfilt precision */
+		colrs_color(fovscan(fy), cscan, fvxr);
+		memset(fsum, 0, fvxr*sizeof(COLOR));
+		fy++; ny = 0;
+	}
+	free(scan);
+	if (dofov) {
+		free(fsum); free(cscan);
+		free(fcol); free(fcnt);
+	}
+}
+
+
 static void
 check2do(void)		/* check histogram to see what isn't worth doing */
 {
@@ -108,6 +108,8 @@ extern double rgblum(COLOR clr, int scotopic);	/* compute (scotopic) luminance o
 extern double cielum(COLOR xyz, int scotopic);	/* compute (scotopic) luminance of CIE color */
 extern COLOR	*nextscan(void);		/* next processed scanline */
 extern COLOR	*firstscan(void);		/* first processed scanline */
+extern void	initscan(void);			/* prepare conditioning */
+extern COLOR	*seekscan(int y, long pos);	/* processed scanline y at pos */
 
 	/* defined in pcond3.c */
 extern void getfixations(FILE *fp);	/* load fixation history list */
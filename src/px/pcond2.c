@@ -102,8 +102,8 @@ nextscan(void)				/* read and condition next scanline */
 }
 
 
-COLOR *
-firstscan(void)				/* return first processed scanline */
+void
+initscan(void)				/* prepare scanline conditioning */
 {
 	if (mbcalfile != NULL)		/* load macbethcal file */
 		getmbcalfile(mbcalfile, &mbcond);
@@ -120,11 +120,32 @@ firstscan(void)				/* return first processed scanline */
 	scanbuf = (COLOR *)malloc(scanlen(&inpres)*sizeof(COLOR));
 	if (scanbuf == NULL)
 		syserror("malloc");
+}
+
+
+COLOR *
+firstscan(void)				/* return first processed scanline */
+{
+	initscan();
 	nread = 0;
 	return(nextscan());
 }
 
 
+COLOR *
+seekscan(			/* condition scanline y at file position pos */
+	int	y,
+	long	pos
+)
+{
+	/* acuity sampling reads its own way from the first scanline */
+	if (!(what2do&DO_ACUITY) && fseek(infp, pos, SEEK_SET) < 0)
+		syserror(infn);
+	nread = y;
+	return(nextscan());
+}
+
+
 static void
 sfscan(			/* apply scalefactor to scanline */
 	COLOR	*sl,
@@ -331,6 +331,8 @@ sumans(		/* sum input pixel to output */
 				continue;
 			copycolor(ctmp, pval);
 			dx = norm*warr[i++];
+			if ((r < orow0) | (r >= orow1))
+				continue;	/* not in our band */
 			scalecolor(ctmp, dx);
 			addcolor(scan[c+offs], ctmp);
 		}
@@ -19,7 +19,12 @@ static const char RCSid[] = "$Id: pfilt.c,v 2.33 2018/08/02 18:33:44 greg Exp $"
 #include  "color.h"
 #include  "view.h"
 #include  "paths.h"
+#include  "rtprocess.h"
+#include  "picmap.h"
 #include  "pfilt.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include  <sys/wait.h>
+#endif
 
 
 #define	 FEQ(a,b)	((a) >= .98*(b) && (a) <= 1.02*(b))
@@ -28,6 +33,8 @@ double	 CHECKRAD = 2.0;	/* radius to check for filtering */
 
 #define  THRESHRAD	5.0	/* maximum sample spread in output */
 
+#define  MAXBROWS	256	/* maximum rows per parallel band */
+
 COLOR  exposure = WHTCOLOR;	/* exposure for the frame */
 
 double	rad = 0.0;		/* output pixel radius for filtering */
@@ -81,6 +88,14 @@ COLOR  **scoutbar;		/* output scan bar (if thresh > 0) */
 float  **greybar;		/* grey-averaged input values */
 int  obarsize = 0;		/* size of output scan bar */
 int  orad = 0;			/* output window radius */
+int  orow0, orow1;		/* output rows in current band */
+
+int  nproc = 1;			/* number of filtering processes */
+
+static int  nextrow;		/* next grey-averaged row */
+static uby8  *obuf = NULL;	/* encoded band buffer (if parallel) */
+static long  olen;		/* bytes used in obuf */
+static COLR  *cbuf;		/* scanline conversion buffer */
 
 char  *progname;
 
@@ -92,7 +107,6 @@ static void pass1(FILE  *in);
 static void pass2(FILE  *in);
 static void scan2init(void);
 static void scan2sync(int  r);
-static void scan2flush(void);
 
 
 int
@@ -198,6 +212,9 @@ main(
 			case 'n':
 				npts = atoi(argv[++i]) / 2;
 				break;
+			case 'N':
+				nproc = atoi(argv[++i]);
+				break;
 			case 's':
 				spread = atof(argv[++i]);
 				break;
@@ -423,34 +440,78 @@ pass1(				/* first pass of picture file */
 
 
 static void
-pass2(			/* last pass on file, write to stdout */
-	FILE  *in
+getrow(			/* read input scanline into bar */
+	FILE  *in,
+	PICMAP  *pm,
+	int  y
+)
+{
+	if ((pm != NULL ? pm_readscan(pm, scanin[y%barsize], y) :
+			freadscan(scanin[y%barsize], xres, in)) < 0) {
+		fprintf(stderr, "%s: truncated input (y=%d)\n",
+				progname, yres-1-y);
+		quit(1);
+	}
+	pass2scan(scanin[y%barsize], y);
+}
+
+
+static void
+putrow(			/* write out filtered scanline */
+	COLOR  *scan
+)
+{
+	if (obuf != NULL) {	/* encode to band buffer */
+		setcolrs(cbuf, scan, ncols);
+		olen += encodecolrs(obuf+olen, cbuf, ncols);
+		return;
+	}
+	if (fwritescan(scan, ncols, stdout) < 0) {
+		fprintf(stderr, "%s: write error in pass2\n", progname);
+		quit(1);
+	}
+}
+
+
+static void
+filtband(		/* filter output rows r0 through r1-1 */
+	FILE  *in,
+	PICMAP  *pm,
+	int  r0,
+	int  r1
 )
 {
+	int  rs, re, rw;
 	int  yread;
 	int  ycent, xcent;
 	int  r, c;
-	
-	pass2init();
-	scan2init();
-	yread = 0;
-	for (r = 0; r < nrows; r++) {
+					/* rows affecting this band */
+	rs = r0 - orad;
+	if (rs < 0) rs = 0;
+	re = r1 + orad;
+	if (re > nrows) re = nrows;
+	rw = rs - 2*orad;		/* grey averages need warm-up */
+	if (rw < 0) rw = 0;
+	orow0 = r0; orow1 = r1;
+	nextrow = rw ? rw+orad : 0;
+					/* fill bar as sequential pass would */
+	yread = rw ? (int)((rw-1+.5)*yres/nrows) + yrad + 1 : 0;
+	for (r = yread-barsize; r < yread; r++)
+		if ((r >= 0) & (r < yres))
+			getrow(in, pm, r);
+	for (r = rw; r < re; r++) {
 		ycent = (r+.5)*yres/nrows;
 		while (yread <= ycent+yrad) {
-			if (yread < yres) {
-				if (freadscan(scanin[yread%barsize],
-						xres, in) < 0) {
-					fprintf(stderr,
-						"%s: truncated input (y=%d)\n",
-						progname, yres-1-yread);
-					quit(1);
-				}
-				pass2scan(scanin[yread%barsize], yread);
-			}
+			if (yread < yres)
+				getrow(in, pm, yread);
 			yread++;
 		}
 		if (obarsize > 0)
 			scan2sync(r);
+		if (r < rs)
+			continue;	/* just warming up */
+		if ((obarsize <= 0) & (r >= r1))
+			break;
 		for (c = 0; c < ncols; c++) {
 			xcent = (c+.5)*xres/ncols;
 			if (thresh > FTINY)
@@ -460,18 +521,129 @@ pass2(			/* last pass on file, write to stdout */
 			else
 				dobox(scanout[c], xcent, ycent, c, r);
 		}
-		if (scanout != NULL && fwritescan(scanout, ncols, stdout) < 0) {
+		if (obarsize > 0 ? (r-orad >= r0) & (r-orad < r1) : r >= r0)
+			putrow(scanout);
+	}
+	if (obarsize > 0)		/* flush remaining rows */
+		for (r = re-orad; r < re; r++)
+			if ((r >= r0) & (r < r1))
+				putrow(scoutbar[r%obarsize]);
+	if (in != NULL)			/* skip leftover input */
+		while (yread++ < yres)
+			if (freadscan(scanin[0], xres, in) < 0)
+				break;
+}
+
+
+#if !defined(_WIN32) && !defined(_WIN64)
+static int
+pass2par(		/* filter bands in parallel, or return 0 */
+	FILE  *in
+)
+{
+	long  fpos = ftell(in);
+	PICMAP  *pm;
+	int  *pfd;
+	int  nbands, brows;
+	int  b, i, n;
+	int  cfd[2];
+
+	if ((fpos < 0) | (nproc <= 1) || fseek(in, 0L, SEEK_SET) < 0)
+		return(0);
+	if ((pm = pm_load(in, NULL, NULL)) == NULL || pm->nvalid < yres) {
+		pm_free(pm);		/* let sequential pass handle it */
+		fseek(in, fpos, SEEK_SET);
+		return(0);
+	}
+	brows = nrows/(4*nproc) + 1;	/* bands large vs. overlap */
+	if (brows < 8*orad) brows = 8*orad;
+	if (brows > MAXBROWS) brows = MAXBROWS;
+	nbands = (nrows + brows-1)/brows;
+	if (nbands < 2) {
+		pm_free(pm);
+		fseek(in, fpos, SEEK_SET);
+		return(0);
+	}
+	if (nproc > nbands)
+		nproc = nbands;
+	pfd = (int *)malloc(nproc*sizeof(int));
+	obuf = (uby8 *)malloc(COLRBUFSIZ(ncols)*(long)brows);
+	cbuf = (COLR *)malloc(ncols*sizeof(COLR));
+	if ((pfd == NULL) | (obuf == NULL) | (cbuf == NULL)) {
+		fprintf(stderr, "%s: out of memory in pass2\n", progname);
+		quit(1);
+	}
+	fflush(stdout);
+	for (i = 0; i < nproc; i++) {	/* start filtering processes */
+		if (pipe(cfd) < 0) {
+			perror("pipe");
+			quit(1);
+		}
+		if ((n = fork()) == 0) {	/* child does every nproc band */
+			close(cfd[0]);
+			for (b = 0; b < i; b++)
+				close(pfd[b]);
+			tfname = NULL;		/* parent removes temp file */
+			for (b = i; b < nbands; b += nproc) {
+				olen = 0;
+				filtband(NULL, pm, b*brows,
+					(b+1)*brows < nrows ? (b+1)*brows : nrows);
+				if (writebuf(cfd[1], (char *)&olen,
+						sizeof(olen)) != sizeof(olen) ||
+						writebuf(cfd[1], (char *)obuf,
+							olen) != olen)
+					_exit(1);
+			}
+			_exit(0);
+		}
+		if (n < 0) {
+			perror("fork");
+			quit(1);
+		}
+		close(cfd[1]);
+		pfd[i] = cfd[0];
+	}
+	for (b = 0; b < nbands; b++) {	/* copy bands out in order */
+		i = b % nproc;
+		if (readbuf(pfd[i], (char *)&olen, sizeof(olen)) != sizeof(olen) ||
+				readbuf(pfd[i], (char *)obuf, olen) != olen) {
+			fprintf(stderr, "%s: filter process failed\n", progname);
+			quit(1);
+		}
+		if (fwrite(obuf, 1, olen, stdout) != olen) {
 			fprintf(stderr, "%s: write error in pass2\n", progname);
 			quit(1);
 		}
 	}
-					/* skip leftover input */
-	while (yread < yres) {
-		if (freadscan(scanin[0], xres, in) < 0)
-			break;
-		yread++;
+	for (i = 0; i < nproc; i++)	/* clean up */
+		close(pfd[i]);
+	while (wait(&n) >= 0)
+		if (n) {
+			fprintf(stderr, "%s: filter process error\n", progname);
+			quit(1);
+		}
+	free(pfd);
+	pm_free(pm);
+	return(1);
+}
+#else
+#define pass2par(in)	0
+#endif
+
+
+static void
+pass2(			/* last pass on file, write to stdout */
+	FILE  *in
+)
+{
+	pass2init();
+	scan2init();
+	if (!pass2par(in))
+		filtband(in, NULL, 0, nrows);
+	if (fflush(stdout) < 0) {
+		fprintf(stderr, "%s: write error at end of pass2\n", progname);
+		quit(1);
 	}
-	scan2flush();			/* flush output */
 }
 
 
@@ -558,7 +730,6 @@ scan2sync(			/* synchronize grey averages and output scan */
 	int  r
 )
 {
-	static int  nextrow = 0;
 	COLOR  ctmp;
 	int  ybot;
 	int  c;
@@ -581,21 +752,6 @@ scan2sync(			/* synchronize grey averages and output scan */
 }
 
 
-static void
-scan2flush(void)			/* flush output buffer */
-{
-	int  r;
-
-	for (r = nrows-orad; r < nrows; r++)
-		if (fwritescan(scoutbar[r%obarsize], ncols, stdout) < 0)
-			break;
-	if (fflush(stdout) < 0) {
-		fprintf(stderr, "%s: write error at end of pass2\n", progname);
-		quit(1);
-	}
-}
-
-
 void
 quit(code)		/* remove temporary file and exit */
 int  code;
@@ -36,6 +36,7 @@ extern COLOR  **scoutbar;	/* output scan bar (if thresh > 0) */
 extern float  **greybar;	/* grey-averaged input values */
 extern int  obarsize;		/* size of output scan bar */
 extern int  orad;		/* output window radius */
+extern int  orow0, orow1;	/* output rows in current band */
 
 extern int  wrapfilt;		/* wrap filter horizontally? */
 
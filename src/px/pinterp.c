@@ -17,6 +17,10 @@ static const char	RCSid[] = "$Id: pinterp.c,v 2.47 2018/08/02 18:33:45 greg Exp
 #include "rtprocess.h" /* Windows: must come before color.h */
 #include "view.h"
 #include "color.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/mman.h>
+#include <sys/wait.h>
+#endif
 
 #define LOG2		0.69314718055994530942
 
@@ -48,6 +52,11 @@ struct position {int x,y; float z;};
 
 struct bound {int min,max;};
 
+#define PSTRIP		128		/* input rows per parallel strip */
+#define SHMPAD		64		/* padding before shared buffers */
+
+struct mvpos {int x,y; double w,z;};	/* moved pixel (parallel) */
+
 VIEW	ourview = STDVIEW;		/* desired view */
 int	hresolu = 512;			/* horizontal resolution */
 int	vresolu = 512;			/* vertical resolution */
@@ -55,6 +64,9 @@ double	pixaspect = 1.0;		/* pixel aspect ratio */
 
 double	zeps = .02;			/* allowed z epsilon */
 
+int	nproc = 1;			/* number of processes */
+struct bound	ourband;		/* output rows we may fill */
+
 COLR	*ourpict;			/* output picture (COLR's) */
 COLOR	*ourspict;			/* output pixel sums (averaging) */
 float	*ourweigh = NULL;		/* output pixel weights (averaging) */
@@ -97,8 +109,11 @@ static int nextview(FILE *fp);
 static void compavgview(void);
 static void addpicture(char *pfile, char *zspec);
 static int pixform(MAT4 xfmat, VIEW *vw1, VIEW *vw2);
+static void paddpicture(FILE *pfp, char *pfile, int zfd, char *zspec,
+	float *zin, struct bound *xlim, struct bound *ylim);
 static void addscanline(struct bound *xl, int y,
-	COLR *pline, float *zline, struct position *lasty);
+	COLR *pline, float *zline, struct position *lasty,
+	struct mvpos *mvp);
 static void addpixel(struct position *p0, struct position *p1,
 	struct position *p2, COLR pix, double w, double z);
 static double movepixel(FVECT pos);
@@ -115,6 +130,7 @@ static void calstart(char *prog, char *args);
 static void caldone(void);
 static void clearqueue(void);
 static void syserror(char *s);
+static void *shmalloc(size_t n);
 
 fillfunc_t *fillfunc = backfill;	/* selected fill function */
 
@@ -220,6 +236,10 @@ main(			/* interpolate pictures */
 			check(2,"s");
 			zfile = argv[++an];
 			break;
+		case 'N':				/* processes */
+			check(2,"i");
+			nproc = atoi(argv[++an]);
+			break;
 		case 'x':				/* x resolution */
 			check(2,"i");
 			hresolu = atoi(argv[++an]);
@@ -257,6 +277,9 @@ main(			/* interpolate pictures */
 						/* check arguments */
 	if ((argc-an)%2)
 		goto userr;
+#if defined(_WIN32) || defined(_WIN64)
+	nproc = 1;				/* no fork() */
+#endif
 	if (fillsamp == 1)
 		fillo &= ~F_BACK;
 	if (doavg < 0)
@@ -284,14 +307,15 @@ main(			/* interpolate pictures */
 		exit(1);
 	}
 	normaspect(viewaspect(&ourview), &pixaspect, &hresolu, &vresolu);
+	ourband.min = 0; ourband.max = vresolu-1;
 						/* allocate frame */
 	if (doavg) {
-		ourspict = (COLOR *)bmalloc(hresolu*vresolu*sizeof(COLOR));
-		ourweigh = (float *)bmalloc(hresolu*vresolu*sizeof(float));
+		ourspict = (COLOR *)shmalloc(hresolu*vresolu*sizeof(COLOR));
+		ourweigh = (float *)shmalloc(hresolu*vresolu*sizeof(float));
 		if ((ourspict == NULL) | (ourweigh == NULL))
 			syserror(progname);
 	} else {
-		ourpict = (COLR *)bmalloc(hresolu*vresolu*sizeof(COLR));
+		ourpict = (COLR *)shmalloc(hresolu*vresolu*sizeof(COLR));
 		if (ourpict == NULL)
 			syserror(progname);
 	}
@@ -300,7 +324,7 @@ main(			/* interpolate pictures */
 		if (ourbpict == NULL)
 			syserror(progname);
 	}
-	ourzbuf = (float *)bmalloc(hresolu*vresolu*sizeof(float));
+	ourzbuf = (float *)shmalloc(hresolu*vresolu*sizeof(float));
 	if (ourzbuf == NULL)
 		syserror(progname);
 							/* new header */
@@ -348,7 +372,7 @@ main(			/* interpolate pictures */
 	exit(0);
 userr:
 	fprintf(stderr,
-	"Usage: %s [view opts][-t eps][-z zout][-e spec][-B][-a|-q][-fT][-n] pfile zspec ..\n",
+	"Usage: %s [view opts][-t eps][-z zout][-e spec][-B][-a|-q][-fT][-n][-N nproc] pfile zspec ..\n",
 			progname);
 	exit(1);
 #undef check
@@ -516,6 +540,15 @@ addpicture(		/* add picture to output */
 			close(zfd);
 		fclose(pfp);
 		return;
+	}
+	if (nproc > 1) {			/* divide the work */
+		paddpicture(pfp, pfile, zfd, zspec, zin, xlim, &ylim);
+		free((void *)xlim);
+		free((void *)zin);
+		fclose(pfp);
+		if (zfd != -1)
+			close(zfd);
+		return;
 	}
 					/* allocate scanlines */
 	scanin = (COLR *)malloc(scanlen(&tresolu)*sizeof(COLR));
@@ -543,7 +576,7 @@ addpicture(		/* add picture to output */
 				scanlen(&tresolu)*sizeof(float))
 				< scanlen(&tresolu)*sizeof(float))
 			syserror(zspec);
-		addscanline(xlim+y, y, scanin, zin, plast);
+		addscanline(xlim+y, y, scanin, zin, plast, NULL);
 	}
 					/* clean up */
 	free((void *)xlim);
@@ -556,6 +589,153 @@ addpicture(		/* add picture to output */
 }
 
 
+#if !defined(_WIN32) && !defined(_WIN64)
+static void
+paddpicture(		/* add picture using parallel processes */
+	FILE	*pfp,
+	char	*pfile,
+	int	zfd,
+	char	*zspec,
+	float	*zin,
+	struct bound	*xlim,
+	struct bound	*ylim
+)
+{
+	int	sl = scanlen(&tresolu);
+	int	*cfd, *rfd, *pid;
+	COLR	*scanin;
+	float	*zbuf;
+	struct mvpos	*mvbuf, *mp;
+	struct position	*plast;
+	FVECT	pos;
+	int	cmd[3];			/* phase, first & last+1 row */
+	int	i, n, y, x;
+	int	p1[2], p2[2];
+	char	c;
+					/* strip buffers shared with helpers */
+	scanin = (COLR *)shmalloc(PSTRIP*sl*sizeof(COLR));
+	zbuf = (float *)shmalloc(PSTRIP*sl*sizeof(float));
+	mvbuf = (struct mvpos *)shmalloc(PSTRIP*sl*sizeof(struct mvpos));
+	cfd = (int *)malloc(3*nproc*sizeof(int));
+	if ((scanin == NULL) | (zbuf == NULL) | (mvbuf == NULL) | (cfd == NULL))
+		syserror(progname);
+	rfd = cfd + nproc;
+	pid = rfd + nproc;
+	fflush(stdout);
+	for (i = 0; i < nproc; i++) {	/* start our helpers */
+		if (pipe(p1) < 0 || pipe(p2) < 0)
+			syserror("pipe");
+		if ((pid[i] = fork()) == 0) {
+			close(p1[1]); close(p2[0]);
+			for (n = 0; n < i; n++) {
+				close(cfd[n]); close(rfd[n]);
+			}
+			break;
+		}
+		if (pid[i] < 0)
+			syserror("fork");
+		close(p1[0]); close(p2[1]);
+		cfd[i] = p1[1]; rfd[i] = p2[0];
+	}
+	if (i < nproc) {		/* helper i */
+		plast = (struct position *)calloc(sl, sizeof(struct position));
+		if (plast == NULL)
+			syserror(progname);
+		ourband.min = (long)vresolu*i/nproc;
+		ourband.max = (long)vresolu*(i+1)/nproc - 1;
+		c = 0;
+		while (readbuf(p1[0], (char *)cmd, sizeof(cmd)) == sizeof(cmd)) {
+			if (cmd[0])		/* fill our band of output */
+				for (y = cmd[1]; y < cmd[2]; y++) {
+					n = (y - cmd[1])*sl;
+					addscanline(xlim+y, y, scanin+n,
+						zbuf+n, plast, mvbuf+n);
+				}
+			else			/* move our rows of pixels */
+				for (y = cmd[1]+i; y < cmd[2]; y += nproc) {
+					n = (y - cmd[1])*sl;
+					mp = mvbuf + n;
+					for (x = xlim[y].min; x <= xlim[y].max;
+							x++) {
+						pix2loc(pos, &tresolu, x, y);
+						pos[2] = zbuf[n+x];
+						mp[x].w = movepixel(pos);
+						mp[x].x = pos[0] * hresolu;
+						mp[x].y = pos[1] * vresolu;
+						mp[x].z = pos[2];
+					}
+				}
+			if (write(p2[1], &c, 1) != 1)
+				_exit(1);
+		}
+		_exit(0);
+	}
+					/* skip to starting point */
+	for (y = 0; y < ylim->min; y++)
+		if (freadcolrs(scanin, sl, pfp) < 0) {
+			fprintf(stderr, "%s: read error\n", pfile);
+			exit(1);
+		}
+	if (zfd != -1 && lseek(zfd, (off_t)ylim->min*sl*sizeof(float),
+			SEEK_SET) < 0)
+		syserror(zspec);
+					/* process image in strips */
+	for (cmd[1] = ylim->min; cmd[1] <= ylim->max; cmd[1] += PSTRIP) {
+		cmd[2] = cmd[1] + PSTRIP;
+		if (cmd[2] > ylim->max+1)
+			cmd[2] = ylim->max+1;
+		for (y = cmd[1]; y < cmd[2]; y++) {
+			n = (y - cmd[1])*sl;
+			if (freadcolrs(scanin+n, sl, pfp) < 0) {
+				fprintf(stderr, "%s: read error\n", pfile);
+				exit(1);
+			}
+			if (zfd == -1)
+				memcpy(zbuf+n, zin, sl*sizeof(float));
+			else if (read(zfd, (char *)(zbuf+n), sl*sizeof(float))
+					< sl*sizeof(float))
+				syserror(zspec);
+		}
+		for (cmd[0] = 0; cmd[0] < 2; cmd[0]++) {  /* move, then fill */
+			for (i = 0; i < nproc; i++)
+				if (writebuf(cfd[i], (char *)cmd,
+						sizeof(cmd)) != sizeof(cmd))
+					syserror("write");
+			for (i = 0; i < nproc; i++)
+				if (read(rfd[i], &c, 1) != 1) {
+					fprintf(stderr,
+					"%s: reprojection process failed\n",
+							progname);
+					exit(1);
+				}
+		}
+	}
+	for (i = 0; i < nproc; i++) {	/* done */
+		close(cfd[i]); close(rfd[i]);
+	}
+	for (i = 0; i < nproc; i++)	/* not our rtrace, though */
+		if (waitpid(pid[i], &n, 0) < 0 || n) {
+			fprintf(stderr, "%s: reprojection process error\n",
+					progname);
+			exit(1);
+		}
+	free((void *)cfd);
+	munmap((char *)scanin - SHMPAD, PSTRIP*sl*sizeof(COLR) + SHMPAD);
+	munmap((char *)zbuf - SHMPAD, PSTRIP*sl*sizeof(float) + SHMPAD);
+	munmap((char *)mvbuf - SHMPAD,
+			PSTRIP*sl*sizeof(struct mvpos) + SHMPAD);
+}
+#else
+static void
+paddpicture(FILE *pfp, char *pfile, int zfd, char *zspec,
+	float *zin, struct bound *xlim, struct bound *ylim)
+{
+	fprintf(stderr, "%s: no parallel processes\n", progname);
+	exit(1);
+}
+#endif
+
+
 static int
 pixform(		/* compute view1 to view2 matrix */
 	MAT4	xfmat,
@@ -606,7 +786,8 @@ addscanline(	/* add scanline to output */
 	int	y,
 	COLR	*pline,
 	float	*zline,
-	struct position	*lasty		/* input/output */
+	struct position	*lasty,		/* input/output */
+	struct mvpos	*mvp		/* moved pixels (or NULL) */
 )
 {
 	FVECT	pos;
@@ -616,15 +797,26 @@ addscanline(	/* add scanline to output */
 
 	lastx.z = 0;
 	for (x = xl->max; x >= xl->min; x--) {
-		pix2loc(pos, &tresolu, x, y);
-		pos[2] = zline[x];
-		if ((wt = movepixel(pos)) <= FTINY) {
+		if (mvp != NULL) {		/* already moved */
+			wt = mvp[x].w;
+			pos[2] = mvp[x].z;
+		} else {
+			pix2loc(pos, &tresolu, x, y);
+			pos[2] = zline[x];
+			wt = movepixel(pos);
+		}
+		if (wt <= FTINY) {
 			lasty[x].z = lastx.z = 0;	/* mark invalid */
 			continue;
 		}
 					/* add pixel to our image */
-		newpos.x = pos[0] * hresolu;
-		newpos.y = pos[1] * vresolu;
+		if (mvp != NULL) {
+			newpos.x = mvp[x].x;
+			newpos.y = mvp[x].y;
+		} else {
+			newpos.x = pos[0] * hresolu;
+			newpos.y = pos[1] * vresolu;
+		}
 		newpos.z = zline[x];
 		addpixel(&newpos, &lastx, &lasty[x], pline[x], wt, pos[2]);
 		lasty[x].x = lastx.x = newpos.x;
@@ -693,7 +885,7 @@ addpixel(		/* fill in pixel parallelogram */
 			if ((x < 0) | (x >= hresolu))
 				continue;
 			y = y1 + c2*s2y/l2;
-			if ((y < 0) | (y >= vresolu))
+			if ((y < ourband.min) | (y > ourband.max))
 				continue;
 			if (averaging) {
 				if (zscan(y)[x] <= 0 || zscan(y)[x]-z
@@ -997,7 +1189,7 @@ clipaft(void)			/* perform aft clipping as indicated */
 	int	x, y;
 	int	adjtest = (ourview.type == VT_PER) & zisnorm;
 	double	tstdist;
-	double	yzn2, vx;
+	double	yzn2 = 1., vx;
 
 	if (ourview.vaft <= FTINY)
 		return(0);
@@ -1276,6 +1468,22 @@ clearqueue(void)				/* process queue */
 }
 
 
+static void *
+shmalloc(			/* get memory shared with helpers */
+	size_t	n
+)
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	if (nproc > 1) {		/* pad, as backpicture() peeks before */
+		char	*p = (char *)mmap(NULL, n+SHMPAD, PROT_READ|PROT_WRITE,
+					MAP_ANON|MAP_SHARED, -1, 0);
+		return(p == (char *)MAP_FAILED ? NULL : (void *)(p+SHMPAD));
+	}
+#endif
+	return(bmalloc(n));
+}
+
+
 static void
 syserror(			/* report error and exit */
 	char	*s
@@ -78,6 +78,9 @@ main(int argc, char *argv[])
 			case 'r':
 				reverse = !reverse;
 				break;
+			case 'n':
+				tmNumProcs = atoi(argv[++i]);
+				break;
 			default:
 				goto userr;
 			}
@@ -188,7 +191,7 @@ main(int argc, char *argv[])
 	return(0);			/* success */
 userr:
 	fprintf(stderr,
-"Usage: %s [-b][-g gamma][-e spec][-p xr yr xg yg xb yb xw yw] [input|- [output]]\n",
+"Usage: %s [-b][-g gamma][-e spec][-n nproc][-p xr yr xg yg xb yb xw yw] [input|- [output]]\n",
 			progname);
 	fprintf(stderr,
 		"   or: %s -r [-g gamma][-e +/-stops] [input|- [output]]\n",
@@ -0,0 +1,325 @@
+#ifndef lint
+static const char	RCSid[] = "$Id$";
+#endif
+/*
+ *  Add or remove a pyramid of tiled, reduced-resolution levels
+ *  in a RADIANCE picture (see picmap.h for the layout).
+ *
+ *  The full-resolution scanlines are unchanged, so the result is
+ *  still read by freadscan() and every other picture tool.
+ */
+
+#include  <stdio.h>
+#include  <string.h>
+
+#include  "platform.h"
+#include  "rtio.h"
+#include  "color.h"
+#include  "resolu.h"
+#include  "picmap.h"
+
+char	*progname;
+
+int	gargc;				/* global argc for printargs */
+char	**gargv;			/* global argv for printargs */
+
+int	reverse = 0;			/* remove pyramid? */
+int	tsize = 64;			/* tile size */
+int	nlevels = 0;			/* levels (0 for automatic) */
+
+char	fmt[MAXFMTLEN] = COLRFMT;	/* picture format */
+
+static gethfunc headline;
+static void quiterr(char *err);
+static void addrow(COLOR *acc, COLOR *row, int sl);
+static void putrow(COLR *dst, COLOR *acc, int sl, int ny);
+static void putbytes(uby8 *bp, long n, long *op);
+static void topyramid(void);
+static void frompyramid(void);
+
+
+static int
+headline(				/* process header line */
+	char	*s,
+	void	*p
+)
+{
+	if (formatval(fmt, s))		/* check if format string */
+		return(0);		/* don't echo */
+	if (isPYR(s))			/* old pyramid is replaced */
+		return(0);
+	return(fputs(s, stdout));
+}
+
+
+int
+main(int  argc, char  *argv[])
+{
+	int	i;
+
+	SET_DEFAULT_BINARY();
+	SET_FILE_BINARY(stdin);
+	SET_FILE_BINARY(stdout);
+	progname = argv[0];
+	gargc = argc; gargv = argv;
+
+	for (i = 1; i < argc && argv[i][0] == '-' && argv[i][1]; i++)
+		switch (argv[i][1]) {
+		case 'r':		/* remove pyramid */
+			reverse = !reverse;
+			break;
+		case 't':		/* tile size */
+			if (argc-i < 2) goto userr;
+			tsize = atoi(argv[++i]);
+			if (tsize < 8)
+				goto userr;
+			break;
+		case 'l':		/* levels, or level to extract */
+			if (argc-i < 2) goto userr;
+			nlevels = atoi(argv[++i]);
+			if (nlevels < 0)
+				goto userr;
+			break;
+		default:
+			goto userr;
+		}
+	if (i < argc-2)
+		goto userr;
+	if (i <= argc-1 && strcmp(argv[i], "-") &&
+			freopen(argv[i], "r", stdin) == NULL) {
+		fprintf(stderr, "%s: can't open input \"%s\"\n",
+				progname, argv[i]);
+		exit(1);
+	}
+	if (i == argc-2 && strcmp(argv[i+1], "-") &&
+			freopen(argv[i+1], "w", stdout) == NULL) {
+		fprintf(stderr, "%s: can't open output \"%s\"\n",
+				progname, argv[i+1]);
+		exit(1);
+	}
+	SET_FILE_BINARY(stdin);
+	SET_FILE_BINARY(stdout);
+	if (reverse)
+		frompyramid();
+	else
+		topyramid();
+	if (fflush(stdout) == EOF)
+		quiterr("error writing picture");
+	exit(0);
+userr:
+	fprintf(stderr,
+	"Usage: %s [-t tsize][-l nlevels] [input|- [output]]\n", progname);
+	fprintf(stderr,
+	"   or: %s -r [-l level] [input|- [output]]\n", progname);
+	exit(1);
+}
+
+
+static void
+quiterr(		/* print message and exit */
+	char  *err
+)
+{
+	if (err != NULL) {
+		fprintf(stderr, "%s: %s\n", progname, err);
+		exit(1);
+	}
+	exit(0);
+}
+
+
+static void
+addrow(			/* add scanline into half-size accumulator */
+	COLOR  *acc,
+	COLOR  *row,
+	int  sl
+)
+{
+	int	x;
+
+	for (x = 0; x < sl; x++)
+		addcolor(acc[x>>1], row[x]);
+}
+
+
+static void
+putrow(			/* average accumulator into reduced scanline */
+	COLR  *dst,
+	COLOR  *acc,
+	int  sl,
+	int  ny
+)
+{
+	const int	hsl = (sl+1)>>1;
+	double	d;
+	int	x;
+
+	for (x = 0; x < hsl; x++) {
+		d = 1./(ny*(2*x+1 < sl ? 2 : 1));
+		scalecolor(acc[x], d);
+	}
+	setcolrs(dst, acc, hsl);
+	memset(acc, 0, sizeof(COLOR)*hsl);
+}
+
+
+static void
+putbytes(		/* write bytes and advance offset */
+	uby8  *bp,
+	long  n,
+	long  *op
+)
+{
+	if (fwrite(bp, 1, n, stdout) != n)
+		quiterr("error writing picture");
+	*op += n;
+}
+
+
+static void
+topyramid(void)			/* copy picture, adding pyramid */
+{
+	RESOLU	rs;
+	int	sl, ns;
+	int	lsl[64], lns[64];
+	COLR	*lev[64];
+	long	*tndx[64];
+	COLR	*scan;
+	COLOR	*frow, *acc;
+	uby8	*ebuf;
+	long	*sndx, off = 0;
+	int	nl, l, x, y, tx, ty;
+					/* get header */
+	if (getheader(stdin, headline, NULL) < 0)
+		quiterr("bad picture header");
+	if (strcmp(fmt, COLRFMT) && strcmp(fmt, CIEFMT))
+		quiterr("input must be a RADIANCE picture");
+	if (!fgetsresolu(&rs, stdin))
+		quiterr("bad picture resolution");
+	sl = scanlen(&rs); ns = numscans(&rs);
+	lsl[0] = sl; lns[0] = ns;	/* count levels */
+	for (nl = 1; (lsl[nl-1] > tsize) | (lns[nl-1] > tsize) &&
+			(nlevels <= 0) | (nl < nlevels) && nl < 64; nl++) {
+		lsl[nl] = (lsl[nl-1] + 1) >> 1;
+		lns[nl] = (lns[nl-1] + 1) >> 1;
+	}
+	printargs(gargc, gargv, stdout);
+	if (nl > 1)
+		printf("%s %d %d\n", PYRSTR, nl, tsize);
+	fputformat(fmt, stdout);
+	putchar('\n');
+	fputsresolu(&rs, stdout);
+					/* allocate buffers */
+	scan = (COLR *)malloc(sizeof(COLR)*sl);
+	ebuf = (uby8 *)malloc(COLRBUFSIZ(sl));
+	frow = (COLOR *)malloc(sizeof(COLOR)*sl);
+	acc = (COLOR *)calloc((sl+1)>>1, sizeof(COLOR));
+	sndx = (long *)malloc(sizeof(long)*(ns+1));
+	if ((scan == NULL) | (ebuf == NULL) | (frow == NULL) |
+			(acc == NULL) | (sndx == NULL))
+		quiterr("out of memory");
+	for (l = 1; l < nl; l++)
+		if ((lev[l] = (COLR *)malloc(sizeof(COLR)*lsl[l]*lns[l])) == NULL)
+			quiterr("out of memory for reduced levels");
+					/* copy scanlines, reduce to level 1 */
+	for (y = 0; y < ns; y++) {
+		if (freadcolrs(scan, sl, stdin) < 0)
+			quiterr("error reading picture");
+		sndx[y] = off;
+		putbytes(ebuf, encodecolrs(ebuf, scan, sl), &off);
+		if (nl < 2)
+			continue;
+		colrs_color(frow, scan, sl);
+		addrow(acc, frow, sl);
+		if ((y & 1) | (y == ns-1))
+			putrow(lev[1] + (y>>1)*lsl[1], acc, sl, 2 - (~y & 1));
+	}
+	sndx[ns] = off;
+	if (nl < 2)
+		return;
+	for (l = 2; l < nl; l++)	/* reduce remaining levels */
+		for (y = 0; y < lns[l-1]; y++) {
+			colrs_color(frow, lev[l-1] + y*lsl[l-1], lsl[l-1]);
+			addrow(acc, frow, lsl[l-1]);
+			if ((y & 1) | (y == lns[l-1]-1))
+				putrow(lev[l] + (y>>1)*lsl[l], acc,
+						lsl[l-1], 2 - (~y & 1));
+		}
+	free(frow); free(acc); free(scan);
+					/* write tiles, saving offsets */
+	for (l = 1; l < nl; l++) {
+		const int	ntx = (lsl[l] + tsize-1)/tsize;
+		const int	nty = (lns[l] + tsize-1)/tsize;
+		tndx[l] = (long *)malloc(sizeof(long)*(ntx*nty+1));
+		if (tndx[l] == NULL)
+			quiterr("out of memory");
+		for (ty = 0; ty < nty; ty++)
+		    for (tx = 0; tx < ntx; tx++) {
+			int	tw = lsl[l] - tx*tsize;
+			int	th = lns[l] - ty*tsize;
+			if (tw > tsize) tw = tsize;
+			if (th > tsize) th = tsize;
+			tndx[l][ty*ntx + tx] = off;
+			for (y = ty*tsize; y < ty*tsize + th; y++)
+				putbytes(ebuf, encodecolrs(ebuf, lev[l] +
+						y*lsl[l] + tx*tsize, tw), &off);
+		    }
+		tndx[l][ntx*nty] = off;
+		free(lev[l]);
+	}
+					/* write index and its offset */
+	fputs(PYRMAGIC, stdout);
+	for (y = 0; y <= ns; y++)
+		putint(sndx[y], 8, stdout);
+	for (l = 1; l < nl; l++) {
+		const long	nt = (long)((lsl[l] + tsize-1)/tsize) *
+					((lns[l] + tsize-1)/tsize);
+		for (x = 0; x <= nt; x++)
+			putint(tndx[l][x], 8, stdout);
+		free(tndx[l]);
+	}
+	putint(off, 8, stdout);
+	free(sndx); free(ebuf);
+}
+
+
+static void
+frompyramid(void)		/* write plain picture from any level */
+{
+	PICMAP	*pm;
+	RESOLU	rs;
+	COLR	*scan;
+	int	sl, ns, y;
+
+	if ((pm = pm_load(stdin, headline, NULL)) == NULL)
+		quiterr("cannot load picture");
+	if (strcmp(fmt, COLRFMT) && strcmp(fmt, CIEFMT))
+		quiterr("input must be a RADIANCE picture");
+	if (nlevels >= pm->nlevels)
+		quiterr("no such reduced level in picture");
+	sl = nlevels ? pm->lev[nlevels].sl : pm->sl;
+	ns = nlevels ? pm->lev[nlevels].ns : pm->ns;
+	if (pm->nvalid < pm->ns)
+		fprintf(stderr, "%s: warning - picture is truncated\n",
+				progname);
+	rs.rt = pm->rs.rt;		/* same orientation */
+	if (rs.rt & YMAJOR) {
+		rs.xr = sl; rs.yr = ns;
+	} else {
+		rs.xr = ns; rs.yr = sl;
+	}
+	printargs(gargc, gargv, stdout);
+	fputformat(fmt, stdout);
+	putchar('\n');
+	fputsresolu(&rs, stdout);
+	if ((scan = (COLR *)malloc(sizeof(COLR)*sl)) == NULL)
+		quiterr("out of memory");
+	for (y = 0; y < ns; y++) {
+		if (pm_readlevel(pm, nlevels, scan, y) < 0)
+			break;
+		if (fwritecolrs(scan, sl, stdout) < 0)
+			quiterr("error writing picture");
+	}
+	free(scan);
+	pm_free(pm);
+}
@@ -3,11 +3,18 @@ static const char	RCSid[] = "$Id: data.c,v 2.33 2018/08/02 18:33:48 greg Exp $";
 #endif
 /*
  *  data.c - routines dealing with interpolated data.
+ *
+ *  If the RAYDCACHE variable names a directory, each data file and
+ *  picture is also saved there in binary form once it has been read,
+ *  and later loads map the saved arrays read-only, so they are shared
+ *  by every process using them.  A cache file is only used while the
+ *  device, inode, size and modification time of its source still match.
  */
 
 #include "copyright.h"
 
 #include  <time.h>
+#include  <sys/stat.h>
 
 #include  "platform.h"
 #include  "paths.h"
@@ -16,6 +23,9 @@ static const char	RCSid[] = "$Id: data.c,v 2.33 2018/08/02 18:33:48 greg Exp $";
 #include  "resolu.h"
 #include  "view.h"
 #include  "data.h"
+#if !defined(_WIN32) && !defined(_WIN64)
+#include  <sys/mman.h>
+#endif
 
 				/* picture memory usage before warning */
 #ifndef PSIZWARN
@@ -32,12 +42,260 @@ static const char	RCSid[] = "$Id: data.c,v 2.33 2018/08/02 18:33:48 greg Exp $";
 
 #define hash(s)		(shash(s)%TABSIZ)
 
+#ifndef DCACHEVAR
+#define DCACHEVAR	"RAYDCACHE"	/* cache directory variable */
+#endif
+#define DCMAGIC		"#?RDCACH"	/* cache file magic number */
+
+typedef struct {
+	char	magic[8];		/* DCMAGIC */
+	int	hsiz;			/* sizeof(DCHEAD), checks byte order */
+	short	type, nd;		/* DATATY or RED, dimensions */
+	long	sdev, sino;		/* source device and inode */
+	long	ssiz, smtime;		/* source size and modify time */
+	struct {
+		DATATYPE  org, siz;		/* coordinate domain */
+		int  ne;			/* number of elements */
+		int  np;			/* point locations stored? */
+	} dim[MAXDDIM];
+} DCHEAD;		/* data cache file header */
+
+#define dcelsiz(t)	((t)==DATATY ? sizeof(DATATYPE) : sizeof(COLR))
+
 
 static DATARRAY	 *dtab[TABSIZ];		/* data array list */
 
 static gethfunc headaspect;
 
 
+static char *
+dcachename(			/* get cache file name for source */
+	char  *fname
+)
+{
+	static char  cname[PATH_MAX];
+	char  *cdir = getenv(DCACHEVAR);
+	char  *cp;
+
+	if (cdir == NULL || !*cdir)
+		return(NULL);
+	for (cp = fname + strlen(fname); cp > fname && !ISDIRSEP(cp[-1]); cp--)
+		;
+	if (strlen(cdir) + strlen(cp) + 16 > sizeof(cname))
+		return(NULL);
+	sprintf(cname, "%s%c%s.%08x.rdc", cdir, DIRSEP, cp,
+			(unsigned)shash(fname));
+	return(cname);
+}
+
+
+static int
+dcstat(				/* get source file identity */
+	DCHEAD  *hp,
+	char  *fname
+)
+{
+	struct stat  st;
+
+	if (stat(fname, &st) < 0)
+		return(0);
+	hp->sdev = st.st_dev;
+	hp->sino = st.st_ino;
+	hp->ssiz = st.st_size;
+	hp->smtime = st.st_mtime;
+	return(1);
+}
+
+
+static size_t
+dclength(			/* compute cache file length */
+	DCHEAD  *hp
+)
+{
+	size_t  len = sizeof(DCHEAD);
+	size_t  asize = 1;
+	int  i;
+
+	for (i = 0; i < hp->nd; i++) {
+		if (hp->dim[i].np)
+			len += hp->dim[i].ne*sizeof(DATATYPE);
+		asize *= hp->dim[i].ne;
+	}
+	return(len + asize*dcelsiz(hp->type));
+}
+
+
+static DATARRAY *
+dcload(				/* map array from cache if it's current */
+	char  *name,
+	char  *fname,
+	int  type
+)
+{
+	char  *cname = dcachename(fname);
+	DCHEAD  sh, ch;
+	DATARRAY  *dp;
+	char  *base, *cp;
+	size_t  len;
+	int  fd, i;
+
+	if (cname == NULL || !dcstat(&sh, fname))
+		return(NULL);
+	if ((fd = open(cname, O_RDONLY)) < 0)
+		return(NULL);
+	SET_FD_BINARY(fd);
+	if (read(fd, (char *)&ch, sizeof(DCHEAD)) != sizeof(DCHEAD) ||
+			memcmp(ch.magic, DCMAGIC, 8) ||
+			ch.hsiz != sizeof(DCHEAD) || ch.type != type ||
+			(ch.nd < 1) | (ch.nd > MAXDDIM) ||
+			(ch.sdev != sh.sdev) | (ch.sino != sh.sino) ||
+			(ch.ssiz != sh.ssiz) | (ch.smtime != sh.smtime))
+		goto fail;
+	for (i = 0; i < ch.nd; i++)
+		if (ch.dim[i].ne < 1)
+			goto fail;
+	len = dclength(&ch);
+	if (lseek(fd, 0, SEEK_END) != (off_t)len)
+		goto fail;
+#if !defined(_WIN32) && !defined(_WIN64)
+	base = (char *)mmap(NULL, len, PROT_READ, MAP_SHARED, fd, 0);
+	if ((void *)base == MAP_FAILED)
+		goto fail;
+#else
+	if ((base = (char *)malloc(len)) == NULL)
+		goto fail;
+	if (lseek(fd, 0, SEEK_SET) < 0 || read(fd, base, len) != len) {
+		free(base);
+		goto fail;
+	}
+#endif
+	close(fd);
+	dp = (DATARRAY *)malloc((type==DATATY ? 1 : 3)*sizeof(DATARRAY));
+	if (dp == NULL)
+		error(SYSTEM, "out of memory in dcload");
+	dp->name = savestr(name);
+	dp->type = type;
+	dp->nd = ch.nd;
+	cp = base + sizeof(DCHEAD);
+	for (i = 0; i < ch.nd; i++) {
+		dp->dim[i].org = ch.dim[i].org;
+		dp->dim[i].siz = ch.dim[i].siz;
+		dp->dim[i].ne = ch.dim[i].ne;
+		if (ch.dim[i].np) {
+			dp->dim[i].p = (DATATYPE *)cp;
+			cp += ch.dim[i].ne*sizeof(DATATYPE);
+		} else
+			dp->dim[i].p = NULL;
+	}
+	if (type == DATATY)
+		dp->arr.d = (DATATYPE *)cp;
+	else
+		dp->arr.c = (COLR *)cp;
+	dp->mbase = base;
+	dp->mlen = len;
+	return(dp);
+fail:
+	close(fd);
+	return(NULL);
+}
+
+
+static int
+dcsave(				/* save loaded array to cache */
+	DATARRAY  *dp,
+	char  *fname
+)
+{
+	char  *cname = dcachename(fname);
+	char  tname[PATH_MAX+16];
+	DCHEAD  ch;
+	FILE  *fp;
+	size_t  asize = 1;
+	int  i;
+
+	if (cname == NULL)
+		return(0);
+	memset((void *)&ch, 0, sizeof(DCHEAD));
+	if (!dcstat(&ch, fname))
+		return(0);
+	memcpy(ch.magic, DCMAGIC, 8);
+	ch.hsiz = sizeof(DCHEAD);
+	ch.type = dp->type;
+	ch.nd = dp->nd;
+	for (i = 0; i < dp->nd; i++) {
+		ch.dim[i].org = dp->dim[i].org;
+		ch.dim[i].siz = dp->dim[i].siz;
+		ch.dim[i].ne = dp->dim[i].ne;
+		ch.dim[i].np = (dp->dim[i].p != NULL);
+		asize *= dp->dim[i].ne;
+	}
+	sprintf(tname, "%s.%d", cname, getpid());
+	if ((fp = fopen(tname, "wb")) == NULL)
+		goto writerr;
+	fwrite((void *)&ch, sizeof(DCHEAD), 1, fp);
+	for (i = 0; i < dp->nd; i++)
+		if (dp->dim[i].p != NULL)
+			fwrite((void *)dp->dim[i].p, sizeof(DATATYPE),
+					dp->dim[i].ne, fp);
+	if (dp->type == DATATY)
+		fwrite((void *)dp->arr.d, sizeof(DATATYPE), asize, fp);
+	else
+		fwrite((void *)dp->arr.c, sizeof(COLR), asize, fp);
+	if (ferror(fp) | (fclose(fp) == EOF) || rename(tname, cname) < 0) {
+		unlink(tname);
+		goto writerr;
+	}
+	return(1);
+writerr:
+	sprintf(errmsg, "cannot write data cache file \"%s\"", cname);
+	error(WARNING, errmsg);
+	return(0);
+}
+
+
+static void
+dfree(				/* free array and its record */
+	DATARRAY  *dp
+)
+{
+	int  i;
+
+	if (dp->mbase != NULL) {
+#if !defined(_WIN32) && !defined(_WIN64)
+		munmap(dp->mbase, dp->mlen);
+#else
+		free((void *)dp->mbase);
+#endif
+	} else {
+		if (dp->type == DATATY)
+			free((void *)dp->arr.d);
+		else
+			free((void *)dp->arr.c);
+		for (i = 0; i < dp->nd; i++)
+			if (dp->dim[i].p != NULL)
+				free((void *)dp->dim[i].p);
+	}
+	freestr(dp->name);
+	free((void *)dp);
+}
+
+
+static DATARRAY *
+dcshare(			/* swap loaded array for cache mapping */
+	DATARRAY  *dp,
+	char  *fname
+)
+{
+	DATARRAY  *mp;
+
+	if (!dcsave(dp, fname) ||
+			(mp = dcload(dp->name, fname, dp->type)) == NULL)
+		return(dp);
+	dfree(dp);
+	return(mp);
+}
+
+
 DATARRAY *
 getdata(				/* get data array dname */
 	char  *dname
@@ -76,6 +334,8 @@ getdata(				/* get data array dname */
 		sprintf(errmsg, "cannot find data file \"%s\"", dname);
 		error(SYSTEM, errmsg);
 	}
+	if ((dp = dcload(dname, dfname, DATATY)) != NULL)
+		goto link;
 	if ((fp = fopen(dfname, "r")) == NULL) {
 		sprintf(errmsg, "cannot open data file \"%s\"", dfname);
 		error(SYSTEM, errmsg);
@@ -92,6 +352,8 @@ getdata(				/* get data array dname */
 	dp->name = savestr(dname);
 	dp->type = DATATY;
 	dp->nd = asize;
+	dp->mbase = NULL;
+	dp->mlen = 0;
 	asize = 1;
 	for (i = 0; i < dp->nd; i++) {
 		if (fgetval(fp, DATATY, (char *)&dp->dim[i].org) <= 0)
@@ -129,6 +391,8 @@ getdata(				/* get data array dname */
 		if (fgetval(fp, DATATY, (char *)&dp->arr.d[i]) <= 0)
 			goto scanerr;
 	fclose(fp);
+	dp = dcshare(dp, dfname);
+link:
 	i = hash(dname);
 	dp->next = dtab[i];
 	return(dtab[i] = dp);
@@ -183,10 +447,15 @@ getpict(				/* get picture pname */
 		sprintf(errmsg, "cannot find picture file \"%s\"", pname);
 		error(SYSTEM, errmsg);
 	}
+	if ((pp = dcload(pname, pfname, RED)) != NULL)
+		goto link;
 	if ((pp = (DATARRAY *)malloc(3*sizeof(DATARRAY))) == NULL)
 		goto memerr;
 
 	pp[0].name = savestr(pname);
+	pp[0].type = RED;
+	pp[0].mbase = NULL;
+	pp[0].mlen = 0;
 
 	if ((fp = fopen(pfname, "r")) == NULL) {
 		sprintf(errmsg, "cannot open picture file \"%s\"", pfname);
@@ -240,6 +509,8 @@ getpict(				/* get picture pname */
 	}
 	free((void *)scanin);
 	fclose(fp);
+	pp = dcshare(pp, pfname);
+link:
 	i = hash(pname);
 	pp[0].next = dtab[i];		/* link into picture list */
 	pp[1] = pp[0];
@@ -266,7 +537,6 @@ freedata(			/* release data array reference */
 	DATARRAY  head;
 	int  hval, nents;
 	DATARRAY  *dpl, *dp;
-	int  i;
 
 	if (dta == NULL) {			/* free all if NULL */
 		hval = 0; nents = TABSIZ;
@@ -279,15 +549,7 @@ freedata(			/* release data array reference */
 		while ((dp = dpl->next) != NULL)
 			if ((dta == NULL) | (dta == dp)) {
 				dpl->next = dp->next;
-				if (dp->type == DATATY)
-					free((void *)dp->arr.d);
-				else
-					free((void *)dp->arr.c);
-				for (i = 0; i < dp->nd; i++)
-					if (dp->dim[i].p != NULL)
-						free((void *)dp->dim[i].p);
-				freestr(dp->name);
-				free((void *)dp);
+				dfree(dp);
 			} else
 				dpl = dp;
 		dtab[hval++] = head.next;
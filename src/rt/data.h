@@ -26,6 +26,8 @@ typedef struct datarray {
 		DATATYPE  *d;			/* float data */
 		COLR  *c;			/* RGB data */
 	}  arr;				/* the data */
+	char  *mbase;			/* cache mapping (or NULL) */
+	size_t  mlen;			/* length of cache mapping */
 	struct datarray  *next;		/* next array in list */
 } DATARRAY;			/* a data array */
 
@@ -96,6 +96,8 @@ typedef struct {
 
 #define	cvt_sdcolor(cv, svp)	ccy2rgb(&(svp)->spec, (svp)->cieY, cv)
 
+#define MAXBSAMP	32		/* BSDF samples evaluated together */
+
 /* Compute "through" component color for MAT_ABSDF */
 static void
 compute_through(BSDFDAT *ndp)
@@ -197,14 +199,14 @@ direct_specular_OK(COLOR cval, FVECT ldir, double omega, BSDFDAT *ndp)
 {
 	int	nsamp;
 	double	wtot = 0;
-	FVECT	vsrc, vsmp, vjit;
+	FVECT	vsrc, vsmp[MAXBSAMP], vjit[MAXBSAMP];
 	double	tomega, tomega2;
 	double	sf, tsr, sd[2];
 	COLOR	csmp, cdiff;
 	double	diffY;
-	SDValue	sv;
+	SDValue	sv[MAXBSAMP];
 	SDError	ec;
-	int	i;
+	int	i, j, n;
 					/* in case we fail */
 	setcolor(cval,  0, 0, 0);
 					/* transform source direction */
@@ -215,22 +217,22 @@ direct_specular_OK(COLOR cval, FVECT ldir, double omega, BSDFDAT *ndp)
 	case 3:
 		if (ndp->sd->rf == NULL)
 			return(0);	/* all diffuse */
-		sv = ndp->sd->rLambFront;
+		sv[0] = ndp->sd->rLambFront;
 		break;
 	case 0:
 		if (ndp->sd->rb == NULL)
 			return(0);	/* all diffuse */
-		sv = ndp->sd->rLambBack;
+		sv[0] = ndp->sd->rLambBack;
 		break;
 	default:
 		if ((ndp->sd->tf == NULL) & (ndp->sd->tb == NULL))
 			return(0);	/* all diffuse */
-		sv = ndp->sd->tLamb;
+		sv[0] = ndp->sd->tLamb;
 		break;
 	}
-	if (sv.cieY > FTINY) {
-		diffY = sv.cieY *= 1./PI;
-		cvt_sdcolor(cdiff, &sv);
+	if (sv[0].cieY > FTINY) {
+		diffY = sv[0].cieY *= 1./PI;
+		cvt_sdcolor(cdiff, &sv[0]);
 	} else {
 		diffY = 0;
 		setcolor(cdiff,  0, 0, 0);
@@ -263,35 +265,42 @@ direct_specular_OK(COLOR cval, FVECT ldir, double omega, BSDFDAT *ndp)
 	nsamp += !nsamp;
 	sf = sqrt(omega);		/* sample our source area */
 	tsr = sqrt(tomega);
-	for (i = nsamp; i--; ) {
-		VCOPY(vsmp, vsrc);	/* jitter query directions */
-		if (nsamp > 1) {
-			multisamp(sd, 2, (i + frandom())/(double)nsamp);
-			vsmp[0] += (sd[0] - .5)*sf;
-			vsmp[1] += (sd[1] - .5)*sf;
-			normalize(vsmp);
+	for (i = nsamp; i > 0; i -= n) {
+		n = (i < MAXBSAMP) ? i : MAXBSAMP;
+		for (j = 0; j < n; j++) {
+			VCOPY(vsmp[j], vsrc);	/* jitter query directions */
+			if (nsamp > 1) {
+				multisamp(sd, 2, (i-1-j + frandom())/(double)nsamp);
+				vsmp[j][0] += (sd[0] - .5)*sf;
+				vsmp[j][1] += (sd[1] - .5)*sf;
+				normalize(vsmp[j]);
+			}
+			bsdf_jitter(vjit[j], ndp, tsr);
 		}
-		bsdf_jitter(vjit, ndp, tsr);
-					/* compute BSDF */
-		ec = SDevalBSDF(&sv, vjit, vsmp, ndp->sd);
+					/* compute BSDFs together */
+		ec = SDevalBSDFs(sv, n, (const FVECT *)vjit,
+					(const FVECT *)vsmp, ndp->sd);
 		if (ec)
 			goto baderror;
-		if (sv.cieY - diffY <= FTINY)
-			continue;	/* no specular part */
+		for (j = 0; j < n; j++) {
+			if (sv[j].cieY - diffY <= FTINY)
+				continue;	/* no specular part */
 					/* check for variable resolution */
-		ec = SDsizeBSDF(&tomega2, vjit, vsmp, SDqueryMin, ndp->sd);
-		if (ec)
-			goto baderror;
-		if (tomega2 < .12*tomega)
-			continue;	/* not safe to include */
-		cvt_sdcolor(csmp, &sv);
-
-		if (sf < 2.5*tsr) {	/* weight by Y for small sources */
-			scalecolor(csmp, sv.cieY);
-			wtot += sv.cieY;
-		} else
-			wtot += 1.;
-		addcolor(cval, csmp);
+			ec = SDsizeBSDF(&tomega2, vjit[j], vsmp[j],
+						SDqueryMin, ndp->sd);
+			if (ec)
+				goto baderror;
+			if (tomega2 < .12*tomega)
+				continue;	/* not safe to include */
+			cvt_sdcolor(csmp, &sv[j]);
+
+			if (sf < 2.5*tsr) {	/* weight by Y for small sources */
+				scalecolor(csmp, sv[j].cieY);
+				wtot += sv[j].cieY;
+			} else
+				wtot += 1.;
+			addcolor(cval, csmp);
+		}
 	}
 	if (wtot <= FTINY)		/* no valid specular samples? */
 		return(0);
@@ -3,6 +3,12 @@ static const char RCSid[] = "$Id: o_face.c,v 2.7 2014/07/08 18:25:00 greg Exp $"
 #endif
 /*
  *  o_face.c - compute ray intersection with faces.
+ *
+ *  Triangles are intersected directly from their vertex arguments
+ *  using the method of Moller and Trumbore (JGT 1997), so no FACE
+ *  structure need be kept for them.  This saves the FACE record (about
+ *  64 bytes) for the most common polygon, and skips the general
+ *  in-polygon test.  The OBJREC and its vertex arguments remain.
  */
 
 #include "copyright.h"
@@ -12,6 +18,54 @@ static const char RCSid[] = "$Id: o_face.c,v 2.7 2014/07/08 18:25:00 greg Exp $"
 #include  "rtotypes.h"
 
 
+static int
+o_tri(		/* compute intersection with triangle */
+	OBJREC  *o,
+	RAY  *r
+)
+{
+	RREAL  *v0 = o->oargs.farg;
+	FVECT  e1, e2, nrm;	/* edges and (unnormalized) normal */
+	FVECT  pv, tv, qv;
+	double  nn, det, u, v, t;
+
+	VSUB(e1, v0+3, v0);
+	VSUB(e2, v0+6, v0);
+	VCROSS(nrm, e1, e2);
+	nn = DOT(nrm, nrm);
+	VCROSS(pv, r->rdir, e2);
+	det = DOT(e1, pv);			/* -DOT(r->rdir, nrm) */
+	if (det*det <= FTINY*FTINY*nn)		/* ray parallels plane */
+		return(0);			/* (or zero area) */
+	det = 1./det;
+	VSUB(tv, r->rorg, v0);
+	u = DOT(tv, pv) * det;
+	if ((u < 0.) | (u > 1.))
+		return(0);
+	VCROSS(qv, tv, e1);
+	v = DOT(r->rdir, qv) * det;
+	if ((v < 0.) | (u + v > 1.))
+		return(0);
+	t = DOT(e2, qv) * det;
+	if (t <= FTINY || t >= r->rot)		/* not good enough */
+		return(0);
+
+	nn = 1./sqrt(nn);
+	r->ro = o;
+	r->rot = t;
+	VSUM(r->rop, r->rorg, r->rdir, t);
+	r->ron[0] = nrm[0]*nn;
+	r->ron[1] = nrm[1]*nn;
+	r->ron[2] = nrm[2]*nn;
+	r->rod = -DOT(r->rdir, r->ron);
+	r->pert[0] = r->pert[1] = r->pert[2] = 0.0;
+	r->uv[0] = r->uv[1] = 0.0;
+	r->rox = NULL;
+
+	return(1);				/* hit */
+}
+
+
 int
 o_face(		/* compute intersection with polygonal face */
 	OBJREC  *o,
@@ -23,6 +77,9 @@ o_face(		/* compute intersection with polygonal face */
 	FVECT  pisect;		/* intersection point */
 	FACE  *f;	/* face record */
 
+	if (o->oargs.nfargs == 9)		/* triangle */
+		return(o_tri(o, r));
+
 	f = getface(o);
 		
 	/*
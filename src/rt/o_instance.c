@@ -12,6 +12,38 @@ static const char RCSid[] = "$Id: o_instance.c,v 2.9 2014/07/08 18:25:00 greg Ex
 #include  "rtotypes.h"
 
 
+static int
+cubereach(		/* does ray reach cube before tmax? */
+	RAY  *r,
+	CUBE  *cu,
+	double  tmax
+)
+{
+	double  t0 = 0., t1 = tmax;
+	double  ta, tb;
+	int  i;
+
+	for (i = 0; i < 3; i++) {
+		if (r->rdir[i] == 0.) {
+			if ((r->rorg[i] < cu->cuorg[i]) |
+					(r->rorg[i] > cu->cuorg[i] + cu->cusize))
+				return(0);
+			continue;
+		}
+		ta = (cu->cuorg[i] - r->rorg[i]) / r->rdir[i];
+		tb = (cu->cuorg[i] + cu->cusize - r->rorg[i]) / r->rdir[i];
+		if (ta > tb) {
+			double	t = ta; ta = tb; tb = t;
+		}
+		if (ta > t0) t0 = ta;
+		if (tb < t1) t1 = tb;
+		if (t0 > t1)
+			return(0);
+	}
+	return(1);
+}
+
+
 int
 o_instance(		/* compute ray intersection with octree */
 	OBJREC  *o,
@@ -22,8 +54,8 @@ o_instance(		/* compute ray intersection with octree */
 	double  d;
 	INSTANCE  *ins;
 	int  i;
-					/* get the octree */
-	ins = getinstance(o, IO_ALL);
+					/* get the octree bounds */
+	ins = getinstance(o, IO_BOUNDS);
 					/* copy and transform ray */
 	rcont = *r;
 	multp3(rcont.rorg, r->rorg, ins->x.b.xfm);
@@ -31,6 +63,11 @@ o_instance(		/* compute ray intersection with octree */
 	for (i = 0; i < 3; i++)
 		rcont.rdir[i] /= ins->x.b.sca;
 	rcont.rmax *= ins->x.b.sca;
+					/* load the rest if we get there */
+	if (!(ins->obj->ldflags & IO_TREE) && !cubereach(&rcont,
+			&ins->obj->scube, r->rot*ins->x.b.sca + FTINY))
+		return(0);
+	ins = getinstance(o, IO_ALL);
 					/* clear and trace it */
 	rayclear(&rcont);
 	if (!localhit(&rcont, &ins->obj->scube))
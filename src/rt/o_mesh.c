@@ -17,6 +17,10 @@ static const char RCSid[] = "$Id: o_mesh.c,v 2.14 2014/07/08 18:25:00 greg Exp $
  *  into the Radiance OBJREC list, but a mesh triangle index.  We still
  *  utilize the standard octree traversal code by setting the hitf
  *  function pointer in the RAY struct to our custom mesh_hit() call.
+ *
+ *  If the mesh was compiled with a compressed BVH, we traverse that
+ *  instead, nearest child first, and skip whatever lies beyond the
+ *  closest hit found so far.
  */
 
 #include  "copyright.h"
@@ -31,6 +35,8 @@ static const char RCSid[] = "$Id: o_mesh.c,v 2.14 2014/07/08 18:25:00 greg Exp $
 
 #define  EDGE_CACHE_SIZ		251	/* length of mesh edge cache */
 
+#define  BVH_STACK_SIZ		256	/* depth of BVH traversal stack */
+
 #define  curmi			(edge_cache.mi)
 #define  curmsh			(curmi->msh)
 
@@ -95,8 +101,9 @@ int32		v1, v2;
 
 
 static void
-mesh_hit(oset, r)		/* intersect ray with mesh triangle(s) */
-OBJECT	*oset;
+hit_tris(tl, n, r)		/* intersect ray with listed triangles */
+OBJECT	*tl;
+int	n;
 RAY	*r;
 {
 	int32		tvi[3];
@@ -107,10 +114,10 @@ RAY	*r;
 	double		d;
 	int		i;
 					/* check each triangle */
-	for (i = oset[0]; i > 0; i--) {
-		if (!getmeshtrivid(tvi, &tmod, curmsh, oset[i]))
+	for (i = n; i-- > 0; ) {
+		if (!getmeshtrivid(tvi, &tmod, curmsh, tl[i]))
 			objerror(edge_cache.o, INTERNAL,
-				"missing triangle vertices in mesh_hit");
+				"missing triangle vertices in hit_tris");
 		sv1 = volume_sign(r, tvi[0], tvi[1]);
 		sv2 = volume_sign(r, tvi[1], tvi[2]);
 		if (sv1 != sv2)			/* compare volume signs */
@@ -132,7 +139,7 @@ RAY	*r;
 		d = DOT(va, nrm) / d;
 		if (d <= FTINY || d >= r->rot)
 			continue;		/* not good enough */
-		r->robj = oset[i];		/* else record hit */
+		r->robj = tl[i];		/* else record hit */
 		r->ro = edge_cache.o;
 		r->rot = d;
 		VSUM(r->rop, r->rorg, r->rdir, d);
@@ -142,6 +149,96 @@ RAY	*r;
 }
 
 
+static void
+mesh_hit(oset, r)		/* intersect ray with mesh triangle(s) */
+OBJECT	*oset;
+RAY	*r;
+{
+	hit_tris(oset+1, oset[0], r);
+}
+
+
+static int
+bvh_hit(r)			/* trace ray through mesh BVH */
+RAY	*r;
+{
+	struct BVHEntry {
+		double	tnear;		/* distance to child bounds */
+		int32	kid;		/* child node or first leaf triangle */
+		int	ntri;		/* leaf triangles (0 for node) */
+	}		stk[BVH_STACK_SIZ], ent[MBVHWIDTH], te;
+	static double	qstep[33];
+	MESH		*msh = curmsh;
+	MBVHNODE	*np;
+	double		vres, base[3], step[3], rinv[3];
+	double		t0, t1, tn, tf;
+	int		neg[3];
+	int		sp, ne, i, j;
+
+	if (qstep[0] == 0.0)		/* quantization steps */
+		for (qstep[0] = 1.0, i = 1; i <= 32; i++)
+			qstep[i] = 2.0*qstep[i-1];
+	nrays++;			/* increment trace counter */
+	if (r->rmax > FTINY)		/* nothing past aft plane */
+		r->rot = r->rmax;
+	vres = (1./4294967296.)*msh->mcube.cusize;
+	for (i = 0; i < 3; i++) {	/* zero direction never crosses */
+		if (r->rdir[i] != 0.0)
+			rinv[i] = 1./r->rdir[i];
+		else
+			rinv[i] = 1e30;
+		neg[i] = (rinv[i] < 0.0);
+	}
+	stk[0].tnear = 0.0;		/* start from root */
+	stk[0].kid = 0;
+	stk[0].ntri = 0;
+	sp = 1;
+	while (sp > 0) {
+		te = stk[--sp];
+		if (te.tnear >= r->rot)	/* beyond closest hit */
+			continue;
+		if (te.ntri) {		/* leaf triangles */
+			hit_tris(msh->bvtri + te.kid, te.ntri, r);
+			continue;
+		}
+		np = msh->bvh + te.kid;	/* decode child bounds */
+		for (i = 0; i < 3; i++) {
+			base[i] = msh->mcube.cuorg[i] + np->org[i]*vres -
+					r->rorg[i];
+			step[i] = vres * qstep[np->qsh[i]];
+		}
+		ne = 0;
+		for (j = 0; j < np->nkids; j++) {
+			tn = 0.0; tf = r->rot;
+			for (i = 0; i < 3; i++) {
+				if (neg[i]) {
+					t0 = base[i] + np->qhi[j][i]*step[i];
+					t1 = base[i] + np->qlo[j][i]*step[i];
+				} else {
+					t0 = base[i] + np->qlo[j][i]*step[i];
+					t1 = base[i] + np->qhi[j][i]*step[i];
+				}
+				if ((t0 *= rinv[i]) > tn) tn = t0;
+				if ((t1 *= rinv[i]) < tf) tf = t1;
+			}
+			if (tn > tf)
+				continue;	/* missed child */
+			for (i = ne++; i > 0 && ent[i-1].tnear > tn; i--)
+				ent[i] = ent[i-1];
+			ent[i].tnear = tn;	/* sorted by distance */
+			ent[i].kid = np->kid[j];
+			ent[i].ntri = np->ntri[j];
+		}
+		if (sp + ne > BVH_STACK_SIZ)
+			objerror(edge_cache.o, INTERNAL,
+					"BVH stack overflow in bvh_hit");
+		while (ne-- > 0)	/* nearest on top */
+			stk[sp++] = ent[ne];
+	}
+	return(r->ro != NULL);
+}
+
+
 int
 o_mesh(			/* compute ray intersection with a mesh */
 	OBJREC		*o,
@@ -166,7 +263,10 @@ o_mesh(			/* compute ray intersection with a mesh */
 					/* clear and trace ray */
 	rayclear(&rcont);
 	rcont.hitf = mesh_hit;
-	if (!localhit(&rcont, &curmi->msh->mcube))
+	if (curmsh->bvh != NULL) {
+		if (!bvh_hit(&rcont))
+			return(0);		/* missed */
+	} else if (!localhit(&rcont, &curmi->msh->mcube))
 		return(0);			/* missed */
 	if (rcont.rot * curmi->x.f.sca >= r->rot)
 		return(0);			/* not close enough */
@@ -34,8 +34,9 @@ load_os(			/* load associated data for object */
 	SDretainSet = SDretainAll;
 
 	switch (op->otype) {
-	case OBJ_FACE:		/* polygon */
-		getface(op);
+	case OBJ_FACE:		/* polygon (triangles need none) */
+		if (op->oargs.nfargs != 9)
+			getface(op);
 		return(1);
 	case OBJ_CONE:		/* cone */
 	case OBJ_RING:		/* disk */
@@ -44,8 +45,8 @@ load_os(			/* load associated data for object */
 	case OBJ_TUBE:		/* inverted cylinder */
 		getcone(op, 1);
 		return(1);
-	case OBJ_INSTANCE:	/* octree instance */
-		getinstance(op, IO_ALL);
+	case OBJ_INSTANCE:	/* octree instance (loaded when reached) */
+		getinstance(op, IO_BOUNDS);
 		return(1);
 	case OBJ_MESH:		/* mesh instance */
 		getmeshinst(op, IO_ALL);
@@ -101,6 +101,7 @@ static const char	RCSid[] = "$Id: raycalls.c,v 2.23 2018/01/23 23:37:11 greg Exp
 #include  "data.h"
 #include  "font.h"
 #include  "pmapray.h"
+#include  "instance.h"
 
 char	*progname = "unknown_app";	/* caller sets to argv[0] */
 
@@ -191,6 +192,7 @@ ray_trace(			/* trace a primary ray */
 	RAY	*r
 )
 {
+	trimscenes();		/* unload old instances over limit */
 	rayorigin(r, PRIMARY, NULL, NULL);
 	samplendx++;
 	rayvalue(r);		/* assumes origin and direction are set */
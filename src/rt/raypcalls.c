@@ -142,6 +142,8 @@ static const char	RCSid[] = "$Id: raypcalls.c,v 2.29 2016/03/04 02:48:14 greg Ex
 #include  "rtprocess.h"
 #include  "ray.h"
 #include  "ambient.h"
+#include  "otypes.h"
+#include  "instance.h"
 #include  <sys/types.h>
 #include  <sys/wait.h>
 #include  "selcall.h"
@@ -446,6 +448,20 @@ ray_pchild(	/* process rays (never returns) */
 }
 
 
+static void
+ray_pinstances(void)		/* load all instance contents to share */
+{
+	OBJECT	on;
+	OBJREC	*op;
+				/* children return object pointers, */
+				/* which must be valid in the parent */
+	for (on = 0; on < nobjects; on++)
+		if ((op = objptr(on))->otype == OBJ_INSTANCE)
+			getinstance(op, IO_ALL);
+	instmemlim = 0;		/* and must stay put */
+}
+
+
 void
 ray_popen(			/* open the specified # processes */
 	int	nadd
@@ -459,6 +475,7 @@ ray_popen(			/* open the specified # processes */
 	ambsync();			/* load any new ambient values */
 	if (shm_boundary == NULL) {	/* first child process? */
 		preload_objs();		/* preload auxiliary data */
+		ray_pinstances();
 					/* set shared memory boundary */
 		shm_boundary = (char *)malloc(16);
 		strcpy(shm_boundary, "SHM_BOUNDARY");
@@ -249,15 +249,31 @@ openerr:
 }
 
 
-/* Get a vector from stdin */
+RAYQ	*rayq = NULL;			/* shared ray queue (or NULL) */
+
+
+/* Get a vector from stdin (or our ray queue) */
 int
 getvec(FVECT vec)
 {
+	static RQREC	*rr = NULL;
 	float	vf[3];
 	double	vd[3];
 	char	buf[32];
 	int	i;
 
+	if (rayq != NULL) {			/* origin, then direction */
+		if (rr == NULL) {
+			if ((rr = rq_request(rayq, 1)) == NULL)
+				return(-1);
+			VCOPY(vec, rr->org);
+		} else {
+			VCOPY(vec, rr->dir);
+			rq_putres(rayq, NULL, 0.0);	/* done with request */
+			rr = NULL;
+		}
+		return(0);
+	}
 	switch (inpfmt) {
 	case 'a':					/* ascii */
 		for (i = 0; i < 3; i++) {
@@ -333,13 +349,189 @@ put_contrib(const DCOLOR cnt, FILE *fout)
 }
 
 
+/************************** CHUNKED MATRIX OUTPUT **************************/
+
+#define MATCHUNK	(1L<<22)	/* target bytes per matrix chunk */
+
+static FILE	*mat_fp = NULL;		/* open matrix file */
+static char	*mat_buf = NULL;	/* current chunk */
+static int	mat_vsiz;		/* bytes per value */
+static int	mat_ncols;		/* values per record */
+static int	mat_nrows;		/* records per chunk */
+static int	mat_row = 0;		/* records in current chunk */
+static int	mat_col = 0;		/* next column in record */
+
+
+/* Open matrix file and write header with column index */
+static void
+mat_open(void)
+{
+	char	*info, *cp;
+	MODCONT	*mp;
+	int	i, col;
+
+	switch (outfmt) {
+	case 'f':
+		mat_vsiz = sizeof(float)*3;
+		break;
+	case 'd':
+		mat_vsiz = sizeof(double)*3;
+		break;
+	case 'c':
+		mat_vsiz = sizeof(COLR);
+		break;
+	default:
+		error(USER, "matrix output must be binary");
+	}
+	mat_ncols = 0;
+	for (i = 0; i < nmods; i++)
+		mat_ncols += ((MODCONT *)lu_find(&modconttab,modname[i])->data)->nbins;
+	mat_nrows = MATCHUNK/((long)mat_ncols*mat_vsiz);
+	if (mat_nrows < 1)
+		mat_nrows = 1;
+	mat_buf = (char *)malloc((size_t)mat_nrows*mat_ncols*mat_vsiz);
+	info = (char *)malloc(nmods*(MAXSTR+24) + 64);
+	if ((mat_buf == NULL) | (info == NULL))
+		error(SYSTEM, "out of memory in mat_open");
+	if ((mat_fp = fopen(matfile, "wb")) == NULL) {
+		sprintf(errmsg, "cannot open '%s' for writing", matfile);
+		error(SYSTEM, errmsg);
+	}
+	cp = info;
+	if (yres > 0) {
+		sprintf(cp, "NROWS=%d\n", yres*(xres + !xres));
+		while (*cp) ++cp;
+	}
+	sprintf(cp, "NCOLS=%d\nCHUNKROWS=%d\n", mat_ncols, mat_nrows);
+	while (*cp) ++cp;
+	for (i = col = 0; i < nmods; i++) {	/* index of columns */
+		mp = (MODCONT *)lu_find(&modconttab,modname[i])->data;
+		sprintf(cp, "MODCOLS=%d %d %.*s\n", col, mp->nbins,
+				MAXSTR, mp->modname);
+		while (*cp) ++cp;
+		col += mp->nbins;
+	}
+	if (header)
+		printheader(mat_fp, info);
+	free(info);
+	if (fflush(mat_fp) == EOF)
+		goto writerr;
+	setvbuf(mat_fp, NULL, _IONBF, 0);	/* we write whole chunks */
+	return;
+writerr:
+	sprintf(errmsg, "write error on file '%s'", matfile);
+	error(SYSTEM, errmsg);
+}
+
+
+/* Write out current chunk, compacting it first if partial */
+static void
+mat_putchunk(void)
+{
+	MODCONT	*mp;
+	long	col;
+	int	i;
+
+	if (!mat_row)
+		return;
+	if (mat_row < mat_nrows)
+		for (i = col = 0; i < nmods; i++) {
+			mp = (MODCONT *)lu_find(&modconttab,modname[i])->data;
+			memmove(mat_buf + col*mat_row*mat_vsiz,
+					mat_buf + col*mat_nrows*mat_vsiz,
+					(size_t)mp->nbins*mat_row*mat_vsiz);
+			col += mp->nbins;
+		}
+	if (fwrite(mat_buf, mat_vsiz, (size_t)mat_row*mat_ncols, mat_fp) !=
+			(size_t)mat_row*mat_ncols) {
+		sprintf(errmsg, "write error on file '%s'", matfile);
+		error(SYSTEM, errmsg);
+	}
+	mat_row = 0;
+}
+
+
+/* Put modifier bins into its block of current chunk */
+static void
+mat_output(MODCONT *mp)
+{
+	const double	sf = (accumulate > 1) ? 1./(double)accumulate : 1.;
+	char		*cp;
+	float		*fp;
+	double		*dp;
+	int		j;
+
+	if (mat_fp == NULL)
+		mat_open();
+	cp = mat_buf + ((long)mat_col*mat_nrows + (long)mat_row*mp->nbins) *
+					mat_vsiz;
+	for (j = 0; j < mp->nbins; j++, cp += mat_vsiz)
+		switch (outfmt) {
+		case 'f':
+			fp = (float *)cp;
+			fp[0] = sf*mp->cbin[j][0];
+			fp[1] = sf*mp->cbin[j][1];
+			fp[2] = sf*mp->cbin[j][2];
+			break;
+		case 'd':
+			dp = (double *)cp;
+			dp[0] = sf*mp->cbin[j][0];
+			dp[1] = sf*mp->cbin[j][1];
+			dp[2] = sf*mp->cbin[j][2];
+			break;
+		case 'c':
+			setcolr((uby8 *)cp, sf*mp->cbin[j][0],
+					sf*mp->cbin[j][1], sf*mp->cbin[j][2]);
+			break;
+		}
+	mat_col += mp->nbins;
+}
+
+
+/* End matrix record, writing chunk if full */
+static void
+mat_endrec(void)
+{
+	mat_col = 0;
+	if (++mat_row >= mat_nrows)
+		mat_putchunk();
+}
+
+
+/* Finish and close all outputs */
+void
+end_output(void)
+{
+	end_writer();				/* wait for output process */
+	if (mat_fp != NULL) {
+		mat_putchunk();
+		if (fclose(mat_fp) == EOF) {
+			sprintf(errmsg, "error closing '%s'", matfile);
+			error(SYSTEM, errmsg);
+		}
+		mat_fp = NULL;
+		free(mat_buf);
+		mat_buf = NULL;
+	}
+	lu_done(&ofiletab);
+}
+
+/************************** RECORD OUTPUT ***************************/
+
 /* Output modifier values to appropriate stream(s) */
 void
 mod_output(MODCONT *mp)
 {
-	STREAMOUT	*sop = getostream(mp->outspec, mp->modname, mp->bin0, 0);
+	STREAMOUT	*sop;
 	int		j;
 
+	if (wr_modout(mp))		/* output process has it? */
+		return;
+	if (matfile != NULL) {
+		mat_output(mp);
+		return;
+	}
+	sop = getostream(mp->outspec, mp->modname, mp->bin0, 0);
 	put_contrib(mp->cbin[0], sop->ofp);
 	if (mp->nbins > 3 &&	/* minor optimization */
 			sop == getostream(mp->outspec, mp->modname, mp->bin0+1, 0)) {
@@ -377,9 +569,15 @@ void
 end_record()
 {
 	--waitflush;
-	lu_doall(&ofiletab, &puteol, NULL);
-	if (using_stdout & (outfmt == 'a'))
-		putc('\n', stdout);
+	if (wr_endrec(!waitflush))
+		;			/* sent to output process */
+	else if (matfile != NULL)
+		mat_endrec();
+	else {
+		lu_doall(&ofiletab, &puteol, NULL);
+		if (using_stdout & (outfmt == 'a'))
+			putc('\n', stdout);
+	}
 	if (!waitflush) {
 		waitflush = (yres > 0) & (xres > 1) ? 0 : xres;
 		if (using_stdout)
@@ -7,6 +7,9 @@ static const char RCSid[] = "$Id: rc3.c,v 2.23 2018/05/27 18:35:57 greg Exp $";
  */
 
 #include <signal.h>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/wait.h>
+#endif
 #include "rcontrib.h"
 #include "selcall.h"
 
@@ -287,6 +290,8 @@ in_rchild()
 				fclose(kida[nchild].infp);
 			}
 			inpfmt = (sizeof(RREAL)==sizeof(double)) ? 'd' : 'f';
+			rayq = NULL;	/* parent reads the queue */
+			matfile = NULL;
 			outfmt = 'd';
 			header = 0;
 			yres = 0;
@@ -336,6 +341,172 @@ end_children(int immed)
 }
 
 
+/* Our output process takes batches of records to format and write */
+
+#define WRBATCH		(1L<<18)	/* target bytes per batch */
+
+static int	wr_fd = -1;		/* pipe to output process */
+static int	wr_pid;			/* its process id */
+static char	*wr_buf = NULL;		/* batch being filled */
+static long	wr_recsiz;		/* bytes per record */
+static int	wr_maxrec;		/* records per batch */
+static int	wr_nrec = 0;		/* records in batch */
+static char	*wr_pos;		/* next bin position */
+
+#define wr_head		((int *)wr_buf)	/* record count & flush flag */
+#define WRHEADSIZ	(sizeof(int)*2)
+
+
+/* callback to forget stream now owned by output process */
+static int
+drop_stream(const LUENT *e, void *p)
+{
+	((STREAMOUT *)e->data)->ofp = NULL;
+	return(0);
+}
+
+
+/* Format and write records sent by parent (output process) */
+static void
+writer_loop(int fd)
+{
+	MODCONT	**mca = (MODCONT **)malloc(sizeof(MODCONT *)*nmods);
+	char	*cp;
+	long	n;
+	int	r, i;
+
+	if (mca == NULL)
+		error(SYSTEM, "out of memory in writer_loop()");
+	for (i = nmods; i--; )
+		mca[i] = (MODCONT *)lu_find(&modconttab,modname[i])->data;
+	while (readbuf(fd, wr_buf, WRHEADSIZ) == WRHEADSIZ) {
+		n = wr_head[0]*wr_recsiz;
+		if (readbuf(fd, wr_buf+WRHEADSIZ, n) != n)
+			error(USER, "lost parent of output process");
+		cp = wr_buf + WRHEADSIZ;
+		for (r = 0; r < wr_head[0]; r++) {
+			for (i = 0; i < nmods; i++) {
+				n = sizeof(DCOLOR)*mca[i]->nbins;
+				memcpy(mca[i]->cbin, cp, n);
+				cp += n;
+				mod_output(mca[i]);
+			}
+			waitflush = 2 - (wr_head[1] & (r == wr_head[0]-1));
+			end_record();
+		}
+	}
+	end_output();
+	if (fflush(stdout) == EOF)
+		error(SYSTEM, "write error on standard output");
+	_exit(0);		/* leave our parent's stdin alone */
+}
+
+
+/* Start output process (parent only, after children and recovery) */
+void
+start_writer(void)
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	int	pfd[2];
+	int	i;
+
+	wr_recsiz = 0;
+	for (i = nmods; i--; )
+		wr_recsiz += sizeof(DCOLOR) *
+			((MODCONT *)lu_find(&modconttab,modname[i])->data)->nbins;
+	wr_maxrec = WRBATCH/wr_recsiz;
+	if (wr_maxrec < 1)
+		wr_maxrec = 1;
+	wr_buf = (char *)malloc(WRHEADSIZ + wr_maxrec*wr_recsiz);
+	if (wr_buf == NULL)
+		error(SYSTEM, "out of memory in start_writer()");
+	if (pipe(pfd) < 0)
+		error(SYSTEM, "cannot create pipe to output process");
+	fflush(NULL);
+	if ((wr_pid = fork()) < 0)
+		error(SYSTEM, "cannot fork output process");
+	if (!wr_pid) {			/* in output process */
+		close(pfd[1]);
+		while (nchild-- > 0) {	/* release children */
+			close(kidpr[nchild].w);
+			fclose(kida[nchild].infp);
+		}
+		nchild = 0;
+		rayq = NULL;
+		writer_loop(pfd[0]);	/* doesn't return */
+	}
+	close(pfd[0]);
+	wr_fd = pfd[1];
+	wr_pos = wr_buf + WRHEADSIZ;
+	lu_doall(&ofiletab, &drop_stream, NULL);
+	lu_done(&ofiletab);		/* output process has these */
+#endif
+}
+
+
+/* Send current batch to output process */
+static void
+wr_send(int flush)
+{
+	long	n = WRHEADSIZ + wr_nrec*wr_recsiz;
+
+	wr_head[0] = wr_nrec;
+	wr_head[1] = flush;
+	if (writebuf(wr_fd, wr_buf, n) != n)
+		error(SYSTEM, "write error to output process");
+	wr_nrec = 0;
+	wr_pos = wr_buf + WRHEADSIZ;
+}
+
+
+/* Copy modifier bins into batch for output process if we have one */
+int
+wr_modout(MODCONT *mp)
+{
+	if (wr_fd < 0)
+		return(0);
+	memcpy(wr_pos, mp->cbin, sizeof(DCOLOR)*mp->nbins);
+	wr_pos += sizeof(DCOLOR)*mp->nbins;
+	return(1);
+}
+
+
+/* End record in batch, sending if full or flushing */
+int
+wr_endrec(int flush)
+{
+	if (wr_fd < 0)
+		return(0);
+	if ((++wr_nrec >= wr_maxrec) | flush)
+		wr_send(flush);
+	return(1);
+}
+
+
+/* Send last records and wait for output process to finish */
+void
+end_writer(void)
+{
+#if !defined(_WIN32) && !defined(_WIN64)
+	int	status;
+
+	if (wr_fd < 0)
+		return;
+	if (wr_nrec)
+		wr_send(0);
+	close(wr_fd);
+	wr_fd = -1;
+	if (waitpid(wr_pid, &status, 0) != wr_pid || status) {
+		sprintf(errmsg, "output process returned bad status (%d)",
+				status);
+		error(USER, errmsg);
+	}
+	free(wr_buf);
+	wr_buf = NULL;
+#endif
+}
+
+
 /* Wait for the next available child, managing output queue simultaneously */
 static int
 next_child_nq(int flushing)
@@ -455,7 +626,7 @@ parental_loop()
 		out_bq = NULL;
 	}
 	free_binq(NULL);			/* clean up */
-	lu_done(&ofiletab);
+	end_output();
 	if (raysleft)
 		error(USER, "unexpected EOF on input");
 }
@@ -555,7 +726,7 @@ feeder_loop()
 	free_binq(out_bq);			/* clean up */
 	out_bq = NULL;
 	free_binq(NULL);
-	lu_done(&ofiletab);
+	end_output();
 	if (raysleft)
 		error(USER, "unexpected EOF on input");
 }
@@ -39,6 +39,7 @@ int	xres = 0;			/* horizontal (scan) size */
 int	yres = 0;			/* vertical resolution */
 
 int	using_stdout = 0;		/* are we using stdout? */
+char	*matfile = NULL;		/* chunked matrix output file */
 
 int	imm_irrad = 0;			/* compute immediate irradiance? */
 int	lim_dist = 0;			/* limit distance? */
@@ -264,6 +265,18 @@ main(int argc, char *argv[])
 			check(2,"s");
 			curout = argv[++i];
 			break;
+		case 'O':			/* chunked matrix output */
+			check(2,"s");
+			matfile = argv[++i];
+			break;
+		case 'q':			/* shared ray queue */
+			check(2,"s");
+			if ((rayq = rq_attach(argv[++i])) == NULL) {
+				sprintf(errmsg, "cannot attach ray queue \"%s\"",
+						argv[i]);
+				error(SYSTEM, errmsg);
+			}
+			break;
 		case 'c':			/* input rays per output */
 			check(2,"i");
 			accumulate = atoi(argv[++i]);
@@ -301,6 +314,19 @@ main(int argc, char *argv[])
 	}
 	if (nmods <= 0)
 		error(USER, "missing required modifier argument");
+	if (matfile != NULL) {		/* check matrix output */
+		if (curout != NULL)
+			error(USER, "-O and -o options are exclusive");
+		if (outfmt == 'a')
+			error(USER, "matrix output must be binary");
+		if (recover)
+			error(USER, "cannot recover matrix output");
+		if (!force_open && access(matfile, F_OK) == 0) {
+			errno = EEXIST;
+			sprintf(errmsg, "cannot open '%s' for writing", matfile);
+			error(SYSTEM, errmsg);
+		}
+	}
 					/* override some option settings */
 	override_options();
 					/* initialize object types */
@@ -366,7 +392,7 @@ main(int argc, char *argv[])
 
 badopt:
 	fprintf(stderr,
-"Usage: %s [-n nprocs][-V][-c count][-r][-e expr][-f source][-o ospec][-p p1=V1,p2=V2][-b binv][-bn N] {-m mod | -M file} [rtrace options] octree\n",
+"Usage: %s [-n nprocs][-V][-c count][-r][-e expr][-f source][-o ospec|-O matfile][-q qfile][-p p1=V1,p2=V2][-b binv][-bn N] {-m mod | -M file} [rtrace options] octree\n",
 			progname);
 	sprintf(errmsg, "command line error at '%s'", argv[i]);
 	error(USER, errmsg);
@@ -11,6 +11,7 @@ static const char RCSid[] = "$Id: rcontrib.c,v 2.33 2018/06/13 21:32:15 greg Exp
 #include "rcontrib.h"
 #include "otypes.h"
 #include "source.h"
+#include "instance.h"
 
 char	*shm_boundary = NULL;		/* boundary of shared memory */
 
@@ -225,8 +226,10 @@ rcinit(void)
 					/* else run appropriate controller */
 	if (accumulate <= 0)
 		feeder_loop();
-	else
+	else {
+		start_writer();		/* format & write in another process */
 		parental_loop();
+	}
 	quit(0);			/* parent musn't return! */
 }
 
@@ -279,6 +282,7 @@ eval_irrad(FVECT org, FVECT dir)
 	thisray.rdir[1] = -dir[1];
 	thisray.rdir[2] = -dir[2];
 	thisray.rmax = 0.0;
+	trimscenes();
 	rayorigin(&thisray, PRIMARY, NULL, NULL);
 					/* pretend we hit surface */
 	thisray.rt = thisray.rot = 1e-5;
@@ -299,6 +303,7 @@ eval_rad(FVECT org, FVECT dir, double dmax)
 	VCOPY(thisray.rorg, org);
 	VCOPY(thisray.rdir, dir);
 	thisray.rmax = dmax;
+	trimscenes();
 	rayorigin(&thisray, PRIMARY, NULL, NULL);
 	samplendx++;			/* call ray evaluation */
 	rayvalue(&thisray);
@@ -373,7 +378,7 @@ rcontrib(void)
 		account = 1;		/* output accumulated totals */
 		done_contrib();
 	}
-	lu_done(&ofiletab);		/* close output files */
+	end_output();			/* close output files */
 	if (raysleft)
 		error(USER, "unexpected EOF on input");
 }
@@ -10,6 +10,7 @@
 #include "ray.h"
 #include "func.h"
 #include "lookup.h"
+#include "rayqueue.h"
 
 extern int		gargc;		/* global argc */
 extern char		**gargv;	/* global argv */
@@ -31,6 +32,7 @@ extern int		xres;		/* horizontal (scan) size */
 extern int		yres;		/* vertical resolution */
 
 extern int		using_stdout;	/* are we using stdout? */
+extern char		*matfile;	/* chunked matrix output file */
 
 extern int		imm_irrad;	/* compute immediate irradiance? */
 extern int		lim_dist;	/* limit distance? */
@@ -105,6 +107,7 @@ extern STREAMOUT *	getostream(const char *ospec, const char *mname,
 
 extern void		mod_output(MODCONT *mp);
 extern void		end_record(void);
+extern void		end_output(void);
 
 extern MODCONT		*addmodifier(char *modn, char *outf,
 					char *prms, char *binv, int bincnt);
@@ -114,6 +117,8 @@ extern void		addmodfile(char *fname, char *outf,
 extern void		reload_output(void);
 extern void		recover_output(void);
 
+extern RAYQ		*rayq;			/* shared ray queue (or NULL) */
+
 extern int		getvec(FVECT vec);
 
 extern int		in_rchild(void);
@@ -121,6 +126,11 @@ extern void		end_children(int immed);
 
 extern void		put_zero_record(int ndx);
 
+extern void		start_writer(void);	/* output process */
+extern int		wr_modout(MODCONT *mp);
+extern int		wr_endrec(int flush);
+extern void		end_writer(void);
+
 extern void		parental_loop(void);	/* controlling process */
 
 extern void		feeder_loop(void);	/* feeder process */
@@ -12,6 +12,7 @@ static const char	RCSid[] = "$Id: renderopts.c,v 2.18 2016/03/21 19:06:08 greg E
 #include  "ray.h"
 #include  "paths.h"
 #include  "pmapopt.h"
+#include  "instance.h"
 
 
 int
@@ -99,6 +100,10 @@ getrenderopt(		/* get next render option */
 			check(3,"f");
 			minweight = atof(av[1]);
 			return(1);
+		case 'm':				/* instance memory */
+			check(3,"f");
+			instmemlim = atof(av[1])*(1L<<20);
+			return(1);
 		}
 		break;
 	case 'i':				/* irradiance */
@@ -258,6 +263,8 @@ print_rdefaults(void)		/* print default render values to stdout */
 	printf("-lr %-9d\t\t\t# limit reflection%s\n", maxdepth,
 			maxdepth<=0 ? " (Russian roulette)" : "");
 	printf("-lw %.2e\t\t\t# limit weight\n", minweight);
+	printf("-lm %-9g\t\t\t# limit instance memory (MB)%s\n",
+			instmemlim*(1./(1L<<20)), instmemlim<=0 ? " (none)" : "");
 	
 	/* PMAP: output photon map defaults */
 	printPmapDefaults();
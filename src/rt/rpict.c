@@ -36,6 +36,8 @@ static const char RCSid[] = "$Id: rpict.c,v 2.90 2015/04/22 20:28:16 rschregle E
 #include  "hilbert.h"
 #include  "pmapbias.h"
 #include  "pmapdiag.h"
+#include  "bsdf.h"
+#include  "instance.h"
 
 #define	 RFTEMPLATE	"rfXXXXXX"
 
@@ -120,7 +122,7 @@ int  hres, vres;			/* resolution for this frame */
 static VIEW	lastview;		/* the previous view input */
 
 static void report(int);
-static int nextview(FILE *fp);
+static int nextview(FILE *fp, int *sp);
 static void render(char *zfile, char *oldfile);
 static void fillscanline(COLOR *scanline, float *zline, char *sd, int xres,
 		int y, int xstep);
@@ -133,23 +135,6 @@ static int salvage(char  *oldfile);
 static int pixnumber(int  x, int  y, int  xres, int  yres);
 
 
-
-#ifdef RHAS_STAT
-#include  <sys/types.h>
-#include  <sys/stat.h>
-int
-file_exists(fname)				/* ordinary file exists? */
-char  *fname;
-{
-	struct stat  sbuf;
-	if (stat(fname, &sbuf) < 0) return(0);
-	return((sbuf.st_mode & S_IFREG) != 0);
-}
-#else
-#define  file_exists(f)	(access(f,F_OK)==0)
-#endif
-
-
 void
 quit(code)			/* quit program */
 int  code;
@@ -164,6 +149,34 @@ int  code;
 }
 
 
+static void
+report_cdcache(void)		/* report BSDF sampling cache use */
+{
+	SDCDstats	cs;
+
+	SDgetCDstats(&cs);
+	if (cs.nhits + cs.nmiss == 0)
+		return;
+	sprintf(errmsg,
+		"BSDF distribution cache: %u entries, %.1f MB, %.1f%% hits\n",
+			cs.nent, cs.nbytes*(1./(1L<<20)),
+			100.*cs.nhits/(double)(cs.nhits + cs.nmiss));
+	eputs(errmsg);
+}
+
+
+static void
+report_instances(void)		/* report instance loading */
+{
+	if (!instloads)
+		return;
+	sprintf(errmsg,
+		"instance octrees: %lu loads, %lu unloads, %.1f MB in memory\n",
+			instloads, instunloads, instmem*(1./(1L<<20)));
+	eputs(errmsg);
+}
+
+
 #ifndef NON_POSIX
 static void
 report(int dummy)		/* report progress */
@@ -202,6 +215,8 @@ report(int dummy)		/* report progress */
 			nrays, bcStat, pctdone, u*(1./3600.), s*(1./3600.),
 			(tlastrept-tstart)*(1./3600.), myhostname(), getpid());
 	eputs(errmsg);
+	report_cdcache();
+	report_instances();
 #ifdef SIGCONT
 	signal(SIGCONT, report);
 #endif
@@ -220,6 +235,8 @@ report(int dummy)		/* report progress */
 	sprintf(errmsg, "%lu rays, %s%4.2f%% after %5.4f hours\n",
 			nrays, bcStat, pctdone, (tlastrept-tstart)/3600.0);
 	eputs(errmsg);
+	report_cdcache();
+	report_instances();
 }
 #endif
 
@@ -267,7 +284,7 @@ rpict(			/* generate image(s) */
 		if (pout == NULL)
 			error(USER, "missing output file specification");
 		for ( ; seq < rn; seq++)
-			if (nextview(stdin) == EOF)
+			if (nextview(stdin, NULL) == EOF)
 				error(USER, "unexpected EOF on view input");
 		setview(&ourview);
 		prvr = fbuf;			/* mark for renaming */
@@ -300,12 +317,20 @@ rpict(			/* generate image(s) */
 	}
 	npicts = 0;			/* render sequence */
 	do {
-		if (seq && nextview(stdin) == EOF)
+		if (seq && nextview(stdin, &seq) == EOF)
 			break;
 		pctdone = 0.0;
 		if (pout != NULL) {
+			int	fd;
 			sprintf(fbuf, pout, seq);
-			if (file_exists(fbuf)) {
+					/* claim frame (others may share) */
+			if ((fd = open(fbuf, O_WRONLY|O_CREAT|O_EXCL, 0666)) >= 0)
+				close(fd);
+			else if (errno != EEXIST) {
+				sprintf(errmsg,
+					"cannot create output file \"%s\"", fbuf);
+				error(SYSTEM, errmsg);
+			} else {
 				if (prvr != NULL || !strcmp(fbuf, pout)) {
 					sprintf(errmsg,
 						"output file \"%s\" exists",
@@ -371,15 +396,20 @@ rpict(			/* generate image(s) */
 
 static int
 nextview(				/* get next view from fp */
-	FILE  *fp
+	FILE  *fp,
+	int  *sp
 )
 {
 	char  linebuf[256];
+	int  fn;
 
 	lastview = ourview;
 	while (fgets(linebuf, sizeof(linebuf), fp) != NULL)
 		if (isview(linebuf) && sscanview(&ourview, linebuf) > 0)
 			return(0);
+		else if (sp != NULL && !strncmp(linebuf, "FRAME=", 6) &&
+				(fn = atoi(linebuf+6)) > 0)
+			*sp = fn;		/* explicit frame number */
 	return(EOF);
 }	
 
@@ -740,6 +770,8 @@ pixvalue(		/* compute pixel value */
 			return(0.0);
 	}
 
+	trimscenes();				/* unload old instances */
+
 	rayorigin(&thisray, PRIMARY, NULL, NULL);
 
 	rayvalue(&thisray);			/* trace ray */
@@ -46,6 +46,8 @@ int  vresolu = 0;			/* vertical resolution */
 int  imm_irrad = 0;			/* compute immediate irradiance? */
 int  lim_dist = 0;			/* limit distance? */
 
+char  *rqfname = NULL;			/* shared ray queue file */
+
 #ifndef	MAXMODLIST
 #define	MAXMODLIST	1024		/* maximum modifiers we'll track */
 #endif
@@ -182,6 +184,10 @@ main(int  argc, char  *argv[])
 		case 'o':				/* output */
 			outvals = argv[i]+2;
 			break;
+		case 'q':				/* shared ray queue */
+			check(2,"s");
+			rqfname = argv[++i];
+			break;
 		case 'h':				/* header output */
 			rval = loadflags & IO_INFO;
 			check_bool(2,rval);
@@ -303,6 +309,11 @@ main(int  argc, char  *argv[])
 			goto badopt;
 		}
 	}
+	if (rqfname != NULL) {
+		if (persist)
+			error(USER, "ray queue incompatible with persist file");
+		loadflags &= ~IO_INFO;	/* results go to queue, not stdout */
+	}
 	if (nproc > 1) {
 		if (persist)
 			error(USER, "multiprocessing incompatible with persist file");
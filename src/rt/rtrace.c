@@ -19,6 +19,9 @@ static const char	RCSid[] = "$Id: rtrace.c,v 2.71 2018/02/13 20:27:19 greg Exp $
  *  with '-ff' for float or '-fd' for double.  By default,
  *  radiance is computed.  The '-i' or '-I' options indicate that
  *  irradiance values are desired.
+ *
+ *  With '-q', rays are taken from a shared-memory queue instead
+ *  (see rayqueue.h), and each result goes back into its record.
  */
 
 #include  <time.h>
@@ -30,6 +33,8 @@ static const char	RCSid[] = "$Id: rtrace.c,v 2.71 2018/02/13 20:27:19 greg Exp $
 #include  "otypes.h"
 #include  "resolu.h"
 #include  "random.h"
+#include  "instance.h"
+#include  "rayqueue.h"
 
 extern int  inform;			/* input format */
 extern int  outform;			/* output format */
@@ -41,11 +46,15 @@ extern int  lim_dist;			/* limit distance? */
 extern char  *tralist[];		/* list of modifers to trace (or no) */
 extern int  traincl;			/* include == 1, exclude == 0 */
 
+extern char  *rqfname;			/* shared ray queue file */
+
 extern int  hresolu;			/* horizontal resolution */
 extern int  vresolu;			/* vertical resolution */
 
 static int  castonly = 0;
 
+static RAYQ  *rayq = NULL;		/* shared ray queue */
+
 #ifndef  MAXTSET
 #define	 MAXTSET	8191		/* maximum number in trace set */
 #endif
@@ -71,6 +80,8 @@ static void raycast(RAY *r);
 static void rayirrad(RAY *r);
 static void rtcompute(FVECT org, FVECT dir, double dmax);
 static int printvals(RAY *r);
+static int rqvals(RAY *r);
+static void rqtrace(int nproc);
 static int getvec(FVECT vec, int fmt, FILE *fp);
 static void tabin(RAY *r);
 static void ourtrace(RAY *r);
@@ -152,9 +163,20 @@ rtrace(				/* trace rays from file */
 	default:
 		error(CONSISTENCY, "botched output format");
 	}
-	if (nproc > 1) {		/* start multiprocessing */
+	ray_fifo_out = printvals;
+	if (rqfname != NULL) {		/* results go to queue */
+		if ((rayq = rq_attach(rqfname)) == NULL) {
+			sprintf(errmsg, "cannot attach ray queue \"%s\"",
+					rqfname);
+			error(SYSTEM, errmsg);
+		}
+		ray_fifo_out = rqvals;
+	}
+	if (nproc > 1)			/* start multiprocessing */
 		ray_popen(nproc);
-		ray_fifo_out = printvals;
+	if (rayq != NULL) {
+		rqtrace(nproc);
+		return;
 	}
 	if (hresolu > 0) {
 		if (vresolu > 0)
@@ -397,9 +419,56 @@ rtcompute(			/* compute and print ray value(s) */
 			error(USER, "lost children");
 		return;
 	}
-	samplendx++;			/* else do it ourselves */
+	trimscenes();			/* else do it ourselves */
+	samplendx++;
 	rayvalue(&thisray);
-	printvals(&thisray);
+	(*ray_fifo_out)(&thisray);
+}
+
+
+static void
+rqtrace(			/* trace rays from shared queue */
+	int  nproc
+)
+{
+	RQREC  *rr;
+	FVECT  orig, direc;
+	double	d;
+
+	for ( ; ; ) {
+		if ((rr = rq_request(rayq, 0)) == NULL) {
+			if (nproc > 1 && ray_fifo_flush() < 0)
+				error(USER, "child(ren) died");
+			if ((rr = rq_request(rayq, 1)) == NULL)
+				break;		/* client is done */
+		}
+		VCOPY(orig, rr->org);
+		VCOPY(direc, rr->dir);
+		d = normalize(direc);
+		if (d == 0.0) {				/* zero ==> flush */
+			if (nproc > 1 && ray_fifo_flush() < 0)
+				error(USER, "child(ren) died");
+						/* numbered as in bogusray() */
+			rayorigin(&thisray, PRIMARY, NULL, NULL);
+			rq_putres(rayq, NULL, 0.0);
+		} else
+			rtcompute(orig, direc, lim_dist ? d : 0.0);
+	}
+	if (nproc > 1) {				/* clean up children */
+		if (ray_fifo_flush() < 0)
+			error(USER, "unable to complete processing");
+		ray_pclose(0);
+	}
+}
+
+
+static int
+rqvals(				/* put ray result in queue */
+	RAY  *r
+)
+{
+	rq_putres(rayq, r->rcol, r->rot);
+	return(1);
 }
 
 
@@ -120,6 +120,27 @@ time_t	pgmapdate;		/* date of global photon map (>= oct1date) */
 char	*pcmapname;		/* name of caustic photon map */
 time_t	pcmapdate;		/* date of caustic photon map (>= oct1date) */
 
+				/* content signatures (64-bit FNV-1a) */
+typedef unsigned long long	SIGVAL;
+
+#define SIG_INIT	0xcbf29ce484222325ULL
+#define SIG_PRIME	0x100000001b3ULL
+#define SIGLEN		16		/* hex digits in signature */
+
+typedef struct {
+	char	*fn;			/* target file name */
+	char	hs[SIGLEN+1];		/* signature of its inputs */
+} TARGSIG;
+
+char	sigfile[PATH_MAX+4];	/* target signature log */
+TARGSIG	*tsig = NULL;		/* recorded target signatures */
+int	ntsigs = 0;		/* number of recorded signatures */
+
+char	octsig[SIGLEN+1];	/* octree inputs signature */
+char	oct1sig[SIGLEN+1];	/* post-mkillum octree signature */
+char	scnsig[SIGLEN+1];	/* scene signature (with photon maps) */
+char	rendsig[SIGLEN+1];	/* scene plus rendering options */
+
 int	nowarn = 0;		/* no warnings */
 int	explicate = 0;		/* explicate variables */
 int	silent = 0;		/* do work silently */
@@ -155,6 +176,16 @@ static void rootname(char	*rn, char	*fn);
 static time_t checklast(char	*fnames);
 static char * newfname(char	*orig, int	pred);
 static void checkfiles(void);
+static SIGVAL sigbytes(SIGVAL h, char *bp, int n);
+static SIGVAL sigstr(SIGVAL h, char *s);
+static SIGVAL sigfiles(SIGVAL h, char *fnames);
+static char * sigtoa(char *hs, SIGVAL h);
+static TARGSIG * findsig(char *fn, int add);
+static void loadsigs(void);
+static char * oldsig(char *fn);
+static void putsig(char *fn, char *hs);
+static void savesigs(void);
+static int uptodate(char *fn, time_t *fdp, time_t indate, char *hs);
 static void getoctcube(double	org[3], double	*sizp);
 static void setdefaults(void);
 static void oconv(void);
@@ -252,6 +283,8 @@ main(
 	checkvalues();
 				/* check files and dates */
 	checkfiles();
+				/* load signatures of previous run */
+	loadsigs();
 				/* set default values as necessary */
 	setdefaults();
 				/* print all values if requested */
@@ -265,11 +298,13 @@ main(
 	checkambfile();
 				/* run simulation */
 	renderopts(ropts, popts);
+	sigtoa(rendsig, sigstr(sigstr(sigstr(SIG_INIT, scnsig), ropts), popts));
 	xferopts(ropts);
 	if (rvdevice != NULL)
 		rvu(ropts, popts);
 	else
 		rpict(ropts, popts);
+	savesigs();			/* compact signature log */
 	quit(0);
 userr:
 	fprintf(stderr,
@@ -407,6 +442,195 @@ checkfiles(void)			/* check for existence and modified times */
 }	
 
 
+static SIGVAL
+sigbytes(			/* add bytes to signature */
+	SIGVAL	h,
+	char	*bp,
+	int	n
+)
+{
+	while (n-- > 0) {
+		h ^= (unsigned char)*bp++;
+		h *= SIG_PRIME;
+	}
+	return(h);
+}
+
+
+static SIGVAL
+sigstr(				/* add string to signature */
+	SIGVAL	h,
+	char	*s
+)
+{
+	return(sigbytes(h, s, strlen(s)+1));
+}
+
+
+static SIGVAL
+sigfiles(			/* add file names and contents to signature */
+	SIGVAL	h,
+	char	*fnames
+)
+{
+	char	thisfile[PATH_MAX];
+	char	buf[8192];
+	FILE	*fp;
+	int	n;
+
+	if (fnames == NULL)
+		return(h);
+	while ((fnames = nextword(thisfile, PATH_MAX, fnames)) != NULL) {
+		h = sigstr(h, thisfile);
+		if (thisfile[0] == '!' ||
+				(thisfile[0] == '\\' && thisfile[1] == '!'))
+			continue;		/* command is its own content */
+		if ((fp = fopen(thisfile, "rb")) == NULL)
+			syserr(thisfile);
+		while ((n = fread(buf, 1, sizeof(buf), fp)) > 0)
+			h = sigbytes(h, buf, n);
+		fclose(fp);
+	}
+	return(h);
+}
+
+
+static char *
+sigtoa(				/* put signature in hexadecimal */
+	char	*hs,
+	SIGVAL	h
+)
+{
+	sprintf(hs, "%016llx", h);
+	return(hs);
+}
+
+
+static TARGSIG *
+findsig(			/* find (or add) target's signature */
+	char	*fn,
+	int	add
+)
+{
+	int	i;
+
+	for (i = ntsigs; i--; )
+		if (!strcmp(tsig[i].fn, fn))
+			return(tsig + i);
+	if (!add)
+		return(NULL);
+	if (!(ntsigs & 63)) {
+		tsig = (TARGSIG *)realloc((void *)tsig,
+				sizeof(TARGSIG)*(ntsigs+64));
+		if (tsig == NULL)
+			syserr(progname);
+	}
+	tsig[ntsigs].fn = savqstr(fn);
+	tsig[ntsigs].hs[0] = '\0';
+	return(tsig + ntsigs++);
+}
+
+
+static void
+loadsigs(void)			/* load target signature log */
+{
+	char	buf[PATH_MAX+SIGLEN+2];
+	char	*cp;
+	FILE	*fp;
+
+	sprintf(sigfile, "%s.sig", radname);
+	if ((fp = fopen(sigfile, "r")) == NULL)
+		return;
+	while (fgets(buf, sizeof(buf), fp) != NULL) {
+		if (strlen(buf) < SIGLEN+2 || buf[SIGLEN] != ' ')
+			continue;
+		buf[SIGLEN] = '\0';
+		for (cp = buf+SIGLEN+1; *cp && *cp != '\n'; cp++)
+			;
+		*cp = '\0';		/* later entries replace earlier */
+		strcpy(findsig(buf+SIGLEN+1, 1)->hs, buf);
+	}
+	fclose(fp);
+}
+
+
+static char *
+oldsig(				/* get recorded signature for target */
+	char	*fn
+)
+{
+	TARGSIG	*tp = findsig(fn, 0);
+
+	return(tp == NULL ? NULL : tp->hs);
+}
+
+
+static void
+putsig(				/* record signature of finished target */
+	char	*fn,
+	char	*hs
+)
+{
+	char	*os = oldsig(fn);
+	FILE	*fp;
+
+	if (!nprocs || touchonly || (os != NULL && !strcmp(os, hs)))
+		return;
+	strcpy(findsig(fn, 1)->hs, hs);
+	if ((fp = fopen(sigfile, "a")) == NULL)	/* children append, too */
+		syserr(sigfile);
+	fprintf(fp, "%s %s\n", hs, fn);
+	fclose(fp);
+}
+
+
+static void
+savesigs(void)			/* rewrite log with current targets only */
+{
+	char	tmpfile[PATH_MAX+8];
+	FILE	*fp;
+	int	i;
+
+	if (!nprocs || touchonly || inchild() || !fdate(sigfile))
+		return;
+	loadsigs();			/* include children's entries */
+	sprintf(tmpfile, "%s.tmp", sigfile);
+	if ((fp = fopen(tmpfile, "w")) == NULL)
+		syserr(tmpfile);
+	for (i = 0; i < ntsigs; i++)
+		if (fdate(tsig[i].fn))
+			fprintf(fp, "%s %s\n", tsig[i].hs, tsig[i].fn);
+	if (fclose(fp) == EOF || rename(tmpfile, sigfile) < 0)
+		syserr(sigfile);
+}
+
+
+static int
+uptodate(			/* check target by date and input signature */
+	char	*fn,
+	time_t	*fdp,
+	time_t	indate,
+	char	*hs
+)
+{
+	char	*os = oldsig(fn);
+
+	if (!*fdp)			/* doesn't exist */
+		return(0);
+	if (os != NULL && strcmp(os, hs))
+		return(0);		/* inputs have changed */
+	if (*fdp >= indate)
+		return(1);		/* newer than inputs */
+	if (os == NULL)
+		return(0);		/* no record, so go by date */
+	touch(fn);			/* inputs are the same, just touched */
+	*fdp = time((time_t *)NULL);
+	if (*fdp < indate)		/* in case clock is off */
+		*fdp = indate;
+	return(1);
+}
+
+
 static void
 getoctcube(		/* get octree bounding cube */
 	double	org[3],
@@ -523,9 +747,25 @@ oconv(void)				/* run oconv and mkillum if necessary */
 {
 	static char	illumtmp[] = "ilXXXXXX";
 	char	combuf[PATH_MAX], ocopts[64], mkopts[1024];
+	SIGVAL	h;
 
 	oconvopts(ocopts);		/* get options */
-	if (octreedate < scenedate) {	/* check date on original octree */
+	if (vdef(SCENE)) {		/* signature of octree inputs */
+		h = sigstr(sigstr(SIG_INIT, c_oconv), ocopts);
+		h = sigfiles(sigfiles(h, vval(SCENE)), vval(OBJECT));
+	} else
+		h = sigfiles(SIG_INIT, vval(OCTREE));
+	sigtoa(octsig, h);
+	h = sigfiles(h, vval(MATERIAL));
+	if (vdef(ILLUM)) {
+		h = sigfiles(h, vval(ILLUM));
+		if (vdef(MKILLUM))
+			h = sigstr(h, vval(MKILLUM));
+	}
+	sigtoa(oct1sig, h);
+					/* check date on original octree */
+	if (vdef(SCENE) && !uptodate(vval(OCTREE), &octreedate,
+					scenedate, octsig)) {
 		if (touchonly && octreedate)
 			touch(vval(OCTREE));
 		else {				/* build command */
@@ -544,16 +784,20 @@ oconv(void)				/* run oconv and mkillum if necessary */
 				unlink(vval(OCTREE));
 				quit(1);
 			}
+			putsig(vval(OCTREE), octsig);
 		}
 		octreedate = time((time_t *)NULL);
 		if (octreedate < scenedate)	/* in case clock is off */
 			octreedate = scenedate;
 	}
-	if (oct1name == vval(OCTREE))		/* no mkillum? */
+	if (oct1name == vval(OCTREE)) {		/* no mkillum? */
 		oct1date = octreedate > matdate ? octreedate : matdate;
-	if ((oct1date >= octreedate) & (oct1date >= matdate)
-			& (oct1date >= illumdate))	/* all done */
 		return;
+	}
+	if (uptodate(oct1name, &oct1date, octreedate > matdate ?
+			(octreedate > illumdate ? octreedate : illumdate) :
+			(matdate > illumdate ? matdate : illumdate), oct1sig))
+		return;				/* all done */
 						/* make octree0 */
 	if ((oct0date < scenedate) | (oct0date < illumdate)) {
 		if (touchonly && oct0date)
@@ -617,6 +861,7 @@ oconv(void)				/* run oconv and mkillum if necessary */
 			quit(1);
 		}
 		rmfile(illumtmp);
+		putsig(oct1name, oct1sig);
 	}
 	oct1date = time((time_t *)NULL);
 	if (oct1date < oct0date)	/* in case clock is off */
@@ -629,9 +874,22 @@ mkpmap(void)			/* run mkpmap if indicated */
 {
 	char	combuf[2048], *cp;
 	time_t	tnow;
-				/* nothing to do? */
-	if ((pgmapname == NULL) | (pgmapdate >= oct1date) &&
-			(pcmapname == NULL) | (pcmapdate >= oct1date))
+	SIGVAL	h;
+	int	pgdo, pcdo;
+				/* scene signature includes maps */
+	h = sigstr(SIG_INIT, oct1sig);
+	if (vdef(MKPMAP))
+		h = sigstr(h, vval(MKPMAP));
+	if (vdef(PGMAP))
+		h = sigstr(h, vval(PGMAP));
+	if (vdef(PCMAP))
+		h = sigstr(h, vval(PCMAP));
+	sigtoa(scnsig, h);
+	pgdo = pgmapname != NULL &&
+			!uptodate(pgmapname, &pgmapdate, oct1date, scnsig);
+	pcdo = pcmapname != NULL &&
+			!uptodate(pcmapname, &pcmapdate, oct1date, scnsig);
+	if (!pgdo & !pcdo)	/* nothing to do? */
 		return;
 				/* just update existing file dates? */
 	if (touchonly && (pgmapname == NULL) | (pgmapdate > 0) &&
@@ -659,13 +917,13 @@ mkpmap(void)			/* run mkpmap if indicated */
 			else
 				badvalue(REPORT);
 		}
-		if (pgmapname != NULL && pgmapdate < oct1date) {
+		if (pgdo) {
 			cp = addarg(cp, "-apg");
 			addarg(cp, vval(PGMAP));
 			cp = sskip(sskip(cp));	/* remove any bandwidth */
 			*cp = '\0';
 		}
-		if (pcmapname != NULL && pcmapdate < oct1date) {
+		if (pcdo) {
 			cp = addarg(cp, "-apc");
 			addarg(cp, vval(PCMAP));
 			cp = sskip(sskip(cp));	/* remove any bandwidth */
@@ -675,12 +933,16 @@ mkpmap(void)			/* run mkpmap if indicated */
 		if (runcom(combuf)) {
 			fprintf(stderr, "%s: error running %s\n",
 					progname, c_mkpmap);
-			if (pgmapname != NULL && pgmapdate < oct1date)
+			if (pgdo)
 				unlink(pgmapname);
-			if (pcmapname != NULL && pcmapdate < oct1date)
+			if (pcdo)
 				unlink(pcmapname);
 			quit(1);
 		}
+		if (pgdo)
+			putsig(pgmapname, scnsig);
+		if (pcdo)
+			putsig(pcmapname, scnsig);
 	}
 	tnow = time((time_t *)NULL);
 	if (pgmapname != NULL)
@@ -775,7 +1037,7 @@ checkambfile(void)			/* check date on ambient file */
 		return;
 	if (!(afdate = fdate(vval(AMBFILE))))
 		return;
-	if (oct1date > afdate) {
+	if (!uptodate(vval(AMBFILE), &afdate, oct1date, scnsig)) {
 		if (touchonly)
 			touch(vval(AMBFILE));
 		else
@@ -1464,6 +1726,7 @@ rpict(				/* run rpict and pfilt for each view */
 	char	rppopt[32], sfile[PATH_MAX], *pfile = NULL;
 	char	pfopts[128];
 	char	vs[32], *vw;
+	char	picsig[SIGLEN+1], *os;
 	int	vn, mult;
 	FILE	*fp;
 	time_t	rfdt, pfdt;
@@ -1537,14 +1800,22 @@ rpict(				/* run rpict and pfilt for each view */
 			sprintf(zopt, " -z %s_%s.zbf", vval(ZFILE), vs);
 		else
 			zopt[0] = '\0';
-						/* check date on picture */
+						/* check date & inputs of picture */
+		sigtoa(picsig, sigstr(sigstr(sigstr(sigstr(sigstr(sigstr(
+				sigstr(SIG_INIT, rendsig), c_rpict), vw),
+				res), zopt), c_pfilt), pfopts));
 		pfdt = fdate(picfile);
-		if (pfdt >= oct1date)
+		if (uptodate(picfile, &pfdt, oct1date, picsig))
 			continue;
 						/* get raw file name */
 		sprintf(rawfile, "%s_%s.unf",
 			vdef(RAWFILE) ? vval(RAWFILE) : vval(PICTURE), vs);
 		rfdt = fdate(rawfile);
+		if (rfdt && !touchonly && (os = oldsig(rawfile)) != NULL &&
+				strcmp(os, picsig)) {
+			rmfile(rawfile);	/* partial render is stale */
+			rfdt = 0;
+		}
 		if (touchonly) {		/* update times only */
 			if (rfdt) {
 				if (rfdt < oct1date)
@@ -1600,6 +1871,7 @@ rpict(				/* run rpict and pfilt for each view */
 			if (runcom(combuf))	/* run rpict/rpiece */
 				goto rperror;
 		} else {
+			putsig(rawfile, picsig);	/* for recovery */
 			if (overture) {		/* run overture calculation */
 				sprintf(combuf,
 					"%s%s %s%s -x 64 -y 64 -ps 1 %s > %s",
@@ -1683,12 +1955,15 @@ rpict(				/* run rpict and pfilt for each view */
 			mvfile(rawfile, combuf);
 		} else
 			rmfile(rawfile);
+		putsig(picfile, picsig);
 		if (do_rpiece)			/* done with sync file */
 			rmfile(sfile);
 		else
 			finish_process();	/* exit if child */
 	}
 	wait_process(1);		/* wait for children to finish */
+	if (vdef(AMBFILE) && fdate(vval(AMBFILE)))
+		putsig(vval(AMBFILE), scnsig);
 	if (pfile != NULL) {		/* clean up persistent rpict */
 		RT_PID	pid;
 		fp = fopen(pfile, "r");
@@ -25,6 +25,7 @@ static const char RCSid[] = "$Id: ranimate.c,v 2.56 2016/03/06 01:13:18 schorsch
 #include "rtprocess.h"
 #include "paths.h"
 #include "standard.h"
+#include "color.h"
 #include "view.h"
 #include "vars.h"
 #include "netproc.h"
@@ -150,6 +151,11 @@ static int dofilt(int frame, int rvr);
 static void archive(void);
 static int frecover(int frame);
 static int recover(int frame);
+static char * rcvrcom(char *cp, int frame);
+static int unfinished(char *fname);
+static void resumeframes(int first, int last);
+static int ourpersist(PSERVER *ps, int add);
+static void killpersist(void);
 static void sethosts(void);
 static void walkwait(int first, int last, char *vfn);
 static void animrend(int frame, VIEW *vp);
@@ -596,6 +602,8 @@ animate(void)			/* run animation */
 		filterframes();
 		transferframes();
 	}
+					/* release rendering servers */
+	killpersist();
 					/* mark status as finished */
 	astat.pid = 0;
 	putastat();
@@ -631,6 +639,8 @@ renderframes(int nframes)		/* render next nframes frames */
 		lastframe += vint(INTERP)+1 - ((lastframe-1)%(vint(INTERP)+1));
 	if (lastframe > vint(END))		/* check for end */
 		lastframe = vint(END);
+					/* finish interrupted frames */
+	resumeframes(astat.rnext, lastframe);
 					/* render each view */
 	for (i = astat.rnext; i <= lastframe; i++) {
 		if ((vp = getview(i)) == NULL) {
@@ -645,6 +655,7 @@ renderframes(int nframes)		/* render next nframes frames */
 		if (vdef(ANIMATE))		/* animate frame */
 			animrend(i, vp);
 		else {				/* else record it */
+			fprintf(fp, "FRAME=%d\n", i);
 			fputs(VIEWSTR, fp);
 			fprintview(vp, fp);
 			putc('\n', fp);
@@ -802,24 +813,46 @@ recover(int frame)			/* recover the specified frame */
 {
 	static int	*rfrm;		/* list of recovered frames */
 	static int	nrfrms = 0;
-	double	mblurf, dblurf;
-	int	nblur = getblur(&mblurf, &dblurf);
 	char	combuf[2048];
-	char	fname[128];
-	register char	*cp;
 	register int	i;
 					/* check to see if recovered already */
 	for (i = nrfrms; i--; )
 		if (rfrm[i] == frame)
 			return(0);
-					/* build command */
+					/* run command */
+	if (runcom(rcvrcom(combuf, frame)))
+		return(1);
+					/* add frame to recovered list */
+	if (nrfrms)
+		rfrm = (int *)realloc((void *)rfrm, (nrfrms+1)*sizeof(int));
+	else
+		rfrm = (int *)malloc(sizeof(int));
+	if (rfrm == NULL) {
+		perror("malloc");
+		quit(1);
+	}
+	rfrm[nrfrms++] = frame;
+	return(0);
+}
+
+
+static char *
+rcvrcom(			/* build command to recover frame */
+char	*cp,
+int	frame
+)
+{
+	double	mblurf, dblurf;
+	int	nblur = getblur(&mblurf, &dblurf);
+	char	fname[128];
+	char	*combuf = cp;
+
 	sprintf(fname, vval(BASENAME), frame);
 	if (vdef(ANIMATE))
-		sprintf(combuf, "%s %d | rpict%s -w0",
+		sprintf(cp, "%s %d | rpict%s -w0",
 				vval(ANIMATE), frame, rendopt);
 	else
-		sprintf(combuf, "rpict%s -w0", rendopt);
-	cp = combuf;
+		sprintf(cp, "rpict%s -w0", rendopt);
 	while (*cp) cp++;
 	if (nblur) {
 		sprintf(cp, " -pm %.3f", mblurf/nblur);
@@ -837,19 +870,65 @@ recover(int frame)			/* recover the specified frame */
 		*cp++ = ' ';
 		strcpy(cp, vval(OCTREE));
 	}
-	if (runcom(combuf))		/* run command */
-		return(1);
-					/* add frame to recovered list */
-	if (nrfrms)
-		rfrm = (int *)realloc((void *)rfrm, (nrfrms+1)*sizeof(int));
-	else
-		rfrm = (int *)malloc(sizeof(int));
-	if (rfrm == NULL) {
+	return(combuf);
+}
+
+
+static int
+unfinished(char *fname)			/* check for partial rendering */
+{
+	RESOLU	rs;
+	COLR	*scan;
+	FILE	*fp;
+	int	y;
+
+	if ((fp = fopen(fname, "r")) == NULL)
+		return(0);			/* not started */
+	SET_FILE_BINARY(fp);
+	if (getheader(fp, NULL, NULL) < 0 || !fgetsresolu(&rs, fp)) {
+		fclose(fp);
+		return(-1);			/* nothing to salvage */
+	}
+	if ((scan = (COLR *)malloc(scanlen(&rs)*sizeof(COLR))) == NULL) {
 		perror("malloc");
 		quit(1);
 	}
-	rfrm[nrfrms++] = frame;
-	return(0);
+	for (y = numscans(&rs); y > 0; y--)
+		if (freadcolrs(scan, scanlen(&rs), fp) < 0)
+			break;
+	free((void *)scan);
+	fclose(fp);
+	return(y > 0);
+}
+
+
+static void
+resumeframes(			/* finish frames left by an interruption */
+int	first,
+int	last
+)
+{
+	char	combuf[2048];
+	char	fname[128];
+	int	nresumed = 0;
+	register int	i;
+
+	for (i = first; i <= last; i++) {
+		sprintf(fname, vval(BASENAME), i);
+		strcat(fname, ".unf");
+		switch (unfinished(fname)) {
+		case 0:				/* absent or complete */
+			continue;
+		case -1:			/* start it over */
+			rmfile(fname);
+			continue;
+		}
+		if (!nresumed++ && !silent)
+			printf("	Resuming interrupted frames\n");
+		bruncom(rcvrcom(combuf, i), i, NULL);
+	}
+	if (nresumed)
+		bwait(0);
 }
 
 
@@ -1335,8 +1414,6 @@ int	maxcopies
 	int	hostcopies;
 	char	buf[10240], *com1, *s;
 	int	status;
-	int	pfd;
-	register int	n;
 	register PSERVER	*ps;
 
 	if (!silent)
@@ -1347,11 +1424,12 @@ int	maxcopies
 					/* start jobs on each server */
 	for (ps = pslist; ps != NULL; ps = ps->next) {
 		hostcopies = 0;
-		if (maxcopies > 1 && ps->nprocs > 1 && ppins != NULL) {
-			strcpy(com1=buf, com);	/* build -PP command */
+		if (ppins != NULL) {		/* build -PP command */
+			strcpy(com1=buf, com);
 			sprintf(com1+(ppins-com), " -PP %s/%s.persist",
 					vval(DIRECTORY), phostname(ps));
-			unlink(com1+(ppins-com)+5);
+			if (!ourpersist(ps, 1))	/* remove stale file */
+				unlink(com1+(ppins-com)+5);
 			strcat(com1, ppins);
 		} else
 			com1 = com;
@@ -1378,21 +1456,69 @@ int	maxcopies
 					/* wait for jobs to finish */
 	while ((status = wait4job(NULL, -1)) != -1)
 		retstatus += status && !serverdown();
-					/* terminate parallel rpict's */
+	return(retstatus);		/* leave servers for next batch */
+}
+
+
+static int
+ourpersist(			/* check if we started server on host */
+PSERVER	*ps,
+int	add			/* add host if not listed */
+)
+{
+	static char	**pphost;	/* hosts with our servers */
+	static int	npphosts = 0;
+	register int	i;
+
+	for (i = npphosts; i--; )
+		if (!strcmp(pphost[i], phostname(ps)))
+			return(1);
+	if (!add)
+		return(0);
+	if (npphosts)
+		pphost = (char **)realloc((void *)pphost,
+					(npphosts+1)*sizeof(char *));
+	else
+		pphost = (char **)malloc(sizeof(char *));
+	if (pphost == NULL) {
+		perror("malloc");
+		quit(1);
+	}
+	pphost[npphosts++] = savestr(phostname(ps));
+	return(0);
+}
+
+
+static void
+killpersist(void)		/* terminate our persistent rpict servers */
+{
+	char	buf[512];
+	int	pfd;
+	register int	n;
+	register PSERVER	*ps;
+
+	if (noaction)
+		return;
 	for (ps = pslist; ps != NULL; ps = ps->next) {
+		if (!ourpersist(ps, 0))
+			continue;
 		sprintf(buf, "%s/%s.persist", vval(DIRECTORY), phostname(ps));
-		if ((pfd = open(buf, O_RDONLY)) >= 0) {
-			n = read(pfd, buf, sizeof(buf)-1);	/* get PID */
-			buf[n] = '\0';
-			close(pfd);
-			for (n = 0; buf[n] && !isspace(buf[n]); n++)
-				;
-								/* terminate */
-			sprintf(buf, "kill -ALRM %d", atoi(buf+n));
-			wait4job(ps, startjob(ps, buf, NULL));
-		}
+		if ((pfd = open(buf, O_RDONLY)) < 0)
+			continue;
+		unlink(buf);
+		n = read(pfd, buf, sizeof(buf)-1);	/* get PID */
+		close(pfd);
+		if (n <= 0)
+			continue;
+		buf[n] = '\0';
+		for (n = 0; buf[n] && !isspace(buf[n]); n++)
+			;
+		if (atoi(buf+n) <= 0)
+			continue;
+							/* terminate */
+		sprintf(buf, "kill -ALRM %d", atoi(buf+n));
+		wait4job(ps, startjob(ps, buf, NULL));
 	}
-	return(retstatus);
 }
 
 
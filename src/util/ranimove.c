@@ -35,6 +35,8 @@ int		quickstart = 0;	/* time initial frame as well? */
 
 int		nprocs = 1;	/* number of rendering processes */
 
+int		pipeline = 0;	/* overlap output with rendering? */
+
 int		rtperfrm = 60;	/* seconds to spend per frame */
 
 double		ndthresh = 2.;	/* noticeable difference threshold */
@@ -125,6 +127,9 @@ main(
 		case 'n':			/* number of processes */
 			nprocs = atoi(argv[++i]);
 			break;
+		case 'p':			/* pipeline frame output */
+			pipeline = 1;
+			break;
 		default:
 			goto userr;
 		}
@@ -161,7 +166,7 @@ main(
 	return(0);
 userr:
 	fprintf(stderr,
-"Usage: %s [-n nprocs][-f beg,end][-t sec][-d jnd][-s][-w][-e] anim_file\n",
+"Usage: %s [-n nprocs][-p][-f beg,end][-t sec][-d jnd][-s][-w][-e] anim_file\n",
 			progname);
 	quit(1);
 	return 1; /* pro forma return */
@@ -192,6 +197,8 @@ eputs(				/* put string to stderr */
 void
 quit(int ec)			/* make sure exit is called */
 {
+	if (pipeline < 0)	/* background output process */
+		_exit(ec);
 	if (ray_pnprocs > 0)	/* close children if any */
 		ray_pclose(0);		
 	exit(ec);
@@ -452,11 +459,16 @@ animate(void)			/* run through animation */
 						/* refinement */
 		for (rpass = 0; refine_frame(rpass); rpass++)
 			;
+		if (pipeline) {			/* filter & output behind */
+			pipe_frame();
+			continue;
+		}
 						/* final filter pass */
 		filter_frame();
 						/* output frame */
 		send_frame();
 	}
+	wait_frame();				/* finish last output */
 					/* free resources */
 	free_frame();
 	if (nprocs > 1)
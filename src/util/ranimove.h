@@ -85,6 +85,8 @@ extern int		quickstart;	/* time initial frame as well? */
 
 extern int		nprocs;		/* number of rendering processes */
 
+extern int		pipeline;	/* overlap output with rendering? */
+
 extern int		rtperfrm;	/* seconds to spend per frame */
 
 extern double		ndthresh;	/* noticeable difference threshold */
@@ -136,6 +138,7 @@ extern short	*xmbuffer;	/* x motion at each pixel */
 extern short	*ymbuffer;	/* y motion at each pixel */
 extern uby8	*abuffer;	/* accuracy at each pixel */
 extern uby8	*sbuffer;	/* sample count per pixel */
+extern uby8	*smap;		/* sampled pixel bitmap (sbuffer != 0) */
 
 extern VIEW	vwprev;		/* last frame's view */
 extern COLOR	*cprev;		/* last frame colors */
@@ -158,6 +161,9 @@ extern double	hlsmax;		/* maximum high-level saliency */
 
 #define fndx(x,y)	((y)*hres + (x))
 
+#define setsmap(n)	(smap[(n)>>3] |= 1<<((n)&7))
+#define clrsmap(n)	(smap[(n)>>3] &= ~(1<<((n)&7)))
+
 #define MO_UNK		-32768	/* unknown motion value */
 
 #define FOV_DEG		1.0	/* foveal radius (degrees) */
@@ -176,6 +182,8 @@ extern double	hlsmax;		/* maximum high-level saliency */
 extern void	init_frame(void);
 extern void filter_frame(void);
 extern void send_frame(void);
+extern void pipe_frame(void);
+extern void wait_frame(void);
 extern void free_frame(void);
 extern void write_map(float *mp, char *fn);
 extern void sample_pos(double hv[2], int x, int y, int sn);
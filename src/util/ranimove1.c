@@ -12,6 +12,9 @@ static const char	RCSid[] = "$Id: ranimove1.c,v 3.23 2018/01/24 04:39:52 greg Ex
 #include "copyright.h"
 
 #include <string.h>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <sys/wait.h>
+#endif
 
 #include "platform.h"
 #include "ranimove.h"
@@ -32,6 +35,7 @@ short		*xmbuffer;	/* x motion at each pixel */
 short		*ymbuffer;	/* y motion at each pixel */
 uby8		*abuffer;	/* accuracy at each pixel */
 uby8		*sbuffer;	/* sample count per pixel */
+uby8		*smap;		/* sampled pixel bitmap (sbuffer != 0) */
 
 VIEW		vwprev;		/* last frame's view */
 COLOR		*cprev;		/* last frame colors */
@@ -50,8 +54,13 @@ double		hlsmax;		/* maximum high-level saliency this frame */
 static void next_frame(void);
 static int sample_here(int x, int y);
 static int offset_cmp(const void *p1, const void *p2);
+static int smaprow(int x, int y);
 static void setmotion(int n, FVECT wpos);
 static void init_frame_sample(void);
+static void interp_frame(void);
+static void expose_frame(void);
+
+static int	outpid = 0;	/* background output process */
 
 
 #if 0
@@ -133,6 +142,7 @@ next_frame(void)			/* prepare next frame buffer */
 		ymbuffer = (short *)malloc(sizeof(short)*hres*vres);
 		abuffer = (uby8 *)calloc(hres*vres, sizeof(uby8));
 		sbuffer = (uby8 *)calloc(hres*vres, sizeof(uby8));
+		smap = (uby8 *)calloc(hres*vres/8 + 2, sizeof(uby8));
 		cprev = (COLOR *)malloc(sizeof(COLOR)*hres*vres);
 		zprev = (float *)malloc(sizeof(float)*hres*vres);
 		oprev = (OBJECT *)malloc(sizeof(OBJECT)*hres*vres);
@@ -140,6 +150,7 @@ next_frame(void)			/* prepare next frame buffer */
 		if ((cbuffer==NULL) | (zbuffer==NULL) | (obuffer==NULL) |
 				(xmbuffer==NULL) | (ymbuffer==NULL) |
 				(abuffer==NULL) | (sbuffer==NULL) |
+				(smap==NULL) |
 				(cprev==NULL) | (zprev == NULL) |
 				(oprev==NULL) | (aprev==NULL))
 			error(SYSTEM, "out of memory in init_frame");
@@ -159,6 +170,7 @@ next_frame(void)			/* prepare next frame buffer */
 		bp = aprev; aprev = abuffer; abuffer = bp;
 		memset(abuffer, '\0', sizeof(uby8)*hres*vres);
 		memset(sbuffer, '\0', sizeof(uby8)*hres*vres);
+		memset(smap, '\0', sizeof(uby8)*(hres*vres/8 + 2));
 		frm_stop += rtperfrm;
 	}
 	cerrmap = NULL;
@@ -235,6 +247,31 @@ offset_cmp(		/* compare offset distances */
 }
 
 
+static int
+smaprow(		/* get sampled bits for neighborhood row */
+	int	x,
+	int	y
+)
+{
+	int	x0 = x - SAMPDIST;
+	int	x1 = x + SAMPDIST + 1;
+	int	sh = 0;
+	long	n;
+
+	if ((y < 0) | (y >= vres))
+		return(0);
+	if (x0 < 0) {
+		sh = -x0;
+		x0 = 0;
+	}
+	if (x1 > hres)
+		x1 = hres;
+	n = fndx(x0, y);
+	return(((smap[n>>3] | smap[(n>>3)+1]<<8) >> (n&7) &
+			((1<<(x1-x0))-1)) << sh);
+}
+
+
 int
 getclosest(	/* get nc closest neighbors on same object */
 	int	*iarr,
@@ -244,64 +281,38 @@ getclosest(	/* get nc closest neighbors on same object */
 )
 {
 #define	NSCHECK		((2*SAMPDIST+1)*(2*SAMPDIST+1))
-	static int	hro, vro;
-	static int	ioffs[NSCHECK];
+	static int	noffs = 0;
+	static int	toffs[NSCHECK][3];
+	int	wrow[2*SAMPDIST+1];
 	OBJECT	myobj;
-	int	i0, nf;
+	int	i0, nf, wany;
 	int	i, j;
-					/* get our object number */
-	myobj = obuffer[fndx(x, y)];
-					/* special case for borders */
-	if ((x < SAMPDIST) | (x >= hres-SAMPDIST) |
-			(y < SAMPDIST) | (y >= vres-SAMPDIST)) {
-		int	tndx[NSCHECK][2];
-		nf = 0;
-		for (j = y - SAMPDIST; j <= y + SAMPDIST; j++) {
-		    if (j >= vres) break;
-		    if (j < 0) j = 0;
-		    for (i = x - SAMPDIST; i <= x + SAMPDIST; i++) {
-			if (i >= hres) break;
-			if (i < 0) i = 0;
-			i0 = fndx(i, j);
-			if (!sbuffer[i0])
-				continue;
-			if ((myobj != OVOID) & (obuffer[i0] != myobj))
-				continue;
-			tndx[nf][0] = (i-x)*(i-x) + (j-y)*(j-y);
-			tndx[nf][1] = i0;
-			nf++;
-		    }
-		}
-		qsort((void *)tndx, nf, 2*sizeof(int), offset_cmp);
-		if (nf > nc)
-			nf = nc;
-		for (i = nf; i--; )
-			iarr[i] = tndx[i][1];
-		return(nf);
-	}
-					/* initialize offset array */
-	if ((hres != hro) | (vres != vro)) {
-		int	toffs[NSCHECK][2];
-		i0 = fndx(SAMPDIST, SAMPDIST);
-		nf = 0;
-		for (i = 0; i <= 2*SAMPDIST; i++)
-		    for (j = 0; j <= 2*SAMPDIST; j++) {
-			toffs[nf][0] = (i-SAMPDIST)*(i-SAMPDIST) +
-					(j-SAMPDIST)*(j-SAMPDIST);
-			toffs[nf][1] = fndx(i, j) - i0;
-			nf++;
+					/* initialize sorted offsets */
+	if (!noffs) {
+		for (i = -SAMPDIST; i <= SAMPDIST; i++)
+		    for (j = -SAMPDIST; j <= SAMPDIST; j++) {
+			toffs[noffs][0] = i*i + j*j;
+			toffs[noffs][1] = i;
+			toffs[noffs][2] = j;
+			noffs++;
 		    }
-		qsort((void *)toffs, nf, 2*sizeof(int), offset_cmp);
-		for (i = NSCHECK; i--; )
-			ioffs[i] = toffs[i][1];
-		hro = hres;
-		vro = vres;
+		qsort((void *)toffs, noffs, 3*sizeof(int), offset_cmp);
 	}
-					/* find up to nc neighbors */
+					/* get sampled neighborhood */
+	wany = 0;
+	for (j = 2*SAMPDIST+1; j--; )
+		wany |= wrow[j] = smaprow(x, y+j-SAMPDIST);
+	if (!wany)
+		return(0);
+					/* get our object number */
 	i0 = fndx(x, y);
+	myobj = obuffer[i0];
+					/* find up to nc neighbors */
 	for (j = 0, nf = 0; (j < NSCHECK) & (nf < nc); j++) {
-		i = i0 + ioffs[j];
-		if (sbuffer[i] && (myobj == OVOID) | (obuffer[i] == myobj))
+		if (!(wrow[toffs[j][2]+SAMPDIST] >> (toffs[j][1]+SAMPDIST) & 1))
+			continue;
+		i = i0 + fndx(toffs[j][1], toffs[j][2]);
+		if ((myobj == OVOID) | (obuffer[i] == myobj))
 			iarr[nf++] = i;
 	}
 					/* return number found */
@@ -383,6 +394,7 @@ init_frame_sample(void)		/* sample our initial frame */
 				obuffer[n] = ir.robj;
 				abuffer[n] = ADISTANT;
 				sbuffer[n] = 1;
+				setsmap(n);
 			} else {
 				zbuffer[n] = ir.rot;
 				obuffer[n] = ir.robj;
@@ -406,6 +418,7 @@ init_frame_sample(void)		/* sample our initial frame */
 		zbuffer[n] = ir.rot;
 		obuffer[n] = ir.robj;
 		sbuffer[n] = 1;
+		setsmap(n);
 		if (ir.rot >= 0.99*FHUGE)
 			abuffer[n] = ADISTANT;
 		else {
@@ -420,6 +433,7 @@ init_frame_sample(void)		/* sample our initial frame */
 			zbuffer[n] = ir.rot;
 			obuffer[n] = ir.robj;
 			sbuffer[n] = 1;
+			setsmap(n);
 			if (ir.rot >= FHUGE)
 				abuffer[n] = ADISTANT;
 			else {
@@ -716,14 +730,6 @@ init_frame(void)			/* render base (low quality) frame */
 void
 filter_frame(void)			/* interpolation, motion-blur, and exposure */
 {
-	const double	expval = expspec_val(getexp(fcur));
-	int		x, y;
-	int		neigh[NPINTERP];
-	int		nc;
-	COLOR		cval;
-	double		w, wsum;
-	int		n;
-
 #if 0
 	/* XXX TEMPORARY!! */
 	conspicuity();
@@ -740,6 +746,20 @@ filter_frame(void)			/* interpolation, motion-blur, and exposure */
 		printf("\tFiltering frame\n");
 		fflush(stdout);
 	}
+	interp_frame();
+	expose_frame();
+}
+
+
+static void
+interp_frame(void)			/* normalize and interpolate samples */
+{
+	int		x, y;
+	int		neigh[NPINTERP];
+	int		nc;
+	COLOR		cval;
+	double		w, wsum;
+	int		n;
 					/* normalize samples */
 	for (n = hres*vres; n--; ) {
 		if (sbuffer[n] <= 1)
@@ -777,6 +797,17 @@ filter_frame(void)			/* interpolation, motion-blur, and exposure */
 		w = 1.0/wsum;
 		scalecolor(cbuffer[n], w);
 	    }
+}
+
+
+static void
+expose_frame(void)			/* motion-blur and exposure to output */
+{
+	const double	expval = expspec_val(getexp(fcur));
+	int		x, y;
+	COLOR		cval;
+	double		w;
+	int		n;
 					/* motion blur if requested */
 	if (mblur > .02) {
 		int	xs, ys, xl, yl;
@@ -991,6 +1022,53 @@ writerr:
 }
 
 
+void
+pipe_frame(void)			/* filter and send frame in background */
+{
+	if (!silent) {
+		printf("\tFiltering frame\n");
+		fflush(stdout);
+	}
+	interp_frame();			/* next frame reuses these values */
+	wait_frame();			/* one frame in the pipe at a time */
+#if !defined(_WIN32) && !defined(_WIN64)
+	fflush(NULL);
+	if ((outpid = fork()) == 0) {	/* child finishes on its copy */
+		pipeline = -1;		/* flag output process for quit() */
+		expose_frame();
+		send_frame();
+		fflush(NULL);
+		_exit(0);
+	}
+	if (outpid > 0)
+		return;
+	outpid = 0;			/* fork failed -- do it here */
+#endif
+	expose_frame();
+	send_frame();
+}
+
+
+void
+wait_frame(void)			/* wait for background frame output */
+{
+	int	status = 0;
+
+	if (outpid <= 0)
+		return;
+#if !defined(_WIN32) && !defined(_WIN64)
+	while (waitpid(outpid, &status, 0) < 0)
+		if (errno != EINTR) {
+			status = 0;
+			break;
+		}
+#endif
+	outpid = 0;
+	if (status)
+		error(USER, "background frame output failed");
+}
+
+
 void
 free_frame(void)			/* free frame allocation */
 {
@@ -1004,6 +1082,7 @@ free_frame(void)			/* free frame allocation */
 	free((void *)cprev); cprev = NULL;
 	free((void *)zprev); zprev = NULL;
 	free((void *)oprev); oprev = NULL;
+	free((void *)smap); smap = NULL;
 	cerrmap = NULL;
 	val2map = NULL;
 	hres = vres = 0;
@@ -81,8 +81,10 @@ refine_first(void)			/* initial refinement pass */
 		nextra++;
 	    }
 	for (n = hres*vres; n--; )	/* update sample counts */
-		if (esamp[n])
+		if (esamp[n]) {
 			sbuffer[n] = 1;
+			setsmap(n);
+		}
 	if (!silent)
 		printf("extrapolated %d pixels\n", nextra);
 	return(1);
@@ -421,6 +423,7 @@ ray_refine(			/* refine the given pixel by tracing a ray */
 			asump->nsamps++;
 		}
 		sbuffer[n] = 0;
+		clrsmap(n);
 	}
 	setcolor(ctmp,
 		colval(ir.rcol,RED)*colval(ir.rcol,RED),
@@ -431,6 +434,7 @@ ray_refine(			/* refine the given pixel by tracing a ray */
 		copycolor(val2map[n], ctmp);
 		abuffer[n] = AHIGHQ;
 		sbuffer[n] = 1;
+		setsmap(n);
 	} else {				/* else sum in sample */
 		addcolor(cbuffer[n], ir.rcol);
 		addcolor(val2map[n], ctmp);
@@ -18,8 +18,17 @@ static const char RCSid[] = "$Id: rcollate.c,v 2.28 2018/10/19 16:53:37 greg Exp
   #define ssize_t	size_t
 #else
   #include <sys/mman.h>
+  #include <sys/wait.h>
 #endif
 
+#ifndef MAXPROC
+#define MAXPROC		64		/* maximum indexing processes */
+#endif
+#ifndef TILEMEM
+#define TILEMEM		(1L<<25)	/* target bytes per output tile */
+#endif
+#define CBLK		32		/* records per cache block side */
+
 typedef struct {
 	void	*base;		/* pointer to base memory */
 	size_t	len;		/* allocated memory length */
@@ -141,19 +150,149 @@ load_file(MEMLOAD *mp, FILE *fp)
 /* free a record index */
 #define free_records(rp)	free(rp)
 
+/* index up to nmax records from *cpp, advancing it (-1 on error) */
+static long
+index_range(char **rec, long nmax, char **cpp, char *mend, int nw_rec)
+{
+	long	nrecs = 0;
+	char	*cp = *cpp;
+	int	n;
+
+	while (nrecs < nmax) {			/* whitespace-separated words */
+		while (cp < mend && !*cp | isspace(*cp))
+			++cp;
+		if (cp >= mend)
+			break;
+		rec[nrecs++] = cp;		/* point to first non-white */
+		n = nw_rec;
+		while (++cp < mend)		/* find end of record */
+			if (!*cp | isspace(*cp)) {
+				if (--n <= 0)
+					break;	/* got requisite # words */
+				do {		/* else find next word */
+					if (*cp == '\n') {
+						fprintf(stderr,
+						"Unexpected EOL in record!\n");
+						return(-1);
+					}
+					if (++cp >= mend)
+						break;
+				} while (!*cp | isspace(*cp));
+			}
+	}
+	*cpp = cp;
+	return(nrecs);
+}
+
+#if !defined(_WIN32) && !defined(_WIN64) && defined(MAP_SHARED)
+
+#ifndef MAP_ANONYMOUS
+#define MAP_ANONYMOUS	MAP_ANON
+#endif
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE	0
+#endif
+
+#define	MINSLICE	(1L<<20)	/* smallest slice worth a process */
+
+/* index records in line-aligned slices using parallel processes */
+static RECINDEX *
+par_index(const MEMLOAD *mp, int nw_rec, int np)
+{
+	char		*base = (char *)mp->base;
+	char		*mend = base + mp->len;
+	char		*slice[MAXPROC+1];
+	long		cap[MAXPROC], *nfound;
+	size_t		mlen, off[MAXPROC];
+	char		*smem, *cp;
+	RECINDEX	*rp;
+	long		nrecs;
+	int		pid[MAXPROC];
+	int		i, status;
+
+	if (np > mp->len/MINSLICE)
+		np = mp->len/MINSLICE;
+	if (np < 2)
+		return(NULL);
+	slice[0] = base;		/* split after EOLs (not mid-record) */
+	for (i = 1; i < np; i++) {
+		cp = base + mp->len/np*i;
+		if (cp < slice[i-1])
+			cp = slice[i-1];
+		while (cp < mend && *cp++ != '\n')
+			;
+		slice[i] = cp;
+	}
+	slice[np] = mend;
+	mlen = sizeof(long)*np;		/* bounded shared index space */
+	for (i = 0; i < np; i++) {
+		cap[i] = (slice[i+1] - slice[i])/(2*nw_rec) + 1;
+		off[i] = mlen;
+		mlen += sizeof(char *)*cap[i];
+	}
+	smem = (char *)mmap(NULL, mlen, PROT_READ|PROT_WRITE,
+			MAP_SHARED|MAP_ANONYMOUS|MAP_NORESERVE, -1, 0);
+	if (smem == MAP_FAILED)
+		return(NULL);
+	nfound = (long *)smem;
+	fflush(stdout);
+	for (i = 0; i < np; i++) {
+		if ((pid[i] = fork()) < 0)
+			break;
+		if (!pid[i]) {		/* child indexes its slice */
+			cp = slice[i];
+			nfound[i] = index_range((char **)(smem + off[i]),
+					cap[i], &cp, slice[i+1], nw_rec);
+			_exit(nfound[i] < 0);
+		}
+	}
+	status = (i < np);
+	while (i-- > 0) {
+		int	st;
+		if (waitpid(pid[i], &st, 0) != pid[i] || st)
+			status = 1;
+	}
+	nrecs = 0;
+	if (!status)
+		for (i = 0; i < np; i++)
+			nrecs += nfound[i];
+	rp = status ? NULL :
+		(RECINDEX *)malloc(sizeof(RECINDEX) + nrecs*sizeof(char *));
+	if (rp != NULL) {		/* gather slices in order */
+		rp->nw_rec = nw_rec;
+		rp->nrecs = 0;
+		for (i = 0; i < np; i++) {
+			memcpy(rp->rec + rp->nrecs, smem + off[i],
+					sizeof(char *)*nfound[i]);
+			rp->nrecs += nfound[i];
+		}
+		rp->rec[rp->nrecs] = mend;
+	}
+	munmap(smem, mlen);
+	return(rp);
+}
+
+#else
+#define par_index(mp,nw,np)	NULL
+#endif
+
+int		nprocs = 1;	/* processes for indexing */
+
 /* compute record index */
 static RECINDEX *
 index_records(const MEMLOAD *mp, int nw_rec)
 {
-	int		nall = 0;
+	long		nall;
 	RECINDEX	*rp;
 	char		*cp, *mend;
-	int		n;
+	long		n;
 
 	if (mp == NULL || (mp->base == NULL) | (mp->len <= 0))
 		return(NULL);
 	if (nw_rec <= 0)
 		return(NULL);
+	if (nprocs > 1 && (rp = par_index(mp, nw_rec, nprocs)) != NULL)
+		return(rp);
 	nall = 1000;
 	rp = (RECINDEX *)malloc(sizeof(RECINDEX) + nall*sizeof(char *));
 	if (rp == NULL)
@@ -162,35 +301,21 @@ index_records(const MEMLOAD *mp, int nw_rec)
 	rp->nrecs = 0;
 	cp = (char *)mp->base;
 	mend = cp + mp->len;
-	for ( ; ; ) {				/* whitespace-separated words */
-		while (cp < mend && !*cp | isspace(*cp))
-			++cp;
-		if (cp >= mend)
-			break;
-		if (rp->nrecs >= nall) {
-			nall += nall>>1;	/* get more record space */
-			rp = (RECINDEX *)realloc(rp,
-					sizeof(RECINDEX) + nall*sizeof(char *));
-			if (rp == NULL)
-				return(NULL);
+	for ( ; ; ) {
+		n = index_range(rp->rec + rp->nrecs, nall - rp->nrecs,
+				&cp, mend, nw_rec);
+		if (n < 0) {
+			free_records(rp);
+			return(NULL);
 		}
-		rp->rec[rp->nrecs++] = cp;	/* point to first non-white */
-		n = rp->nw_rec;
-		while (++cp < mend)		/* find end of record */
-			if (!*cp | isspace(*cp)) {
-				if (--n <= 0)
-					break;	/* got requisite # words */
-				do {		/* else find next word */
-					if (*cp == '\n') {
-						fprintf(stderr,
-						"Unexpected EOL in record!\n");
-						free_records(rp);
-						return(NULL);
-					}
-					if (++cp >= mend)
-						break;
-				} while (!*cp | isspace(*cp));
-			}
+		rp->nrecs += n;
+		if (rp->nrecs < nall)
+			break;			/* reached the end */
+		nall += nall>>1;		/* get more record space */
+		rp = (RECINDEX *)realloc(rp,
+				sizeof(RECINDEX) + nall*sizeof(char *));
+		if (rp == NULL)
+			return(NULL);
 	}
 	rp->rec[rp->nrecs] = mend;		/* reallocate to save space */
 	rp = (RECINDEX *)realloc(rp,
@@ -320,6 +445,55 @@ check_sizes()
 	return(1);
 }
 
+/* output transposed binary data in tiles of whole output rows */
+static int
+tile_transpose(const MEMLOAD *mp)
+{
+	const size_t	recsiz = (size_t)n_comp*comp_size;
+	const size_t	irowsiz = recsiz*ni_columns;
+	const size_t	orowsiz = recsiz*no_columns;
+	char		*tile;
+	long		nt, i0, j0, k0;
+	long		j, k, ie, je, ke;
+
+	nt = TILEMEM/orowsiz;		/* output rows per tile */
+	if (nt < 1)
+		nt = 1;
+	if (nt > no_rows)
+		nt = no_rows;
+	if ((tile = (char *)malloc(nt*orowsiz)) == NULL) {
+		fprintf(stderr, "Out of memory for output tile\n");
+		return(0);
+	}
+	for (i0 = 0; i0 < no_rows; i0 += nt) {
+		ie = (i0+nt < no_rows) ? i0+nt : no_rows;
+					/* one pass down input per tile */
+		for (j0 = 0; j0 < no_columns; j0 += CBLK) {
+		    je = (j0+CBLK < no_columns) ? j0+CBLK : no_columns;
+		    for (k0 = i0; k0 < ie; k0 += CBLK) {
+			ke = (k0+CBLK < ie) ? k0+CBLK : ie;
+			for (j = j0; j < je; j++) {
+			    const char	*src = (const char *)mp->base +
+						irowsiz*j + recsiz*k0;
+			    char	*dst = tile + orowsiz*(k0-i0) + recsiz*j;
+			    for (k = k0; k < ke; k++) {
+				memcpy(dst, src, recsiz);
+				src += recsiz;
+				dst += orowsiz;
+			    }
+			}
+		    }
+		}
+		if (fwrite(tile, orowsiz, ie-i0, stdout) != ie-i0) {
+			fprintf(stderr, "Error writing to stdout\n");
+			free(tile);
+			return(0);
+		}
+	}
+	free(tile);
+	return(1);
+}
+
 /* output transposed ASCII or binary data from memory */
 static int
 do_transpose(const MEMLOAD *mp)
@@ -362,17 +536,14 @@ do_transpose(const MEMLOAD *mp)
 		no_rows = ni_columns;
 	if ((no_rows != ni_columns) | (no_columns != ni_rows))
 		goto badspec;
+	if (rp == NULL)				/* binary goes by tiles */
+		return(tile_transpose(mp));
 						/* transpose records */
 	for (i = 0; i < no_rows; i++) {
-	    for (j = 0; j < no_columns; j++)
-		if (rp != NULL) {		/* ASCII output */
-			print_record(rp, j*ni_columns + i);
-			putc(tabEOL[j >= no_columns-1], stdout);
-		} else {			/* binary output */
-			putbinary((char *)mp->base +
-				(size_t)(n_comp*comp_size)*(j*ni_columns + i),
-					comp_size, n_comp, stdout);
-		}
+	    for (j = 0; j < no_columns; j++) {
+		print_record(rp, j*ni_columns + i);
+		putc(tabEOL[j >= no_columns-1], stdout);
+	    }
 	    if (ferror(stdout)) {
 		fprintf(stderr, "Error writing to stdout\n");
 		return(0);
@@ -567,6 +738,13 @@ main(int argc, char *argv[])
 			} else
 				n_comp = 1;
 			break;
+		case 'n':			/* indexing processes */
+			if (argv[a][2] || a >= argc-1)
+				goto userr;
+			nprocs = atoi(argv[++a]);
+			if ((nprocs <= 0) | (nprocs > MAXPROC))
+				goto userr;
+			break;
 		case 'w':			/* warnings on/off */
 			warnings = !warnings;
 			break;
@@ -636,7 +814,7 @@ main(int argc, char *argv[])
 	return(0);
 userr:
 	fprintf(stderr,
-"Usage: %s [-h[io]][-w][-f[afdb][N]][-t][-ic in_col][-ir in_row][-oc out_col][-or out_row] [input.dat]\n",
+"Usage: %s [-h[io]][-w][-n nproc][-f[afdb][N]][-t][-ic in_col][-ir in_row][-oc out_col][-or out_row] [input.dat]\n",
 			argv[0]);
 	return(1);
 }
@@ -0,0 +1,231 @@
+#ifndef lint
+static const char	RCSid[] = "$Id$";
+#endif
+/*
+ *  rqbench.c - compare ray throughput over pipes and a shared queue.
+ *
+ *  Rays are read from the standard input as ascii origin/direction
+ *  pairs, then sent to the given rtrace command, first as binary doubles
+ *  over its standard input and output, then through a ray queue.
+ *  Rays per second for each path and the largest difference between
+ *  their results are reported on the standard output.
+ */
+
+#include "copyright.h"
+
+#include  <stdio.h>
+#include  <stdlib.h>
+#include  <string.h>
+#include  <sys/time.h>
+
+#include  "platform.h"
+#include  "rtio.h"
+#include  "rtprocess.h"
+#include  "rayqueue.h"
+
+char	*progname;
+
+int	batch = 1024;			/* rays per batch */
+int	nreps = 1;			/* passes over ray list */
+
+double	*rayv = NULL;			/* loaded origins & directions */
+long	nrays = 0;			/* rays loaded */
+
+
+static double
+now(void)			/* get time in seconds */
+{
+	struct timeval  tv;
+
+	gettimeofday(&tv, NULL);
+	return(tv.tv_sec + 1e-6*tv.tv_usec);
+}
+
+
+static void
+loadrays(void)			/* read ascii rays from stdin */
+{
+	long	nalloc = 0;
+	double	v[6];
+
+	while (scanf("%lf %lf %lf %lf %lf %lf",
+			v, v+1, v+2, v+3, v+4, v+5) == 6) {
+		int	i;
+		if (nrays >= nalloc) {
+			nalloc += nalloc + 1024;
+			rayv = (double *)realloc(rayv, sizeof(double)*6*nalloc);
+			if (rayv == NULL) {
+				fputs(progname, stderr);
+				fputs(": out of memory\n", stderr);
+				exit(1);
+			}
+		}
+		for (i = 0; i < 6; i++)
+			rayv[6*nrays + i] = v[i];
+		nrays++;
+	}
+}
+
+
+static double
+pipetrace(			/* trace rays via pipes, return time */
+	char  *av[],
+	float  *res
+)
+{
+	static double	zray[6], zres[3];
+	SUBPROC	sp;
+	char	**nav;
+	double	*dres, t0;
+	long	i, j, n;
+	int	ac, r;
+
+	for (ac = 0; av[ac] != NULL; ac++)
+		;
+	nav = (char **)malloc((ac+4)*sizeof(char *));
+	dres = (double *)malloc(sizeof(double)*3*batch);
+	if ((nav == NULL) | (dres == NULL))
+		return(-1.);
+	nav[0] = av[0];			/* doubles, as in the queue */
+	nav[1] = "-h-"; nav[2] = "-fd";
+	memcpy(nav+3, av+1, ac*sizeof(char *));
+	sp.w = sp.r = -1; sp.running = 0;
+	if (open_process(&sp, nav) <= 0)
+		return(-1.);
+	t0 = now();
+	for (r = 0; r < nreps; r++)
+		for (i = 0; i < nrays; i += n) {
+			n = nrays - i;
+			if (n > batch) n = batch;
+			if (writebuf(sp.w, (char *)(rayv + 6*i),
+					sizeof(double)*6*n) != sizeof(double)*6*n)
+				return(-1.);
+					/* zero ray flushes batch */
+			if (writebuf(sp.w, (char *)zray, sizeof(zray)) !=
+					sizeof(zray))
+				return(-1.);
+			if (readbuf(sp.r, (char *)dres,
+					sizeof(double)*3*n) != sizeof(double)*3*n)
+				return(-1.);
+			if (readbuf(sp.r, (char *)zres, sizeof(zres)) !=
+					sizeof(zres))
+				return(-1.);
+			for (j = 3*n; j--; )
+				res[3*i + j] = dres[j];
+		}
+	t0 = now() - t0;
+	close_process(&sp);
+	free(dres);
+	free(nav);
+	return(t0);
+}
+
+
+static double
+queuetrace(			/* trace rays via queue, return time */
+	char  *av[],
+	float  *res
+)
+{
+	char	qfile[] = TEMPLATE;
+	RAYQ	*rq;
+	RQREC	*rr;
+	double	t0;
+	long	i, j, n;
+	int	r;
+
+	if ((r = mkstemp(qfile)) < 0)
+		return(-1.);
+	close(r);
+	if ((rq = rq_open(qfile, batch+1, av)) == NULL)
+		return(-1.);
+	t0 = now();
+	for (r = 0; r < nreps; r++)
+		for (i = 0; i < nrays; i += n) {
+			for (n = 0; n < batch && i+n < nrays; n++) {
+				rr = rq_next(rq);
+				for (j = 0; j < 3; j++) {
+					rr->org[j] = rayv[6*(i+n) + j];
+					rr->dir[j] = rayv[6*(i+n) + 3+j];
+				}
+			}
+			rr = rq_next(rq);	/* zero ray, as over pipe */
+			memset(rr->org, 0, sizeof(rr->org));
+			memset(rr->dir, 0, sizeof(rr->dir));
+			rq_submit(rq);
+			for (j = 0; j <= n; j++) {
+				if ((rr = rq_result(rq)) == NULL)
+					return(-1.);
+				if (j < n)
+					memcpy(res + 3*(i+j), rr->val,
+							sizeof(float)*3);
+			}
+		}
+	t0 = now() - t0;
+	rq_close(rq);
+	return(t0);
+}
+
+
+int
+main(int argc, char *argv[])
+{
+	float	*pres, *qres;
+	double	tp, tq, d, maxd = 0;
+	long	i;
+	int	a;
+
+	progname = argv[0];
+	for (a = 1; a < argc && argv[a][0] == '-'; a++)
+		switch (argv[a][1]) {
+		case 'b':			/* rays per batch */
+			if (a >= argc-1) goto userr;
+			batch = atoi(argv[++a]);
+			if (batch <= 0) goto userr;
+			break;
+		case 'r':			/* repetitions */
+			if (a >= argc-1) goto userr;
+			nreps = atoi(argv[++a]);
+			if (nreps <= 0) goto userr;
+			break;
+		default:
+			goto userr;
+		}
+	if (a >= argc-1)
+		goto userr;
+	loadrays();
+	if (!nrays) {
+		fprintf(stderr, "%s: no rays on standard input\n", progname);
+		return(1);
+	}
+	pres = (float *)malloc(sizeof(float)*3*nrays);
+	qres = (float *)malloc(sizeof(float)*3*nrays);
+	if ((pres == NULL) | (qres == NULL)) {
+		fprintf(stderr, "%s: out of memory\n", progname);
+		return(1);
+	}
+	if ((tp = pipetrace(argv+a, pres)) < 0) {
+		fprintf(stderr, "%s: pipe trace failed\n", progname);
+		return(1);
+	}
+	if ((tq = queuetrace(argv+a, qres)) < 0) {
+		fprintf(stderr, "%s: queue trace failed\n", progname);
+		return(1);
+	}
+	for (i = 3*nrays; i--; ) {
+		d = pres[i] - qres[i];
+		if (d < 0) d = -d;
+		if (d > maxd) maxd = d;
+	}
+	printf("%ld rays in batches of %d, %d pass(es)\n", nrays, batch, nreps);
+	printf("pipe:\t%.3f seconds\t%.0f rays/second\n",
+			tp, nrays*nreps/(tp + 1e-9));
+	printf("queue:\t%.3f seconds\t%.0f rays/second\n",
+			tq, nrays*nreps/(tq + 1e-9));
+	printf("largest difference in results: %g\n", maxd);
+	return(0);
+userr:
+	fprintf(stderr, "Usage: %s [-b batch][-r reps] rtrace [options] octree < rays\n",
+			progname);
+	return(1);
+}